@@ -0,0 +1,43 @@
+#pragma once
+
+#include <algorithm>
+
+// positions & masking of query rows in one call of an attention kernel
+//
+//   row m of q is the query of position pos(m) = pos0 + m * pos_step, key n is of position n
+//   (pos_step is 0 when the single query of all heads in a group are stacked as rows)
+//
+//   causal      : key n is masked if n > pos(m)
+//   window > 0  : key n is masked if n <= pos(m) - window (sliding-window / local attention)
+//   alibi       : slope(m) * (n - pos(m)) is added to scaled q*k' (ALiBi), slope of row m
+//                 is alibi[m * alibi_stride] (stride 0 when all rows are of the same head)
+//
+// so row m attends keys [key_begin(m), key_end(m, N)), both are non-decreasing in m
+struct AttnMask {
+    int pos0 = 0;
+    int pos_step = 1;
+    bool causal = false;
+    int window = 0;
+    const float * alibi = nullptr;
+    int alibi_stride = 0;
+
+    int pos(int m) const {
+        return pos0 + m * pos_step;
+    }
+    int key_begin(int m) const {
+        return window > 0 ? std::max(0, pos(m) - window + 1) : 0;
+    }
+    int key_end(int m, int N) const {
+        return causal ? std::max(0, std::min(N, pos(m) + 1)) : N;
+    }
+    float slope(int m) const {
+        return alibi ? alibi[m * alibi_stride] : 0.0f;
+    }
+    // rows start from m0 & keys start from n0 (the kernel sees key n0 as key 0)
+    AttnMask shift(int m0, int n0) const {
+        AttnMask ret = *this;
+        ret.pos0 = pos(m0) - n0;
+        if (alibi) ret.alibi = alibi + m0 * alibi_stride;
+        return ret;
+    }
+};
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// CPU features detected at runtime (CPUID + XCR0), so a binary built for baseline x86-64
+// can pick the best kernels of the machine it actually runs on.
+//
+// a feature is usable only when the CPU reports it and the OS saves/restores the registers
+// it needs (XCR0 bits), AMX further requires per-process permission of XTILEDATA on Linux.
+// nothing here needs to be compiled with -mavx* flags, nor includes the kernel headers (per-ISA
+// translation units include this header at global scope, see linear/linear_isa.hpp).
+struct CpuFeatures {
+    bool avx2 = false;
+    bool fma = false;
+    bool f16c = false;
+    bool avx512f = false;
+    bool avx512bw = false;
+    bool avx512vl = false;
+    bool avx512dq = false;
+    bool avx512_vnni = false;
+    bool avx512_bf16 = false;
+    bool amx_tile = false;
+    bool amx_bf16 = false;
+    bool amx_int8 = false;
+
+    static const CpuFeatures & get() {
+        static CpuFeatures features;
+        return features;
+    }
+
+private:
+    static void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t r[4]) {
+#ifdef _WIN32
+        int regs[4];
+        __cpuidex(regs, leaf, subleaf);
+        memcpy(r, regs, sizeof(regs));
+#else
+        if (!__get_cpuid_count(leaf, subleaf, &r[0], &r[1], &r[2], &r[3]))
+            r[0] = r[1] = r[2] = r[3] = 0;
+#endif
+    }
+
+    static uint64_t xgetbv0() {
+#ifdef _WIN32
+        return _xgetbv(0);
+#else
+        uint32_t eax, edx;
+        __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+    }
+
+    static bool bit(uint32_t r, int i) {
+        return (r >> i) & 1;
+    }
+
+public:
+    // ask the kernel for XTILEDATA permission (as initXTILE() of misc.hpp, without the kernel headers)
+    static bool request_xtiledata() {
+#ifdef _WIN32
+        return false;
+#else
+        // ARCH_GET_XCOMP_PERM, ARCH_REQ_XCOMP_PERM, XFEATURE_XTILEDATA
+        const int get_perm = 0x1022, req_perm = 0x1023, xtiledata = 18;
+        unsigned long bitmask = 0;
+        if (syscall(SYS_arch_prctl, get_perm, &bitmask) != 0)
+            return false;
+        if (bitmask & (1ul << xtiledata))
+            return true;
+        if (syscall(SYS_arch_prctl, req_perm, xtiledata) != 0)
+            return false;
+        return syscall(SYS_arch_prctl, get_perm, &bitmask) == 0 && (bitmask & (1ul << xtiledata));
+#endif
+    }
+
+private:
+
+    CpuFeatures() {
+        uint32_t r[4];
+        cpuid(0, 0, r);
+        uint32_t max_leaf = r[0];
+
+        cpuid(1, 0, r);
+        bool osxsave = bit(r[2], 27);
+        if (!osxsave || !bit(r[2], 28))
+            return;
+        uint64_t xcr0 = xgetbv0();
+        bool os_ymm = (xcr0 & 0x6) == 0x6;             // XMM | YMM
+        bool os_zmm = (xcr0 & 0xE6) == 0xE6;           // + opmask | ZMM_Hi256 | Hi16_ZMM
+        bool os_tile = (xcr0 & 0x60000) == 0x60000;    // XTILECFG | XTILEDATA
+        if (!os_ymm)
+            return;
+        fma = bit(r[2], 12);
+        f16c = bit(r[2], 29);
+        if (max_leaf < 7)
+            return;
+
+        cpuid(7, 0, r);
+        uint32_t max_subleaf = r[0];
+        avx2 = bit(r[1], 5);
+        if (os_zmm) {
+            avx512f = bit(r[1], 16);
+            avx512dq = bit(r[1], 17);
+            avx512bw = bit(r[1], 30);
+            avx512vl = bit(r[1], 31);
+            avx512_vnni = bit(r[2], 11);
+        }
+        if (os_zmm && os_tile) {
+            amx_bf16 = bit(r[3], 22);
+            amx_tile = bit(r[3], 24);
+            amx_int8 = bit(r[3], 25);
+        }
+        if (os_zmm && max_subleaf >= 1) {
+            cpuid(7, 1, r);
+            avx512_bf16 = bit(r[0], 5);
+        }
+    }
+};
+
+// instruction sets with kernels, in increasing order of preference
+enum class ISA {
+    none = 0,
+    avx2,           // AVX2 + FMA
+    avx512,         // AVX512 F/BW/VL/DQ
+    avx512_bf16,    // AVX512 + AVX512-BF16 (Cooperlake...), opt-in only (see max_isa())
+    amx,            // AMX-BF16 + AVX512-BF16
+};
+
+inline const char * isa_name(ISA isa) {
+    switch(isa) {
+        case ISA::avx2: return "avx2";
+        case ISA::avx512: return "avx512";
+        case ISA::avx512_bf16: return "avx512_bf16";
+        case ISA::amx: return "amx";
+        default: return "none";
+    }
+}
+
+inline bool isa_supported(ISA isa) {
+    auto & f = CpuFeatures::get();
+    bool has_avx2 = f.avx2 && f.fma;
+    bool has_avx512 = has_avx2 && f.avx512f && f.avx512bw && f.avx512vl && f.avx512dq;
+    switch(isa) {
+        case ISA::none: return true;
+        case ISA::avx2: return has_avx2;
+        case ISA::avx512: return has_avx512;
+        case ISA::avx512_bf16: return has_avx512 && f.avx512_bf16;
+        case ISA::amx: {
+#ifdef _WIN32
+            return false;
+#else
+            // ask the kernel for XTILEDATA permission once
+            static bool xtile_ok = has_avx512 && f.avx512_bf16 && f.amx_tile && f.amx_bf16 && CpuFeatures::request_xtiledata();
+            return xtile_ok;
+#endif
+        }
+    }
+    return false;
+}
+
+// best ISA usable on current CPU, can be capped by env MAX_ISA=avx2/avx512/amx (e.g. to test
+// or benchmark lower-ISA kernels on a newer machine). avx512_bf16 is never chosen here: it
+// computes fp32 inputs in bf16, so it's only used when asked for explicitly
+inline ISA max_isa() {
+    static ISA best = []() {
+        ISA cap = ISA::amx;
+        if (auto * env = std::getenv("MAX_ISA")) {
+            for(auto isa : {ISA::none, ISA::avx2, ISA::avx512, ISA::amx})
+                if (strcmp(env, isa_name(isa)) == 0) cap = isa;
+        }
+        ISA ret = ISA::none;
+        for(auto isa : {ISA::avx2, ISA::avx512, ISA::amx})
+            if (isa <= cap && isa_supported(isa)) ret = isa;
+        return ret;
+    }();
+    return best;
+}
@@ -0,0 +1,206 @@
+#pragma once
+
+#include "kernels_amx.hpp"
+#include "matmul16m.hpp"
+#include <cmath>
+#include <vector>
+
+#include <omp.h>
+
+// Linear layer of the decoding phase (M <= 16 rows), grown out of the fc16m benchmarks
+// (weight_compression/fc16m.cpp: MultiThreaded<WType> with matmul16m_base/matmul16m_Wint8B)
+//
+//   C[M, N] = pp(A[M, K] * W[K, N])
+//
+//  - W is split along N into one slice of whole 32-column panels per OpenMP thread. each slice
+//    is repacked by the thread which later consumes it, so its pages come from numa_alloc_local
+//    (USE_NUMA=1 of an ENABLE_NUMA build) or are first-touched on that thread's NUMA node.
+//    threads must be pinned (OMP_PROC_BIND=close or spread) for the placement to hold
+//  - bfloat16 W is kept in the 1x2 layout of Matmul<bf16,bf16> (repackB_1x2_panel)
+//  - int8_t W uses the same layout with a symmetric scale per output column. the scale is
+//    applied to the fp32 C tiles before pp (the "dequantize moved to post-process" variant of
+//    fc16m), and int8 tiles are expanded into bf16 2 tiles ahead by matmul16m_pingpong()
+//  - pp is any PP kernel (PP::BiasGeluStore gives the bias/GELU/ReLU epilogues), it gets the
+//    32x32 buffC at global (m, n) just as from Matmul, so bias must be readable up to rndup(N, 32)
+//  - M > 16 is done in blocks of 16 rows which stream the weights again, Matmul is better there
+namespace amx_kernel {
+
+template<typename WType>
+struct DecodeLinear {
+    static_assert(std::is_same<WType, ov::bfloat16>::value || std::is_same<WType, int8_t>::value,
+                  "DecodeLinear only support ov::bfloat16/int8_t weights");
+
+    struct Slice {
+        int n0 = 0;                     // columns [n0, n1) of W
+        int n1 = 0;
+        tensor2D<WType> W;              // one [K_padded x 32] panel per row
+        tensor2D<float> scales;         // int8 only: dequantize scales of the columns
+        tensor2D<float> buffC;
+    };
+
+    int K = 0;
+    int N = 0;
+    int K_padded = 0;
+    std::vector<Slice> slices;
+
+    // W : K x N (or N x K if transposeW), bf16 or fp32, K >= 32
+    template<typename TW>
+    DecodeLinear(tensor_view<TW> W, bool transposeW = false) {
+        K = W.dims[transposeW ? 1 : 0];
+        N = W.dims[transposeW ? 0 : 1];
+        assert(K >= 32);
+        K_padded = rndup(K, 32);
+        slices.resize(get_nthr());
+        #pragma omp parallel
+        {
+            int nthr = omp_get_num_threads();
+            for(int s = omp_get_thread_num(); s < static_cast<int>(slices.size()); s += nthr)
+                init_slice(s, W, transposeW);
+        }
+    }
+
+    template<typename TW>
+    void init_slice(int s, tensor_view<TW> W, bool transposeW) {
+        auto & sl = slices[s];
+        int p0, p1;
+        splitter((N + 31) / 32, static_cast<int>(slices.size()), s, p0, p1);
+        sl.n0 = p0 * 32;
+        sl.n1 = std::min(N, p1 * 32);
+        sl.buffC.resize(32, 32);
+        if (p0 >= p1)
+            return;
+
+        // all allocations below happen in the thread owning the slice
+        sl.W.resize(p1 - p0, K_padded * 32);
+        tensor2D<ov::bfloat16> panel(1, K_padded * 32);
+        tensor2D<ov::bfloat16> Wb;
+        if (std::is_same<WType, int8_t>::value)
+            sl.scales.resize(1, (p1 - p0) * 32);
+        for(int p = p0; p < p1; p++) {
+            // the panel of fp32 W is converted first, so its repack is the same as bf16's
+            tensor_view<ov::bfloat16> src;
+            if (std::is_same<TW, ov::bfloat16>::value) {
+                src = reinterpret_cast<tensor_view<ov::bfloat16>&>(W);
+            } else {
+                Wb.resize(transposeW ? 32 : K, transposeW ? K : 32);
+                int rows = transposeW ? std::min(32, N - p * 32) : K;
+                int cols = transposeW ? K : std::min(32, N - p * 32);
+                for(int r = 0; r < rows; r++)
+                    for(int c = 0; c < cols; c++)
+                        Wb(r, c) = static_cast<float>(transposeW ? W(p * 32 + r, c) : W(r, p * 32 + c));
+                src = Wb.view().Slice(0, rows, 0, cols);
+            }
+            int n = std::is_same<TW, ov::bfloat16>::value ? p * 32 : 0;
+            auto * dst = std::is_same<WType, ov::bfloat16>::value ? reinterpret_cast<int8_t*>(&sl.W(p - p0, 0))
+                                                                  : reinterpret_cast<int8_t*>(&panel[0]);
+            repackB_1x2_panel(dst, src, n, transposeW);
+            if (std::is_same<WType, int8_t>::value)
+                quantize_panel(reinterpret_cast<int8_t*>(&sl.W(p - p0, 0)), &panel[0], &sl.scales(0, (p - p0) * 32));
+        }
+    }
+
+    // symmetric per-column int8 of a repacked bf16 panel: element i is in tile i / 512 which
+    // holds columns [0, 16) or [16, 32) by parity, with 2 k-rows of each column in a tile row
+    void quantize_panel(int8_t * dst, const ov::bfloat16 * src, float * scales) {
+        auto col = [](int i) { return (i / 512) % 2 * 16 + (i % 32) / 2; };
+        int size = K_padded * 32;
+        float amax[32] = {0};
+        for(int i = 0; i < size; i++)
+            amax[col(i)] = std::max(amax[col(i)], std::abs(static_cast<float>(src[i])));
+        for(int c = 0; c < 32; c++)
+            scales[c] = amax[c] > 0 ? amax[c] / 127 : 1.0f;
+        for(int i = 0; i < size; i++) {
+            float q = std::nearbyint(static_cast<float>(src[i]) / scales[col(i)]);
+            dst[i] = static_cast<int8_t>(std::min(127.0f, std::max(-127.0f, q)));
+        }
+    }
+
+    // all slices over OpenMP threads, slice s on thread s when the team is the same as at construction
+    template<typename PP>
+    void operator()(tensor_view<ov::bfloat16> A, PP ppkernel) {
+        #pragma omp parallel
+        {
+            int nthr = omp_get_num_threads();
+            for(int s = omp_get_thread_num(); s < static_cast<int>(slices.size()); s += nthr)
+                (*this)(s, A, ppkernel);
+        }
+    }
+
+    // single slice, for callers already inside a parallel region (as drivers of Matmul are)
+    template<typename PP>
+    void operator()(int s, tensor_view<ov::bfloat16> A, PP & ppkernel) {
+        auto & sl = slices[s];
+        int M = A.dims[0];
+        assert(A.dims[1] == K);
+        if (sl.n0 >= sl.n1)
+            return;
+
+        int panels = sl.W.dims[0];
+        int KB = K_padded / 32;
+        // K tails are loaded into A tile right-aligned, as repackB_1x2_panel expects
+        int Kbackoff = K_padded - K;
+        auto strideA = A.stride;
+        constexpr int prefetch_ahead = 4096 * 48;
+
+        for(int m0 = 0; m0 < M; m0 += 16) {
+            int valid_m = std::min(M - m0, 16);
+            auto * pA0 = &A(m0, 0);
+            auto tileA = [&](int kb) {
+                return kb < KB - 1 ? pA0 + kb * 32 : pA0 + kb * 32 - Kbackoff;
+            };
+            auto store = [&](int p) {
+                auto & buffC = sl.buffC;
+                _tile_stored(0, &buffC(0, 0), buffC.stride);
+                _tile_stored(1, &buffC(0, 16), buffC.stride);
+                if (std::is_same<WType, int8_t>::value) {
+                    auto s0 = _mm512_loadu_ps(&sl.scales(0, p * 32));
+                    auto s1 = _mm512_loadu_ps(&sl.scales(0, p * 32 + 16));
+                    for(int i = 0; i < valid_m; i++) {
+                        _mm512_storeu_ps(&buffC(i, 0), _mm512_mul_ps(_mm512_loadu_ps(&buffC(i, 0)), s0));
+                        _mm512_storeu_ps(&buffC(i, 16), _mm512_mul_ps(_mm512_loadu_ps(&buffC(i, 16)), s1));
+                    }
+                }
+                int n = sl.n0 + p * 32;
+                ppkernel(buffC, m0, n, valid_m, std::min(32, N - n));
+            };
+
+            if (std::is_same<WType, ov::bfloat16>::value) {
+                // C: 0,1  A: 2  B: 3,4
+                tileconfig_t tfg(1, 0, {valid_m, valid_m, valid_m, 16, 16}, 64);
+                auto * pB = reinterpret_cast<ov::bfloat16*>(&sl.W(0, 0));
+                for(int p = 0; p < panels; p++) {
+                    _tile_zero(0);
+                    _tile_zero(1);
+                    for(int kb = 0; kb < KB; kb++) {
+                        _tile_loadd(2, tileA(kb), strideA);
+                        prefetch_bytes<1024, _MM_HINT_T1, prefetch_ahead>(pB);
+                        _tile_loadd(3, pB, 64); pB += 16 * 32;
+                        prefetch_bytes<1024, _MM_HINT_T1, prefetch_ahead>(pB);
+                        _tile_loadd(4, pB, 64); pB += 16 * 32;
+                        _tile_dpbf16ps(0, 2, 3);
+                        _tile_dpbf16ps(1, 2, 4);
+                    }
+                    store(p);
+                }
+            } else {
+                // int8 weights of the slice are one sequential stream
+                auto * pBint = reinterpret_cast<int8_t*>(&sl.W(0, 0));
+                auto expand_tile = [&](ov::bfloat16 * dst, int) {
+                    prefetch_bytes<512, _MM_HINT_T1, prefetch_ahead>(pBint);
+                    functional::i8_to_bf16_Kx32<16>(pBint, dst);
+                };
+                matmul16m_pingpong(A.Slice(m0, m0 + valid_m, 0, K), 0, panels, expand_tile, store);
+            }
+        }
+    }
+
+    // bytes of weights streamed by each call (per 16 rows of A)
+    size_t weight_bytes() const {
+        size_t bytes = 0;
+        for(auto & sl : slices)
+            bytes += static_cast<size_t>(sl.W.dims[0]) * K_padded * 32 * sizeof(WType);
+        return bytes;
+    }
+};
+
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+namespace ov {
+
+// IEEE half precision storage type, only conversion from/to float is provided
+// (vectorized kernels convert with F16C/AVX-512 vcvtph2ps & vcvtps2ph instead)
+class float16 {
+public:
+    constexpr float16() : m_value{0} {}
+
+    // round to nearest even, same as vcvtps2ph with _MM_FROUND_TO_NEAREST_INT
+    float16(float value) : m_value{from_float(value)} {}
+
+    template <typename I>
+    explicit float16(I value) : float16{static_cast<float>(value)} {}
+
+    operator float() const {
+        return to_float(m_value);
+    }
+
+    static constexpr float16 from_bits(uint16_t bits) {
+        return float16(bits, true);
+    }
+    uint16_t to_bits() const {
+        return m_value;
+    }
+
+    friend std::ostream& operator<<(std::ostream& out, const float16& obj) {
+        out << static_cast<float>(obj);
+        return out;
+    }
+
+private:
+    constexpr float16(uint16_t x, bool) : m_value{x} {}
+
+    static uint16_t from_float(float f) {
+        uint32_t x;
+        memcpy(&x, &f, sizeof(x));
+        uint32_t sign = (x >> 16) & 0x8000;
+        uint32_t absx = x & 0x7FFFFFFF;
+        if (absx >= 0x7F800000)                         // inf/nan
+            return sign | 0x7C00 | (absx > 0x7F800000 ? 0x200 | ((absx >> 13) & 0x3FF) : 0);
+        if (absx >= 0x477FF000)                         // rounds to >= 65520 : overflow to inf
+            return sign | 0x7C00;
+        if (absx < 0x38800000) {                        // subnormal or zero in fp16
+            if (absx < 0x33000000)                      // < half of smallest subnormal
+                return sign;
+            uint32_t mant = (absx & 0x7FFFFF) | 0x800000;
+            int shift = 126 - (absx >> 23);             // 14 ~ 24
+            uint32_t half = mant >> shift;
+            uint32_t rem = mant & ((1u << shift) - 1);
+            uint32_t mid = 1u << (shift - 1);
+            if (rem > mid || (rem == mid && (half & 1)))
+                half++;
+            return sign | half;
+        }
+        // normal: rebias exponent (127 -> 15) & round 23-bit mantissa to 10 bits
+        uint32_t h = (absx - 0x38000000) >> 13;
+        uint32_t rem = absx & 0x1FFF;
+        if (rem > 0x1000 || (rem == 0x1000 && (h & 1)))
+            h++;
+        return sign | h;
+    }
+
+    static float to_float(uint16_t h) {
+        uint32_t sign = (h & 0x8000u) << 16;
+        uint32_t exp = (h >> 10) & 0x1F;
+        uint32_t mant = h & 0x3FF;
+        uint32_t x;
+        if (exp == 0x1F) {
+            x = sign | 0x7F800000 | (mant << 13);
+        } else if (exp) {
+            x = sign | ((exp + 112) << 23) | (mant << 13);
+        } else if (mant) {
+            // subnormal: normalize
+            int e = 113;
+            while (!(mant & 0x400)) {
+                mant <<= 1;
+                e--;
+            }
+            x = sign | (e << 23) | ((mant & 0x3FF) << 13);
+        } else {
+            x = sign;
+        }
+        float f;
+        memcpy(&f, &x, sizeof(f));
+        return f;
+    }
+
+    uint16_t m_value;
+};
+
+}
@@ -224,13 +224,16 @@ class Singleton {
   }
 };
 
+// ldtilecfg/tilerelease through the thread-local tilecfg_cache (tilecfg.hpp), so a scope of the
+// config already loaded costs nothing
 class TileConfigScope {
  public:
   TileConfigScope(const TileConfig& cfg) {
-    (Singleton<TileConfiger>::get())(&cfg);
+    tilecfg_cache::get().load(&cfg);
   };
   void update(const TileConfig& cfg) {
-    (Singleton<TileConfiger>::get())(&cfg);
+    tilecfg_cache::get().load(&cfg);
   }
-  ~TileConfigScope() { (Singleton<TileConfiger>::get())(nullptr); }
+  ~TileConfigScope() { tilecfg_cache::get().release(); }
 };
+static_assert(sizeof(TileConfig) == 64, "TileConfig must be 64 bytes");
@@ -20,6 +20,11 @@ matmul:
 #include "misc.hpp"
 #include "block_iter.hpp"
 #include "tensor2D.hpp"
+#include "reorder.hpp"
+#include "kernels_avx512.hpp"
+#include "mvn_avx512.hpp"
+#include <atomic>
+#include <cmath>
 
 #ifdef _WIN32
 #include <intrin.h>
@@ -28,264 +33,101 @@ matmul:
 #endif
 
 #include "bf16.hpp"
+#include "fp16.hpp"
 #ifdef ENABLE_NUMA
 #include "numa.h"
 #endif
 
 namespace amx_kernel {
 
-namespace functional {
-
-    inline void transpose_m512i_16x16(__m512i &r0, __m512i &r1, __m512i &r2, __m512i &r3,
-                               __m512i &r4, __m512i &r5, __m512i &r6, __m512i &r7,
-                               __m512i &r8, __m512i &r9, __m512i &ra, __m512i &rb,
-                               __m512i &rc, __m512i &rd, __m512i &re, __m512i &rf) {
-        __m512i t0, t1, t2, t3, t4, t5, t6, t7, t8, t9, ta, tb, tc, td, te, tf;
-
-        t0 = _mm512_unpacklo_epi32(r0,r1); //   0  16   1  17   4  20   5  21   8  24   9  25  12  28  13  29 
-        t1 = _mm512_unpackhi_epi32(r0,r1); //   2  18   3  19   6  22   7  23  10  26  11  27  14  30  15  31
-        t2 = _mm512_unpacklo_epi32(r2,r3); //  32  48  33  49 ...
-        t3 = _mm512_unpackhi_epi32(r2,r3); //  34  50  35  51 ...
-        t4 = _mm512_unpacklo_epi32(r4,r5); //  64  80  65  81 ...  
-        t5 = _mm512_unpackhi_epi32(r4,r5); //  66  82  67  83 ...
-        t6 = _mm512_unpacklo_epi32(r6,r7); //  96 112  97 113 ...
-        t7 = _mm512_unpackhi_epi32(r6,r7); //  98 114  99 115 ...
-        t8 = _mm512_unpacklo_epi32(r8,r9); // 128 ...
-        t9 = _mm512_unpackhi_epi32(r8,r9); // 130 ...
-        ta = _mm512_unpacklo_epi32(ra,rb); // 160 ...
-        tb = _mm512_unpackhi_epi32(ra,rb); // 162 ...
-        tc = _mm512_unpacklo_epi32(rc,rd); // 196 ...
-        td = _mm512_unpackhi_epi32(rc,rd); // 198 ...
-        te = _mm512_unpacklo_epi32(re,rf); // 228 ...
-        tf = _mm512_unpackhi_epi32(re,rf); // 230 ...
-
-        r0 = _mm512_unpacklo_epi64(t0,t2); //   0  16  32  48 ...
-        r1 = _mm512_unpackhi_epi64(t0,t2); //   1  17  33  49 ...
-        r2 = _mm512_unpacklo_epi64(t1,t3); //   2  18  34  49 ...
-        r3 = _mm512_unpackhi_epi64(t1,t3); //   3  19  35  51 ...
-        r4 = _mm512_unpacklo_epi64(t4,t6); //  64  80  96 112 ...  
-        r5 = _mm512_unpackhi_epi64(t4,t6); //  65  81  97 114 ...
-        r6 = _mm512_unpacklo_epi64(t5,t7); //  66  82  98 113 ...
-        r7 = _mm512_unpackhi_epi64(t5,t7); //  67  83  99 115 ...
-        r8 = _mm512_unpacklo_epi64(t8,ta); // 128 144 160 176 ...  
-        r9 = _mm512_unpackhi_epi64(t8,ta); // 129 145 161 178 ...
-        ra = _mm512_unpacklo_epi64(t9,tb); // 130 146 162 177 ... 
-        rb = _mm512_unpackhi_epi64(t9,tb); // 131 147 163 179 ...
-        rc = _mm512_unpacklo_epi64(tc,te); // 192 208 228 240 ... 
-        rd = _mm512_unpackhi_epi64(tc,te); // 193 209 229 241 ...
-        re = _mm512_unpacklo_epi64(td,tf); // 194 210 230 242 ...
-        rf = _mm512_unpackhi_epi64(td,tf); // 195 211 231 243 ...
-
-        t0 = _mm512_shuffle_i32x4(r0, r4, 0x88); //   0  16  32  48   8  24  40  56  64  80  96  112 ...
-        t1 = _mm512_shuffle_i32x4(r1, r5, 0x88); //   1  17  33  49 ...
-        t2 = _mm512_shuffle_i32x4(r2, r6, 0x88); //   2  18  34  50 ...
-        t3 = _mm512_shuffle_i32x4(r3, r7, 0x88); //   3  19  35  51 ...
-        t4 = _mm512_shuffle_i32x4(r0, r4, 0xdd); //   4  20  36  52 ...
-        t5 = _mm512_shuffle_i32x4(r1, r5, 0xdd); //   5  21  37  53 ...
-        t6 = _mm512_shuffle_i32x4(r2, r6, 0xdd); //   6  22  38  54 ...
-        t7 = _mm512_shuffle_i32x4(r3, r7, 0xdd); //   7  23  39  55 ...
-        t8 = _mm512_shuffle_i32x4(r8, rc, 0x88); // 128 144 160 176 ...
-        t9 = _mm512_shuffle_i32x4(r9, rd, 0x88); // 129 145 161 177 ...
-        ta = _mm512_shuffle_i32x4(ra, re, 0x88); // 130 146 162 178 ...
-        tb = _mm512_shuffle_i32x4(rb, rf, 0x88); // 131 147 163 179 ...
-        tc = _mm512_shuffle_i32x4(r8, rc, 0xdd); // 132 148 164 180 ...
-        td = _mm512_shuffle_i32x4(r9, rd, 0xdd); // 133 149 165 181 ...
-        te = _mm512_shuffle_i32x4(ra, re, 0xdd); // 134 150 166 182 ...
-        tf = _mm512_shuffle_i32x4(rb, rf, 0xdd); // 135 151 167 183 ...
-
-        r0 = _mm512_shuffle_i32x4(t0, t8, 0x88); //   0  16  32  48  64  80  96 112 ... 240
-        r1 = _mm512_shuffle_i32x4(t1, t9, 0x88); //   1  17  33  49  66  81  97 113 ... 241
-        r2 = _mm512_shuffle_i32x4(t2, ta, 0x88); //   2  18  34  50  67  82  98 114 ... 242
-        r3 = _mm512_shuffle_i32x4(t3, tb, 0x88); //   3  19  35  51  68  83  99 115 ... 243
-        r4 = _mm512_shuffle_i32x4(t4, tc, 0x88); //   4 ...
-        r5 = _mm512_shuffle_i32x4(t5, td, 0x88); //   5 ...
-        r6 = _mm512_shuffle_i32x4(t6, te, 0x88); //   6 ...
-        r7 = _mm512_shuffle_i32x4(t7, tf, 0x88); //   7 ...
-        r8 = _mm512_shuffle_i32x4(t0, t8, 0xdd); //   8 ...
-        r9 = _mm512_shuffle_i32x4(t1, t9, 0xdd); //   9 ...
-        ra = _mm512_shuffle_i32x4(t2, ta, 0xdd); //  10 ...
-        rb = _mm512_shuffle_i32x4(t3, tb, 0xdd); //  11 ...
-        rc = _mm512_shuffle_i32x4(t4, tc, 0xdd); //  12 ...
-        rd = _mm512_shuffle_i32x4(t5, td, 0xdd); //  13 ...
-        re = _mm512_shuffle_i32x4(t6, te, 0xdd); //  14 ...
-        rf = _mm512_shuffle_i32x4(t7, tf, 0xdd); //  15  31  47  63  79  96 111 127 ... 255
-    }
-
-    inline void transpose_epi32_16x16(void * _dst, const void * src, int stride) {
-        auto * dst = reinterpret_cast<uint32_t*>(_dst);
-        __m512i r0, r1, r2, r3, r4, r5, r6, r7, r8, r9, ra, rb, rc, rd, re, rf;
-        auto * pA = reinterpret_cast<const uint8_t*>(src);
-        r0 = _mm512_loadu_epi32(pA);
-        r1 = _mm512_loadu_epi32(pA + stride);
-        r2 = _mm512_loadu_epi32(pA + 2*stride);
-        r3 = _mm512_loadu_epi32(pA + 3*stride);
-        r4 = _mm512_loadu_epi32(pA + 4*stride);
-        r5 = _mm512_loadu_epi32(pA + 5*stride);
-        r6 = _mm512_loadu_epi32(pA + 6*stride);
-        r7 = _mm512_loadu_epi32(pA + 7*stride);
-        r8 = _mm512_loadu_epi32(pA + 8*stride);
-        r9 = _mm512_loadu_epi32(pA + 9*stride);
-        ra = _mm512_loadu_epi32(pA + 10*stride);
-        rb = _mm512_loadu_epi32(pA + 11*stride);
-        rc = _mm512_loadu_epi32(pA + 12*stride);
-        rd = _mm512_loadu_epi32(pA + 13*stride);
-        re = _mm512_loadu_epi32(pA + 14*stride);
-        rf = _mm512_loadu_epi32(pA + 15*stride);
-
-        transpose_m512i_16x16(r0, r1, r2, r3, r4, r5, r6, r7, r8, r9, ra, rb, rc, rd, re, rf);
-
-        _mm512_storeu_epi32(dst, r0);
-        _mm512_storeu_epi32(dst + 16, r1);
-        _mm512_storeu_epi32(dst + 2*16, r2);
-        _mm512_storeu_epi32(dst + 3*16, r3);
-        _mm512_storeu_epi32(dst + 4*16, r4);
-        _mm512_storeu_epi32(dst + 5*16, r5);
-        _mm512_storeu_epi32(dst + 6*16, r6);
-        _mm512_storeu_epi32(dst + 7*16, r7);
-        _mm512_storeu_epi32(dst + 8*16, r8);
-        _mm512_storeu_epi32(dst + 9*16, r9);
-        _mm512_storeu_epi32(dst + 10*16, ra);
-        _mm512_storeu_epi32(dst + 11*16, rb);
-        _mm512_storeu_epi32(dst + 12*16, rc);
-        _mm512_storeu_epi32(dst + 13*16, rd);
-        _mm512_storeu_epi32(dst + 14*16, re);
-        _mm512_storeu_epi32(dst + 15*16, rf);
-    }
+// optional A-prologue of bf16 Matmul: LayerNorm/RMSNorm of each A row (K elements) applied
+// while A is staged into bf16 tiles, gamma/beta (K elements) are optional
+struct NormA {
+    avx512::NormType type;
+    float eps;
+    const float * gamma;
+    const float * beta;
+};
 
-    // 16xN, N<=16, non-valid part is filled with zeros
-    void transpose_epi32_16xN(void * _dst, const void * src, int stride, int valid_bytes) {
-        auto * dst = reinterpret_cast<uint32_t*>(_dst);
-        __m512i r0, r1, r2, r3, r4, r5, r6, r7, r8, r9, ra, rb, rc, rd, re, rf;
-        auto * pA = reinterpret_cast<const uint8_t*>(src);
-        uint64_t mask_value = 0xFFFFFFFFFFFFFFFFull >> (64 - valid_bytes);
-        __mmask64 mask = _cvtu64_mask64(mask_value);
-        r0 = _mm512_maskz_loadu_epi8 (mask, pA);
-        r1 = _mm512_maskz_loadu_epi8 (mask, pA + stride);
-        r2 = _mm512_maskz_loadu_epi8 (mask, pA + 2*stride);
-        r3 = _mm512_maskz_loadu_epi8 (mask, pA + 3*stride);
-        r4 = _mm512_maskz_loadu_epi8 (mask, pA + 4*stride);
-        r5 = _mm512_maskz_loadu_epi8 (mask, pA + 5*stride);
-        r6 = _mm512_maskz_loadu_epi8 (mask, pA + 6*stride);
-        r7 = _mm512_maskz_loadu_epi8 (mask, pA + 7*stride);
-        r8 = _mm512_maskz_loadu_epi8 (mask, pA + 8*stride);
-        r9 = _mm512_maskz_loadu_epi8 (mask, pA + 9*stride);
-        ra = _mm512_maskz_loadu_epi8 (mask, pA + 10*stride);
-        rb = _mm512_maskz_loadu_epi8 (mask, pA + 11*stride);
-        rc = _mm512_maskz_loadu_epi8 (mask, pA + 12*stride);
-        rd = _mm512_maskz_loadu_epi8 (mask, pA + 13*stride);
-        re = _mm512_maskz_loadu_epi8 (mask, pA + 14*stride);
-        rf = _mm512_maskz_loadu_epi8 (mask, pA + 15*stride);
-        transpose_m512i_16x16(r0, r1, r2, r3, r4, r5, r6, r7, r8, r9, ra, rb, rc, rd, re, rf);
-        _mm512_storeu_epi32(dst, r0);
-        _mm512_storeu_epi32(dst + 16, r1);
-        _mm512_storeu_epi32(dst + 2*16, r2);
-        _mm512_storeu_epi32(dst + 3*16, r3);
-        _mm512_storeu_epi32(dst + 4*16, r4);
-        _mm512_storeu_epi32(dst + 5*16, r5);
-        _mm512_storeu_epi32(dst + 6*16, r6);
-        _mm512_storeu_epi32(dst + 7*16, r7);
-        _mm512_storeu_epi32(dst + 8*16, r8);
-        _mm512_storeu_epi32(dst + 9*16, r9);
-        _mm512_storeu_epi32(dst + 10*16, ra);
-        _mm512_storeu_epi32(dst + 11*16, rb);
-        _mm512_storeu_epi32(dst + 12*16, rc);
-        _mm512_storeu_epi32(dst + 13*16, rd);
-        _mm512_storeu_epi32(dst + 14*16, re);
-        _mm512_storeu_epi32(dst + 15*16, rf);
-    }
+namespace functional {
 
-    // 16xN, N<=16, non-valid part is on the left, filled with zeros
-    void transpose_epi32_16xN_right_align(void * _dst, const void * src, int stride, int valid_bytes) {
-        auto * dst = reinterpret_cast<uint32_t*>(_dst);
-        __m512i r0, r1, r2, r3, r4, r5, r6, r7, r8, r9, ra, rb, rc, rd, re, rf;
-        int invalid_bytes = 64 - valid_bytes;
-        auto * pA = reinterpret_cast<const uint8_t*>(src) - invalid_bytes;
-        uint64_t mask_value = 0xFFFFFFFFFFFFFFFFull << invalid_bytes;
-        __mmask64 mask = _cvtu64_mask64(mask_value);
-        r0 = _mm512_maskz_loadu_epi8 (mask, pA);
-        r1 = _mm512_maskz_loadu_epi8 (mask, pA + stride);
-        r2 = _mm512_maskz_loadu_epi8 (mask, pA + 2*stride);
-        r3 = _mm512_maskz_loadu_epi8 (mask, pA + 3*stride);
-        r4 = _mm512_maskz_loadu_epi8 (mask, pA + 4*stride);
-        r5 = _mm512_maskz_loadu_epi8 (mask, pA + 5*stride);
-        r6 = _mm512_maskz_loadu_epi8 (mask, pA + 6*stride);
-        r7 = _mm512_maskz_loadu_epi8 (mask, pA + 7*stride);
-        r8 = _mm512_maskz_loadu_epi8 (mask, pA + 8*stride);
-        r9 = _mm512_maskz_loadu_epi8 (mask, pA + 9*stride);
-        ra = _mm512_maskz_loadu_epi8 (mask, pA + 10*stride);
-        rb = _mm512_maskz_loadu_epi8 (mask, pA + 11*stride);
-        rc = _mm512_maskz_loadu_epi8 (mask, pA + 12*stride);
-        rd = _mm512_maskz_loadu_epi8 (mask, pA + 13*stride);
-        re = _mm512_maskz_loadu_epi8 (mask, pA + 14*stride);
-        rf = _mm512_maskz_loadu_epi8 (mask, pA + 15*stride);
-        transpose_m512i_16x16(r0, r1, r2, r3, r4, r5, r6, r7, r8, r9, ra, rb, rc, rd, re, rf);
-        _mm512_storeu_epi32(dst, r0);
-        _mm512_storeu_epi32(dst + 16, r1);
-        _mm512_storeu_epi32(dst + 2*16, r2);
-        _mm512_storeu_epi32(dst + 3*16, r3);
-        _mm512_storeu_epi32(dst + 4*16, r4);
-        _mm512_storeu_epi32(dst + 5*16, r5);
-        _mm512_storeu_epi32(dst + 6*16, r6);
-        _mm512_storeu_epi32(dst + 7*16, r7);
-        _mm512_storeu_epi32(dst + 8*16, r8);
-        _mm512_storeu_epi32(dst + 9*16, r9);
-        _mm512_storeu_epi32(dst + 10*16, ra);
-        _mm512_storeu_epi32(dst + 11*16, rb);
-        _mm512_storeu_epi32(dst + 12*16, rc);
-        _mm512_storeu_epi32(dst + 13*16, rd);
-        _mm512_storeu_epi32(dst + 14*16, re);
-        _mm512_storeu_epi32(dst + 15*16, rf);
-    }
+    // 16x16 dword transposes are shared with the reorder engine
+    using reorder::transpose_m512i_16x16;
+    using reorder::transpose_epi32_16x16;
+    using reorder::transpose_epi32_16xN;
+    using reorder::transpose_epi32_16xN_right_align;
+
+    // fp32 math shared with AVX-512 kernels
+    using avx512::functional::gelu_erf_minmax_approx;
+    using avx512::functional::exp_ps;
+
+    // load/store 16 floats as float/bf16
+    using avx512::functional::load_x16;
+    using avx512::functional::store_x16;
+
+    // AVX-512 version of avx2::functional::softmax_online (same arguments & results)
+    template<typename TO>
+    inline void softmax_online(TO * dst, const float * src, int N, int valid,
+                               float scale = 1.0f, const float * bias = nullptr, float slope = 0.0f, int dist0 = 0,
+                               float * s_max = nullptr, float * s_sum = nullptr) {
+        const auto lowest = _mm512_set1_ps(std::numeric_limits<float>::lowest());
+        const auto vscale = _mm512_set1_ps(scale);
+        const auto vslope = _mm512_set1_ps(slope);
+        const auto vlane = _mm512_set_ps(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+        // masked lanes are lowest, so they contribute exp(lowest - max) = 0
+        auto load_x = [&](int n, __mmask16 mask) {
+            auto x = _mm512_mul_ps(_mm512_maskz_loadu_ps(mask, src + n), vscale);
+            if (bias) x = _mm512_add_ps(x, _mm512_maskz_loadu_ps(mask, bias + n));
+            x = _mm512_fmadd_ps(_mm512_add_ps(vlane, _mm512_set1_ps(n + dist0)), vslope, x);
+            return _mm512_mask_mov_ps(lowest, mask, x);
+        };
+        auto tail_mask = [](int n) {
+            return _cvtu32_mask16(n >= 16 ? 0xFFFFu : ((1u << n) - 1));
+        };
 
-    // gelu_erf_minimax_approx_compute_vector_fwd in oneDNN
-    //   x*0.5*(1+erf(x/sqrt(2))) = x*0.5*(1 + x*Polynomial(x^2))
-    inline __m512 gelu_erf_minmax_approx(__m512 & x) {
-        auto x2 = _mm512_mul_ps(x, x); // x^2
-        
-        auto x_positive = _mm512_castsi512_ps(_mm512_and_epi32(_mm512_castps_si512(x), _mm512_set1_epi32(0x7FFFFFFF)));    // clear sign mask
-        auto x_half = _mm512_mul_ps(x, _mm512_set1_ps(0.5f));
-
-        auto poly = _mm512_castsi512_ps(_mm512_set1_epi32(0x1f1c83fd));
-        poly = _mm512_fmadd_ps(poly, x2, _mm512_castsi512_ps(_mm512_set1_epi32(0xa3198977))); // poly * x^2 + xxx
-        poly = _mm512_fmadd_ps(poly, x2, _mm512_castsi512_ps(_mm512_set1_epi32(0x268a7927)));
-        poly = _mm512_fmadd_ps(poly, x2, _mm512_castsi512_ps(_mm512_set1_epi32(0xa998c963)));
-        poly = _mm512_fmadd_ps(poly, x2, _mm512_castsi512_ps(_mm512_set1_epi32(0x2c67ddb2)));
-        poly = _mm512_fmadd_ps(poly, x2, _mm512_castsi512_ps(_mm512_set1_epi32(0xaf013b2c)));
-        poly = _mm512_fmadd_ps(poly, x2, _mm512_castsi512_ps(_mm512_set1_epi32(0x315d4a4f)));
-        poly = _mm512_fmadd_ps(poly, x2, _mm512_castsi512_ps(_mm512_set1_epi32(0xb3969b11)));
-        poly = _mm512_fmadd_ps(poly, x2, _mm512_castsi512_ps(_mm512_set1_epi32(0x35a776e9)));
-        poly = _mm512_fmadd_ps(poly, x2, _mm512_castsi512_ps(_mm512_set1_epi32(0xb79b0914)));
-        poly = _mm512_fmadd_ps(poly, x2, _mm512_castsi512_ps(_mm512_set1_epi32(0x3970b255)));
-        poly = _mm512_fmadd_ps(poly, x2, _mm512_castsi512_ps(_mm512_set1_epi32(0xbb1b7399)));
-        poly = _mm512_fmadd_ps(poly, x2, _mm512_castsi512_ps(_mm512_set1_epi32(0x3ca3621f)));
-        poly = _mm512_fmadd_ps(poly, x2, _mm512_castsi512_ps(_mm512_set1_epi32(0xbe082bc7)));
-        poly = _mm512_fmadd_ps(poly, x2, _mm512_castsi512_ps(_mm512_set1_epi32(0x3f4c4228)));
-
-        // 1.0f + erf(x * inv_sqrt2) = 1.0f + x * P(x^2)
-        poly = _mm512_fmadd_ps(poly, x, _mm512_set1_ps(1.0f));
-        // x*0.5*(1 + x*Polynomial(x^2))
-        poly = _mm512_mul_ps(poly, x_half);
-
-        // combine:
-        // zone_id
-        //  1 -inf; -saturation_lbound           : 0.0f
-        //  2 -saturation_lbound; -linear_ubound : x*0.5*(1 + x*Polynomial(x^2))
-        //  3 -linear_ubound, linear_ubound         : x*0.5
-        //  4 linear_ubound : saturation_lbound     : x*0.5*(1 + x*Polynomial(x^2))
-        //  5 saturation_lbound: +inf               : x
-        constexpr int neg_saturation_lbound = 0xc0a00000;
-        constexpr int linear_ubound = 0x33800000;
-        constexpr int saturation_lbound = 0x40a00000;
-
-        auto mask_x_not_zone1 = _mm512_cmpnlt_ps_mask(x, _mm512_castsi512_ps(_mm512_set1_epi32(neg_saturation_lbound)));
-        x = _mm512_maskz_mov_ps(mask_x_not_zone1, x);
-
-        auto mask_x_in_zone5 = _mm512_cmpnle_ps_mask(x_positive, _mm512_castsi512_ps(_mm512_set1_epi32(saturation_lbound)));
-        poly = _mm512_mask_mov_ps(poly, mask_x_in_zone5, x);
-
-        auto mask_x_in_zone3 = _mm512_cmple_ps_mask(x_positive, _mm512_castsi512_ps(_mm512_set1_epi32(linear_ubound)));
-        poly = _mm512_mask_mov_ps(poly, mask_x_in_zone3, x_half);
-        return poly;
+        auto v_max = lowest;
+        auto v_sum = _mm512_setzero_ps();
+        int n = 0;
+        for(; n + 64 <= valid; n += 64) {
+            auto x0 = load_x(n, 0xFFFF);
+            auto x1 = load_x(n + 16, 0xFFFF);
+            auto x2 = load_x(n + 32, 0xFFFF);
+            auto x3 = load_x(n + 48, 0xFFFF);
+            auto new_max = _mm512_max_ps(_mm512_max_ps(x0, x1), _mm512_max_ps(x2, x3));
+            new_max = _mm512_max_ps(new_max, v_max);
+            auto r = exp_ps(_mm512_sub_ps(v_max, new_max));
+            x0 = exp_ps(_mm512_sub_ps(x0, new_max));
+            x1 = exp_ps(_mm512_sub_ps(x1, new_max));
+            x2 = exp_ps(_mm512_sub_ps(x2, new_max));
+            x3 = exp_ps(_mm512_sub_ps(x3, new_max));
+            v_sum = _mm512_fmadd_ps(v_sum, r, _mm512_add_ps(_mm512_add_ps(x0, x1), _mm512_add_ps(x2, x3)));
+            v_max = new_max;
+        }
+        for(; n < valid; n += 16) {
+            auto mask = tail_mask(valid - n);
+            auto x = load_x(n, mask);
+            auto new_max = _mm512_max_ps(v_max, x);
+            auto r = exp_ps(_mm512_sub_ps(v_max, new_max));
+            x = _mm512_maskz_mov_ps(mask, exp_ps(_mm512_sub_ps(x, new_max)));
+            v_sum = _mm512_fmadd_ps(v_sum, r, x);
+            v_max = new_max;
+        }
+        // merge lanes
+        float max = _mm512_reduce_max_ps(v_max);
+        auto x_max = _mm512_set1_ps(max);
+        float sum = _mm512_reduce_add_ps(_mm512_mul_ps(v_sum, exp_ps(_mm512_sub_ps(v_max, x_max))));
+        if (s_max) *s_max = max;
+        if (s_sum) *s_sum = sum;
+        auto reciprocal_sum = _mm512_set1_ps(sum > 0 ? 1.0f / sum : 0.0f);
+
+        // normalize & store
+        for(n = 0; n < valid; n += 16) {
+            auto mask = tail_mask(valid - n);
+            auto x = exp_ps(_mm512_sub_ps(load_x(n, mask), x_max));
+            store_x16(dst + n, _mm512_mul_ps(x, reciprocal_sum), mask);
+        }
+        if (valid < N)
+            memset(dst + valid, 0, (N - valid) * sizeof(TO));
     }
 
 
@@ -390,6 +232,11 @@ namespace functional {
         }
     }
 
+    // bytes are only moved, so u8 B is packed the same as s8
+    inline void kpack_tile_B0B1(void * _dst0, void * _dst1, const uint8_t * _src, int stride, int src_rows) {
+        kpack_tile_B0B1(_dst0, _dst1, reinterpret_cast<const int8_t *>(_src), stride, src_rows);
+    }
+
     void kpack_tile_B0B1(void * _dst0, void * _dst1, const ov::bfloat16 * _src, int stride, int src_rows) {
         static const uint64_t idx[8] = {0,4,1,5,2,6,3,7};
         auto midx = _mm512_loadu_epi64(idx);
@@ -462,7 +309,7 @@ namespace functional {
     //   0 2 4 6 ... ...
     //   1 3 5 7 ... ...
 
-    inline void get_min_max(tensor2D<ov::bfloat16> & matB, float& min, float& max) {
+    inline void get_min_max(tensor_view<ov::bfloat16> matB, float& min, float& max) {
         int K = matB.dims[0];
         int N = matB.dims[1];
         auto m_max = _mm512_set1_ps(-__FLT_MAX__);
@@ -505,7 +352,7 @@ namespace functional {
         }
     }
 
-    void bf16_to_i8_tensor(tensor2D<int8_t>& dst, tensor2D<ov::bfloat16>& src, float quant_scale) {
+    void bf16_to_i8_tensor(tensor2D<int8_t>& dst, tensor_view<ov::bfloat16> src, float quant_scale) {
         dst.resize(src.dims[0], src.dims[1]);
         auto scale = _mm512_set1_ps(quant_scale);
         for (int k = 0; k < src.dims[0]; k++) {
@@ -521,6 +368,129 @@ namespace functional {
             }
         }
     }
+
+    // convert lanes of src[0, 32) selected by k into bf16 (round to nearest even), other lanes
+    // are zero (and not read), all 32 elements of dst are written
+    inline void cvt_bf16_x32_mask(ov::bfloat16 * dst, const float * src, __mmask32 k) {
+        auto r0 = _mm512_maskz_loadu_ps(static_cast<__mmask16>(k), src);
+        auto r1 = _mm512_maskz_loadu_ps(static_cast<__mmask16>(k >> 16), src + 16);
+        auto c = _mm512_cvtne2ps_pbh(r1, r0);
+        _mm512_storeu_epi16(dst, reinterpret_cast<__m512i&>(c));
+    }
+    inline void cvt_bf16_x32_mask(ov::bfloat16 * dst, const ov::float16 * src, __mmask32 k) {
+        auto h = _mm512_maskz_loadu_epi16(k, src);
+        auto r0 = _mm512_cvtph_ps(_mm512_castsi512_si256(h));
+        auto r1 = _mm512_cvtph_ps(_mm512_extracti64x4_epi64(h, 1));
+        auto c = _mm512_cvtne2ps_pbh(r1, r0);
+        _mm512_storeu_epi16(dst, reinterpret_cast<__m512i&>(c));
+    }
+    inline void cvt_bf16_x32_mask(ov::bfloat16 * dst, const ov::bfloat16 * src, __mmask32 k) {
+        _mm512_storeu_epi16(dst, _mm512_maskz_loadu_epi16(k, src));
+    }
+
+    // convert (at most 32) elements into bf16, the rest of 32 destination elements are zero
+    template<typename TS>
+    inline void cvt_bf16_x32(ov::bfloat16 * dst, const TS * src, int n) {
+        cvt_bf16_x32_mask(dst, src, _cvtu32_mask32(n >= 32 ? 0xFFFFFFFF : (0xFFFFFFFF >> (32 - n))));
+    }
+
+    // convert fp32/fp16 src into bf16 tile-blocked dst of same shape, K-tails are loaded
+    // right-aligned with zeros at left, rows beyond M (zero padding of dst) are not written
+    template<typename TS>
+    void cvt_bf16_blocked(tensor_blocked<ov::bfloat16> dst, tensor_view<TS> src) {
+        using bK = std::integral_constant<int, tensor_blocked<ov::bfloat16>::bK>;
+        int M = src.dims[0];
+        int K = src.dims[1];
+        int Ktails = K % bK::value;
+        int Kbody = K - Ktails;
+        for(int m = 0; m < M; m++) {
+            auto * pdst = dst.tile(m / dst.bM, 0) + (m % dst.bM) * bK::value;
+            int k;
+            for(k = 0; k < Kbody; k += bK::value, pdst += dst.bM * bK::value)
+                cvt_bf16_x32(pdst, &src(m, k), bK::value);
+            if (Ktails)
+                cvt_bf16_x32_mask(pdst, &src(m, k) - (bK::value - Ktails), _cvtu32_mask32(0xFFFFFFFF << (bK::value - Ktails)));
+        }
+    }
+
+    // cvt_bf16_blocked() of whole src into dst (resized to src), 16-row blocks are split among
+    // OpenMP threads. threads computing N-slices of same fp32/fp16 A should share it converted
+    // this way, instead of passing A to their own Matmul (see Matmul::compute_cvtA())
+    template<typename TS>
+    void cvt_bf16_blocked_omp(tensor2D_blocked<ov::bfloat16> & dst, tensor_view<TS> src) {
+        int M = src.dims[0];
+        int K = src.dims[1];
+        dst.resize(M, K);
+        #pragma omp parallel for
+        for(int mb = 0; mb < dst.blocks[0]; mb++) {
+            int m0 = mb * dst.bM;
+            int rows = std::min(static_cast<int>(dst.bM), M - m0);
+            cvt_bf16_blocked(tensor_blocked<ov::bfloat16>(rows, K, dst.tile(mb, 0)), src.Slice(m0, m0 + rows, 0, K));
+        }
+    }
+
+    // normalize lanes of src[0, 32) selected by k into bf16: (x - mean) * rstd * gamma + beta,
+    // same arithmetic as avx512::functional::norm_apply, other lanes are zero
+    template<typename TS>
+    inline void norm_bf16_x32_mask(ov::bfloat16 * dst, const TS * src, __mmask32 k,
+                                   avx512::NormStat st, const float * gamma, const float * beta) {
+        auto vmean = _mm512_set1_ps(st.mean);
+        auto vrstd = _mm512_set1_ps(st.rstd);
+        auto k0 = static_cast<__mmask16>(k);
+        auto k1 = static_cast<__mmask16>(k >> 16);
+        auto r0 = _mm512_mul_ps(_mm512_sub_ps(load_x16(src, k0), vmean), vrstd);
+        auto r1 = _mm512_mul_ps(_mm512_sub_ps(load_x16(src + 16, k1), vmean), vrstd);
+        if (gamma) {
+            r0 = _mm512_mul_ps(r0, _mm512_maskz_loadu_ps(k0, gamma));
+            r1 = _mm512_mul_ps(r1, _mm512_maskz_loadu_ps(k1, gamma + 16));
+        }
+        if (beta) {
+            r0 = _mm512_add_ps(r0, _mm512_maskz_loadu_ps(k0, beta));
+            r1 = _mm512_add_ps(r1, _mm512_maskz_loadu_ps(k1, beta + 16));
+        }
+        auto c = _mm512_cvtne2ps_pbh(_mm512_maskz_mov_ps(k1, r1), _mm512_maskz_mov_ps(k0, r0));
+        _mm512_storeu_epi16(dst, reinterpret_cast<__m512i&>(c));
+    }
+
+    // LayerNorm/RMSNorm rows of fp32/bf16 src into bf16 tile-blocked dst, layout is same as
+    // cvt_bf16_blocked(). statistics of each row are found right before it's normalized, so
+    // the 2nd read of the row hits L1
+    template<typename TS>
+    void norm_bf16_blocked(tensor_blocked<ov::bfloat16> dst, tensor_view<TS> src, const NormA & norm) {
+        using bK = std::integral_constant<int, tensor_blocked<ov::bfloat16>::bK>;
+        int M = src.dims[0];
+        int K = src.dims[1];
+        int Ktails = K % bK::value;
+        int Kbody = K - Ktails;
+        int back = bK::value - Ktails;
+        auto * gamma = norm.gamma;
+        auto * beta = norm.beta;
+        for(int m = 0; m < M; m++) {
+            auto st = avx512::functional::norm_stat(norm.type, &src(m, 0), K, norm.eps);
+            auto * pdst = dst.tile(m / dst.bM, 0) + (m % dst.bM) * bK::value;
+            int k;
+            for(k = 0; k < Kbody; k += bK::value, pdst += dst.bM * bK::value)
+                norm_bf16_x32_mask(pdst, &src(m, k), 0xFFFFFFFF, st,
+                                   gamma ? gamma + k : nullptr, beta ? beta + k : nullptr);
+            if (Ktails)
+                norm_bf16_x32_mask(pdst, &src(m, k) - back, _cvtu32_mask32(0xFFFFFFFF << back), st,
+                                   gamma ? gamma + k - back : nullptr, beta ? beta + k - back : nullptr);
+        }
+    }
+
+    // norm_bf16_blocked() of whole src into dst, shared by N-split threads as cvt_bf16_blocked_omp()
+    template<typename TS>
+    void norm_bf16_blocked_omp(tensor2D_blocked<ov::bfloat16> & dst, tensor_view<TS> src, const NormA & norm) {
+        int M = src.dims[0];
+        int K = src.dims[1];
+        dst.resize(M, K);
+        #pragma omp parallel for
+        for(int mb = 0; mb < dst.blocks[0]; mb++) {
+            int m0 = mb * dst.bM;
+            int rows = std::min(static_cast<int>(dst.bM), M - m0);
+            norm_bf16_blocked(tensor_blocked<ov::bfloat16>(rows, K, dst.tile(mb, 0)), src.Slice(m0, m0 + rows, 0, K), norm);
+        }
+    }
 };
 
 // 2x2 tiles post process kernels
@@ -543,8 +513,10 @@ namespace PP {
         BIAS = 1<<1,
         GELU = 1<<2,
         QUANT = 1<<3,
+        RELU = 1<<4,
 
         BIAS_GELU = BIAS | GELU,
+        BIAS_RELU = BIAS | RELU,
         DEQUANT_BIAS_GELU = DEQUANT | BIAS_GELU,
         DEQUANT_BIAS_GELU_QUANT = DEQUANT_BIAS_GELU | QUANT
     };
@@ -554,9 +526,16 @@ namespace PP {
         static_assert(std::is_same<D, ov::bfloat16>::value || std::is_same<D, int8_t>::value || std::is_same<D, float>::value,
                       "BiasGeluStore only support output data types ov::bfloat16/int8_t/float");
 
-        BiasGeluStore(tensor2D<D> & C, float * bias = nullptr) : C(C), bias(bias) {}
+        BiasGeluStore(tensor_view<D> C, float * bias = nullptr) : C(C), bias(bias) {}
+
+        // store C in tile-blocked layout, so it can be consumed as A by next Matmul w/o repacking
+        BiasGeluStore(tensor_blocked<D> Cb, float * bias = nullptr) : Cb(Cb), blocked(true), bias(bias) {
+            assert(!(std::is_same<D, float>::value));
+        }
 
-        tensor2D<D> & C;
+        tensor_view<D> C;
+        tensor_blocked<D> Cb;
+        bool blocked = false;
         float * bias;
         void set_bias(float * _bias) {
             assert (steps & BIAS);
@@ -586,8 +565,18 @@ namespace PP {
         template<typename T, typename std::enable_if<is_f32i32<T>::value, bool>::type = true>
         void operator()(tensor2D<T> & buffC, int m, int n, int valid_m, int valid_n) {
             auto * psrc = &buffC(0,0);
-            int8_t * pdst = reinterpret_cast<int8_t*>(&(C(m, n)));
+            int8_t * pdst = nullptr;
             int stride = C.stride;
+            int kb = 0, pos = 0, zero_bytes = 0;
+            if (blocked) {
+                // columns [n, n+32) are in same block column, the first chunk of right-aligned
+                // tail block also needs to clear the padding at left
+                Cb.locate(n, kb, pos);
+                if (n == Cb.dims[1] - Cb.dims[1] % Cb.bK)
+                    zero_bytes = pos * sizeof(D);
+            } else {
+                pdst = reinterpret_cast<int8_t*>(&(C(m, n)));
+            }
 
             __m512 bias0, bias1;
             if (steps & BIAS) {
@@ -626,6 +615,12 @@ namespace PP {
             }
 
             for(int i = 0; i < valid_m; i ++) {
+                if (blocked) {
+                    auto * prow = reinterpret_cast<int8_t*>(Cb.tile((m + i) / Cb.bM, kb) + ((m + i) % Cb.bM) * Cb.bK);
+                    if (zero_bytes)
+                        _mm512_mask_storeu_epi8(prow, _cvtu64_mask64(0xFFFFFFFFFFFFFFFFull >> (64 - zero_bytes)), _mm512_setzero_si512());
+                    pdst = prow + pos * sizeof(D);
+                }
                 auto r0 = _mm512_loadu_ps(psrc);
                 auto r1 = _mm512_loadu_ps(psrc + 16);
                 if (std::is_same<T, int32_t>::value) {
@@ -644,6 +639,10 @@ namespace PP {
                     r0 = functional::gelu_erf_minmax_approx(r0);
                     r1 = functional::gelu_erf_minmax_approx(r1);
                 }
+                if (steps & RELU) {
+                    r0 = _mm512_max_ps(r0, _mm512_setzero_ps());
+                    r1 = _mm512_max_ps(r1, _mm512_setzero_ps());
+                }
 
                 // quantize & store
                 if (steps & QUANT) {
@@ -671,14 +670,92 @@ namespace PP {
             }
         }
     };
+
+    // cos/sin of rotary position embedding, pairs of columns (2i, 2i+1) of a head are
+    // rotated by angle pos * base^(-2i/head_size), both duplicated per column:
+    //   cos(pos, 2i) = cos(pos, 2i+1) = cos(angle)
+    //   sin(pos, 2i) = -sin(angle)   sin(pos, 2i+1) = sin(angle)
+    struct RopeTable {
+        tensor2D<float> cos;
+        tensor2D<float> sin;
+        int head_size;
+        RopeTable(int max_pos, int head_size, float base = 10000.0f) :
+            cos(max_pos, head_size), sin(max_pos, head_size), head_size(head_size) {
+            assert(head_size % 2 == 0);
+            for(int pos = 0; pos < max_pos; pos++) {
+                for(int i = 0; i < head_size; i += 2) {
+                    float angle = pos * std::pow(base, -static_cast<float>(i) / head_size);
+                    cos(pos, i) = cos(pos, i + 1) = std::cos(angle);
+                    sin(pos, i) = -std::sin(angle);
+                    sin(pos, i + 1) = std::sin(angle);
+                }
+            }
+        }
+    };
+
+    // applies rotary position embedding on fp32 results and stores them per head, so
+    // projection output goes directly into attention layouts (no extra pass over q/k):
+    //   column n of C is element (n % head_size) of head (n / head_size), heads [0, rotary_heads)
+    //   are rotated (Q & K of a fused QKV projection), the rest (V) are stored as is
+    //   positions[m]  : position of token (row) m
+    //   dst(m, h)     : D pointer to head h of token m, e.g. into q[B, M, H, S], k[B, H, N, S]
+    //                   or blocks of a paged KV-cache
+    // head_size must be multiple of 16, so 16 columns never cross heads
+    template<typename D, typename DST>
+    struct RopeStore {
+        static_assert(std::is_same<D, ov::bfloat16>::value || std::is_same<D, float>::value,
+                      "RopeStore only support output data types ov::bfloat16/float");
+        const RopeTable & rope;
+        const int * positions;
+        int rotary_heads;
+        DST dst;
+
+        RopeStore(const RopeTable & rope, const int * positions, int rotary_heads, DST dst) :
+            rope(rope), positions(positions), rotary_heads(rotary_heads), dst(dst) {
+            assert(rope.head_size % 16 == 0);
+        }
+
+        void operator()(tensor2D<float> & buffC, int m, int n, int valid_m, int valid_n) {
+            int S = rope.head_size;
+            for(int i = 0; i < valid_m; i++) {
+                auto * psrc = &buffC(i, 0);
+                for(int j = 0; j < valid_n; j += 16) {
+                    int h = (n + j) / S;
+                    int s = (n + j) % S;
+                    auto k = _cvtu32_mask16(valid_n - j >= 16 ? 0xFFFF : (0xFFFF >> (16 - (valid_n - j))));
+                    auto r = _mm512_loadu_ps(psrc + j);
+                    if (h < rotary_heads) {
+                        // (x0, x1) => (x0*c - x1*s, x1*c + x0*s)
+                        int pos = positions[m + i];
+                        auto c = _mm512_loadu_ps(&rope.cos(pos, s));
+                        auto sn = _mm512_loadu_ps(&rope.sin(pos, s));
+                        auto r_swap = _mm512_permute_ps(r, 0xB1);
+                        r = _mm512_fmadd_ps(r_swap, sn, _mm512_mul_ps(r, c));
+                    }
+                    D * pdst = dst(m + i, h) + s;
+                    if (std::is_same<D, ov::bfloat16>::value) {
+                        auto b = _mm512_cvtneps_pbh(r);
+                        _mm256_mask_storeu_epi16(pdst, k, reinterpret_cast<__m256i&>(b));
+                    } else {
+                        _mm512_mask_storeu_ps(pdst, k, r);
+                    }
+                }
+            }
+        }
+    };
+
+    template<typename D, typename DST>
+    RopeStore<D, DST> make_rope_store(const RopeTable & rope, const int * positions, int rotary_heads, DST dst) {
+        return RopeStore<D, DST>(rope, positions, rotary_heads, dst);
+    }
 }
 
 template <int bytes, int sel=_MM_HINT_T0, int advance = 4096>
-void prefetch_bytes(void *src)
+void prefetch_bytes(const void *src)
 {
-    int8_t *p = reinterpret_cast<int8_t *>(src);
+    auto *p = reinterpret_cast<const int8_t *>(src);
     for (int i = 0; i < bytes; i+=64)
-        _mm_prefetch(p + i + advance, sel);
+        _mm_prefetch(p + i + advance, static_cast<decltype(_MM_HINT_T0)>(sel));
 }
 
 template<typename C=void>
@@ -697,11 +774,11 @@ void zero_tiles() {
 // store precision for weight compression, only for BF16 AMX
 
 template<typename T>
-tensor2D<T> getSubMatB(tensor2D<T> & _matB, int n0, int n1, bool transposeB) {
+tensor_view<T> getSubMatB(tensor_view<T> _matB, int n0, int n1, bool transposeB) {
     int Bd0 = transposeB ? (n1-n0) : _matB.dims[0];
     int Bd1 = transposeB ? _matB.dims[1] : (n1-n0);
     T * pbase = transposeB ? (&_matB(n0, 0)):(&_matB(0, n0));
-    return tensor2D<T>(Bd0, Bd1, pbase, _matB.stride);
+    return tensor_view<T>(Bd0, Bd1, pbase, _matB.stride);
 }
 
 template<int bN, class F>
@@ -752,6 +829,60 @@ void loop2D_opt_Mtail(int M, int N, int mc, F f) {
     }
 }
 
+// repack a single N-panel of B (columns [n, n+32)) into dst,
+// dst is a K_padded x 32 submatrix composed of B0/B1 tiles put sequentially
+template<class T>
+void repackB_1x2_panel(int8_t * dst, tensor_view<T> Bi, int n, bool transpose) {
+    int K = Bi.dims[transpose?1:0];
+    int N = Bi.dims[transpose?0:1];
+
+    if (n + 32 > N) {
+        // tail panel: full tiles would read beyond the end of Bi, which can be fatal
+        // when Bi is mmapped, so repack from a zero-padded copy of valid part instead
+        int valid_n = N - n;
+        tensor2D<T> tmp;
+        tmp.resize(transpose ? 32 : K, transpose ? K : 32);
+        memset(&tmp[0], 0, tmp.dims[0] * tmp.stride);
+        for(int k = 0; k < (transpose ? valid_n : K); k++)
+            memcpy(&tmp(k, 0), transpose ? &Bi(n + k, 0) : &Bi(k, n), (transpose ? K : valid_n) * sizeof(T));
+        repackB_1x2_panel(dst, tmp.view(), 0, transpose);
+        return;
+    }
+
+    // K_padded : round up to multiple of 32/64
+    int kStep = 64 / sizeof(T);
+    int Ktails = K % kStep;
+    int Kbody = K - Ktails;
+
+    if (transpose) {
+        auto * src0 = reinterpret_cast<const int8_t *>(&Bi(n, 0));
+        int k;
+        for(k = 0; k < Kbody; k += kStep) {
+            // B0 (16x32) => transpose+repack as 32x16(16x16x2) or 64x16(16x16x4)
+            functional::transpose_epi32_16x16(dst, src0 + 0*16*Bi.stride + k*sizeof(T), Bi.stride);
+            dst += 1024;
+            functional::transpose_epi32_16x16(dst, src0 + 1*16*Bi.stride + k*sizeof(T), Bi.stride);
+            dst += 1024;
+        }
+        if (Ktails) {
+            // Ktails part is loaded into A tile right-aligned, so B tile must also load
+            // Ktails part to bottom-aligned, and fill upper padding with zero
+            functional::transpose_epi32_16xN_right_align(dst, src0 + 0*16*Bi.stride + k*sizeof(T), Bi.stride, (K-k)*sizeof(T));
+            dst += 1024;
+            functional::transpose_epi32_16xN_right_align(dst, src0 + 1*16*Bi.stride + k*sizeof(T), Bi.stride, (K-k)*sizeof(T));
+            dst += 1024;
+        }
+    } else {
+        for(int k = 0; k < K; k+=kStep) {
+            // bf16: B0 B1 32x(16+16) => repack as two 16x16x2
+            // int8: B0 B1 64x(16+16) => repack as two 16x16x4
+            int src_rows = std::min(K - k, kStep);
+            functional::kpack_tile_B0B1(dst, dst + (1024), &Bi(k, n), Bi.stride, src_rows);
+            dst += 2048;
+        }
+    }
+}
+
 // L = 1 ... 4
 // Bi : input matrix of shape KxN (transpose=false) or NxK (transpose=true)
 // transpose : transpose before repack
@@ -759,7 +890,7 @@ void loop2D_opt_Mtail(int M, int N, int mc, F f) {
 // Bo is layout as axb where a=(N_padded/32) b=(K_padded*32)
 //
 template<class T>
-tensor2D<T> repackB_1x2(const tensor2D<T> &Bi, bool transpose) {
+tensor2D<T> repackB_1x2(tensor_view<T> Bi, bool transpose) {
     tensor2D<T> Bo;
     int K = Bi.dims[transpose?1:0];
     int N = Bi.dims[transpose?0:1];
@@ -767,8 +898,6 @@ tensor2D<T> repackB_1x2(const tensor2D<T> &Bi, bool transpose) {
     // K_padded : round up to multiple of 32/64
     int kStep = 64 / sizeof(T);
     int K_padded = (K + kStep - 1)/kStep * kStep;
-    int Ktails = K % kStep;
-    int Kbody = K - Ktails;
 
     // N_padded : round up to multiple of (2*16)
     int N_unit = 2*16;
@@ -777,44 +906,80 @@ tensor2D<T> repackB_1x2(const tensor2D<T> &Bi, bool transpose) {
     // Bo(ni, 0) is a vector flattened from a slice of shape [K_padded x N_unit]
     Bo.resize(N_padded/N_unit, K_padded * N_unit);
 
-    if (transpose) {
-        for(int n = 0; n < N; n += N_unit) {
-            // a K_padded x N_unit submatrix layouted in B0/B1... and put sequentially
-            auto * dst = reinterpret_cast<int8_t *>(&Bo(n/N_unit, 0));
-            auto * src0 = reinterpret_cast<const int8_t *>(&Bi(n, 0));
-            int k;
-            for(k = 0; k < Kbody; k += kStep) {
-                // B0 (16x32) => transpose+repack as 32x16(16x16x2) or 64x16(16x16x4)
-                functional::transpose_epi32_16x16(dst, src0 + 0*16*Bi.stride + k*sizeof(T), Bi.stride);
-                dst += 1024;
-                functional::transpose_epi32_16x16(dst, src0 + 1*16*Bi.stride + k*sizeof(T), Bi.stride);
-                dst += 1024;
-            }
-            if (Ktails) {
-                // Ktails part is loaded into A tile right-aligned, so B tile must also load
-                // Ktails part to bottom-aligned, and fill upper padding with zero
-                functional::transpose_epi32_16xN_right_align(dst, src0 + 0*16*Bi.stride + k*sizeof(T), Bi.stride, (K-k)*sizeof(T));
-                dst += 1024;
-                functional::transpose_epi32_16xN_right_align(dst, src0 + 1*16*Bi.stride + k*sizeof(T), Bi.stride, (K-k)*sizeof(T));
-                dst += 1024;
-            }
-        }
-    } else {
-        // pack & layout sequentially
-        for(int n = 0; n < N; n += N_unit) {
-            auto * dst = reinterpret_cast<int8_t *>(&Bo(n/N_unit, 0));
-            for(int k = 0; k < K; k+=kStep) {
-                // bf16: B0 B1 32x(16+16) => repack as two 16x16x2
-                // int8: B0 B1 64x(16+16) => repack as two 16x16x4
-                int src_rows = std::min(K - k, kStep);
-                functional::kpack_tile_B0B1(dst, dst + (1024), &Bi(k, n), Bi.stride, src_rows);
-                dst += 2048;
-            }
-        }
+    // pack & layout sequentially
+    for(int n = 0; n < N; n += N_unit) {
+        repackB_1x2_panel(reinterpret_cast<int8_t *>(&Bo(n/N_unit, 0)), Bi, n, transpose);
     }
     return Bo;
 }
 
+template<class T>
+tensor2D<T> repackB_1x2(const tensor2D<T> &Bi, bool transpose) {
+    return repackB_1x2(Bi.view(), transpose);
+}
+
+// repackB_1x2 done lazily at granularity of N-panel (32 columns):
+//  - nothing is read from source B (which can be a mmapped weight file) until first use
+//  - each panel is repacked by the first thread requesting it, which is usually
+//    the thread consuming it in Matmul, so repack is done in parallel and the
+//    repacked pages are first-touched (thus allocated) on the local NUMA node
+//  - other threads requesting a panel being repacked wait until it's done
+template<class T>
+struct LazyRepackedB {
+    tensor_view<T> src;
+    bool transpose = false;
+    int K = 0;
+    int N = 0;
+    tensor2D<T> Bo;
+    std::unique_ptr<std::atomic<int>[]> state;   // 0: not packed, 1: packing, 2: packed
+
+    enum { N_unit = 32 };
+
+    LazyRepackedB() = default;
+
+    LazyRepackedB(tensor_view<T> Bi, bool _transpose) : src(Bi), transpose(_transpose) {
+        K = Bi.dims[transpose?1:0];
+        N = Bi.dims[transpose?0:1];
+        int kStep = 64 / sizeof(T);
+        int K_padded = (K + kStep - 1)/kStep * kStep;
+        int panels = (N + N_unit - 1)/N_unit;
+        // not using tensor2D::resize(): numa_alloc_local would bind all pages to
+        // current node, we want pages to be first-touched by consumer threads
+        auto bytes = static_cast<size_t>(panels) * K_padded * N_unit * sizeof(T);
+        auto * p = reinterpret_cast<T*>(aligned_alloc(64, rndup(bytes, 64)));
+        Bo = tensor2D<T>(panels, K_padded * N_unit, p, K_padded * N_unit * sizeof(T));
+        Bo.data = std::shared_ptr<T>(p, [](void * p) { ::free(p); });
+        state.reset(new std::atomic<int>[panels]);
+        for(int i = 0; i < panels; i++)
+            state[i].store(0, std::memory_order_relaxed);
+    }
+
+    operator bool() const {
+        return static_cast<bool>(state);
+    }
+
+    // make sure panels covering columns [n0, n1) are repacked,
+    // returns the packed sub-matrix in same layout as repackB_1x2(getSubMatB(B, n0, n1))
+    tensor_view<T> get(int n0, int n1) {
+        assert(n0 % N_unit == 0);
+        int p0 = n0 / N_unit;
+        int p1 = (n1 + N_unit - 1) / N_unit;
+        for(int p = p0; p < p1; p++) {
+            if (state[p].load(std::memory_order_acquire) == 2)
+                continue;
+            int expected = 0;
+            if (state[p].compare_exchange_strong(expected, 1, std::memory_order_acq_rel)) {
+                repackB_1x2_panel(reinterpret_cast<int8_t *>(&Bo(p, 0)), src, p * N_unit, transpose);
+                state[p].store(2, std::memory_order_release);
+            } else {
+                while(state[p].load(std::memory_order_acquire) != 2)
+                    _mm_pause();
+            }
+        }
+        return Bo.view().Slice(p0, p1, 0, Bo.dims[1]);
+    }
+};
+
 template<class T = void>
 struct acc_type {};
 template<>
@@ -956,7 +1121,7 @@ struct MatmulVector {
         }
     }
 
-    void operator()(tensor2D<TA> & matA, const TB * vB, TC * vC) {
+    void operator()(tensor_view<TA> matA, const TB * vB, TC * vC) {
         int M = matA.dims[0];
         int K = matA.dims[1];
         TA * pA = &matA[0];
@@ -1102,7 +1267,7 @@ struct Matmul {
 
     template<int tmmN, typename PP>
     void kernel_slimB(int M, int N, int K,
-                    tensor2D<TA> & A,
+                    tensor_view<TA> A,
                     void * B,
                     tensor2D<TC> & buffC,
                     PP ppkernel) {
@@ -1166,16 +1331,242 @@ struct Matmul {
         }
     }
 
+    // repack B[:, n0:n1] into internalB
+    tensor_view<TB> packB(tensor_view<TB> _matB, int n0, int n1, int K) {
+        auto matB = getSubMatB(_matB, n0, n1, transposeB);
+        assert(K == matB.dims[transposeB ? 1 : 0]);
+
+        // for non-constB, internalB is updated every time
+        // for constB, internalB is updated once
+        if (!constB || (internalB.capacity == 0)) {
+            internalB = repackB_1x2(matB, transposeB);
+        }
+        return internalB;
+    }
+
     template<typename PP>
-    void operator()(tensor2D<TA> & matA,
-                    tensor2D<TB> & _matB,
+    void operator()(tensor_view<TA> matA,
+                    tensor_view<TB> _matB,
                     int n0, int n1,
                     PP ppkernel) {
-        auto matB = getSubMatB(_matB, n0, n1, transposeB);
+        auto packedB = packB(_matB, n0, n1, matA.dims[1]);
+        compute(matA, packedB, n1 - n0, n0, ppkernel);
+    }
+
+    // B is shared & repacked lazily per N-panel, n0 must be multiple of 32
+    template<typename PP>
+    void operator()(tensor_view<TA> matA,
+                    LazyRepackedB<TB> & B,
+                    int n0, int n1,
+                    PP ppkernel) {
+        assert(matA.dims[1] == B.K);
+        compute(matA, B.get(n0, n1), n1 - n0, n0, ppkernel);
+    }
+
+    // A in tile-blocked layout (for example C of previous Matmul stored by blocked BiasGeluStore)
+    template<typename PP>
+    void operator()(tensor_blocked<TA> matA,
+                    tensor_view<TB> _matB,
+                    int n0, int n1,
+                    PP ppkernel) {
+        auto packedB = packB(_matB, n0, n1, matA.dims[1]);
+        compute(matA, packedB, n1 - n0, n0, ppkernel);
+    }
+
+    template<typename PP>
+    void operator()(tensor_blocked<TA> matA,
+                    LazyRepackedB<TB> & B,
+                    int n0, int n1,
+                    PP ppkernel) {
+        assert(matA.dims[1] == B.K);
+        compute(matA, B.get(n0, n1), n1 - n0, n0, ppkernel);
+    }
+
+    // fp32/fp16 A (bf16 Matmul only) is converted into bf16 inside Matmul, see compute_cvtA()
+    template<typename PP>
+    void operator()(tensor_view<float> matA,
+                    tensor_view<TB> _matB,
+                    int n0, int n1,
+                    PP ppkernel) {
+        auto packedB = packB(_matB, n0, n1, matA.dims[1]);
+        compute_cvtA(matA, packedB, n1 - n0, n0, ppkernel);
+    }
+
+    template<typename PP>
+    void operator()(tensor_view<ov::float16> matA,
+                    tensor_view<TB> _matB,
+                    int n0, int n1,
+                    PP ppkernel) {
+        auto packedB = packB(_matB, n0, n1, matA.dims[1]);
+        compute_cvtA(matA, packedB, n1 - n0, n0, ppkernel);
+    }
+
+    template<typename PP>
+    void operator()(tensor_view<float> matA,
+                    LazyRepackedB<TB> & B,
+                    int n0, int n1,
+                    PP ppkernel) {
+        assert(matA.dims[1] == B.K);
+        compute_cvtA(matA, B.get(n0, n1), n1 - n0, n0, ppkernel);
+    }
+
+    template<typename PP>
+    void operator()(tensor_view<ov::float16> matA,
+                    LazyRepackedB<TB> & B,
+                    int n0, int n1,
+                    PP ppkernel) {
+        assert(matA.dims[1] == B.K);
+        compute_cvtA(matA, B.get(n0, n1), n1 - n0, n0, ppkernel);
+    }
+
+    // LayerNorm/RMSNorm of fp32/bf16 A rows fused into the staging of A (bf16 Matmul only), so
+    // the normalized activations are never written out & re-read as a separate tensor
+    template<typename PP>
+    void operator()(tensor_view<float> matA, const NormA & norm,
+                    tensor_view<TB> _matB,
+                    int n0, int n1,
+                    PP ppkernel) {
+        auto packedB = packB(_matB, n0, n1, matA.dims[1]);
+        compute_cvtA(matA, packedB, n1 - n0, n0, ppkernel, &norm);
+    }
+
+    template<typename PP>
+    void operator()(tensor_view<ov::bfloat16> matA, const NormA & norm,
+                    tensor_view<TB> _matB,
+                    int n0, int n1,
+                    PP ppkernel) {
+        auto packedB = packB(_matB, n0, n1, matA.dims[1]);
+        compute_cvtA(matA, packedB, n1 - n0, n0, ppkernel, &norm);
+    }
+
+    template<typename PP>
+    void operator()(tensor_view<float> matA, const NormA & norm,
+                    LazyRepackedB<TB> & B,
+                    int n0, int n1,
+                    PP ppkernel) {
+        assert(matA.dims[1] == B.K);
+        compute_cvtA(matA, B.get(n0, n1), n1 - n0, n0, ppkernel, &norm);
+    }
+
+    template<typename PP>
+    void operator()(tensor_view<ov::bfloat16> matA, const NormA & norm,
+                    LazyRepackedB<TB> & B,
+                    int n0, int n1,
+                    PP ppkernel) {
+        assert(matA.dims[1] == B.K);
+        compute_cvtA(matA, B.get(n0, n1), n1 - n0, n0, ppkernel, &norm);
+    }
+
+    // bf16 copy (converted or normalized) of a band of A rows in tile-blocked layout
+    tensor2D_blocked<ov::bfloat16> Astage;
+
+    // A is converted band by band: each band of rows is converted once into Astage (sized as
+    // the L2 cache blocking of A), then all N-panels are computed over it by dense tile loads,
+    // so there's no separate conversion pass writing & re-reading a bf16 copy of whole A.
+    // with norm, row statistics are also found once per band while staging it.
+    // staging is per Matmul: when T threads each compute an N-slice of same A, whole A is
+    // converted (or normalized) T times (M*K per thread vs. M*K*N/T MACs), which isn't
+    // negligible once N/T is a few hundred columns; then stage it once by
+    // functional::cvt_bf16_blocked_omp() or norm_bf16_blocked_omp() and pass the blocked A
+    // instead (see perf_mixed_a_omp() & perf_norm_a_omp() in test_mixed_a.cpp)
+    template<typename TS, typename PP>
+    void compute_cvtA(tensor_view<TS> matA,
+                      tensor_view<TB> packedB,
+                      int N, int n0,
+                      PP ppkernel,
+                      const NormA * norm = nullptr) {
+        static_assert(is_bf16bf16, "fp32/fp16 A is only supported by bf16 Matmul");
+        int M = matA.dims[0];
+        int K = matA.dims[1];
+        // same blocking as compute(): mc 32-row slices of A are kept in L2
+        int slice_size = 32*rndup(K, 32)*sizeof(TA);
+        int band = std::max(1, get_L2_size()/slice_size - 1) * 32;
+        for(int m0 = 0; m0 < M; m0 += band) {
+            int rows = std::min(band, M - m0);
+            if (Astage.dims[0] != rows || Astage.dims[1] != K)
+                Astage.resize(rows, K);
+            if (norm)
+                functional::norm_bf16_blocked(Astage, matA.Slice(m0, m0 + rows, 0, K), *norm);
+            else
+                functional::cvt_bf16_blocked(Astage, matA.Slice(m0, m0 + rows, 0, K));
+            compute(static_cast<tensor_blocked<TA>&>(Astage), packedB, N, n0,
+                    [&](tensor2D<TC> & buffC, int m, int n, int valid_m, int valid_n) {
+                        (ppkernel)(buffC, m0 + m, n, valid_m, valid_n);
+                    });
+        }
+    }
+
+    // all A tiles are loaded densely (stride 64) from tile-blocked A, M & K tails are
+    // already zero-padded by the layout, so no shifting or back-off is required
+    template<typename PP>
+    void compute(tensor_blocked<TA> matA,
+                 tensor_view<TB> packedB,
+                 int N, int n0,
+                 PP ppkernel) {
+        static_assert(tensor_blocked<TA>::bK == kStep, "blocked A must have same k-step as AMX tile");
+        int M = matA.dims[0];
+        int K = matA.dims[1];
+        int KB = matA.blocks[1];
+        auto kernel = [&](int m, int n, int valid_m, int valid_n) {
+            auto * pA0 = reinterpret_cast<int8_t*>(matA.tile(m / 16, 0));
+            auto * pB = reinterpret_cast<int8_t*>(&packedB(n>>5, 0));
+            if (valid_m > 16) {
+                auto * pA1 = pA0 + KB*1024;
+                zero_tiles<0, 1, 2, 3>();
+                for (int kb = 0; kb < KB; kb++) {
+                    _tile_loadd(4, pA0, 64); pA0 += 1024;
+                    _tile_loadd(6, pB, 64); pB += 1024;
+                    prefetch_bytes<1024>(pB);
+                    TILE_DP(0, 4, 6);
+
+                    _tile_loadd(5, pA1, 64); pA1 += 1024;
+                    TILE_DP(2, 5, 6);
+                    _tile_loadd(7, pB, 64); pB += 1024;
+                    prefetch_bytes<1024>(pB);
+                    TILE_DP(1, 4, 7);
+
+                    TILE_DP(3, 5, 7);
+                }
+                _tile_stored(0, &buffC(0,0), buffC.stride);
+                _tile_stored(1, &buffC(0,16), buffC.stride);
+                _tile_stored(2, &buffC(16,0), buffC.stride);
+                _tile_stored(3, &buffC(16,16), buffC.stride);
+            } else {
+                zero_tiles<0, 1>();
+                for (int kb = 0; kb < KB; kb++) {
+                    _tile_loadd(4, pA0, 64); pA0 += 1024;
+                    _tile_loadd(6, pB, 64); pB += 1024;
+                    prefetch_bytes<1024>(pB);
+                    TILE_DP(0, 4, 6);
+                    _tile_loadd(7, pB, 64); pB += 1024;
+                    prefetch_bytes<1024>(pB);
+                    TILE_DP(1, 4, 7);
+                }
+                _tile_stored(0, &buffC(0,0), buffC.stride);
+                _tile_stored(1, &buffC(0,16), buffC.stride);
+            }
+            (ppkernel)(buffC, m, n + n0, valid_m, valid_n);
+        };
+
+        // same cache blocking scheme as plain A
+        int elesz = sizeof(TA);
+        int L2 = get_L2_size();
+        int slice_size = 32*rndup(K, 32)*elesz;
+        int mc = std::max(1, L2/slice_size - 1);
+
+        // 2x2 tile, C:0/1/2/3 A:4/5 B:6/7, M tails are computed with zero rows
+        tileconfig_t tfg(1, 0, 8, 16, 64);
+        loop2D<32, 32>(M, N, mc, kernel);
+    }
+
+    // packedB is in layout of repackB_1x2 (starting from column n0)
+    template<typename PP>
+    void compute(tensor_view<TA> matA,
+                 tensor_view<TB> packedB,
+                 int N, int n0,
+                 PP ppkernel) {
         int M = matA.dims[0];
         int K = matA.dims[1];
-        int N = matB.dims[transposeB ? 0 : 1];
-        assert(K == matB.dims[transposeB ? 1 : 0]);
         // Due to the fact that we load a full tile at tails of K dimension
         // we may access memory address beyond the limit of A matrix
         // to avoid read in nan values, we backoff to the left to ensure A tile
@@ -1185,12 +1576,6 @@ struct Matmul {
         int Kbody = K - Ktails;
         int KbackoffBytes = (kStep - Ktails)*sizeof(TA);
 
-        // for non-constB, internalB is updated every time
-        // for constB, internalB is updated once
-        if (!constB || (internalB.capacity == 0)) {
-            internalB = repackB_1x2(matB, transposeB);
-        }
-
         // special case when whole B matrix can fit in 6 tiles
         // we can load B only once
         if (M >= 16 && N <= 16 && K <= 6*kStep) {
@@ -1198,7 +1583,7 @@ struct Matmul {
             // C:0
             // A:1
             // B:2,3,4,5,6,7
-            auto * pB0 = reinterpret_cast<int8_t*>(&internalB[0]);
+            auto * pB0 = reinterpret_cast<int8_t*>(&packedB[0]);
             tileconfig_t tfg(1, 0, 8, 16, 64);
             switch((K + kStep - 1)/kStep) {
                 case 1: kernel_slimB<1>(M, N, K, matA, pB0, buffC, ppkernel); break;
@@ -1219,7 +1604,7 @@ struct Matmul {
             // A_MxK: 2,
             // B_KxN: 3, 4
             tileconfig_t tfg(1, 0, {M,M,M,16,16}, 64);
-            auto * pB0 = reinterpret_cast<int8_t*>(&internalB[0]);
+            auto * pB0 = reinterpret_cast<int8_t*>(&packedB[0]);
             auto * const pC0 = &buffC[0];
             int k;
             const auto strideA = matA.stride;
@@ -1256,7 +1641,7 @@ struct Matmul {
             auto * pA0 = reinterpret_cast<int8_t*>(&matA(m, 0));
             auto * pA1 = reinterpret_cast<int8_t*>(&matA(m + 16, 0));
             auto strideA = matA.stride;
-            auto * pB = reinterpret_cast<int8_t*>(&internalB(n>>5, 0));
+            auto * pB = reinterpret_cast<int8_t*>(&packedB(n>>5, 0));
             zero_tiles<0, 1, 2, 3>();
             // 2x2
             for (int k = 0; k < Kbody; k += kStep) {
@@ -1304,7 +1689,7 @@ struct Matmul {
         // generic input shapes with M > 32
         // determine cache blocking scheme
         int elesz = sizeof(TA);
-        int L2 = 2048*1024; // 2MB
+        int L2 = get_L2_size();
         int slice_size = 32*rndup(K, 32)*elesz;
         int mc = std::max(1, L2/slice_size - 1);
 
@@ -1340,8 +1725,8 @@ struct Matmul<ov::bfloat16, int8_t, float> {
     float dequant_scale_B;
     
     template<typename PP>
-    void operator()(tensor2D<ov::bfloat16> & matA,
-                    tensor2D<ov::bfloat16> & _matB,
+    void operator()(tensor_view<ov::bfloat16> matA,
+                    tensor_view<ov::bfloat16> _matB,
                     int n0, int n1,
                     PP ppkernel) {
         auto matB = getSubMatB(_matB, n0, n1, transposeB);
@@ -1505,7 +1890,7 @@ struct Matmul<ov::bfloat16, int8_t, float> {
 
         // determine blocking scheme
         int elesz = sizeof(uint16_t);
-        int L2 = 2048*1024; // 2MB
+        int L2 = get_L2_size();
         int slice_size = 32*rndup(K, 32)*elesz;
         int mc = std::max(1, L2/slice_size - 1); // if 1 32xK slice cannot fit L2, use 1 slice at least
 
@@ -1531,7 +1916,7 @@ struct GemAvB {
     GemAvB() {
     }
 
-    void operator()(tensor2D<ov::bfloat16> & matA,
+    void operator()(tensor_view<ov::bfloat16> matA,
                     ov::bfloat16 * vecB,
                     float * vecC) {
         int M = matA.dims[0];
@@ -2,11 +2,14 @@
 #pragma once
 
 #include "tensorND.hpp"
+#include "reorder.hpp"
+#include "bf16.hpp"
 #include <memory>
 #include <cstring>
 #include <cstdlib>
 #include <iostream>
 #include <functional>
+#include <limits>
 
 #ifdef _WIN32
 #include <intrin.h>
@@ -176,6 +179,9 @@ namespace functional {
         }
         
         // valid_n == 16
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+        reorder::transpose_2d(pBdst, 16*sizeof(float), pBsrc, strideB*sizeof(float), 16, K);
+#else
         for(int k = 0; k < K; k+=8, pBsrc+=8) {
             {
                 b0 = _mm256_loadu_ps(pBsrc);
@@ -203,6 +209,7 @@ namespace functional {
             }
             pBdst += 8*16;
         }
+#endif
 #undef STORE_B0_B7
     }
 
@@ -225,20 +232,20 @@ namespace functional {
         x = _mm256_add_ps(x, y);             //x: 01234567 x x x x x x x
     }
     inline void exp_ps(__m256 & src) {
-        static __m256 exp_ln_flt_min_f = _mm256_castsi256_ps(_mm256_set1_epi32(0xc2aeac50));    // log(FLT_MIN)
-        static __m256 exp_ln_flt_max_f = _mm256_castsi256_ps(_mm256_set1_epi32(0x42b17218));    // log(FLT_MAX)
-        static __m256 exp_log2ef = _mm256_castsi256_ps(_mm256_set1_epi32(0x3fb8aa3b));          // log2(e)
-        static __m256 half = _mm256_castsi256_ps(_mm256_set1_epi32(0x3f000000));                // 0.5f
-        static __m256 ln2f = _mm256_castsi256_ps(_mm256_set1_epi32(0x3f317218));                // ln(2)
-        static __m256 one = _mm256_castsi256_ps(_mm256_set1_epi32(0x3f800000));                 // 1.0f
-        static __m256i exponent_bias = _mm256_set1_epi32(0x0000007f);                           // 127
-        static constexpr int n_mantissa_bits = 23;
-        static __m256 exp_pol1 = _mm256_castsi256_ps(_mm256_set1_epi32(0x3f7ffffb));            // p1 = 0.999999701f
-        static __m256 exp_pol2 = _mm256_castsi256_ps(_mm256_set1_epi32(0x3efffee3));            // p2 = 0.499991506f
-        static __m256 exp_pol3 = _mm256_castsi256_ps(_mm256_set1_epi32(0x3e2aad40));            // p3 = 0.166676521f
-        static __m256 exp_pol4 = _mm256_castsi256_ps(_mm256_set1_epi32(0x3d2b9d0d));            // p4 = 0.0418978221f
-        static __m256 exp_pol5 = _mm256_castsi256_ps(_mm256_set1_epi32(0x3c07cfce));            // p5 = 0.00828929059f
-        static __m256 two = _mm256_castsi256_ps(_mm256_set1_epi32(0x40000000));                 // 2
+        const auto exp_ln_flt_min_f = _mm256_castsi256_ps(_mm256_set1_epi32(0xc2aeac50));    // log(FLT_MIN)
+        const auto exp_ln_flt_max_f = _mm256_castsi256_ps(_mm256_set1_epi32(0x42b17218));    // log(FLT_MAX)
+        const auto exp_log2ef = _mm256_castsi256_ps(_mm256_set1_epi32(0x3fb8aa3b));          // log2(e)
+        const auto half = _mm256_castsi256_ps(_mm256_set1_epi32(0x3f000000));                // 0.5f
+        const auto ln2f = _mm256_castsi256_ps(_mm256_set1_epi32(0x3f317218));                // ln(2)
+        const auto one = _mm256_castsi256_ps(_mm256_set1_epi32(0x3f800000));                 // 1.0f
+        const auto exponent_bias = _mm256_set1_epi32(0x0000007f);                           // 127
+        constexpr int n_mantissa_bits = 23;
+        const auto exp_pol1 = _mm256_castsi256_ps(_mm256_set1_epi32(0x3f7ffffb));            // p1 = 0.999999701f
+        const auto exp_pol2 = _mm256_castsi256_ps(_mm256_set1_epi32(0x3efffee3));            // p2 = 0.499991506f
+        const auto exp_pol3 = _mm256_castsi256_ps(_mm256_set1_epi32(0x3e2aad40));            // p3 = 0.166676521f
+        const auto exp_pol4 = _mm256_castsi256_ps(_mm256_set1_epi32(0x3d2b9d0d));            // p4 = 0.0418978221f
+        const auto exp_pol5 = _mm256_castsi256_ps(_mm256_set1_epi32(0x3c07cfce));            // p5 = 0.00828929059f
+        const auto two = _mm256_castsi256_ps(_mm256_set1_epi32(0x40000000));                 // 2
         // exp(x) =
         // = exp(n * ln(2) + r) // divide x by ln(2) and get quot and rem
         // = 2^n * exp(r)       // simplify the exp(n*ln(2)) expression
@@ -292,77 +299,133 @@ namespace functional {
         src = _mm256_mul_ps(src, two);
     }
 
+    // first N7 (0~8) lanes set
     inline __m256i get_mask(int N7) {
-        static __m256i mask[] = {
-            _mm256_set_epi32( 0, 0, 0, 0, 0, 0, 0, 0),
-            _mm256_set_epi32( 0, 0, 0, 0, 0, 0, 0,-1),
-            _mm256_set_epi32( 0, 0, 0, 0, 0, 0,-1,-1),
-            _mm256_set_epi32( 0, 0, 0, 0, 0,-1,-1,-1),
-            _mm256_set_epi32( 0, 0, 0, 0,-1,-1,-1,-1),
-            _mm256_set_epi32( 0, 0, 0,-1,-1,-1,-1,-1),
-            _mm256_set_epi32( 0, 0,-1,-1,-1,-1,-1,-1),
-            _mm256_set_epi32( 0,-1,-1,-1,-1,-1,-1,-1),
-            _mm256_set_epi32(-1,-1,-1,-1,-1,-1,-1,-1),
-        };
-        return _mm256_loadu_si256(&mask[N7]);
+        static const int32_t mask[16] = {-1,-1,-1,-1,-1,-1,-1,-1, 0, 0, 0, 0, 0, 0, 0, 0};
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(mask + 8 - N7));
     }
 
-    inline void softmax(float * v, int N, float * s_max=nullptr, float * s_sum=nullptr) {
-        static __m256 one = _mm256_castsi256_ps(_mm256_set1_epi32(0x3f800000));                 // 1.0f
-        auto x_mask = get_mask(N & 7);
-
-        // get max
-        auto x_max = _mm256_set1_ps(std::numeric_limits<float>::lowest());
-        int i;
-        for(i = 0; (i+8) <= N; i+=8) {
-            auto x = _mm256_loadu_ps(v + i);
-            x_max = _mm256_max_ps(x_max, x);
-        }
-        // tails
-        if (i < N) {
-            auto x = _mm256_maskload_ps(v+i, x_mask);
-            x = _mm256_blendv_ps(x_max, x, _mm256_castsi256_ps(x_mask)); // replace the padding zero with current max
-            x_max = _mm256_max_ps(x_max, x);
-        }
-        avx2::functional::hmax(x_max);
-        if (s_max) *s_max = _mm256_cvtss_f32(x_max);
-
-        // softmax
-        auto sum_exp = _mm256_setzero_ps();
-        for(i = 0; (i+8) <= N; i+=8) {
-            auto x = _mm256_loadu_ps(v + i);
-            x = _mm256_sub_ps(x, x_max);
-            avx2::functional::exp_ps(x);         // exp(x-x_max)
-            sum_exp = _mm256_add_ps(sum_exp, x); // sum(exp(x-x_max))
-            _mm256_storeu_ps(v + i, x);          // save exp(x-x_max)
-        }
+    // fp32 => bf16 (round to nearest even) of 8 values
+    inline __m128i cvt_ps_bf16(__m256 x) {
+        auto xi = _mm256_castps_si256(x);
+        auto lsb = _mm256_and_si256(_mm256_srli_epi32(xi, 16), _mm256_set1_epi32(1));
+        xi = _mm256_add_epi32(xi, _mm256_add_epi32(lsb, _mm256_set1_epi32(0x7fff)));
+        xi = _mm256_srli_epi32(xi, 16);
+        return _mm_packus_epi32(_mm256_castsi256_si128(xi), _mm256_extracti128_si256(xi, 1));
+    }
 
-        // handle tails
-        if (i < N) {
-            auto x = _mm256_maskload_ps(v+i, x_mask);
-            x = _mm256_sub_ps(x, x_max);
-            avx2::functional::exp_ps(x);
-            x = _mm256_blendv_ps(_mm256_setzero_ps(), x, _mm256_castsi256_ps(x_mask));
-            sum_exp = _mm256_add_ps(sum_exp, x);
-            _mm256_maskstore_ps(v + i, x_mask, x);
+    inline void store_n(float * dst, __m256 x, __m256i mask, int n) {
+        if (n == 8)
+            _mm256_storeu_ps(dst, x);
+        else
+            _mm256_maskstore_ps(dst, mask, x);
+    }
+    inline void store_n(ov::bfloat16 * dst, __m256 x, __m256i mask, int n) {
+        if (n == 8) {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), cvt_ps_bf16(x));
+            return;
         }
+        uint16_t tmp[8];
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(tmp), cvt_ps_bf16(x));
+        memcpy(dst, tmp, n * sizeof(uint16_t));
+    }
 
-        avx2::functional::hsum(sum_exp);
-        if (s_sum) *s_sum = _mm256_cvtss_f32(sum_exp);
-        auto reciprocal_sum_exp = _mm256_div_ps(one, sum_exp);     // 1/sum_exp
+    // single-pass (online) softmax of a row
+    //   x[n] = src[n] * scale + bias[n] + slope * (n + dist0)       (bias is optional, slope is ALiBi)
+    //   dst[n] = exp(x[n] - max(x)) / sum(exp(x - max(x)))          n in [0, valid)
+    //   dst[n] = 0                                                   n in [valid, N) (causal limit)
+    //
+    // max & sum are found in one read of src : each lane keeps its running max and the sum of
+    // exp relative to it, rescaled by exp(old_max - new_max) once per 4 vectors, lanes are merged
+    // at the end. the second (last) pass writes normalized fp32 or bf16 into dst, which may alias
+    // src when TO is float. that's 2 reads + 1 write of the row instead of 3 reads + 2 writes of
+    // the 3-pass version, and scale/bias don't take extra passes over the score matrix.
+    template<typename TO>
+    inline void softmax_online(TO * dst, const float * src, int N, int valid,
+                               float scale = 1.0f, const float * bias = nullptr, float slope = 0.0f, int dist0 = 0,
+                               float * s_max = nullptr, float * s_sum = nullptr) {
+        const auto lowest = _mm256_set1_ps(std::numeric_limits<float>::lowest());
+        const auto zero = _mm256_setzero_ps();
+        const auto vscale = _mm256_set1_ps(scale);
+        const auto vslope = _mm256_set1_ps(slope);
+        const auto vlane = _mm256_set_ps(7, 6, 5, 4, 3, 2, 1, 0);
+        auto load_x = [&](int n) {
+            auto x = _mm256_mul_ps(_mm256_loadu_ps(src + n), vscale);
+            if (bias) x = _mm256_add_ps(x, _mm256_loadu_ps(bias + n));
+            return _mm256_fmadd_ps(_mm256_add_ps(vlane, _mm256_set1_ps(n + dist0)), vslope, x);
+        };
+        auto load_x_tail = [&](int n, __m256i mask) {
+            auto x = _mm256_mul_ps(_mm256_maskload_ps(src + n, mask), vscale);
+            if (bias) x = _mm256_add_ps(x, _mm256_maskload_ps(bias + n, mask));
+            x = _mm256_fmadd_ps(_mm256_add_ps(vlane, _mm256_set1_ps(n + dist0)), vslope, x);
+            return _mm256_blendv_ps(lowest, x, _mm256_castsi256_ps(mask));
+        };
 
-        // divide
-        for(i = 0; (i+8) <= N; i+=8) {
-            auto x = _mm256_loadu_ps(v + i);
-            x = _mm256_mul_ps(x, reciprocal_sum_exp);
-            _mm256_storeu_ps(v + i, x);
+        auto v_max = lowest;
+        auto v_sum = zero;
+        int n = 0;
+        for(; n + 32 <= valid; n += 32) {
+            auto x0 = load_x(n);
+            auto x1 = load_x(n + 8);
+            auto x2 = load_x(n + 16);
+            auto x3 = load_x(n + 24);
+            auto new_max = _mm256_max_ps(_mm256_max_ps(x0, x1), _mm256_max_ps(x2, x3));
+            new_max = _mm256_max_ps(new_max, v_max);
+            auto r = _mm256_sub_ps(v_max, new_max);
+            x0 = _mm256_sub_ps(x0, new_max);
+            x1 = _mm256_sub_ps(x1, new_max);
+            x2 = _mm256_sub_ps(x2, new_max);
+            x3 = _mm256_sub_ps(x3, new_max);
+            exp_ps(r);
+            exp_ps(x0);
+            exp_ps(x1);
+            exp_ps(x2);
+            exp_ps(x3);
+            v_sum = _mm256_fmadd_ps(v_sum, r, _mm256_add_ps(_mm256_add_ps(x0, x1), _mm256_add_ps(x2, x3)));
+            v_max = new_max;
         }
-        // handle tails
-        if (i < N) {
-            auto x = _mm256_maskload_ps(v+i, x_mask);
-            x = _mm256_mul_ps(x, reciprocal_sum_exp);
-            _mm256_maskstore_ps(v + i, x_mask, x);
+        for(; n < valid; n += 8) {
+            auto mask = get_mask(std::min(8, valid - n));
+            auto x = load_x_tail(n, mask);
+            auto new_max = _mm256_max_ps(v_max, x);
+            auto r = _mm256_sub_ps(v_max, new_max);
+            x = _mm256_sub_ps(x, new_max);
+            exp_ps(r);
+            exp_ps(x);
+            x = _mm256_blendv_ps(zero, x, _mm256_castsi256_ps(mask));
+            v_sum = _mm256_fmadd_ps(v_sum, r, x);
+            v_max = new_max;
         }
+        // merge lanes
+        auto x_max = v_max;
+        hmax(x_max);
+        auto r = _mm256_sub_ps(v_max, x_max);
+        exp_ps(r);
+        v_sum = _mm256_mul_ps(v_sum, r);
+        hsum(v_sum);
+        float sum = _mm256_cvtss_f32(v_sum);
+        if (s_max) *s_max = _mm256_cvtss_f32(x_max);
+        if (s_sum) *s_sum = sum;
+        auto reciprocal_sum = _mm256_set1_ps(sum > 0 ? 1.0f / sum : 0.0f);
+
+        // normalize & store
+        for(n = 0; n + 8 <= valid; n += 8) {
+            auto x = _mm256_sub_ps(load_x(n), x_max);
+            exp_ps(x);
+            store_n(dst + n, _mm256_mul_ps(x, reciprocal_sum), get_mask(8), 8);
+        }
+        if (n < valid) {
+            auto mask = get_mask(valid - n);
+            auto x = _mm256_sub_ps(load_x_tail(n, mask), x_max);
+            exp_ps(x);
+            store_n(dst + n, _mm256_mul_ps(x, reciprocal_sum), mask, valid - n);
+        }
+        if (valid < N)
+            memset(dst + valid, 0, (N - valid) * sizeof(TO));
+    }
+
+    inline void softmax(float * v, int N, float * s_max=nullptr, float * s_sum=nullptr) {
+        softmax_online(v, v, N, N, 1.0f, nullptr, 0.0f, 0, s_max, s_sum);
     }
 
     // gelu_erf_minimax_approx_compute_vector_fwd in oneDNN
@@ -815,7 +878,7 @@ struct Matmul {
         #undef FMADD
     };
 
-    void reorderB(tensorND<float> & matB, int n0, int n1) {
+    void reorderB(tensorND_view<float> matB, int n0, int n1) {
         // transposeB : B_NxK
         //
         int K = matB.shape[transposeB ? 1 : 0];
@@ -852,15 +915,16 @@ struct Matmul {
                 int nsrc = (valid_n <= 8) ? (n1 - 8) : ((valid_n < 16) ? (n1 - 16) : (n0 + n));
                 auto * pBdst = &internalB(n/16, 0);
                 auto * pBsrc = &matB(nsrc, 0);
-                functional::transpose_16xK_ps(pBdst, pBsrc, strideB, valid_n, K);
+                // shifted tails overlap with previous columns, which are valid & must be transposed too
+                functional::transpose_16xK_ps(pBdst, pBsrc, strideB, (nsrc >= 0 && nsrc < n0 + n) ? (valid_n <= 8 ? 8 : 16) : valid_n, K);
             });
         }
     }
 
     template<typename P>
-    void operator()(tensorND<float> & matA,
-                    tensorND<float> & matB,
-                    tensorND<float> & matC,
+    void operator()(tensorND_view<float> matA,
+                    tensorND_view<float> matB,
+                    tensorND_view<float> matC,
                     int n0, int n1,
                     P pp) {
         int M = matA.shape[0];
@@ -914,7 +978,7 @@ struct Matmul {
             auto * pC = &matC(m, ndst);
             if (use_dynTransB && m == 0) {
                 // dynamically transpose 16 rows of matB into internalB
-                functional::transpose_16xK_ps(&internalB[0], &matB(ndst, 0), strideB, valid_n, K);
+                functional::transpose_16xK_ps(&internalB[0], &matB(ndst, 0), strideB, (ndst >= 0 && ndst < n0 + n) ? (valid_n <= 8 ? 8 : 16) : valid_n, K);
             }
             if (use_dynReorderB && m == 0) {
                 // dynamically reorder B matrix into continous internalB
@@ -1,8 +1,10 @@
 
 #pragma once
 
+#include "misc.hpp"
 #include "block_iter.hpp"
 #include "tensor2D.hpp"
+#include <algorithm>
 #ifdef _WIN32
 #include <intrin.h>
 #else
@@ -21,23 +23,146 @@ tests:1 passed:1 skipped:0 mistrusted:0 unimplemented:0 invalid_arguments:0 fail
 total perf: min(ms):0.0012207 avg(ms):0.00159982
 */
 
+namespace functional {
+
+    // gelu_erf_minimax_approx_compute_vector_fwd in oneDNN
+    //   x*0.5*(1+erf(x/sqrt(2))) = x*0.5*(1 + x*Polynomial(x^2))
+    inline __m512 gelu_erf_minmax_approx(__m512 & x) {
+        auto x2 = _mm512_mul_ps(x, x); // x^2
+        
+        auto x_positive = _mm512_castsi512_ps(_mm512_and_epi32(_mm512_castps_si512(x), _mm512_set1_epi32(0x7FFFFFFF)));    // clear sign mask
+        auto x_half = _mm512_mul_ps(x, _mm512_set1_ps(0.5f));
+
+        auto poly = _mm512_castsi512_ps(_mm512_set1_epi32(0x1f1c83fd));
+        poly = _mm512_fmadd_ps(poly, x2, _mm512_castsi512_ps(_mm512_set1_epi32(0xa3198977))); // poly * x^2 + xxx
+        poly = _mm512_fmadd_ps(poly, x2, _mm512_castsi512_ps(_mm512_set1_epi32(0x268a7927)));
+        poly = _mm512_fmadd_ps(poly, x2, _mm512_castsi512_ps(_mm512_set1_epi32(0xa998c963)));
+        poly = _mm512_fmadd_ps(poly, x2, _mm512_castsi512_ps(_mm512_set1_epi32(0x2c67ddb2)));
+        poly = _mm512_fmadd_ps(poly, x2, _mm512_castsi512_ps(_mm512_set1_epi32(0xaf013b2c)));
+        poly = _mm512_fmadd_ps(poly, x2, _mm512_castsi512_ps(_mm512_set1_epi32(0x315d4a4f)));
+        poly = _mm512_fmadd_ps(poly, x2, _mm512_castsi512_ps(_mm512_set1_epi32(0xb3969b11)));
+        poly = _mm512_fmadd_ps(poly, x2, _mm512_castsi512_ps(_mm512_set1_epi32(0x35a776e9)));
+        poly = _mm512_fmadd_ps(poly, x2, _mm512_castsi512_ps(_mm512_set1_epi32(0xb79b0914)));
+        poly = _mm512_fmadd_ps(poly, x2, _mm512_castsi512_ps(_mm512_set1_epi32(0x3970b255)));
+        poly = _mm512_fmadd_ps(poly, x2, _mm512_castsi512_ps(_mm512_set1_epi32(0xbb1b7399)));
+        poly = _mm512_fmadd_ps(poly, x2, _mm512_castsi512_ps(_mm512_set1_epi32(0x3ca3621f)));
+        poly = _mm512_fmadd_ps(poly, x2, _mm512_castsi512_ps(_mm512_set1_epi32(0xbe082bc7)));
+        poly = _mm512_fmadd_ps(poly, x2, _mm512_castsi512_ps(_mm512_set1_epi32(0x3f4c4228)));
+
+        // 1.0f + erf(x * inv_sqrt2) = 1.0f + x * P(x^2)
+        poly = _mm512_fmadd_ps(poly, x, _mm512_set1_ps(1.0f));
+        // x*0.5*(1 + x*Polynomial(x^2))
+        poly = _mm512_mul_ps(poly, x_half);
+
+        // combine:
+        // zone_id
+        //  1 -inf; -saturation_lbound           : 0.0f
+        //  2 -saturation_lbound; -linear_ubound : x*0.5*(1 + x*Polynomial(x^2))
+        //  3 -linear_ubound, linear_ubound         : x*0.5
+        //  4 linear_ubound : saturation_lbound     : x*0.5*(1 + x*Polynomial(x^2))
+        //  5 saturation_lbound: +inf               : x
+        constexpr int neg_saturation_lbound = 0xc0a00000;
+        constexpr int linear_ubound = 0x33800000;
+        constexpr int saturation_lbound = 0x40a00000;
+
+        auto mask_x_not_zone1 = _mm512_cmpnlt_ps_mask(x, _mm512_castsi512_ps(_mm512_set1_epi32(neg_saturation_lbound)));
+        x = _mm512_maskz_mov_ps(mask_x_not_zone1, x);
+
+        auto mask_x_in_zone5 = _mm512_cmpnle_ps_mask(x_positive, _mm512_castsi512_ps(_mm512_set1_epi32(saturation_lbound)));
+        poly = _mm512_mask_mov_ps(poly, mask_x_in_zone5, x);
+
+        auto mask_x_in_zone3 = _mm512_cmple_ps_mask(x_positive, _mm512_castsi512_ps(_mm512_set1_epi32(linear_ubound)));
+        poly = _mm512_mask_mov_ps(poly, mask_x_in_zone3, x_half);
+        return poly;
+    }
+
+    // same algorithm as avx2::functional::exp_ps
+    inline __m512 exp_ps(__m512 src) {
+        const auto exp_ln_flt_min_f = _mm512_castsi512_ps(_mm512_set1_epi32(0xc2aeac50));    // log(FLT_MIN)
+        const auto exp_ln_flt_max_f = _mm512_castsi512_ps(_mm512_set1_epi32(0x42b17218));    // log(FLT_MAX)
+        const auto exp_log2ef = _mm512_castsi512_ps(_mm512_set1_epi32(0x3fb8aa3b));          // log2(e)
+        const auto half = _mm512_castsi512_ps(_mm512_set1_epi32(0x3f000000));                // 0.5f
+        const auto ln2f = _mm512_castsi512_ps(_mm512_set1_epi32(0x3f317218));                // ln(2)
+        const auto one = _mm512_castsi512_ps(_mm512_set1_epi32(0x3f800000));                 // 1.0f
+        const auto exponent_bias = _mm512_set1_epi32(0x0000007f);                            // 127
+        constexpr int n_mantissa_bits = 23;
+        const auto exp_pol1 = _mm512_castsi512_ps(_mm512_set1_epi32(0x3f7ffffb));            // p1 = 0.999999701f
+        const auto exp_pol2 = _mm512_castsi512_ps(_mm512_set1_epi32(0x3efffee3));            // p2 = 0.499991506f
+        const auto exp_pol3 = _mm512_castsi512_ps(_mm512_set1_epi32(0x3e2aad40));            // p3 = 0.166676521f
+        const auto exp_pol4 = _mm512_castsi512_ps(_mm512_set1_epi32(0x3d2b9d0d));            // p4 = 0.0418978221f
+        const auto exp_pol5 = _mm512_castsi512_ps(_mm512_set1_epi32(0x3c07cfce));            // p5 = 0.00828929059f
+        const auto two = _mm512_castsi512_ps(_mm512_set1_epi32(0x40000000));                 // 2
+
+        // values lower than log(FLT_MIN) (including -inf) are zero in the output
+        auto zero_mask = _mm512_cmp_ps_mask(src, exp_ln_flt_min_f, _CMP_LT_OS);
+
+        src = _mm512_min_ps(src, exp_ln_flt_max_f);
+        src = _mm512_max_ps(src, exp_ln_flt_min_f);
+        auto aux1 = src;
+
+        // fx = floorf(x * log2(e) + 0.5)
+        src = _mm512_fmadd_ps(src, exp_log2ef, half);
+        src = _mm512_roundscale_ps(src, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+
+        // r = x - fx * ln2
+        aux1 = _mm512_fnmadd_ps(src, ln2f, aux1);
+
+        // 2^(n-1), 2^n can overflow when n=128
+        src = _mm512_sub_ps(src, one);
+        auto aux2_i = _mm512_cvtps_epi32(src);
+        aux2_i = _mm512_add_epi32(aux2_i, exponent_bias);
+        aux2_i = _mm512_slli_epi32(aux2_i, n_mantissa_bits);
+        auto aux2 = _mm512_maskz_mov_ps(_knot_mask16(zero_mask), _mm512_castsi512_ps(aux2_i));
+
+        src = exp_pol5;
+        src = _mm512_fmadd_ps(src, aux1, exp_pol4);
+        src = _mm512_fmadd_ps(src, aux1, exp_pol3);
+        src = _mm512_fmadd_ps(src, aux1, exp_pol2);
+        src = _mm512_fmadd_ps(src, aux1, exp_pol1);
+        src = _mm512_fmadd_ps(src, aux1, one);
+
+        // y = y * 2^(n-1) * 2
+        src = _mm512_mul_ps(src, aux2);
+        return _mm512_mul_ps(src, two);
+    }
+}
+
 namespace PP {
-struct AddbiasRelu {
-    float * bias;
-    AddbiasRelu(float * bias) : bias(bias) {};
+// post-ops are prepared for 4x16 columns starting from n, valid_n (<=64) of which are
+// inside C, so nothing is read beyond the end of bias at N tails
+struct None {
+    void prepare(int n, int valid_n = 64) {}
+    void exec(__m512 & v0, __m512 & v1, __m512 & v2, __m512 & v3) {}
+};
+
+enum Act {
+    Act_NONE = 0,
+    Act_RELU = 1,
+    Act_GELU = 2,
+};
+
+template<Act act>
+struct AddbiasAct {
+    const float * bias;     // optional
+    AddbiasAct(const float * bias) : bias(bias) {};
 
     __m512 bias0;
     __m512 bias1;
     __m512 bias2;
     __m512 bias3;
     __m512 zero;
-    void prepare(int n) {
-        // prepare 4x16 biases
+    void prepare(int n, int valid_n = 64) {
         zero = _mm512_setzero_ps();
-        bias0 = _mm512_loadu_ps(bias + n);
-        bias1 = _mm512_loadu_ps(bias + n + 16);
-        bias2 = _mm512_loadu_ps(bias + n + 16*2);
-        bias3 = _mm512_loadu_ps(bias + n + 16*3);
+        bias0 = bias1 = bias2 = bias3 = zero;
+        if (!bias) return;
+        auto k = [&](int i) {
+            int v = std::max(0, std::min(16, valid_n - i * 16));
+            return _cvtu32_mask16(0xFFFFu >> (16 - v));
+        };
+        bias0 = _mm512_maskz_loadu_ps(k(0), bias + n);
+        bias1 = _mm512_maskz_loadu_ps(k(1), bias + n + 16);
+        bias2 = _mm512_maskz_loadu_ps(k(2), bias + n + 16*2);
+        bias3 = _mm512_maskz_loadu_ps(k(3), bias + n + 16*3);
     }
     void exec(__m512 & v0, __m512 & v1, __m512 & v2, __m512 & v3) {
         // bias
@@ -46,26 +171,94 @@ struct AddbiasRelu {
         v2 = _mm512_add_ps(v2, bias2);
         v3 = _mm512_add_ps(v3, bias3);
 
-        // relu
-        v0 = _mm512_max_ps (v0, zero);
-        v1 = _mm512_max_ps (v1, zero);
-        v2 = _mm512_max_ps (v2, zero);
-        v3 = _mm512_max_ps (v3, zero);
+        if (act == Act_RELU) {
+            v0 = _mm512_max_ps (v0, zero);
+            v1 = _mm512_max_ps (v1, zero);
+            v2 = _mm512_max_ps (v2, zero);
+            v3 = _mm512_max_ps (v3, zero);
+        }
+        if (act == Act_GELU) {
+            v0 = functional::gelu_erf_minmax_approx(v0);
+            v1 = functional::gelu_erf_minmax_approx(v1);
+            v2 = functional::gelu_erf_minmax_approx(v2);
+            v3 = functional::gelu_erf_minmax_approx(v3);
+        }
     }
 };
 
+using AddbiasRelu = AddbiasAct<Act_RELU>;
+
 }
 
 
 struct Matmul {
     BlockIterator blk_it;
-    tensor2D<float> scratch;
     Matmul() {};
 
+    // rows x 64 of C, using rows x (4x16) zmm accumulators (at most 24)
+    template<int rows, typename P>
+    static void kernel(const float * pA, int strideA,
+                       const float * pB, int strideB,
+                       float * pC, int strideC,
+                       int K, int n, int valid_n, const __mmask16 * km, P & pp) {
+        __m512 c00, c01, c02, c03;
+        __m512 c10, c11, c12, c13;
+        __m512 c20, c21, c22, c23;
+        __m512 c30, c31, c32, c33;
+        __m512 c40, c41, c42, c43;
+        __m512 c50, c51, c52, c53;
+
+        #define ZERO(i) \
+            if (rows > i) { \
+                c##i##0 = _mm512_setzero_ps(); \
+                c##i##1 = _mm512_setzero_ps(); \
+                c##i##2 = _mm512_setzero_ps(); \
+                c##i##3 = _mm512_setzero_ps(); \
+            }
+        #define FMADD(i) \
+            if (rows > i) { \
+                auto a = _mm512_set1_ps(pA[i*strideA]); \
+                c##i##0 = _mm512_fmadd_ps(a, b0, c##i##0); \
+                c##i##1 = _mm512_fmadd_ps(a, b1, c##i##1); \
+                c##i##2 = _mm512_fmadd_ps(a, b2, c##i##2); \
+                c##i##3 = _mm512_fmadd_ps(a, b3, c##i##3); \
+            }
+        // post-ops work on copies : accumulators passed by reference into a non-inlined
+        // epilogue (GELU) are kept in memory by the compiler, i.e. stored in every k step
+        #define STORE(i) \
+            if (rows > i) { \
+                auto v0 = c##i##0, v1 = c##i##1, v2 = c##i##2, v3 = c##i##3; \
+                pp.exec(v0, v1, v2, v3); \
+                _mm512_mask_storeu_ps (pC       , km[0], v0); \
+                _mm512_mask_storeu_ps (pC + 16  , km[1], v1); \
+                _mm512_mask_storeu_ps (pC + 16*2, km[2], v2); \
+                _mm512_mask_storeu_ps (pC + 16*3, km[3], v3); \
+                pC += strideC; \
+            }
+
+        ZERO(0); ZERO(1); ZERO(2); ZERO(3); ZERO(4); ZERO(5);
+
+        for(int k = 0; k < K; k++, pB += strideB, pA++) {
+            auto b0 = _mm512_maskz_loadu_ps(km[0], pB);
+            auto b1 = _mm512_maskz_loadu_ps(km[1], pB + 16);
+            auto b2 = _mm512_maskz_loadu_ps(km[2], pB + 16*2);
+            auto b3 = _mm512_maskz_loadu_ps(km[3], pB + 16*3);
+            FMADD(0); FMADD(1); FMADD(2); FMADD(3); FMADD(4); FMADD(5);
+        }
+
+        //save rows x (4x16) to matC
+        pp.prepare(n, valid_n);
+        STORE(0); STORE(1); STORE(2); STORE(3); STORE(4); STORE(5);
+
+        #undef ZERO
+        #undef FMADD
+        #undef STORE
+    }
+
     template<typename P>
-    void operator()(tensor2D<float> & matA,
-                    tensor2D<float> & matB,
-                    tensor2D<float> & matC,
+    void operator()(tensor_view<float> matA,
+                    tensor_view<float> matB,
+                    tensor_view<float> matC,
                     P pp) {
         int M = matA.dims[0];
         int K = matA.dims[1];
@@ -73,8 +266,8 @@ struct Matmul {
         int N = matB.dims[1];
 
         // determine blocking scheme
-        int elesz = sizeof(uint16_t);
-        int L2 = 2048*1024; // 2MB
+        int elesz = sizeof(float);
+        int L2 = get_L2_size();
         int slice_size = 6*rndup(K, 6)*elesz;
         int mc = L2/slice_size - 1;
 
@@ -86,21 +279,7 @@ struct Matmul {
         BlockIterator::blkloop bloops[] = {{mc,6,0}, {dmax,0,64}, {dmax,mc*6,0}};
         blk_it.reset(bloops, 3, M, N);
 
-        tensor2D<float> & Atails = scratch;
-        int mtails = M % 6;
-        if (mtails > 0) {
-            Atails.resize(6, rndup(K, 16));
-            // copy tails into Atails (in unit of 32x32)
-            for (int m = 0; m < mtails; m++) {
-                memcpy(&Atails(m, 0), &matA(M - mtails + m, 0), matA.stride);
-                if (Atails.stride > matA.stride) {
-                    memset(reinterpret_cast<int8_t*>(&Atails(m, 0)) + matA.stride,
-                            0,
-                            Atails.stride - matA.stride);
-                }
-            }
-        }
-
+        auto strideA = matA.stride/sizeof(float);
         auto strideB = matB.stride/sizeof(float);
         auto strideC = matC.stride/sizeof(float);
         do
@@ -111,86 +290,22 @@ struct Matmul {
             int valid_n = std::min(N - n, 64);
             auto * pA = &matA(m, 0);
             auto * pB = &matB(0, n);
-            auto strideA = matA.stride/sizeof(float);
-            if (valid_m < 6) {
-                // use Atails buffer to prevent memory read segmentfault
-                pA = &Atails(0, 0);
-                strideA = Atails.stride/sizeof(float);
-            }
-
-            // do a 6x64 result, use 6x(4x16)=24 512bit register
-            auto c00 = _mm512_setzero_ps(); auto c01 = _mm512_setzero_ps(); auto c02 = _mm512_setzero_ps(); auto c03 = _mm512_setzero_ps();
-            auto c10 = _mm512_setzero_ps(); auto c11 = _mm512_setzero_ps(); auto c12 = _mm512_setzero_ps(); auto c13 = _mm512_setzero_ps();
-            auto c20 = _mm512_setzero_ps(); auto c21 = _mm512_setzero_ps(); auto c22 = _mm512_setzero_ps(); auto c23 = _mm512_setzero_ps();
-            auto c30 = _mm512_setzero_ps(); auto c31 = _mm512_setzero_ps(); auto c32 = _mm512_setzero_ps(); auto c33 = _mm512_setzero_ps();
-            auto c40 = _mm512_setzero_ps(); auto c41 = _mm512_setzero_ps(); auto c42 = _mm512_setzero_ps(); auto c43 = _mm512_setzero_ps();
-            auto c50 = _mm512_setzero_ps(); auto c51 = _mm512_setzero_ps(); auto c52 = _mm512_setzero_ps(); auto c53 = _mm512_setzero_ps();
-
-            for(int k = 0; k < K; k++, pB += strideB) {
-                auto b0 = _mm512_loadu_ps(pB);
-                auto b1 = _mm512_loadu_ps(pB + 16);
-                auto b2 = _mm512_loadu_ps(pB + 16*2);
-                auto b3 = _mm512_loadu_ps(pB + 16*3);
-
-                auto a0 = _mm512_set1_ps(pA[k + 0*strideA]);
-                c00 = _mm512_fmadd_ps(a0, b0, c00);
-                c01 = _mm512_fmadd_ps(a0, b1, c01);
-                c02 = _mm512_fmadd_ps(a0, b2, c02);
-                c03 = _mm512_fmadd_ps(a0, b3, c03);
-
-                auto a1 = _mm512_set1_ps(pA[k + 1*strideA]);
-                c10 = _mm512_fmadd_ps(a1, b0, c10);
-                c11 = _mm512_fmadd_ps(a1, b1, c11);
-                c12 = _mm512_fmadd_ps(a1, b2, c12);
-                c13 = _mm512_fmadd_ps(a1, b3, c13);
-
-                auto a2 = _mm512_set1_ps(pA[k + 2*strideA]);
-                c20 = _mm512_fmadd_ps(a2, b0, c20);
-                c21 = _mm512_fmadd_ps(a2, b1, c21);
-                c22 = _mm512_fmadd_ps(a2, b2, c22);
-                c23 = _mm512_fmadd_ps(a2, b3, c23);
-
-                auto a3 = _mm512_set1_ps(pA[k + 3*strideA]);
-                c30 = _mm512_fmadd_ps(a3, b0, c30);
-                c31 = _mm512_fmadd_ps(a3, b1, c31);
-                c32 = _mm512_fmadd_ps(a3, b2, c32);
-                c33 = _mm512_fmadd_ps(a3, b3, c33);
-
-                auto a4 = _mm512_set1_ps(pA[k + 4*strideA]);
-                c40 = _mm512_fmadd_ps(a4, b0, c40);
-                c41 = _mm512_fmadd_ps(a4, b1, c41);
-                c42 = _mm512_fmadd_ps(a4, b2, c42);
-                c43 = _mm512_fmadd_ps(a4, b3, c43);
-
-                auto a5 = _mm512_set1_ps(pA[k + 5*strideA]);
-                c50 = _mm512_fmadd_ps(a5, b0, c50);
-                c51 = _mm512_fmadd_ps(a5, b1, c51);
-                c52 = _mm512_fmadd_ps(a5, b2, c52);
-                c53 = _mm512_fmadd_ps(a5, b3, c53);
-            }
-
-            //save 6x(4x16) to matC
-            pp.prepare(n);
-
             auto * pC = &matC(m, n);
-            __mmask16 mask = _cvtu32_mask16(0xFFFFFFFF >> (32-valid_n));
-            auto lppkernel = [&](__m512 & v0,__m512 & v1,__m512 & v2,__m512 & v3){
-                pp.exec(v0, v1, v2, v3);
-                _mm512_mask_storeu_ps (pC       , mask, v0);
-                _mm512_mask_storeu_ps (pC + 16  , mask, v1);
-                _mm512_mask_storeu_ps (pC + 16*2, mask, v2);
-                _mm512_mask_storeu_ps (pC + 16*3, mask, v3);
-                pC += strideC;
-                valid_m --;
-            };
-
-            if(valid_m) lppkernel(c00, c01, c02, c03);
-            if(valid_m) lppkernel(c10, c11, c12, c13);
-            if(valid_m) lppkernel(c20, c21, c22, c23);
-            if(valid_m) lppkernel(c30, c31, c32, c33);
-            if(valid_m) lppkernel(c40, c41, c42, c43);
-            if(valid_m) lppkernel(c50, c51, c52, c53);
 
+            // N tails : columns beyond N are neither read from B nor written into C
+            __mmask16 km[4];
+            for(int i = 0; i < 4; i++)
+                km[i] = _cvtu32_mask16(0xFFFFu >> (16 - std::max(0, std::min(16, valid_n - i * 16))));
+
+            // M tails : only valid rows are loaded & computed
+            switch(valid_m) {
+                case 6: kernel<6>(pA, strideA, pB, strideB, pC, strideC, K, n, valid_n, km, pp); break;
+                case 5: kernel<5>(pA, strideA, pB, strideB, pC, strideC, K, n, valid_n, km, pp); break;
+                case 4: kernel<4>(pA, strideA, pB, strideB, pC, strideC, K, n, valid_n, km, pp); break;
+                case 3: kernel<3>(pA, strideA, pB, strideB, pC, strideC, K, n, valid_n, km, pp); break;
+                case 2: kernel<2>(pA, strideA, pB, strideB, pC, strideC, K, n, valid_n, km, pp); break;
+                case 1: kernel<1>(pA, strideA, pB, strideB, pC, strideC, K, n, valid_n, km, pp); break;
+            }
         }while(blk_it.next());
     }
 };
@@ -0,0 +1,333 @@
+#pragma once
+
+#include "kernels_amx.hpp"
+#include <type_traits>
+#include <vector>
+
+// AVX-512 fallback of amx_kernel::Matmul for CPUs without AMX (Icelake, Cooperlake...)
+//
+// B is packed by the same repackB_1x2/LazyRepackedB, whose B0/B1 tiles are already in the
+// layout VNNI instructions expect: each 64-byte row holds one dword of k (2 bf16 or 4 int8)
+// for 16 columns, so one row multiplied by a broadcasted dword of an A row is a single
+// vdpbf16ps/vpdpbusd. K-tails are bottom-aligned in packed B, so A tails are right-aligned
+// into a zero-padded copy, the same way AMX backs off the A tile.
+//
+// C is computed in the same 32x32 blocks by loop2D and passed to the ppkernel through buffC
+// with the same (m, n, valid_m, valid_n) convention, so amx_kernel::PP kernels (and any
+// other ppkernel written for amx_kernel::Matmul) work unchanged.
+//
+//   bf16 x bf16 : vdpbf16ps when built with AVX512_BF16 (Cooperlake and later), otherwise
+//                 each bf16 pair is expanded to fp32 by shifting and accumulated by 2 FMAs
+//   int8 x int8 : vpdpbusd (AVX512_VNNI) only multiplies u8 by s8, for other signedness the
+//                 sign bit of B is flipped and the result is compensated by row sum of A:
+//                     s8*s8 : a*(b+128) - 128*sum(a)
+//                     u8*u8 : a*(b-128) + 128*sum(a)
+namespace avx512_vnni {
+
+using amx_kernel::acc_type_t;
+using amx_kernel::LazyRepackedB;
+
+// accumulator register: __m512i of int32 (int8) or __m512 of fp32 (bf16). not std::conditional,
+// whose template arguments would drop the vector attributes of __m512/__m512i
+template<bool i8> struct acc_reg { using type = __m512; };
+template<> struct acc_reg<true> { using type = __m512i; };
+
+template<typename TA, typename TB, typename TC = acc_type_t<TA>>
+struct Matmul {
+    // same layout as amx_kernel::Matmul::internalB
+    tensor2D<TB> internalB;
+
+    bool constB;
+    bool transposeB;
+
+    constexpr static bool is_bf16bf16 = std::is_same<TA,ov::bfloat16>::value && std::is_same<TB,ov::bfloat16>::value;
+    constexpr static bool is_s8s8 = std::is_same<TA,int8_t>::value && std::is_same<TB,int8_t>::value;
+    constexpr static bool is_s8u8 = std::is_same<TA,int8_t>::value && std::is_same<TB,uint8_t>::value;
+    constexpr static bool is_u8s8 = std::is_same<TA,uint8_t>::value && std::is_same<TB,int8_t>::value;
+    constexpr static bool is_u8u8 = std::is_same<TA,uint8_t>::value && std::is_same<TB,uint8_t>::value;
+    constexpr static bool is_i8_mode = is_s8s8 || is_s8u8 || is_u8s8 || is_u8u8;
+    static_assert(is_bf16bf16 || is_i8_mode, "avx512_vnni::Matmul only supports bf16 x bf16 & int8 x int8");
+
+    constexpr static int kStep = is_i8_mode ? 64 : 32;
+
+    // sign bit of B is flipped to fit u8 x s8 of vpdpbusd
+    constexpr static bool flipB = is_s8s8 || is_u8u8;
+
+    using acc_t = typename acc_reg<is_i8_mode>::type;
+
+    tensor2D<TC> buffC;
+    tensor2D<TA> Atails;            // right-aligned K-tails of A rows, zero-padded to kStep
+    std::vector<int32_t> Acomp;     // per-row compensation of flipped B
+
+    Matmul(bool constB = false, bool transposeB = false) :
+        constB(constB), transposeB(transposeB), buffC(32, 32) {}
+
+    // one 64-byte row of B0/B1 prepared for dp()
+    struct OpB {
+        __m512i v;
+        __m512 even, odd;   // fp32 of even/odd k (bf16 w/o AVX512_BF16)
+    };
+
+    FORCE_INLINE static OpB loadB(const int8_t * p) {
+        OpB b;
+        b.v = _mm512_loadu_si512(p);
+#ifndef __AVX512BF16__
+        if (is_bf16bf16) {
+            // bf16 to fp32 is a 16-bit left shift: even k is the low half of dword, odd k the high half
+            b.even = _mm512_castsi512_ps(_mm512_slli_epi32(b.v, 16));
+            b.odd = _mm512_castsi512_ps(_mm512_and_si512(b.v, _mm512_set1_epi32(0xFFFF0000)));
+        }
+#endif
+        if (flipB)
+            b.v = _mm512_xor_si512(b.v, _mm512_set1_epi8(static_cast<char>(0x80)));
+        return b;
+    }
+
+    // c += a * b, a is a broadcasted dword of A
+    FORCE_INLINE static void dp(__m512 & c, __m512i a, const OpB & b) {
+#ifdef __AVX512BF16__
+        c = _mm512_dpbf16_ps(c, reinterpret_cast<__m512bh&>(a), reinterpret_cast<const __m512bh&>(b.v));
+#else
+        c = _mm512_fmadd_ps(_mm512_castsi512_ps(_mm512_slli_epi32(a, 16)), b.even, c);
+        c = _mm512_fmadd_ps(_mm512_castsi512_ps(_mm512_and_si512(a, _mm512_set1_epi32(0xFFFF0000))), b.odd, c);
+#endif
+    }
+
+    FORCE_INLINE static void dp(__m512i & c, __m512i a, const OpB & b) {
+#ifdef __AVX512VNNI__
+        if (std::is_same<TA, uint8_t>::value)
+            c = _mm512_dpbusd_epi32(c, a, b.v);     // A is the unsigned operand, B (flipped if u8) signed
+        else
+            c = _mm512_dpbusd_epi32(c, b.v, a);     // A is the signed operand, B (flipped if s8) unsigned
+#else
+        static_assert(!is_i8_mode, "int8 avx512_vnni::Matmul must be built with AVX512_VNNI");
+#endif
+    }
+
+    static void setzero(__m512 & c) { c = _mm512_setzero_ps(); }
+    static void setzero(__m512i & c) { c = _mm512_setzero_si512(); }
+    static void store(float * p, __m512 c) { _mm512_storeu_ps(p, c); }
+    static void store(int32_t * p, __m512i c) { _mm512_storeu_si512(p, c); }
+
+    // compensation of row i of flipped B (int32 accumulators only), nothing to do w/o flipB
+    template<bool flip = flipB>
+    static typename std::enable_if<flip>::type compensate(acc_t & c0, acc_t & c1, const int32_t * comp, int i) {
+        auto v = _mm512_set1_epi32(comp[i]);
+        c0 = _mm512_add_epi32(c0, v);
+        c1 = _mm512_add_epi32(c1, v);
+    }
+    template<bool flip = flipB>
+    static typename std::enable_if<!flip>::type compensate(acc_t &, acc_t &, const int32_t *, int) {}
+
+    // rows x 32 block of C (one N-panel of packed B) into pC (stride 32):
+    //   KB k-blocks of A from pA, kbStride bytes apart (64 for plain A, 1024 for blocked A)
+    //   optional tail k-block from pAt (right-aligned)
+    //   comp (given iff flipB) is added to each row
+    template<int rows>
+    static void kernel(const int8_t * pA, int strideA, int kbStride, int KB,
+                       const int8_t * pAt, int strideAt,
+                       const int8_t * pB, const int32_t * comp, TC * pC) {
+        acc_t c00, c01, c10, c11, c20, c21, c30, c31;
+        acc_t c40, c41, c50, c51, c60, c61, c70, c71;
+
+        #define ZERO(i) \
+            if (rows > i) { \
+                setzero(c##i##0); \
+                setzero(c##i##1); \
+            }
+        #define DP(i, pa, sa) \
+            if (rows > i) { \
+                auto a = _mm512_set1_epi32(*reinterpret_cast<const int32_t*>(pa + i * sa)); \
+                dp(c##i##0, a, b0); \
+                dp(c##i##1, a, b1); \
+            }
+        #define DP_ROW(pa, sa, pb) { \
+                auto b0 = loadB(pb); \
+                auto b1 = loadB(pb + 1024); \
+                DP(0, pa, sa); DP(1, pa, sa); DP(2, pa, sa); DP(3, pa, sa); \
+                DP(4, pa, sa); DP(5, pa, sa); DP(6, pa, sa); DP(7, pa, sa); \
+            }
+        #define STORE(i) \
+            if (rows > i) { \
+                compensate(c##i##0, c##i##1, comp, i); \
+                store(pC, c##i##0); \
+                store(pC + 16, c##i##1); \
+                pC += 32; \
+            }
+
+        ZERO(0); ZERO(1); ZERO(2); ZERO(3); ZERO(4); ZERO(5); ZERO(6); ZERO(7);
+
+        for(int kb = 0; kb < KB; kb++, pA += kbStride, pB += 2048) {
+            for(int r = 0; r < 16; r++) {
+                _mm_prefetch(pB + r * 64 + 4096, _MM_HINT_T0);
+                _mm_prefetch(pB + r * 64 + 4096 + 1024, _MM_HINT_T0);
+                DP_ROW(pA + r * 4, strideA, pB + r * 64);
+            }
+        }
+        if (pAt) {
+            for(int r = 0; r < 16; r++)
+                DP_ROW(pAt + r * 4, strideAt, pB + r * 64);
+        }
+
+        STORE(0); STORE(1); STORE(2); STORE(3); STORE(4); STORE(5); STORE(6); STORE(7);
+
+        #undef ZERO
+        #undef DP
+        #undef DP_ROW
+        #undef STORE
+    }
+
+    // up to 32 rows of C in unit of 8 rows (16 accumulators), each row of A is given by
+    // pA + i*strideA for plain A, tile(i/16) + (i%16)*64 for blocked A
+    template<typename FA>
+    void kernel_32x32(int valid_m, FA getA, int kbStride, int KB,
+                      const int8_t * pAt, const int8_t * pB, const int32_t * comp) {
+        for(int i = 0; i < valid_m; i += 8) {
+            int strideA;
+            auto * pA = getA(i, strideA);
+            auto * pAti = pAt ? pAt + i * Atails.stride : nullptr;
+            auto * pcomp = comp ? comp + i : nullptr;
+            auto * pC = &buffC(i, 0);
+            switch(std::min(valid_m - i, 8)) {
+                case 8: kernel<8>(pA, strideA, kbStride, KB, pAti, Atails.stride, pB, pcomp, pC); break;
+                case 7: kernel<7>(pA, strideA, kbStride, KB, pAti, Atails.stride, pB, pcomp, pC); break;
+                case 6: kernel<6>(pA, strideA, kbStride, KB, pAti, Atails.stride, pB, pcomp, pC); break;
+                case 5: kernel<5>(pA, strideA, kbStride, KB, pAti, Atails.stride, pB, pcomp, pC); break;
+                case 4: kernel<4>(pA, strideA, kbStride, KB, pAti, Atails.stride, pB, pcomp, pC); break;
+                case 3: kernel<3>(pA, strideA, kbStride, KB, pAti, Atails.stride, pB, pcomp, pC); break;
+                case 2: kernel<2>(pA, strideA, kbStride, KB, pAti, Atails.stride, pB, pcomp, pC); break;
+                case 1: kernel<1>(pA, strideA, kbStride, KB, pAti, Atails.stride, pB, pcomp, pC); break;
+            }
+        }
+    }
+
+    // row sums of A for compensation of flipped B
+    template<typename MA>
+    void prepare_comp(const MA & matA) {
+        if (!flipB)
+            return;
+        int M = matA.dims[0];
+        int K = matA.dims[1];
+        Acomp.resize(M);
+        for(int m = 0; m < M; m++) {
+            int32_t sum = 0;
+            for(int k = 0; k < K; k++)
+                sum += matA(m, k);
+            Acomp[m] = is_s8s8 ? -128 * sum : 128 * sum;
+        }
+    }
+
+    // repack B[:, n0:n1] into internalB
+    tensor_view<TB> packB(tensor_view<TB> _matB, int n0, int n1, int K) {
+        auto matB = amx_kernel::getSubMatB(_matB, n0, n1, transposeB);
+        assert(K == matB.dims[transposeB ? 1 : 0]);
+
+        // for non-constB, internalB is updated every time
+        // for constB, internalB is updated once
+        if (!constB || (internalB.capacity == 0)) {
+            internalB = amx_kernel::repackB_1x2(matB, transposeB);
+        }
+        return internalB;
+    }
+
+    template<typename PP>
+    void operator()(tensor_view<TA> matA,
+                    tensor_view<TB> _matB,
+                    int n0, int n1,
+                    PP ppkernel) {
+        auto packedB = packB(_matB, n0, n1, matA.dims[1]);
+        compute(matA, packedB, n1 - n0, n0, ppkernel);
+    }
+
+    // B is shared & repacked lazily per N-panel, n0 must be multiple of 32
+    template<typename PP>
+    void operator()(tensor_view<TA> matA,
+                    LazyRepackedB<TB> & B,
+                    int n0, int n1,
+                    PP ppkernel) {
+        assert(matA.dims[1] == B.K);
+        compute(matA, B.get(n0, n1), n1 - n0, n0, ppkernel);
+    }
+
+    // A in tile-blocked layout (for example C of previous Matmul stored by blocked BiasGeluStore)
+    template<typename PP>
+    void operator()(tensor_blocked<TA> matA,
+                    tensor_view<TB> _matB,
+                    int n0, int n1,
+                    PP ppkernel) {
+        auto packedB = packB(_matB, n0, n1, matA.dims[1]);
+        compute(matA, packedB, n1 - n0, n0, ppkernel);
+    }
+
+    template<typename PP>
+    void operator()(tensor_blocked<TA> matA,
+                    LazyRepackedB<TB> & B,
+                    int n0, int n1,
+                    PP ppkernel) {
+        assert(matA.dims[1] == B.K);
+        compute(matA, B.get(n0, n1), n1 - n0, n0, ppkernel);
+    }
+
+    // same cache blocking scheme as amx_kernel::Matmul
+    static int get_mc(int K) {
+        int L2 = get_L2_size();
+        int slice_size = 32*rndup(K, 32)*sizeof(TA);
+        return std::max(1, L2/slice_size - 1);
+    }
+
+    // blocked A : tails are already right-aligned & zero-padded by the layout
+    template<typename PP>
+    void compute(tensor_blocked<TA> matA,
+                 tensor_view<TB> packedB,
+                 int N, int n0,
+                 PP ppkernel) {
+        static_assert(tensor_blocked<TA>::bK == kStep, "blocked A must have same k-step as packed B");
+        int M = matA.dims[0];
+        int K = matA.dims[1];
+        int KB = matA.blocks[1];
+        prepare_comp(matA);
+        amx_kernel::loop2D<32, 32>(M, N, get_mc(K), [&](int m, int n, int valid_m, int valid_n) {
+            auto getA = [&](int i, int & strideA) {
+                strideA = 64;
+                return reinterpret_cast<const int8_t*>(matA.tile((m + i) / 16, 0)) + ((m + i) % 16) * 64;
+            };
+            kernel_32x32(valid_m, getA, 1024, KB, nullptr,
+                         reinterpret_cast<const int8_t*>(&packedB(n>>5, 0)),
+                         flipB ? &Acomp[m] : nullptr);
+            (ppkernel)(buffC, m, n + n0, valid_m, valid_n);
+        });
+    }
+
+    // packedB is in layout of repackB_1x2 (starting from column n0)
+    template<typename PP>
+    void compute(tensor_view<TA> matA,
+                 tensor_view<TB> packedB,
+                 int N, int n0,
+                 PP ppkernel) {
+        int M = matA.dims[0];
+        int K = matA.dims[1];
+        int Ktails = K % kStep;
+        int Kbody = K - Ktails;
+        if (Ktails) {
+            Atails.resize(M, kStep);
+            for(int m = 0; m < M; m++) {
+                memset(&Atails(m, 0), 0, (kStep - Ktails) * sizeof(TA));
+                memcpy(&Atails(m, kStep - Ktails), &matA(m, Kbody), Ktails * sizeof(TA));
+            }
+        }
+        prepare_comp(matA);
+        amx_kernel::loop2D<32, 32>(M, N, get_mc(K), [&](int m, int n, int valid_m, int valid_n) {
+            auto getA = [&](int i, int & strideA) {
+                strideA = matA.stride;
+                return reinterpret_cast<const int8_t*>(&matA(m + i, 0));
+            };
+            kernel_32x32(valid_m, getA, 64, Kbody / kStep,
+                         Ktails ? reinterpret_cast<const int8_t*>(&Atails(m, 0)) : nullptr,
+                         reinterpret_cast<const int8_t*>(&packedB(n>>5, 0)),
+                         flipB ? &Acomp[m] : nullptr);
+            (ppkernel)(buffC, m, n + n0, valid_m, valid_n);
+        });
+    }
+};
+
+}
@@ -1,6 +1,13 @@
 #include "kernels_avx2.hpp"
+#include "attn_mask.hpp"
 #include <vector>
 #include <deque>
+#include <atomic>
+
+#if defined(__AMX_BF16__) && defined(__AVX512BF16__)
+#include "kernels_mha_amx.hpp"
+#define MHA_WITH_AMX 1
+#endif
 
 #ifndef PARALLEL_NT_STATIC
 template <typename F>
@@ -62,329 +69,725 @@ inline void splitter1d(const T& n, const Q& team, const Q& tid, T& n_start, T& n
     n_end += n_start;
 }
 
+// split n work items into contiguous ranges of (nearly) equal total cost, cost(i) is the cost of item i
+// e.g. with causal mask, cost of a query row is the number of keys it attends
+template <typename T, typename Q, typename F>
+inline void splitter1d_weighted(const T& n, const Q& team, const Q& tid, const F& cost, T& n_start, T& n_end) {
+    if (team <= 1 || n == 0) {
+        n_start = 0;
+        n_end = n;
+        return;
+    }
+    uint64_t total = 0;
+    for (T i = 0; i < n; i++) total += cost(i);
+    // first item whose prefix cost reaches tid/team and (tid+1)/team of total
+    uint64_t w0 = total * tid / team;
+    uint64_t w1 = total * (tid + 1) / team;
+    uint64_t acc = 0;
+    T i = 0;
+    for (; i < n && acc < w0; i++) acc += cost(i);
+    n_start = i;
+    for (; i < n && acc < w1; i++) acc += cost(i);
+    n_end = ((T)tid == (T)team - 1) ? n : i;
+}
+
 struct MHA2Kernels {
     std::vector<std::shared_ptr<avx2::Matmul>> ops_qk;
     std::vector<std::shared_ptr<avx2::Matmul>> ops_wv;
     std::deque<tensorND<float>> all_qk;
+    std::deque<tensorND<float>> all_kv;    // dequantized K/V block of int8 KV-cache
     tensorND<float> sub_states;
     tensorND<float> qk_max;
     tensorND<float> qk_sum;
     avx2::PP::None pp_none;
+    // number of finished sub-states per (b, kv-head), the worker finishing the last one combines them
+    std::unique_ptr<std::atomic<int>[]> sub_states_done;
+    size_t sub_states_done_size = 0;
+
+#ifdef MHA_WITH_AMX
+    std::vector<std::shared_ptr<amx_kernel::FlashAttention>> ops_fa;
+#endif
+    bool use_amx = false;   // bf16 flash-attention on AMX
+    float qk_scale = 1.0f;  // applied on q*k' before softmax
+
+    // sliding-window (local) attention : query of position p attends keys (p - window, p], 0 means unlimited
+    int window = 0;
+    // ALiBi : slope of each query head (H floats), slope * (n - p) is added to scaled q*k', nullptr means no ALiBi
+    const float * alibi_slopes = nullptr;
+
+    // mask of rows of query heads [h0, ...), first row is of position pos0,
+    // pos_step is 0 when rows are the stacked single query of heads h0, h0+1, ...
+    AttnMask attn_mask(int pos0, bool causal, int h0, int pos_step = 1) const {
+        AttnMask mask;
+        mask.pos0 = pos0;
+        mask.pos_step = pos_step;
+        mask.causal = causal;
+        mask.window = window;
+        if (alibi_slopes) {
+            mask.alibi = alibi_slopes + h0;
+            mask.alibi_stride = pos_step ? 0 : 1;
+        }
+        return mask;
+    }
+
+    // first key attended by any of the last M queries of a sequence of N tokens
+    int first_key(int N, int M) const {
+        return window > 0 ? std::max(0, N - M - window + 1) : 0;
+    }
+
+    // flash-decoding (split N into blocks encoded in parallel) is used for at most
+    // max_split_M queries, larger M has enough parallelism in M dimension
+    enum { max_split_M = 32 };
+    int NT = 0;
 
-    int bN;                 // blocking on N dimension
-    MHA2Kernels() {
-        bN = std::getenv("bN") ? atoi(std::getenv("bN")) : 256;
-        int NT = 0;
+    // kernels of fp32 q/k/v, amx_bf16 is opt-in since it computes attention in bf16
+    // (falls back to avx2 when AMX is unavailable), bf16 q/k/v always needs amx_bf16
+    enum class Backend {
+        avx2,
+        amx_bf16,
+    };
+
+    explicit MHA2Kernels(Backend backend = Backend::avx2) {
         PARALLEL_NT_STATIC([&](int i, int n){
             NT = n;
         });
-        std::cout << "MHA2: NT=" << NT << " bN=" << bN << std::endl;
+#ifdef MHA_WITH_AMX
+        use_amx = backend == Backend::amx_bf16 && initXTILE();
+#endif
+        std::cout << "MHA2: NT=" << NT << " use_amx=" << use_amx << std::endl;
         for(int i = 0; i < NT; i++) {
             ops_qk.push_back(std::make_shared<avx2::Matmul>(false, true));
             ops_wv.push_back(std::make_shared<avx2::Matmul>(false, false));
             all_qk.emplace_back();
+            all_kv.emplace_back();
+#ifdef MHA_WITH_AMX
+            if (use_amx)
+                ops_fa.push_back(std::make_shared<amx_kernel::FlashAttention>());
+#endif
         }
     }
 
-    void operator()(tensorND<float>& q0,
-                    tensorND<float>& k0,
-                    tensorND<float>& v0,
-                    tensorND<float>& wv0,
+    // block size of keys for flash-decoding, a multiple of align
+    //  - (items x N/bN) work items keep all threads busy, 2 items per thread for balance
+    //  - K/V of a block fit in half of L2, so all query heads of a group reuse them in cache
+    //  - not too small, or the encoding & combining overhead dominates
+    int auto_bN(int N, int K, size_t items, int elem_size, int align) const {
+        int L2 = get_L2_size();
+        int bN_cache = std::max(align, (L2 / 2) / (2 * K * elem_size) / align * align);
+        int splits = static_cast<int>((2 * NT + items - 1) / items);
+        int bN_par = rndup((N + splits - 1) / splits, align);
+        int bN_min = rndup(128, align);
+        return std::max(bN_min, std::min(bN_cache, bN_par));
+    }
+
+    template<typename T>
+    static tensorND_view<T> kv_slice(tensorND_view<T> t, bool kv_head_transposed, int b, int h, int n0, int n1) {
+        //  t[b, h, n0:n1, K] or t[b, n0:n1, h, K] => (n1-n0) x K
+        return kv_head_transposed ? t.Slice(b, h, slice(n0, n1), fullslice()) : t.Slice(b, slice(n0, n1), h, fullslice());
+    }
+
+    // flash-decoding : keys of each (b, kv-head) are split into blocks, each (b, kv-head, block) is encoded
+    // into sub-states of all query heads in the group in parallel, the worker finishing the last block of a
+    // (b, kv-head) combines sub-states of the group into wv0 (so no extra barrier is needed)
+    //   num_blocks(b)              : number of blocks of batch b
+    //   encode(ithr, b, hkv, nb)   : encode block nb of kv-head hkv into sub_states/qk_max/qk_sum
+    template<typename T, typename NBLK, typename ENCODE>
+    void flash_decoding(tensorND_view<T> wv0, int Hkv, int max_blocks, const NBLK & num_blocks, const ENCODE & encode) {
+        int B = wv0.shape[0];
+        int M = wv0.shape[1];
+        int H = wv0.shape[2];
+        int K = wv0.shape[3];
+        assert(H % Hkv == 0);
+        int group = H / Hkv;
+
+        // s[B, M, H, nb, K]
+        sub_states.resize({B, M, H, max_blocks, K}, false);
+        qk_max.resize({B, max_blocks, H, M}, true);
+        qk_sum.resize({B, max_blocks, H, M}, true);
+        auto * done = reset_sub_states_done(B * Hkv);
+
+        const size_t work_amount = (size_t)(B * Hkv) * max_blocks;
+        PARALLEL_NT_STATIC([&](int ithr, int nthr) {
+            size_t start{0}, end{0};
+            splitter1d(work_amount, nthr, ithr, start, end);
+            for (auto cur = start; cur < end; cur++) {
+                size_t hkv;
+                size_t nb;
+                auto b = offset2coord(cur, Hkv, hkv, max_blocks, nb);
+                int nblocks = num_blocks(b);
+                if (static_cast<int>(nb) >= nblocks) continue;
+                encode(ithr, b, hkv, nb);
+                if (done[b * Hkv + hkv].fetch_add(1, std::memory_order_acq_rel) + 1 == nblocks)
+                    combine_group(wv0, b, hkv * group, group, nblocks);
+            }
+        });
+    }
+
+    // encode keys/values k/v (n x K) of kv-head hkv into sub-state nb of its query heads with avx2,
+    // when M is 1 the single query of all heads in the group are stacked as rows & encoded together
+    // row m of q is query of position (m + causal_m0) relative to the first key of k
+    void encode_avx2(int ithr, tensorND_view<float> q0, tensorND_view<float> k, tensorND_view<float> v,
+                     int b, int hkv, int nb, int group, int causal_m0, bool causal) {
+        int M = q0.shape[1];
+        int h0 = hkv * group;
+        if (M == 1) {
+            //  q[b, 0, h0:h0+group, K]     => group x K
+            //  s[b, 0, h0:h0+group, nb, K] => group x K
+            auto q = q0.Slice(b, 0, slice(h0, h0 + group), fullslice());
+            auto s = sub_states.Slice(b, 0, slice(h0, h0 + group), nb, fullslice());
+            one_head_attention(ithr, q, k, v, s, attn_mask(causal_m0, false, h0, 0), &qk_max(b, nb, h0, 0), &qk_sum(b, nb, h0, 0));
+            return;
+        }
+        for (int h = h0; h < h0 + group; h++) {
+            //  q[b, 0:M, h, K]     => M x K
+            //  s[b, 0:M, h, nb, K] => M x K
+            auto q = q0.Slice(b, fullslice(), h, fullslice());
+            auto s = sub_states.Slice(b, fullslice(), h, nb, fullslice());
+            one_head_attention(ithr, q, k, v, s, attn_mask(causal_m0, causal, h), &qk_max(b, nb, h, 0), &qk_sum(b, nb, h, 0));
+        }
+    }
+
+#ifdef MHA_WITH_AMX
+    // bf16 q/k/v/wv are only supported by AMX flash-attention
+    void operator()(tensorND_view<ov::bfloat16> q0,
+                    tensorND_view<ov::bfloat16> k0,
+                    tensorND_view<ov::bfloat16> v0,
+                    tensorND_view<ov::bfloat16> wv0,
                     bool kv_head_transposed,
-                    bool with_causal_mask) {
+                    bool with_causal_mask,
+                    float scale = 1.0f) {
+        assert(use_amx);
+        flash_attention(q0, k0, v0, wv0, kv_head_transposed, with_causal_mask, scale);
+    }
+
+    template<typename T>
+    static tensor_view<T> view2D(tensorND_view<T> t) {
+        return tensor_view<T>(t.shape[0], t.shape[1], t.data, t.strides[0]);
+    }
+
+    // parallel in B/H_kv/M dimensions, M in unit of 32 rows, K/V of a kv-head is repacked once by
+    // each thread working on it & shared by all query heads of its group (GQA/MQA)
+    //   kv_len(b)          : number of keys of batch b
+    //   causal_m0(b)       : position of first query of batch b
+    //   set_kv(fa, b, hkv) : load K/V of kv-head hkv of batch b into fa
+    template<typename T, typename KVLEN, typename POS0, typename SETKV>
+    void flash_attention_impl(tensorND_view<T> q0,
+                              tensorND_view<T> wv0,
+                              int Hkv,
+                              bool with_causal_mask,
+                              float scale,
+                              const KVLEN & kv_len,
+                              const POS0 & causal_m0,
+                              const SETKV & set_kv) {
+        constexpr int bM = amx_kernel::FlashAttention::bM;
         auto B = q0.shape[0];
         auto M = q0.shape[1];
         auto H = q0.shape[2];
-        auto K = q0.shape[3];
-        auto N = k0.shape[kv_head_transposed ? 2:1];
-        if (kv_head_transposed) {
-            //q0  {B, M, H, K}
-            //k0  {B, H, N, K}
-            //v0  {B, H, N, K}
-            //wv0 {B, M, H, K}
-            static int sss = 0;
-            // if (N > bN) sss ++;
-            if (with_causal_mask || (N < bN) || M > 1 || (sss & 3)==2) {
-                const size_t work_amount = (size_t) B * H * M;
-                PARALLEL_NT_STATIC([&](int ithr, int nthr) {
-                    size_t start{0}, end{0};
-                    splitter1d(work_amount, nthr, ithr, start, end);
-                    size_t bh0, mb0;
-                    size_t bh1, mb1;
-                    if (start == end) return;
-                    bh0 = offset2coord(start, M, mb0);
-                    bh1 = offset2coord(end, M, mb1);
-                    auto m_start = mb0;
-                    auto m_end = std::min(size_t(M), mb1);
-
-                    // first head
-                    auto m0 = m_start;
-                    auto m1 = m0;
-                    // bh = b*H + h
-                    for(auto bh = bh0; bh <= bh1; bh++) {
-                        // determine m1 for current head
-                        m1 = (bh == bh1) ? m_end : M;
-                        if (m1 <= m0) break;
-
-                        //  q[b, m0:m1, h, K] => (m1-m0)xK
-                        //  k[b, h, 0:N, K] => NxK
-                        //  v[b, h, 0:N, K] => NxK
-                        // wv[b, m0:m1, h, K] => (m1-m0)xK
-                        auto b = bh/H;
-                        auto h = bh - b*H;
-                        tensorND<float> q = q0.Slice(b, slice(m0, m1), h, fullslice());
-                        tensorND<float> k = k0.Slice(b, h, fullslice(), fullslice());
-                        tensorND<float> v = v0.Slice(b, h, fullslice(), fullslice());
-                        tensorND<float> wv = wv0.Slice(b, slice(m0, m1), h, fullslice());
-                        one_head_attention(ithr, q, k, v, wv, m0, with_causal_mask);
-
-                        // m0 for next head is always 0
-                        m0 = 0;
-                    }
-                });                
-            } else {
-                // no with_kv_cache, no with_causal_mask
-                //
-                // kernel register blocking on 6x16, so N is split in unit of 256 columns
-                // that means each token will be encoded by 256 key/values and finally combined
-                // if N is smaller than 256, we don't split them
-                int num_sub_states = (N + bN - 1) / bN;
-                const size_t work_amount = (size_t)(B * H) * num_sub_states;
-
-                // s[B, M, H, nb, K]
-                sub_states.resize({B, M, H,num_sub_states, K}, false);
-                qk_max.resize({B, H, num_sub_states, M}, false);
-                qk_sum.resize({B, H, num_sub_states, M}, false);
-
-                //log(" B,M,N,H,nb,K=", B,M,N,H,num_sub_states,K);
-                //auto _prof1 = Profile("substate");
-                PARALLEL_NT_STATIC([&](int ithr, int nthr) {
-                    // each work item is doing  M x bN sub-states encoding
-                    // and finally, main thread will combine sub-states into one
-                    size_t start{0}, end{0};
-                    splitter1d(work_amount, nthr, ithr, start, end);
-                    if (start == end) return;
-                    //std::stringstream ss; ss << ithr << "/" << nthr << std::endl;   std::cout << ss.str();
-                    // encoding sub-states one by one
-                    for (auto cur = start; cur < end; cur++) {
-                        size_t h;
-                        size_t nb;
-                        auto b = offset2coord(cur, H, h, num_sub_states, nb);
-                        auto n0 = nb * bN;
-                        auto n1 = std::min(size_t(N), n0 + bN);
-
-                        //  q[b, 0:M, h, K]   => M x K
-                        //  k[b, h, n0:n1, K] => bN x K
-                        //  v[b, h, n0:n1, K] => bN x K
-                        //  s[b, 0:M, h, nb, K] => M x K
-                        // wv[b, 0:M, h, K] => M x K
-                        tensorND<float> q = q0.Slice(b, fullslice(), h, fullslice());
-                        tensorND<float> k = k0.Slice(b, h, slice(n0, n1), fullslice());
-                        tensorND<float> v = v0.Slice(b, h, slice(n0, n1), fullslice());
-                        tensorND<float> s = sub_states.Slice(b, fullslice(), h, nb, fullslice());
-
-                        one_head_attention(ithr, q, k, v, s, 0, with_causal_mask,
-                                        &qk_max(b, h, nb, 0),
-                                        &qk_sum(b, h, nb, 0));
-                    }
-                });
-
-                // combine sub-states
-                //auto _prof2 = Profile("combine");
-                for(int b = 0; b<B; b++) {
-                    for(int h = 0; h<H; h++) {
-                        //  s[b, 0:M, h, nb, K] => M x nb x K
-                        // wv[b, 0:M, h, K] => M x K
-                        // qk_max [b,h,nb,M]
-                        tensorND<float> wv = wv0.Slice(b, fullslice(), h, fullslice());
-
-
-                        // qk_max: [b, h, 0:num_sub_states, 0:M]
-                        // qk_sum: [b, h, 0:num_sub_states, 0:M]
-                        auto p_qk_max = qk_max.Slice(b, h, fullslice(), fullslice());  // num_sub_states x M
-                        auto p_qk_sum = qk_sum.Slice(b, h, fullslice(), fullslice());  // num_sub_states x M
-                        
-                        //log("b,h,p_qk_max=",b,h,p_qk_max);
-                        //log("b,h,p_qk_sum=",b,h,p_qk_sum);
-                        for (int m = 0; m < M; m++) {
-                            float * p_wv = &wv(m, 0);
-                            // get weights of sub-states :
-                            //    tmax = max_i(qk_max_i)
-                            //    
-                            //    tsum_i = sum_i * exp(qk_max_i - tmax)
-                            //    weight_i = tsum_i/sum_i(tsum_i)
-                            //float tmax = std::numeric_limits<float>::lowest();
-                            auto tmax = _mm256_set1_ps(std::numeric_limits<float>::lowest());
-                            for (int nb = 0; nb < num_sub_states; nb++) {
-                                auto sub_max = _mm256_broadcast_ss(&p_qk_max(nb,m));
-                                tmax = _mm256_max_ps(tmax, sub_max);
-                            }
-                            //log("b,h,m,max=",b,h,m, tmax);
-
-                            auto tsum = _mm256_setzero_ps();
-                            for (int nb = 0; nb < num_sub_states; nb++) {
-                                auto sub_max = _mm256_broadcast_ss(&p_qk_max(nb,m));
-                                sub_max = _mm256_sub_ps(sub_max, tmax);
-                                auto sub_sum = _mm256_broadcast_ss(&p_qk_sum(nb,m));
-                                avx2::functional::exp_ps(sub_max);
-                                sub_sum = _mm256_mul_ps(sub_sum, sub_max);
-                                p_qk_sum(nb,m) = _mm256_cvtss_f32(sub_sum);
-                                tsum = _mm256_add_ps(tsum, sub_sum);
-                                //p_qk_sum[nb*M + m] *= std::exp(p_qk_max[nb*M + m] - tmax);
-                                //tsum += p_qk_sum[nb*M + m];
-                            }
-                            //log("       tsum=",tsum);
-
-                            static __m256 one = _mm256_castsi256_ps(_mm256_set1_epi32(0x3f800000)); // 1.0f
-                            auto tweight_recip = _mm256_div_ps(one, tsum);                          // 1/sum_exp
-
-                            // linear combine sub-states, 
-                            __m256i wv_mask = _mm256_setzero_si256();
-                            for (int nb = 0; nb < num_sub_states; nb++) {
-                                //
-                                float* p_sub = &sub_states(b, 0, h, nb, 0);
-
-                                auto x_weight = _mm256_broadcast_ss(&p_qk_sum(nb, m));
-                                x_weight = _mm256_mul_ps(x_weight, tweight_recip);
-                                //auto x_weight = _mm256_set1_ps(p_qk_sum[nb*M + m] * tweight_recip);
-                                // wv = substates * weight    for nb=0
-                                // wv += substates * weight   otherwise
-                                if (nb == 1) wv_mask = avx2::functional::get_mask(8);
-                                int k;
-                                for(k = 0; (k+8) <= K; k += 8) {
-                                    auto x_sub = _mm256_loadu_ps(p_sub + k);
-                                    auto x_new = _mm256_maskload_ps(p_wv + k, wv_mask);
-                                    x_new = _mm256_fmadd_ps(x_sub, x_weight, x_new);
-                                    _mm256_storeu_ps(p_wv + k, x_new);
-                                }
-                                if (k < K) {
-                                    auto mask = avx2::functional::get_mask(K&7);
-                                    auto x_sub = _mm256_maskload_ps(p_sub + k, mask);
-                                    auto x_new = _mm256_maskload_ps(p_wv + k, wv_mask);
-                                    x_new = _mm256_fmadd_ps(x_sub, x_weight, x_new);
-                                    _mm256_maskstore_ps(p_wv + k, mask, x_new);
-                                }
-                            }
-                        }
-                    }
+        assert(H % Hkv == 0);
+        int group = H / Hkv;
+        size_t mblocks = (M + bM - 1) / bM;
+        const size_t work_amount = (size_t) B * Hkv * mblocks;
+        bool causal = with_causal_mask && M > 1;
+        PARALLEL_NT_STATIC([&](int ithr, int nthr) {
+            size_t start{0}, end{0};
+            // with causal mask, m-block mb only goes through keys [0, causal_m0 + (mb+1)*bM),
+            // and with sliding-window, from key (causal_m0 + mb*bM - window + 1)
+            splitter1d_weighted(work_amount, nthr, ithr, [&](size_t cur) {
+                size_t mb;
+                auto b = offset2coord(cur, mblocks, mb) / Hkv;
+                int N = kv_len(b);
+                int pos0 = causal_m0(b) + mb * bM;
+                int n_end = causal ? std::min(N, pos0 + bM) : N;
+                int n_begin = window > 0 ? std::max(0, pos0 - window + 1) : 0;
+                return static_cast<size_t>(std::max(1, n_end - n_begin));
+            }, start, end);
+            auto & fa = *ops_fa[ithr];
+            size_t cur_bh = std::numeric_limits<size_t>::max();
+            for (auto cur = start; cur < end; cur++) {
+                size_t mb;
+                auto bh = offset2coord(cur, mblocks, mb);
+                auto b = bh / Hkv;
+                auto hkv = bh - b*Hkv;
+                if (bh != cur_bh) {
+                    set_kv(fa, b, hkv);
+                    cur_bh = bh;
                 }
-            }
-        } else {
-            // with_causal_mask:0   with_kv_cache:0   kv_head_transposed:0
-            // parallel in B/H/M dimensions
-            const size_t work_amount = (size_t) B * H * M;
-            //q0  {B, M, H, K}
-            //k0  {B, N, H, K}
-            //v0  {B, N, H, K}
-            //wv0 {B, M, H, K}
-            PARALLEL_NT_STATIC([&](int ithr, int nthr) {
-                size_t start{0}, end{0};
-                splitter1d(work_amount, nthr, ithr, start, end);
-                size_t bh0, mb0;
-                size_t bh1, mb1;
-                if (start == end) return;
-                bh0 = offset2coord(start, M, mb0);
-                bh1 = offset2coord(end, M, mb1);
-                auto m_start = mb0;
-                auto m_end = std::min(size_t(M), mb1);
-
-                // first head
-                auto m0 = m_start;
-                auto m1 = m0;
-                // bh = b*H + h
-                for(auto bh = bh0; bh <= bh1; bh++) {
-                    // determine m1 for current head
-                    m1 = (bh == bh1) ? m_end : M;
-                    if (m1 <= m0) break;
-
+                if (M == 1) {
+                    // the single query of all heads in the group are stacked as rows of one block
+                    //  q[b, 0, h0:h0+group, K] => group x K
+                    auto q = q0.Slice(b, 0, slice(hkv * group, (hkv + 1) * group), fullslice());
+                    auto wv = wv0.Slice(b, 0, slice(hkv * group, (hkv + 1) * group), fullslice());
+                    fa(view2D(q), view2D(wv), attn_mask(causal_m0(b), false, hkv * group, 0), scale);
+                    continue;
+                }
+                int m0 = mb * bM;
+                int m1 = std::min(M, m0 + bM);
+                for (int h = hkv * group; h < (hkv + 1) * group; h++) {
                     //  q[b, m0:m1, h, K] => (m1-m0)xK
-                    //  k[b, 0:N,   h, K] => NxK
-                    //  v[b, 0:N,   h, K] => NxK
                     // wv[b, m0:m1, h, K] => (m1-m0)xK
-                    auto b = bh/H;
-                    auto h = bh - b*H;
-                    tensorND<float> q = q0.Slice(b, slice(m0, m1), h, fullslice());
-                    tensorND<float> k = k0.Slice(b, fullslice(), h, fullslice());
-                    tensorND<float> v = v0.Slice(b, fullslice(), h, fullslice());
-                    tensorND<float> wv = wv0.Slice(b, slice(m0, m1), h, fullslice());
-                    one_head_attention(ithr, q, k, v, wv, m0, with_causal_mask);
-
-                    // m0 for next head is always 0
-                    m0 = 0;
+                    auto q = q0.Slice(b, slice(m0, m1), h, fullslice());
+                    auto wv = wv0.Slice(b, slice(m0, m1), h, fullslice());
+                    fa(view2D(q), view2D(wv), attn_mask(causal_m0(b) + m0, causal, h), scale);
                 }
+            }
+        });
+    }
+
+    // AMX version of encode_avx2(), K/V are in fa already
+    template<typename T>
+    void encode_amx(amx_kernel::FlashAttention & fa, tensorND_view<T> q0,
+                    int b, int hkv, int nb, int group, int causal_m0, bool causal, float scale) {
+        int M = q0.shape[1];
+        int h0 = hkv * group;
+        if (M == 1) {
+            auto q = q0.Slice(b, 0, slice(h0, h0 + group), fullslice());
+            auto s = sub_states.Slice(b, 0, slice(h0, h0 + group), nb, fullslice());
+            fa(view2D(q), view2D(s), attn_mask(causal_m0, false, h0, 0), scale, &qk_max(b, nb, h0, 0), &qk_sum(b, nb, h0, 0));
+            return;
+        }
+        for (int h = h0; h < h0 + group; h++) {
+            auto q = q0.Slice(b, fullslice(), h, fullslice());
+            auto s = sub_states.Slice(b, fullslice(), h, nb, fullslice());
+            fa(view2D(q), view2D(s), attn_mask(causal_m0, causal, h), scale, &qk_max(b, nb, h, 0), &qk_sum(b, nb, h, 0));
+        }
+    }
+
+    // queries are the last M tokens, i.e. of positions [N-M, N)
+    template<typename T>
+    void flash_attention(tensorND_view<T> q0,
+                         tensorND_view<T> k0,
+                         tensorND_view<T> v0,
+                         tensorND_view<T> wv0,
+                         bool kv_head_transposed,
+                         bool with_causal_mask,
+                         float scale) {
+        int B = q0.shape[0];
+        int M = q0.shape[1];
+        int K = q0.shape[3];
+        int N = k0.shape[kv_head_transposed ? 2:1];
+        int Hkv = k0.shape[kv_head_transposed ? 1:2];
+        bool causal = with_causal_mask && M > 1;
+        int bN = auto_bN(N, K, B * Hkv, sizeof(ov::bfloat16), 32);
+        if (M <= max_split_M && N > bN) {
+            // blocks before the sliding-window are skipped
+            int nb0 = first_key(N, M) / bN;
+            int nblocks = (N + bN - 1) / bN - nb0;
+            flash_decoding(wv0, Hkv, nblocks,
+                [&](size_t b) { return nblocks; },
+                [&](int ithr, int b, int hkv, int nb) {
+                    auto & fa = *ops_fa[ithr];
+                    int n0 = (nb0 + nb) * bN;
+                    int n1 = std::min(N, n0 + bN);
+                    fa.set_kv(view2D(kv_slice(k0, kv_head_transposed, b, hkv, n0, n1)),
+                              view2D(kv_slice(v0, kv_head_transposed, b, hkv, n0, n1)));
+                    encode_amx(fa, q0, b, hkv, nb, q0.shape[2] / Hkv, N - M - n0, causal, scale);
+                });
+            return;
+        }
+        // keys before the sliding-window of the first query are not even repacked
+        int n0 = first_key(N, M);
+        flash_attention_impl(q0, wv0, Hkv, with_causal_mask, scale,
+            [&](size_t b) { return N - n0; },
+            [&](size_t b) { return N - M - n0; },
+            [&](amx_kernel::FlashAttention & fa, size_t b, size_t h) {
+                fa.set_kv(view2D(kv_slice(k0, kv_head_transposed, b, h, n0, N)),
+                          view2D(kv_slice(v0, kv_head_transposed, b, h, n0, N)));
             });
+    }
+
+    // paged KV-cache: K/V of a head is repacked by each thread directly from blocks of the
+    // sequence, queries are the last M tokens of each sequence
+    template<typename T, typename TC>
+    void paged_flash_attention(tensorND_view<T> q0,
+                               const PagedKVCache<TC> & cache,
+                               const std::vector<int> & seqs,
+                               tensorND_view<T> wv0,
+                               bool with_causal_mask,
+                               float scale) {
+        int B = q0.shape[0];
+        int M = q0.shape[1];
+        int K = q0.shape[3];
+        int group = q0.shape[2] / cache.H;
+        bool causal = with_causal_mask && M > 1;
+        int max_len = 0;
+        for (auto seq : seqs)
+            max_len = std::max(max_len, cache.length(seq));
+        // flash-decoding in unit of cache blocks
+        int nblk = auto_bN(max_len, K, B * cache.H, sizeof(ov::bfloat16), cache.block_size) / cache.block_size;
+        if (M <= max_split_M && max_len > nblk * cache.block_size) {
+            // chunks of nblk blocks, chunks before the sliding-window are skipped
+            auto first_split = [&](size_t b) {
+                return first_key(cache.length(seqs[b]), M) / (nblk * cache.block_size);
+            };
+            auto num_splits = [&](size_t b) {
+                return (cache.num_blocks(seqs[b]) + nblk - 1) / nblk - first_split(b);
+            };
+            int max_splits = 0;
+            for (size_t b = 0; b < seqs.size(); b++)
+                max_splits = std::max(max_splits, num_splits(b));
+            flash_decoding(wv0, cache.H, max_splits, num_splits,
+                [&](int ithr, int b, int hkv, int nb) {
+                    auto & fa = *ops_fa[ithr];
+                    int blk0 = (first_split(b) + nb) * nblk;
+                    int blk1 = std::min(cache.num_blocks(seqs[b]), blk0 + nblk);
+                    fa.set_kv(cache, seqs[b], hkv, blk0, blk1, M == 1);
+                    int causal_m0 = cache.length(seqs[b]) - M - blk0 * cache.block_size;
+                    encode_amx(fa, q0, b, hkv, nb, group, causal_m0, causal, scale);
+                });
+            return;
         }
+        // blocks before the sliding-window of the first query are not even repacked
+        auto first_block = [&](size_t b) { return first_key(cache.length(seqs[b]), M) / cache.block_size; };
+        flash_attention_impl(q0, wv0, cache.H, with_causal_mask, scale,
+            [&](size_t b) { return cache.length(seqs[b]) - first_block(b) * cache.block_size; },
+            [&](size_t b) { return cache.length(seqs[b]) - M - first_block(b) * cache.block_size; },
+            [&](amx_kernel::FlashAttention & fa, size_t b, size_t h) {
+                fa.set_kv(cache, seqs[b], h, first_block(b), -1, M == 1);
+            });
     }
 
-    /*
-        q: M x K
-        k: N x K (need transpose)
-        v: N x K
-    */
-    void one_head_attention(int tid,
-                            tensorND<float>& q,
-                            tensorND<float>& k,
-                            tensorND<float>& v,
-                            tensorND<float>& wv,
-                            int causal_m0,
-                            bool causal_mask,
-                            float * qk_max,
-                            float * qk_sum) {
-        auto M = q.shape[0];
-        auto N = k.shape[0];
-        auto K = v.shape[1];
+    void operator()(tensorND_view<ov::bfloat16> q0,
+                    const PagedKVCache<ov::bfloat16> & cache,
+                    const std::vector<int> & seqs,
+                    tensorND_view<ov::bfloat16> wv0,
+                    bool with_causal_mask,
+                    float scale = 1.0f) {
+        assert(use_amx);
+        paged_flash_attention(q0, cache, seqs, wv0, with_causal_mask, scale);
+    }
+#endif
 
-        auto & qk = all_qk[tid];
-        qk.resize({M, N}, false);
-        (*ops_qk[tid])(q, k, qk, 0, N, pp_none);
-
-        // softmax per row
-        if (causal_mask && M > 1) {
-            for(int m = 0; m<M; m++) {
-                int valid_n = std::min(N, m + causal_m0 + 1);
-                avx2::functional::softmax(&qk(m,0), valid_n, qk_max + m, qk_sum + m);
-                // the rest part is set as zero
-                memset(&qk(m, valid_n), 0, sizeof(float)*(N - valid_n));
+    // q0/wv0 : {B, M, H, K}
+    // k0/v0  : {B, Hkv, N, K} (kv_head_transposed) or {B, N, Hkv, K}
+    // queries are the last M tokens, i.e. of positions [N-M, N), when causal mask is on
+    //
+    // GQA/MQA : query heads [hkv*group, (hkv+1)*group) share kv-head hkv
+    void operator()(tensorND_view<float> q0,
+                    tensorND_view<float> k0,
+                    tensorND_view<float> v0,
+                    tensorND_view<float> wv0,
+                    bool kv_head_transposed,
+                    bool with_causal_mask,
+                    float scale = 1.0f) {
+#ifdef MHA_WITH_AMX
+        if (use_amx) {
+            flash_attention(q0, k0, v0, wv0, kv_head_transposed, with_causal_mask, scale);
+            return;
+        }
+#endif
+        qk_scale = scale;
+        int B = q0.shape[0];
+        int M = q0.shape[1];
+        int H = q0.shape[2];
+        int K = q0.shape[3];
+        int N = k0.shape[kv_head_transposed ? 2:1];
+        int Hkv = k0.shape[kv_head_transposed ? 1:2];
+        assert(H % Hkv == 0);
+        int group = H / Hkv;
+        bool causal = with_causal_mask && M > 1;
+
+        // few queries : flash-decoding in parallel over blocks of keys
+        int bN = auto_bN(N, K, B * Hkv, sizeof(float), 8);
+        if (M <= max_split_M && N > bN) {
+            // blocks before the sliding-window are skipped
+            int nb0 = first_key(N, M) / bN;
+            int nblocks = (N + bN - 1) / bN - nb0;
+            flash_decoding(wv0, Hkv, nblocks,
+                [&](size_t b) { return nblocks; },
+                [&](int ithr, int b, int hkv, int nb) {
+                    int n0 = (nb0 + nb) * bN;
+                    int n1 = std::min(N, n0 + bN);
+                    encode_avx2(ithr, q0,
+                                kv_slice(k0, kv_head_transposed, b, hkv, n0, n1),
+                                kv_slice(v0, kv_head_transposed, b, hkv, n0, n1),
+                                b, hkv, nb, group, N - M - n0, causal);
+                });
+            return;
+        }
+
+        // parallel in B/H/M dimensions, heads of a group are adjacent so they reuse K/V in cache
+        const size_t work_amount = (size_t) B * H * M;
+        PARALLEL_NT_STATIC([&](int ithr, int nthr) {
+            size_t start{0}, end{0};
+            split_rows(work_amount, nthr, ithr, M, N, with_causal_mask, window, start, end);
+            size_t bh0, mb0;
+            size_t bh1, mb1;
+            if (start == end) return;
+            bh0 = offset2coord(start, M, mb0);
+            bh1 = offset2coord(end, M, mb1);
+            auto m_start = mb0;
+            auto m_end = std::min(size_t(M), mb1);
+
+            // first head
+            auto m0 = m_start;
+            auto m1 = m0;
+            // bh = b*H + h
+            for(auto bh = bh0; bh <= bh1; bh++) {
+                // determine m1 for current head
+                m1 = (bh == bh1) ? m_end : M;
+                if (m1 <= m0) break;
+
+                //  q[b, m0:m1, h, K] => (m1-m0)xK
+                //  k[b, h/group, 0:N, K] => NxK
+                //  v[b, h/group, 0:N, K] => NxK
+                // wv[b, m0:m1, h, K] => (m1-m0)xK
+                auto b = bh/H;
+                auto h = bh - b*H;
+                auto q = q0.Slice(b, slice(m0, m1), h, fullslice());
+                auto k = kv_slice(k0, kv_head_transposed, b, h / group, 0, N);
+                auto v = kv_slice(v0, kv_head_transposed, b, h / group, 0, N);
+                auto wv = wv0.Slice(b, slice(m0, m1), h, fullslice());
+                one_head_attention(ithr, q, k, v, wv, attn_mask(N - M + m0, with_causal_mask && M > 1, h));
+
+                // m0 for next head is always 0
+                m0 = 0;
+            }
+        });
+    }
+
+    // attention over a paged KV-cache (fp32 or int8)
+    //   q0, wv0 : {B, M, H, K}, batch b holds the last M tokens of sequence seqs[b],
+    //             whose K/V must have been appended into cache already
+    //
+    // each block of a sequence is encoded into a sub-state, which are combined into wv0 at last
+    template<typename TC>
+    void operator()(tensorND_view<float> q0,
+                    const PagedKVCache<TC> & cache,
+                    const std::vector<int> & seqs,
+                    tensorND_view<float> wv0,
+                    bool with_causal_mask,
+                    float scale = 1.0f) {
+#ifdef MHA_WITH_AMX
+        if (use_amx) {
+            paged_flash_attention(q0, cache, seqs, wv0, with_causal_mask, scale);
+            return;
+        }
+#endif
+        qk_scale = scale;
+        int M = q0.shape[1];
+        int group = q0.shape[2] / cache.H;
+        // blocks before the sliding-window are skipped
+        auto first_block = [&](size_t b) { return first_key(cache.length(seqs[b]), M) / cache.block_size; };
+        auto num_blocks = [&](size_t b) { return cache.num_blocks(seqs[b]) - first_block(b); };
+        int max_blocks = 0;
+        for(size_t b = 0; b < seqs.size(); b++)
+            max_blocks = std::max(max_blocks, num_blocks(b));
+
+        flash_decoding(wv0, cache.H, max_blocks, num_blocks,
+            [&](int ithr, int b, int hkv, int nb) {
+                auto seq = seqs[b];
+                int blk = first_block(b) + nb;
+                int causal_m0 = cache.length(seq) - M - blk * cache.block_size;
+                if (blk + 1 < cache.num_blocks(seq))
+                    cache.prefetch(seq, blk + 1, hkv);
+                encode_avx2(ithr, q0, kv_block(ithr, cache, seq, blk, hkv, false), kv_block(ithr, cache, seq, blk, hkv, true),
+                            b, hkv, nb, group, causal_m0, with_causal_mask && M > 1);
+            });
+    }
+
+    // K/V of head h in i-th block of seq as fp32, used in-place
+    tensorND_view<float> kv_block(int ithr, const PagedKVCache<float> & cache, int seq, int i, int h, bool value) {
+        return value ? cache.values(seq, i, h) : cache.keys(seq, i, h);
+    }
+
+    // int8 block is dequantized into per-thread buffer right before it's consumed by q*k' or w*v,
+    // so it's still in L1/L2 and only int8 bytes are streamed from memory
+    tensorND_view<float> kv_block(int ithr, const PagedKVCache<int8_t> & cache, int seq, int i, int h, bool value) {
+        auto src = value ? cache.values(seq, i, h) : cache.keys(seq, i, h);
+        auto * scales = value ? cache.value_scales(seq, i, h) : cache.key_scales(seq, i, h);
+        auto & buff = all_kv[ithr];
+        buff.resize({2, cache.block_size, cache.S}, false);
+        auto dst = buff.Slice(value ? 1 : 0, slice(0, src.shape[0]), fullslice());
+        for(int n = 0; n < src.shape[0]; n++)
+            dequant_i8(&dst(n, 0), &src(n, 0), cache.S, scales[n]);
+        return dst;
+    }
+
+    static void dequant_i8(float * dst, const int8_t * src, int n, float scale) {
+        auto vscale = _mm256_set1_ps(scale);
+        int i;
+        for(i = 0; (i + 8) <= n; i += 8) {
+            auto x = _mm256_cvtepi8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + i)));
+            _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(x), vscale));
+        }
+        for(; i < n; i++)
+            dst[i] = src[i] * scale;
+    }
+
+    std::atomic<int> * reset_sub_states_done(size_t n) {
+        if (n > sub_states_done_size) {
+            sub_states_done.reset(new std::atomic<int>[n]);
+            sub_states_done_size = n;
+        }
+        for (size_t i = 0; i < n; i++)
+            sub_states_done[i].store(0, std::memory_order_relaxed);
+        return sub_states_done.get();
+    }
+
+    // combine sub-states of query heads [h0, h0 + group) of batch b into wv0
+    template<typename TO>
+    void combine_group(tensorND_view<TO> wv0, int b, int h0, int group, int num_sub_states) {
+        for (int h = h0; h < h0 + group; h++) {
+            //  s[b, 0:M, h, nb, K] => M x nb x K
+            // wv[b, 0:M, h, K] => M x K
+            // qk_max: [b, 0:num_sub_states, h, 0:M]
+            // qk_sum: [b, 0:num_sub_states, h, 0:M]
+            combine_sub_states(wv0.Slice(b, fullslice(), h, fullslice()),
+                               sub_states.Slice(b, fullslice(), h, fullslice(), fullslice()),
+                               qk_max.Slice(b, fullslice(), h, fullslice()),
+                               qk_sum.Slice(b, fullslice(), h, fullslice()),
+                               num_sub_states);
+        }
+    }
+
+#if defined(__AVX512F__)
+    static void store_x16(float * dst, __m512 v, __mmask16 k) {
+        _mm512_mask_storeu_ps(dst, k, v);
+    }
+#endif
+#ifdef MHA_WITH_AMX
+    static void store_x16(ov::bfloat16 * dst, __m512 v, __mmask16 k) {
+        amx_kernel::functional::store_x16(dst, v, k);
+    }
+#endif
+
+    // combine sub-states of a head, each encodes the same queries with a different part of keys/values
+    //       wv : M x K
+    //        s : M x num_sub_states x K
+    // p_qk_max : num_sub_states x M    max of q*k' in each part
+    // p_qk_sum : num_sub_states x M    sum of exp(q*k' - max) in each part, overwritten by weights
+    template<typename TO>
+    void combine_sub_states(tensorND_view<TO> wv,
+                            tensorND_view<float> s,
+                            tensorND_view<float> p_qk_max,
+                            tensorND_view<float> p_qk_sum,
+                            int num_sub_states) {
+        auto M = wv.shape[0];
+        auto K = wv.shape[1];
+        for (int m = 0; m < M; m++) {
+            auto * p_wv = &wv(m, 0);
+            // get weights of sub-states :
+            //    tmax = max_i(qk_max_i)
+            //    tsum_i = sum_i * exp(qk_max_i - tmax)
+            //    weight_i = tsum_i/sum_i(tsum_i)
+            float tmax = std::numeric_limits<float>::lowest();
+            for (int nb = 0; nb < num_sub_states; nb++)
+                tmax = std::max(tmax, p_qk_max(nb, m));
+            float tsum = 0;
+            for (int nb = 0; nb < num_sub_states; nb++) {
+                p_qk_sum(nb, m) *= std::exp(p_qk_max(nb, m) - tmax);
+                tsum += p_qk_sum(nb, m);
             }
-        } else {
-            for(int m = 0; m<M; m++) {
-                avx2::functional::softmax(&qk(m,0), N, qk_max + m, qk_sum + m);
+            float tweight_recip = 1.0f / tsum;
+            for (int nb = 0; nb < num_sub_states; nb++)
+                p_qk_sum(nb, m) *= tweight_recip;
+
+            // linear combine sub-states, accumulated in registers
+            auto sub_stride = s.strides[1] / sizeof(float);
+            float * p_sub0 = &s(m, 0, 0);
+#if defined(__AVX512F__)
+            for (int k = 0; k < K; k += 16) {
+                auto mask = _cvtu32_mask16(K - k >= 16 ? 0xFFFF : (0xFFFF >> (16 - (K - k))));
+                auto x_new = _mm512_setzero_ps();
+                float * p_sub = p_sub0 + k;
+                for (int nb = 0; nb < num_sub_states; nb++, p_sub += sub_stride) {
+                    auto x_sub = _mm512_maskz_loadu_ps(mask, p_sub);
+                    x_new = _mm512_fmadd_ps(x_sub, _mm512_set1_ps(p_qk_sum(nb, m)), x_new);
+                }
+                store_x16(p_wv + k, x_new, mask);
+            }
+#else
+            for (int k = 0; k < K; k += 8) {
+                auto mask = avx2::functional::get_mask(std::min(K - k, 8));
+                auto x_new = _mm256_setzero_ps();
+                float * p_sub = p_sub0 + k;
+                for (int nb = 0; nb < num_sub_states; nb++, p_sub += sub_stride) {
+                    auto x_sub = _mm256_maskload_ps(p_sub, mask);
+                    x_new = _mm256_fmadd_ps(x_sub, _mm256_set1_ps(p_qk_sum(nb, m)), x_new);
+                }
+                _mm256_maskstore_ps(p_wv + k, mask, x_new);
             }
+#endif
+        }
+    }
+
+    // split B*H*M query rows among threads, with causal mask row m attends (N - M + m + 1) keys
+    // so later rows of each head are more costly and less of them go to a thread, with
+    // sliding-window each row attends at most window keys
+    static void split_rows(size_t work_amount, int nthr, int ithr, int M, int N, bool causal, int window,
+                           size_t & start, size_t & end) {
+        if (!causal || M == 1) {
+            splitter1d(work_amount, nthr, ithr, start, end);
+            return;
         }
-        // combine
-        (*ops_wv[tid])(qk, v, wv, 0, K, pp_none);
+        splitter1d_weighted(work_amount, nthr, ithr, [&](size_t cur) {
+            size_t n = std::min<size_t>(N, N - M + cur % M + 1);
+            return window > 0 ? std::min<size_t>(n, window) : n;
+        }, start, end);
     }
 
+    /*
+        q: M x K
+        k: N x K (need transpose)
+        v: N x K
 
+        positions & masking of rows of q are described by mask (see AttnMask), row m attends keys
+        [key_begin(m), key_end(m)). rows are processed in blocks of causal_bM rows when rows attend
+        different keys (causal or sliding-window), each block only goes through keys attended by any
+        of its rows, so fully masked keys are skipped and only the diagonal parts of each block are masked.
+
+        qk_max/qk_sum (optional) receive max & sum of exp of each row for combining sub-states
+    */
+    enum { causal_bM = 32 };
     void one_head_attention(int tid,
-                            tensorND<float>& q,
-                            tensorND<float>& k,
-                            tensorND<float>& v,
-                            tensorND<float>& wv,
-                            int causal_m0,
-                            bool causal_mask) {
+                            tensorND_view<float> q,
+                            tensorND_view<float> k,
+                            tensorND_view<float> v,
+                            tensorND_view<float> wv,
+                            const AttnMask & mask,
+                            float * qk_max = nullptr,
+                            float * qk_sum = nullptr) {
         auto M = q.shape[0];
         auto N = k.shape[0];
         auto K = v.shape[1];
 
         auto & qk = all_qk[tid];
         qk.resize({M, N}, false);
-        (*ops_qk[tid])(q, k, qk, 0, N, pp_none);
-
-        // softmax per row
-        if (causal_mask && M > 1) {
-            for(int m = 0; m<M; m++) {
-                int valid_n = std::min(N, m + causal_m0 + 1);
-                avx2::functional::softmax(&qk(m,0), valid_n);
-                // the rest part is set as zero
-                memset(&qk(m, valid_n), 0, sizeof(float)*(N - valid_n));
+        int bM = (mask.causal || mask.window > 0) ? causal_bM : M;
+        for(int m0 = 0; m0 < M; m0 += bM) {
+            int m1 = std::min(M, m0 + bM);
+            // keys before the window of the first row or beyond the last row of this block are masked for all rows
+            int n_begin = std::min(N, mask.key_begin(m0));
+            int n_lim = std::max(n_begin, mask.key_end(m1 - 1, N));
+            auto wv_blk = wv.Slice(slice(m0, m1), fullslice());
+            if (n_lim == n_begin) {
+                // all rows attend to nothing (paged KV-cache blocks after queries)
+                for(int m = m0; m < m1; m++) {
+                    memset(&wv_blk(m - m0, 0), 0, sizeof(float) * K);
+                    if (qk_max) qk_max[m] = std::numeric_limits<float>::lowest();
+                    if (qk_sum) qk_sum[m] = 0;
+                }
+                continue;
             }
-        } else {
-            for(int m = 0; m<M; m++) {
-                avx2::functional::softmax(&qk(m,0), N);
+            int nk = n_lim - n_begin;
+            auto qk_blk = qk.Slice(slice(m0, m1), slice(0, nk));
+            (*ops_qk[tid])(q.Slice(slice(m0, m1), fullslice()), k.Slice(slice(n_begin, n_lim), fullslice()), qk_blk, 0, nk, pp_none);
+            auto blk_mask = mask.shift(m0, n_begin);
+
+            // softmax (with qk_scale & ALiBi fused) per row over its keys [lo, hi), the rest part
+            // (within diagonal blocks) is set as zero
+            for(int m = m0; m < m1; m++) {
+                int lo = std::min(nk, std::max(0, blk_mask.key_begin(m - m0)));
+                int hi = std::max(lo, blk_mask.key_end(m - m0, nk));
+                float * p = &qk(m, lo);
+                avx2::functional::softmax_online(p, p, nk - lo, hi - lo, qk_scale, nullptr,
+                                                 blk_mask.slope(m - m0), lo - blk_mask.pos(m - m0),
+                                                 qk_max ? qk_max + m : nullptr, qk_sum ? qk_sum + m : nullptr);
+                if (lo > 0)
+                    memset(&qk(m, 0), 0, sizeof(float)*lo);
             }
+            // combine
+            (*ops_wv[tid])(qk_blk, v.Slice(slice(n_begin, n_lim), fullslice()), wv_blk, 0, K, pp_none);
         }
-        // combine
-        (*ops_wv[tid])(qk, v, wv, 0, K, pp_none);
     }
 };
@@ -0,0 +1,413 @@
+#pragma once
+
+#include "kernels_amx.hpp"
+#include "kv_cache.hpp"
+#include "attn_mask.hpp"
+#include <limits>
+
+namespace amx_kernel {
+
+namespace functional {
+    // dequantize (at most 32) int8 elements into bf16 : src * scale, the rest of 32 destination elements are zero
+    inline void cvt_bf16_x32(ov::bfloat16 * dst, const int8_t * src, int n, float scale) {
+        auto k = _cvtu32_mask32(n >= 32 ? 0xFFFFFFFF : (0xFFFFFFFF >> (32 - n)));
+        auto x8 = _mm256_maskz_loadu_epi8(k, src);
+        auto vscale = _mm512_set1_ps(scale);
+        auto r0 = _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_cvtepi8_epi32(_mm256_castsi256_si128(x8))), vscale);
+        auto r1 = _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_cvtepi8_epi32(_mm256_extracti128_si256(x8, 1))), vscale);
+        auto c = _mm512_cvtne2ps_pbh(r1, r0);
+        _mm512_storeu_epi16(dst, reinterpret_cast<__m512i&>(c));
+    }
+
+    // bits [a, b) of 16 lanes
+    inline __mmask16 mask16_range(int a, int b) {
+        a = std::max(a, 0);
+        b = std::min(b, 16);
+        if (b <= a) return _cvtu32_mask16(0);
+        return _cvtu32_mask16(((1u << b) - 1) & ~((1u << a) - 1));
+    }
+}
+
+// flash-attention of a single head with AMX-bf16
+//
+//   wv = softmax(scale * q*k' + alibi_bias + mask) * v
+//       q : M x S     k : N x S     v : N x S     wv : M x S     (S : head size)
+//   (causal/sliding-window mask & ALiBi bias are described by AttnMask, ALiBi bias is added
+//    in registers right before online softmax, key blocks outside the window are skipped)
+//
+// K/V of current head are converted into bf16 & repacked (32 keys at a time, from dense
+// tensors or from blocks of a paged KV-cache) once by set_kv(), then every
+// 32 rows of q go through N in blocks of bN columns with online softmax, so the whole
+// M x N score matrix is never materialized, all intermediate S/P/O blocks stay in L1.
+//
+// int8 K/V of a paged KV-cache are not repacked by set_kv(), only their 32-key panels are
+// recorded, each panel is dequantized right before it's consumed : K into a ping-pong pair of
+// panels inside the q*k' loop (next panel is converted while tiles compute current one), V into
+// a bN-keys block before w*v. So only int8 bytes stream from memory. This only pays off when K/V
+// are consumed by a single call of up to 32 rows (decoding : queries of a GQA group stacked),
+// otherwise the conversion would be repeated by every call & every 32 rows, so all panels are
+// repacked once into packK/packV as for other types.
+struct FlashAttention {
+    enum { bM = 32, bN = 128 };
+
+    int N = 0;
+    int S = 0;
+    int Npad = 0;   // N rounded up to multiple of 32
+    int Spad = 0;   // S rounded up to multiple of 32
+
+    tensor2D<ov::bfloat16> kvbuf;   // 32 keys/values converted into bf16 & zero-padded into 32 x Spad
+    tensor2D<ov::bfloat16> packK;   // repackB_1x2 of K' : panels of 32 keys
+    tensor2D<ov::bfloat16> packV;   // repackB_1x2 of V  : panels of 32 head-size columns
+    tensor2D_blocked<ov::bfloat16> qblk;    // 32 rows of q in tile-blocked layout
+
+    // 32-key panel of int8 K/V in a paged KV-cache : valid x S rows, per-key scales
+    struct i8_panel {
+        int8_t * k;
+        int8_t * v;
+        int stride_k;
+        int stride_v;
+        const float * k_scales;
+        const float * v_scales;
+        int valid;
+    };
+    std::vector<i8_panel> i8_panels;   // empty unless K/V are int8
+    tensor2D<ov::bfloat16> kpanel;      // 2 (ping-pong) panels of K' in layout of packK rows
+    tensor2D<ov::bfloat16> vblock;      // bN keys of V in layout of packV (Spad/32 panels)
+
+    tensor2D<float> buffS;          // bM x bN scores
+    tensor2D<float> buffO;          // bM x Spad output accumulator
+    tensor2D<float> buffC;          // 2x2 C tiles
+    ov::bfloat16 * P = nullptr;     // bM x bN probabilities as A tiles: [bN/32][2][16x32]
+    std::shared_ptr<ov::bfloat16> P_mem;
+    float row_max[bM];
+    float row_sum[bM];
+    float row_alpha[bM];
+
+    FlashAttention() : buffS(bM, bN), buffC(32, 32) {
+        P_mem = std::shared_ptr<ov::bfloat16>(
+                    reinterpret_cast<ov::bfloat16*>(aligned_alloc(64, bM * bN * sizeof(ov::bfloat16))),
+                    [](void * p) { ::free(p); });
+        P = P_mem.get();
+    }
+
+    // rows [valid, 32) are zero
+    template<typename T>
+    void to_kvbuf(tensor_view<T> src, const float * scales) {
+        int valid = src.dims[0];
+        kvbuf.resize(32, Spad);
+        for(int n = 0; n < valid; n++) {
+            for(int s = 0; s < Spad; s += 32)
+                functional::cvt_bf16_x32(&kvbuf(n, s), &src(n, s), S - s);
+        }
+        if (valid < 32)
+            memset(&kvbuf(valid, 0), 0, (32 - valid) * kvbuf.stride);
+    }
+
+    // int8 row n is dequantized by scales[n]
+    void to_kvbuf(tensor_view<int8_t> src, const float * scales) {
+        int valid = src.dims[0];
+        kvbuf.resize(32, Spad);
+        for(int n = 0; n < valid; n++) {
+            for(int s = 0; s < Spad; s += 32)
+                functional::cvt_bf16_x32(&kvbuf(n, s), &src(n, s), S - s, scales[n]);
+        }
+        if (valid < 32)
+            memset(&kvbuf(valid, 0), 0, (32 - valid) * kvbuf.stride);
+    }
+
+    // pack : K/V are repacked as a whole into packK/packV, or referenced as int8 panels
+    void reset_kv(int n, int s, bool pack = true) {
+        N = n;
+        S = s;
+        Npad = rndup(N, 32);
+        Spad = rndup(S, 32);
+        i8_panels.clear();
+        if (pack) {
+            packK.resize(Npad / 32, Spad * 32);
+            packV.resize(Spad / 32, Npad * 32);
+        } else {
+            kpanel.resize(2, Spad * 32);
+            vblock.resize(Spad / 32, bN * 32);
+        }
+    }
+
+    // convert & repack keys/values [p*32, p*32 + valid), k/v : valid x S (valid <= 32)
+    //   K' : p-th panel of packK
+    //   V  : p-th k-step (2048 bytes) in each panel of packV
+    // k_scales/v_scales : per-key dequantization scales of int8 k/v
+    template<typename T>
+    void pack_kv(int p, tensor_view<T> k, tensor_view<T> v,
+                 const float * k_scales = nullptr, const float * v_scales = nullptr) {
+        to_kvbuf(k, k_scales);
+        repackB_1x2_panel(reinterpret_cast<int8_t *>(&packK(p, 0)), kvbuf.view(), 0, true);
+        to_kvbuf(v, v_scales);
+        for(int j = 0; j < Spad / 32; j++)
+            repackB_1x2_panel(reinterpret_cast<int8_t *>(&packV(j, 0)) + p * 2048, kvbuf.view(), j * 32, false);
+    }
+
+    // k/v: N x S
+    template<typename T>
+    void set_kv(tensor_view<T> k, tensor_view<T> v) {
+        reset_kv(k.dims[0], k.dims[1]);
+        for(int n0 = 0; n0 < N; n0 += 32) {
+            int n1 = std::min(N, n0 + 32);
+            pack_kv(n0 / 32, k.Slice(n0, n1, 0, S), v.Slice(n0, n1, 0, S));
+        }
+    }
+
+    // K/V of head h in blocks [blk0, blk1) of a sequence in paged KV-cache, blocks are repacked directly from the pool
+    //   single_use : K/V are consumed by one call of up to 32 rows (only int8 K/V make use of it)
+    template<typename T>
+    void set_kv(const PagedKVCache<T> & cache, int seq, int h, int blk0 = 0, int blk1 = -1, bool single_use = false) {
+        assert(cache.block_size % 32 == 0);
+        if (blk1 < 0) blk1 = cache.num_blocks(seq);
+        reset_kv(std::min(cache.length(seq), blk1 * cache.block_size) - blk0 * cache.block_size, cache.S);
+        for(int i = blk0; i < blk1; i++) {
+            auto kb = cache.keys(seq, i, h);
+            auto vb = cache.values(seq, i, h);
+            auto * ks = cache.key_scales(seq, i, h);
+            auto * vs = cache.value_scales(seq, i, h);
+            tensor_view<T> k(kb.shape[0], S, kb.data, kb.strides[0]);
+            tensor_view<T> v(vb.shape[0], S, vb.data, vb.strides[0]);
+            // next block is fetched while current one is converted
+            if (i + 1 < blk1)
+                cache.prefetch(seq, i + 1, h);
+            for(int n0 = 0; n0 < k.dims[0]; n0 += 32) {
+                int n1 = std::min(k.dims[0], n0 + 32);
+                pack_kv(((i - blk0) * cache.block_size + n0) / 32, k.Slice(n0, n1, 0, S), v.Slice(n0, n1, 0, S),
+                        ks ? ks + n0 : nullptr, vs ? vs + n0 : nullptr);
+            }
+        }
+    }
+
+    // int8 K/V of head h in blocks [blk0, blk1) : for single use only panels are recorded (see
+    // unpack_k/unpack_v), otherwise they are repacked as a whole
+    void set_kv(const PagedKVCache<int8_t> & cache, int seq, int h, int blk0 = 0, int blk1 = -1, bool single_use = false) {
+        if (!single_use) {
+            set_kv<int8_t>(cache, seq, h, blk0, blk1);
+            return;
+        }
+        assert(cache.block_size % 32 == 0);
+        if (blk1 < 0) blk1 = cache.num_blocks(seq);
+        reset_kv(std::min(cache.length(seq), blk1 * cache.block_size) - blk0 * cache.block_size, cache.S, false);
+        for(int i = blk0; i < blk1; i++) {
+            auto kb = cache.keys(seq, i, h);
+            auto vb = cache.values(seq, i, h);
+            auto * ks = cache.key_scales(seq, i, h);
+            auto * vs = cache.value_scales(seq, i, h);
+            for(int n0 = 0; n0 < kb.shape[0]; n0 += 32) {
+                i8_panels.push_back({&kb.data[n0 * kb.strides[0]], &vb.data[n0 * vb.strides[0]],
+                                     static_cast<int>(kb.strides[0]), static_cast<int>(vb.strides[0]),
+                                     ks + n0, vs + n0, std::min(kb.shape[0] - n0, 32)});
+            }
+        }
+    }
+
+    // q/wv: M x S, positions & masking of rows are described by mask (see AttnMask),
+    // rows attending no key give zero output
+    // row_max/row_sum of online softmax are stored into out_max/out_sum (if not null) for combining
+    // outputs of different parts of keys (flash-decoding)
+    template<typename T, typename TO>
+    void operator()(tensor_view<T> q, tensor_view<TO> wv, const AttnMask & mask, float scale,
+                    float * out_max = nullptr, float * out_sum = nullptr) {
+        int M = q.dims[0];
+        tileconfig_t tfg(1, 0, 8, 16, 64);
+        buffO.resize(bM, Spad);
+        for(int m0 = 0; m0 < M; m0 += bM) {
+            int valid_m = std::min(M - m0, static_cast<int>(bM));
+            one_block(q.Slice(m0, m0 + valid_m, 0, S), wv.Slice(m0, m0 + valid_m, 0, S),
+                      mask.shift(m0, 0), scale);
+            if (out_max) memcpy(out_max + m0, row_max, valid_m * sizeof(float));
+            if (out_sum) memcpy(out_sum + m0, row_sum, valid_m * sizeof(float));
+        }
+    }
+
+private:
+    // int8 panel p of K' => kpanel(p & 1), K/V of next panel are fetched into L2 meanwhile
+    void unpack_k(int p) {
+        auto & pn = i8_panels[p];
+        to_kvbuf(tensor_view<int8_t>(pn.valid, S, pn.k, pn.stride_k), pn.k_scales);
+        repackB_1x2_panel(reinterpret_cast<int8_t *>(&kpanel(p & 1, 0)), kvbuf.view(), 0, true);
+        if (p + 1 < static_cast<int>(i8_panels.size())) {
+            auto & next = i8_panels[p + 1];
+            for(int n = 0; n < next.valid; n++) {
+                for(int s = 0; s < S; s += 64) {
+                    _mm_prefetch(reinterpret_cast<const char *>(next.k + n * next.stride_k + s), _MM_HINT_T1);
+                    _mm_prefetch(reinterpret_cast<const char *>(next.v + n * next.stride_v + s), _MM_HINT_T1);
+                }
+            }
+        }
+    }
+
+    // int8 panels [p0, p0 + chunks) of V => vblock
+    void unpack_v(int p0, int chunks) {
+        for(int c = 0; c < chunks; c++) {
+            auto & pn = i8_panels[p0 + c];
+            to_kvbuf(tensor_view<int8_t>(pn.valid, S, pn.v, pn.stride_v), pn.v_scales);
+            for(int j = 0; j < Spad / 32; j++)
+                repackB_1x2_panel(reinterpret_cast<int8_t *>(&vblock(j, 0)) + c * 2048, kvbuf.view(), j * 32, false);
+        }
+    }
+
+    // C tiles 0,1,2,3 : 2x2 16x16 fp32 (row tile 1 is only used when valid_m > 16)
+    // A tiles 4,5     : 16x32 bf16
+    // B tiles 6,7     : 32x16 bf16
+    template<bool two_rows>
+    void matmul_32x32(const int8_t * pA0, const int8_t * pA1, int strideA_kstep,
+                      const int8_t * pB, int ksteps) {
+        if (two_rows) zero_tiles<0, 1, 2, 3>(); else zero_tiles<0, 1>();
+        for(int k = 0; k < ksteps; k++) {
+            _tile_loadd(4, pA0, 64); pA0 += strideA_kstep;
+            _tile_loadd(6, pB, 64);
+            _tile_dpbf16ps(0, 4, 6);
+            _tile_loadd(7, pB + 1024, 64);
+            _tile_dpbf16ps(1, 4, 7);
+            if (two_rows) {
+                _tile_loadd(5, pA1, 64); pA1 += strideA_kstep;
+                _tile_dpbf16ps(2, 5, 6);
+                _tile_dpbf16ps(3, 5, 7);
+            }
+            pB += 2048;
+        }
+    }
+
+    template<bool two_rows>
+    void store_32x32(float * dst, int stride) {
+        _tile_stored(0, dst, stride);
+        _tile_stored(1, dst + 16, stride);
+        if (two_rows) {
+            _tile_stored(2, reinterpret_cast<int8_t*>(dst) + 16*stride, stride);
+            _tile_stored(3, reinterpret_cast<int8_t*>(dst) + 16*stride + 64, stride);
+        }
+    }
+
+    template<typename T, typename TO>
+    void one_block(tensor_view<T> q, tensor_view<TO> wv, const AttnMask & mask, float scale) {
+        int valid_m = q.dims[0];
+        bool two_rows = valid_m > 16;
+
+        // q => tile-blocked bf16, zero padded
+        qblk.resize(bM, Spad);
+        for(int m = 0; m < valid_m; m++)
+            for(int s = 0; s < Spad; s += 32)
+                functional::cvt_bf16_x32(qblk.tile(m / 16, s / 32) + (m % 16) * 32, &q(m, s), S - s);
+
+        for(int m = 0; m < valid_m; m++) {
+            row_max[m] = std::numeric_limits<float>::lowest();
+            row_sum[m] = 0;
+        }
+        memset(&buffO[0], 0, bM * buffO.stride);
+
+        // keys after the last query position (causal) or before the window of the first
+        // query are masked for all rows, blocks of them are skipped
+        int n_begin = mask.key_begin(0) / 32 * 32;
+        int n_end = mask.key_end(valid_m - 1, N);
+        int kb_q = Spad / 32;
+        bool i8 = !i8_panels.empty();
+
+        for(int n0 = n_begin; n0 < n_end; n0 += bN) {
+            int n1 = std::min(n0 + static_cast<int>(bN), n_end);
+            int chunks = (n1 - n0 + 31) / 32;
+
+            // S = q * k'
+            if (i8) unpack_k(n0/32);
+            for(int c = 0; c < chunks; c++) {
+                int p = n0/32 + c;
+                auto * pA0 = reinterpret_cast<int8_t*>(qblk.tile(0, 0));
+                auto * pA1 = reinterpret_cast<int8_t*>(qblk.tile(1, 0));
+                auto * pB = reinterpret_cast<int8_t*>(i8 ? &kpanel(p & 1, 0) : &packK(p, 0));
+                if (two_rows)
+                    matmul_32x32<true>(pA0, pA1, 1024, pB, kb_q);
+                else
+                    matmul_32x32<false>(pA0, pA1, 1024, pB, kb_q);
+                // next int8 panel is converted into the other buffer while tiles compute
+                if (i8 && c + 1 < chunks) unpack_k(p + 1);
+                if (two_rows)
+                    store_32x32<true>(&buffS(0, c*32), buffS.stride);
+                else
+                    store_32x32<false>(&buffS(0, c*32), buffS.stride);
+            }
+
+            // online softmax : P = exp(S - new_max), O *= exp(old_max - new_max)
+            auto vscale = _mm512_set1_ps(scale);
+            auto vneginf = _mm512_set1_ps(-std::numeric_limits<float>::infinity());
+            auto vlane = _mm512_set_ps(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+            for(int m = 0; m < valid_m; m++) {
+                // keys [lo, hi) of this block are attended by row m
+                int lo = std::max(n0, mask.key_begin(m)) - n0;
+                int hi = std::min(n1, mask.key_end(m, N)) - n0;
+                int valid_n = n1 - n0;
+                auto * s = &buffS(m, 0);
+                auto vmax = vneginf;
+                // ALiBi : slope * (n - pos), n - pos of lane 0 is (n0 + n - pos)
+                auto vslope = _mm512_set1_ps(mask.slope(m));
+                int dist0 = n0 - mask.pos(m);
+                for(int n = 0; n < valid_n; n += 16) {
+                    auto k = functional::mask16_range(lo - n, hi - n);
+                    auto x = _mm512_mul_ps(_mm512_loadu_ps(s + n), vscale);
+                    if (mask.alibi)
+                        x = _mm512_fmadd_ps(_mm512_add_ps(vlane, _mm512_set1_ps(dist0 + n)), vslope, x);
+                    x = _mm512_mask_mov_ps(vneginf, k, x);
+                    _mm512_storeu_ps(s + n, x);
+                    vmax = _mm512_max_ps(vmax, x);
+                }
+                float new_max = std::max(row_max[m], _mm512_reduce_max_ps(vmax));
+                float alpha = std::exp(row_max[m] - new_max);
+                auto vnew_max = _mm512_set1_ps(new_max);
+                auto vsum = _mm512_setzero_ps();
+                for(int c = 0; c < chunks; c++) {
+                    __m512 p[2];
+                    for(int i = 0; i < 2; i++) {
+                        int n = c*32 + i*16;
+                        if (n < valid_n) {
+                            auto k = functional::mask16_range(lo - n, hi - n);
+                            auto x = _mm512_maskz_loadu_ps(k, s + n);
+                            p[i] = _mm512_maskz_mov_ps(k, functional::exp_ps(_mm512_sub_ps(x, vnew_max)));
+                        } else {
+                            p[i] = _mm512_setzero_ps();
+                        }
+                        vsum = _mm512_add_ps(vsum, p[i]);
+                    }
+                    auto pbf16 = _mm512_cvtne2ps_pbh(p[1], p[0]);
+                    _mm512_storeu_epi16(P + (c*2 + m/16)*512 + (m%16)*32, reinterpret_cast<__m512i&>(pbf16));
+                }
+                row_sum[m] = row_sum[m] * alpha + _mm512_reduce_add_ps(vsum);
+                row_max[m] = new_max;
+                row_alpha[m] = alpha;
+            }
+
+            // O = O*alpha + P*V
+            if (i8) unpack_v(n0/32, chunks);
+            for(int j = 0; j < Spad/32; j++) {
+                auto * pA0 = reinterpret_cast<int8_t*>(P);
+                auto * pA1 = reinterpret_cast<int8_t*>(P + 512);
+                auto * pB = i8 ? reinterpret_cast<int8_t*>(&vblock(j, 0))
+                               : reinterpret_cast<int8_t*>(&packV(j, 0)) + (n0/32)*2048;
+                if (two_rows) {
+                    matmul_32x32<true>(pA0, pA1, 2048, pB, chunks);
+                    store_32x32<true>(&buffC[0], buffC.stride);
+                } else {
+                    matmul_32x32<false>(pA0, pA1, 2048, pB, chunks);
+                    store_32x32<false>(&buffC[0], buffC.stride);
+                }
+                for(int m = 0; m < valid_m; m++) {
+                    auto * o = &buffO(m, j*32);
+                    auto valpha = _mm512_set1_ps(row_alpha[m]);
+                    _mm512_storeu_ps(o, _mm512_fmadd_ps(_mm512_loadu_ps(o), valpha, _mm512_loadu_ps(&buffC(m, 0))));
+                    _mm512_storeu_ps(o + 16, _mm512_fmadd_ps(_mm512_loadu_ps(o + 16), valpha, _mm512_loadu_ps(&buffC(m, 16))));
+                }
+            }
+        }
+
+        // wv = O / sum
+        for(int m = 0; m < valid_m; m++) {
+            auto vrecip = _mm512_set1_ps(row_sum[m] > 0 ? 1.0f / row_sum[m] : 0.0f);
+            for(int s = 0; s < S; s += 16) {
+                auto k = _cvtu32_mask16(S - s >= 16 ? 0xFFFF : (0xFFFF >> (16 - (S - s))));
+                functional::store_x16(&wv(m, s), _mm512_mul_ps(_mm512_loadu_ps(&buffO(m, s)), vrecip), k);
+            }
+        }
+    }
+};
+
+} // namespace amx_kernel
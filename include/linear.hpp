@@ -0,0 +1,92 @@
+#pragma once
+
+#include "cpu_features.hpp"
+#include <memory>
+#include <stdexcept>
+
+// fully-connected layer with runtime ISA dispatch
+//
+//   y[M, N] = act(x[M, K] * W[K, N] + bias[N])      fp32 in & out
+//
+// kernels of each ISA live in their own translation unit linear/linear_<isa>.cpp which is the
+// only one compiled with the corresponding -m flags (see the command lines in each of them),
+// everything else (including this header & callers) is built for baseline x86-64, so one
+// binary runs on AVX2-only, AVX-512 and AMX machines with the best kernel of each:
+//
+//   - amx         : amx_kernel::Matmul<bf16,bf16>, fp32 x is converted to bf16 inside Matmul
+//   - avx512      : avx512::Matmul, fp32
+//   - avx2        : avx2::Matmul, fp32
+//   - avx512_bf16 : avx512_vnni::Matmul<bf16,bf16> (vdpbf16ps), fp32 x is converted to bf16 first
+//
+// avx512_bf16 is opt-in (create(cfg, ISA::avx512_bf16)), max_isa() never picks it: x & W are
+// rounded to bf16 (8-bit mantissa, ~3 significant digits, fp32 accumulation), as on AMX. it
+// reads half the bytes of weights, so it's ~2x faster than fp32 avx512 for decode (M=1, weight
+// bandwidth bound), but slower for prefill (M=256, K=N=1024: 65 vs 82 GOps/s on one core).
+//
+// each of those translation units includes the kernel headers inside a namespace of its ISA
+// (linear/linear_isa.hpp), so inline functions of tensor2D, misc.hpp... built with -mavx512*
+// or -mamx* are never merged with the copies of other ISAs or callers, in any link order.
+//
+// weights are copied/repacked when a Linear is created, one Linear holds scratch buffers and
+// is to be used by one thread at a time. to run on multiple cores, split W along N and create
+// one Linear per thread over its own slice of columns (weight + n0, bias + n0), so each
+// core keeps its part of weights in its own L2.
+namespace linear {
+
+enum class Act {
+    none,
+    relu,
+    gelu,
+};
+
+struct Config {
+    int K = 0;
+    int N = 0;
+    const float * weight = nullptr;     // K x N, or N x K if transposeW
+    int ldw = 0;                        // elements between rows of weight, 0 means dense
+    bool transposeW = false;
+    const float * bias = nullptr;       // N, optional
+    Act act = Act::none;
+
+    int weight_stride() const {
+        return ldw ? ldw : (transposeW ? K : N);
+    }
+};
+
+struct Linear {
+    virtual ~Linear() = default;
+
+    // x : M x K with ldx elements between rows, y : M x N with ldy elements between rows
+    virtual void operator()(const float * x, int M, int ldx, float * y, int ldy) = 0;
+
+    void operator()(const float * x, int M, float * y) {
+        (*this)(x, M, cfg.K, y, cfg.N);
+    }
+
+    virtual ISA isa() const = 0;
+
+    const Config cfg;
+    Linear(const Config & cfg) : cfg(cfg) {}
+};
+
+// defined in linear/linear_<isa>.cpp
+std::unique_ptr<Linear> create_avx2(const Config & cfg);
+std::unique_ptr<Linear> create_avx512(const Config & cfg);
+std::unique_ptr<Linear> create_avx512_bf16(const Config & cfg);
+std::unique_ptr<Linear> create_amx(const Config & cfg);
+
+// kernel of given ISA (best one of current CPU by default)
+inline std::unique_ptr<Linear> create(const Config & cfg, ISA isa = max_isa()) {
+    if (!isa_supported(isa))
+        throw std::runtime_error(std::string("linear::create: ISA not supported on this CPU: ") + isa_name(isa));
+    switch(isa) {
+        case ISA::amx: return create_amx(cfg);
+        case ISA::avx512_bf16: return create_avx512_bf16(cfg);
+        case ISA::avx512: return create_avx512(cfg);
+        case ISA::avx2: return create_avx2(cfg);
+        default: break;
+    }
+    throw std::runtime_error("linear::create: no kernel for baseline x86-64, AVX2 is required");
+}
+
+}
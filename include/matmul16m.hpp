@@ -0,0 +1,78 @@
+#pragma once
+
+// AMX kernel of M <= 16 rows shared by the weight formats decoded on the fly (int8 DecodeLinear,
+// weight_compression/wpack.hpp & bf16z.hpp). each format decodes its weights into bf16 tiles,
+// 2 tiles ahead of use into a ping-pong buffer, so the tile loads never wait on the stores of
+// decoding (TileLoad can't be forwarded from store buffer). formats only provide the tile
+// decoder & the store of C.
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "kernels_amx.hpp"
+
+namespace amx_kernel {
+
+// C tiles 0 & 1 (M x 32) into C[:, n0 : n0 + 32), columns from N on are dropped
+inline void store_16m(int M, tensor_view<float> C, int n0, int N) {
+    static thread_local tensor2D<float> Cbuff(16, 32);
+    if (n0 + 32 <= N) {
+        _tile_stored(0, &C(0, n0), C.stride);
+        _tile_stored(1, &C(0, n0 + 16), C.stride);
+    } else {
+        _tile_stored(0, &Cbuff(0, 0), Cbuff.stride);
+        _tile_stored(1, &Cbuff(0, 16), Cbuff.stride);
+        for(int m = 0; m < M; m++)
+            memcpy(&C(m, n0), &Cbuff(m, 0), (N - n0) * sizeof(float));
+    }
+}
+
+// bf16 A (M <= 16 rows, K columns) times panels [p0, p1) of 32 columns of B, K-tails of A are
+// loaded right-aligned (so K >= 32 then) as repackB_1x2 puts them in B:
+//   decode_tile(dst, t) : decodes the next tile of B into dst (bf16 tile, 1KB), t is 0/1 for
+//                         columns 0~15/16~31 of the panel. tiles are decoded in the order of
+//                         panels, k-blocks & t, so a decoder can walk its stream sequentially
+//   store(p)            : stores tiles 0 & 1 (C of panel p, fp32), for example by store_16m()
+template<typename DecodeTile, typename Store>
+void matmul16m_pingpong(tensor_view<ov::bfloat16> A, int p0, int p1, DecodeTile decode_tile, Store store) {
+    static thread_local tensor2D<ov::bfloat16> Bbuff(16 * 4, 32);
+    int M = A.dims[0];
+    int KB = rndup(A.dims[1], 32) / 32;
+    int Kbackoff = KB * 32 - A.dims[1];
+    assert(M <= 16 && (Kbackoff == 0 || KB > 1));
+    if (p0 >= p1)
+        return;
+    auto tileA = [&](int kb) {
+        return kb < KB - 1 ? &A(0, kb * 32) : &A(0, kb * 32) - Kbackoff;
+    };
+
+    // C: 0,1  A: 2  B: 3,4
+    tileconfig_t tfg(1, 0, {M, M, M, 16, 16}, 64);
+
+    auto * pBsrc = &Bbuff(0, 0);
+    auto * pBdst = &Bbuff(32, 0);
+    decode_tile(pBsrc, 0);
+    decode_tile(pBsrc + 16 * 32, 1);
+    int steps = (p1 - p0) * KB;
+    for(int s = 0; s < steps; s++) {
+        int kb = s % KB;
+        bool more = s + 1 < steps;
+        if (kb == 0) {
+            _tile_zero(0);
+            _tile_zero(1);
+        }
+        _tile_loadd(2, tileA(kb), A.stride);
+        if (more) decode_tile(pBdst, 0);
+        _tile_loadd(3, pBsrc, 64);
+        _tile_dpbf16ps(0, 2, 3);
+        if (more) decode_tile(pBdst + 16 * 32, 1);
+        _tile_loadd(4, pBsrc + 16 * 32, 64);
+        _tile_dpbf16ps(1, 2, 4);
+        std::swap(pBsrc, pBdst);
+        if (kb == KB - 1)
+            store(p0 + s / KB);
+    }
+}
+
+}
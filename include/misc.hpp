@@ -292,10 +292,14 @@ struct MSRConfig {
         abort();                                                                                                                                                                                                                                                                       \
     }
 
-void clflush(void* pv, int bytes) {
+inline void clflush(void* pv, int bytes) {
     auto* p = reinterpret_cast<uint8_t*>(pv);
     for (int i = 0; i < bytes; i += 64) {
+#ifdef __CLFLUSHOPT__
         _mm_clflushopt(p + i);
+#else
+        _mm_clflush(p + i);
+#endif
     }
     _mm_mfence();
 };
@@ -316,7 +320,7 @@ void sw_prefetch_L2(void* pv, int bytes) {
     _mm_mfence();
 };
 
-void load_prefetch_L2(void* pv, int bytes, int rounds = 1) {
+inline void load_prefetch_L2(void* pv, int bytes, int rounds = 1) {
     auto* p = reinterpret_cast<uint8_t*>(pv);
     int i;
     auto sum0 = _mm512_setzero_epi32();
@@ -358,6 +362,15 @@ inline int get_nthr() {
     return _nthr;
 }
 
+// L2 size per core in bytes, read once (2MB if the OS doesn't report it)
+inline int get_L2_size() {
+    static int _L2 = []() {
+        long sz = sysconf(_SC_LEVEL2_CACHE_SIZE);
+        return sz > 0 ? static_cast<int>(sz) : 2048*1024;
+    }();
+    return _L2;
+}
+
 //===============================================================
 #ifndef _GNU_SOURCE
 #define _GNU_SOURCE /* See feature_test_macros(7) */
@@ -430,6 +443,8 @@ std::vector<std::pair<T0, T1>> zip_vector(const std::vector<T0>& v0, const std::
     return ret;
 }
 
+#include "tilecfg.hpp"
+
 struct tileconfig_t {
     uint8_t palette_id;
     uint8_t startRow;
@@ -459,10 +474,10 @@ struct tileconfig_t {
     tileconfig_t(int palette, int _startRow, const std::vector<int>& _rows, int columnsBytes) : tileconfig_t(palette, _startRow, zip_vector(_rows, std::vector<int>(_rows.size(), columnsBytes))) {}
     tileconfig_t(int palette, int _startRow, int numTiles, int _rows, int columnsBytes) : tileconfig_t(palette, _startRow, std::vector<std::pair<int, int>>(numTiles, {_rows, columnsBytes})) {}
 
-    ~tileconfig_t() { _tile_release(); }
+    ~tileconfig_t() { tilecfg_cache::get().release(); }
     void load() {
         // std::cout << "\ttile load config ... " << std::flush;
-        _tile_loadconfig(this);
+        tilecfg_cache::get().load(this);
         // std::cout << *this << std::flush << std::endl;
     }
     void store() { _tile_storeconfig(this); }
@@ -481,6 +496,7 @@ struct tileconfig_t {
         return out;
     }
 } __attribute__((__packed__));
+static_assert(sizeof(tileconfig_t) == 64, "tileconfig_t must be 64 bytes");
 
 // default implementation
 template <typename T>
@@ -506,8 +522,12 @@ template <>
 struct TypeName<int8_t> {
     static const char* get() { return "int8_t"; }
 };
+template <>
+struct TypeName<uint8_t> {
+    static const char* get() { return "uint8_t"; }
+};
 
-std::ostream& logger() {
+inline std::ostream& logger() {
     // https://stackoverflow.com/questions/11826554/standard-no-op-output-stream
     static class NullBuffer : public std::streambuf {
     public:
@@ -604,7 +624,7 @@ typedef struct {
  * @param[in]  vaddr      virtual address to get entry for
  * @return 0 for success, 1 for failure
  */
-int pagemap_get_entry(PagemapEntry *entry, int pagemap_fd, uintptr_t vaddr)
+inline int pagemap_get_entry(PagemapEntry *entry, int pagemap_fd, uintptr_t vaddr)
 {
     size_t nread;
     ssize_t ret;
@@ -636,7 +656,7 @@ int pagemap_get_entry(PagemapEntry *entry, int pagemap_fd, uintptr_t vaddr)
  * @param[in] vaddr virtual address to get entry for
  * @return 0 for success, 1 for failure
  */
-int virt_to_phys_user(uintptr_t *paddr, pid_t pid, uintptr_t vaddr)
+inline int virt_to_phys_user(uintptr_t *paddr, pid_t pid, uintptr_t vaddr)
 {
     char pagemap_file[BUFSIZ];
     int pagemap_fd;
@@ -0,0 +1,200 @@
+#pragma once
+
+#include "misc.hpp"
+#include "tensor2D.hpp"
+#include "fp16.hpp"
+#include <cmath>
+#include <cstdint>
+
+#ifdef _WIN32
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#include <immintrin.h>
+#endif
+
+// LayerNorm & RMSNorm in AVX-512 (mvn_avx2.hpp is the fp32-only, 3-pass AVX2 version)
+//
+//  - statistics are found in one read of the row, a 2nd pass normalizes & stores
+//  - input is fp32/bf16/fp16, output fp32/bf16/fp16 (plain rows, ready as A of amx_kernel::Matmul)
+//  - optional residual add: x = src + residual, written back to res_out (new residual stream)
+//    before being normalized
+namespace avx512 {
+
+enum class NormType {
+    layer,      // (x - mean) / sqrt(var + eps) * gamma + beta
+    rms,        // x / sqrt(mean(x^2) + eps) * gamma + beta
+};
+
+// per-row statistics, normalized x is (x - mean) * rstd, mean is 0 for RMSNorm
+struct NormStat {
+    float mean;
+    float rstd;
+};
+
+namespace functional {
+
+    inline __mmask16 mask16_n(int n) {
+        return _cvtu32_mask16(n >= 16 ? 0xFFFFu : ((1u << n) - 1));
+    }
+
+    // load/store 16 fp32/bf16/fp16 elements as fp32, masked lanes are zero
+    inline __m512 load_x16(const float * src, __mmask16 k) {
+        return _mm512_maskz_loadu_ps(k, src);
+    }
+    inline __m512 load_x16(const ov::bfloat16 * src, __mmask16 k) {
+        auto x = _mm512_cvtepu16_epi32(_mm256_maskz_loadu_epi16(k, src));
+        return _mm512_castsi512_ps(_mm512_slli_epi32(x, 16));
+    }
+    inline __m512 load_x16(const ov::float16 * src, __mmask16 k) {
+        return _mm512_cvtph_ps(_mm256_maskz_loadu_epi16(k, src));
+    }
+    inline void store_x16(float * dst, __m512 v, __mmask16 k) {
+        _mm512_mask_storeu_ps(dst, k, v);
+    }
+    inline void store_x16(ov::bfloat16 * dst, __m512 v, __mmask16 k) {
+#ifdef __AVX512BF16__
+        auto c = _mm512_cvtneps_pbh(v);
+        _mm256_mask_storeu_epi16(dst, k, reinterpret_cast<__m256i&>(c));
+#else
+        // round to nearest even (NaN is not preserved)
+        auto x = _mm512_castps_si512(v);
+        auto lsb = _mm512_and_si512(_mm512_srli_epi32(x, 16), _mm512_set1_epi32(1));
+        x = _mm512_add_epi32(x, _mm512_add_epi32(lsb, _mm512_set1_epi32(0x7FFF)));
+        _mm256_mask_storeu_epi16(dst, k, _mm512_cvtepi32_epi16(_mm512_srli_epi32(x, 16)));
+#endif
+    }
+    inline void store_x16(ov::float16 * dst, __m512 v, __mmask16 k) {
+        _mm256_mask_storeu_epi16(dst, k, _mm512_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+    }
+
+    // statistics of one row in a single read.
+    // LayerNorm: each lane keeps count/sum/sum-of-squares of (x - s), s being the lane's first
+    // element, so sum-of-squares doesn't lose the variance to cancellation when |mean| >> std;
+    // lanes are merged by Chan's parallel formula at the end
+    template<typename TI>
+    NormStat norm_stat(NormType type, const TI * src, int N, float eps,
+                       const TI * residual = nullptr, TI * res_out = nullptr) {
+        auto load = [&](int n, __mmask16 k) {
+            auto x = load_x16(src + n, k);
+            if (residual) {
+                x = _mm512_add_ps(x, load_x16(residual + n, k));
+                if (res_out) {
+                    // normalize pass reads res_out, so stats are of the rounded values too
+                    store_x16(res_out + n, x, k);
+                    x = load_x16(res_out + n, k);
+                }
+            }
+            return x;
+        };
+        int n = 0;
+        if (type == NormType::rms) {
+            auto s0 = _mm512_setzero_ps();
+            auto s1 = _mm512_setzero_ps();
+            for(; n + 32 <= N; n += 32) {
+                auto x0 = load(n, 0xFFFF);
+                auto x1 = load(n + 16, 0xFFFF);
+                s0 = _mm512_fmadd_ps(x0, x0, s0);
+                s1 = _mm512_fmadd_ps(x1, x1, s1);
+            }
+            for(; n < N; n += 16) {
+                auto x = load(n, mask16_n(N - n));
+                s0 = _mm512_fmadd_ps(x, x, s0);
+            }
+            float ms = _mm512_reduce_add_ps(_mm512_add_ps(s0, s1)) / N;
+            return NormStat{0.0f, 1.0f / std::sqrt(ms + eps)};
+        }
+
+        // the first vector is the shift of each lane, it's read again by the loop to keep it simple.
+        // it's not stored into res_out here, which may alias residual (the loop would add it twice)
+        auto shift = load_x16(src, mask16_n(N));
+        if (residual)
+            shift = _mm512_add_ps(shift, load_x16(residual, mask16_n(N)));
+        auto a0 = _mm512_setzero_ps();      // sum(x - s)
+        auto a1 = _mm512_setzero_ps();
+        auto b0 = _mm512_setzero_ps();      // sum((x - s)^2)
+        auto b1 = _mm512_setzero_ps();
+        for(; n + 32 <= N; n += 32) {
+            auto d0 = _mm512_sub_ps(load(n, 0xFFFF), shift);
+            auto d1 = _mm512_sub_ps(load(n + 16, 0xFFFF), shift);
+            a0 = _mm512_add_ps(a0, d0);
+            a1 = _mm512_add_ps(a1, d1);
+            b0 = _mm512_fmadd_ps(d0, d0, b0);
+            b1 = _mm512_fmadd_ps(d1, d1, b1);
+        }
+        for(; n < N; n += 16) {
+            auto k = mask16_n(N - n);
+            auto d = _mm512_maskz_sub_ps(k, load(n, k), shift);
+            a0 = _mm512_add_ps(a0, d);
+            b0 = _mm512_fmadd_ps(d, d, b0);
+        }
+        a0 = _mm512_add_ps(a0, a1);
+        b0 = _mm512_add_ps(b0, b1);
+
+        // lane l has seen N/16 + (l < N%16) elements, lanes w/o any element (N < 16) are masked out
+        auto valid = mask16_n(N);
+        auto cnt = _mm512_add_ps(_mm512_set1_ps(static_cast<float>(N / 16)),
+                                 _mm512_maskz_mov_ps(mask16_n(N % 16), _mm512_set1_ps(1.0f)));
+        // lane means are merged relative to s_0 (shift of lane 0) for the same reason
+        float s0 = _mm512_cvtss_f32(shift);
+        auto lane_avg = _mm512_maskz_div_ps(valid, a0, cnt);                     // mean_l - s_l
+        auto lane_mean = _mm512_maskz_add_ps(valid, _mm512_sub_ps(shift, _mm512_set1_ps(s0)), lane_avg);   // mean_l - s_0
+        auto lane_m2 = _mm512_maskz_sub_ps(valid, b0, _mm512_mul_ps(a0, lane_avg));
+        float mean = _mm512_reduce_add_ps(_mm512_mul_ps(lane_mean, cnt)) / N;    // mean - s_0
+        auto dm = _mm512_maskz_sub_ps(valid, lane_mean, _mm512_set1_ps(mean));
+        float m2 = _mm512_reduce_add_ps(_mm512_fmadd_ps(_mm512_mul_ps(dm, dm), cnt, lane_m2));
+        float var = std::max(m2 / N, 0.0f);
+        return NormStat{s0 + mean, 1.0f / std::sqrt(var + eps)};
+    }
+
+    // dst = (src (+ residual) - mean) * rstd * gamma + beta, gamma/beta are optional
+    template<typename TI, typename TO>
+    void norm_apply(TO * dst, const TI * src, int N, NormStat st,
+                    const float * gamma = nullptr, const float * beta = nullptr, const TI * residual = nullptr) {
+        auto vmean = _mm512_set1_ps(st.mean);
+        auto vrstd = _mm512_set1_ps(st.rstd);
+        for(int n = 0; n < N; n += 16) {
+            auto k = mask16_n(N - n);
+            auto x = load_x16(src + n, k);
+            if (residual)
+                x = _mm512_add_ps(x, load_x16(residual + n, k));
+            x = _mm512_mul_ps(_mm512_sub_ps(x, vmean), vrstd);
+            if (gamma)
+                x = _mm512_mul_ps(x, _mm512_maskz_loadu_ps(k, gamma + n));
+            if (beta)
+                x = _mm512_add_ps(x, _mm512_maskz_loadu_ps(k, beta + n));
+            store_x16(dst + n, x, k);
+        }
+    }
+
+    // normalize one row: 1 read for statistics + 1 read & 1 write for the result
+    template<typename TI, typename TO>
+    NormStat norm_row(NormType type, TO * dst, const TI * src, int N, float eps,
+                      const float * gamma = nullptr, const float * beta = nullptr,
+                      const TI * residual = nullptr, TI * res_out = nullptr) {
+        auto st = norm_stat(type, src, N, eps, residual, res_out);
+        if (residual && res_out)
+            norm_apply(dst, static_cast<const TI*>(res_out), N, st, gamma, beta);
+        else
+            norm_apply(dst, src, N, st, gamma, beta, residual);
+        return st;
+    }
+}
+
+// normalize each row of src into dst, rows are distributed over OpenMP threads
+//  residual/res_out are optional (same shape as src), res_out may alias residual
+template<typename TI, typename TO>
+void norm(NormType type, tensor_view<TO> dst, tensor_view<TI> src, float eps,
+          const float * gamma = nullptr, const float * beta = nullptr,
+          tensor_view<TI> residual = {}, tensor_view<TI> res_out = {}) {
+    int M = src.dims[0];
+    int N = src.dims[1];
+    #pragma omp parallel for if (int64_t(M) * N * sizeof(TI) >= 64 * 1024)
+    for(int m = 0; m < M; m++) {
+        functional::norm_row(type, &dst(m, 0), &src(m, 0), N, eps, gamma, beta,
+                             residual ? &residual(m, 0) : nullptr,
+                             res_out ? &res_out(m, 0) : nullptr);
+    }
+}
+
+}
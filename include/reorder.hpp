@@ -0,0 +1,408 @@
+#pragma once
+
+// layout conversion (reorder) engine for 8/16/32-bit elements
+//
+// all conversions are built on a single 16x16 dword transpose in AVX-512 registers:
+//  - 32-bit: 16 rows x 16 cols => 16 rows x 16 cols
+//  - 16-bit: 16 rows x 32 cols => dword transpose + de-interleave words => 32 rows x 16 cols
+//  -  8-bit: 16 rows x 64 cols => dword transpose + de-interleave bytes => 64 rows x 16 cols
+//
+// a logical KxN matrix can be stored in one of following layouts:
+//  - plain      : K rows x N cols
+//  - transposed : N rows x K cols
+//  - vnni       : (K/V) rows x (N*V) cols, V=4/sizeof(T) adjacent elements along K are
+//                 packed into a dword, which is what AMX/AVX512-VNNI expects for B matrix
+//                 (K tails are zero-padded)
+//
+// big matrices are processed in cache-blocks of 64 rows x 256 bytes in parallel (OpenMP)
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+namespace reorder {
+
+enum class layout {
+    plain,
+    transposed,
+    vnni
+};
+
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+
+inline void transpose_m512i_16x16(__m512i &r0, __m512i &r1, __m512i &r2, __m512i &r3,
+                                  __m512i &r4, __m512i &r5, __m512i &r6, __m512i &r7,
+                                  __m512i &r8, __m512i &r9, __m512i &ra, __m512i &rb,
+                                  __m512i &rc, __m512i &rd, __m512i &re, __m512i &rf) {
+    __m512i t0, t1, t2, t3, t4, t5, t6, t7, t8, t9, ta, tb, tc, td, te, tf;
+
+    t0 = _mm512_unpacklo_epi32(r0,r1); //   0  16   1  17   4  20   5  21   8  24   9  25  12  28  13  29
+    t1 = _mm512_unpackhi_epi32(r0,r1); //   2  18   3  19   6  22   7  23  10  26  11  27  14  30  15  31
+    t2 = _mm512_unpacklo_epi32(r2,r3); //  32  48  33  49 ...
+    t3 = _mm512_unpackhi_epi32(r2,r3); //  34  50  35  51 ...
+    t4 = _mm512_unpacklo_epi32(r4,r5); //  64  80  65  81 ...
+    t5 = _mm512_unpackhi_epi32(r4,r5); //  66  82  67  83 ...
+    t6 = _mm512_unpacklo_epi32(r6,r7); //  96 112  97 113 ...
+    t7 = _mm512_unpackhi_epi32(r6,r7); //  98 114  99 115 ...
+    t8 = _mm512_unpacklo_epi32(r8,r9); // 128 ...
+    t9 = _mm512_unpackhi_epi32(r8,r9); // 130 ...
+    ta = _mm512_unpacklo_epi32(ra,rb); // 160 ...
+    tb = _mm512_unpackhi_epi32(ra,rb); // 162 ...
+    tc = _mm512_unpacklo_epi32(rc,rd); // 196 ...
+    td = _mm512_unpackhi_epi32(rc,rd); // 198 ...
+    te = _mm512_unpacklo_epi32(re,rf); // 228 ...
+    tf = _mm512_unpackhi_epi32(re,rf); // 230 ...
+
+    r0 = _mm512_unpacklo_epi64(t0,t2); //   0  16  32  48 ...
+    r1 = _mm512_unpackhi_epi64(t0,t2); //   1  17  33  49 ...
+    r2 = _mm512_unpacklo_epi64(t1,t3); //   2  18  34  49 ...
+    r3 = _mm512_unpackhi_epi64(t1,t3); //   3  19  35  51 ...
+    r4 = _mm512_unpacklo_epi64(t4,t6); //  64  80  96 112 ...
+    r5 = _mm512_unpackhi_epi64(t4,t6); //  65  81  97 114 ...
+    r6 = _mm512_unpacklo_epi64(t5,t7); //  66  82  98 113 ...
+    r7 = _mm512_unpackhi_epi64(t5,t7); //  67  83  99 115 ...
+    r8 = _mm512_unpacklo_epi64(t8,ta); // 128 144 160 176 ...
+    r9 = _mm512_unpackhi_epi64(t8,ta); // 129 145 161 178 ...
+    ra = _mm512_unpacklo_epi64(t9,tb); // 130 146 162 177 ...
+    rb = _mm512_unpackhi_epi64(t9,tb); // 131 147 163 179 ...
+    rc = _mm512_unpacklo_epi64(tc,te); // 192 208 228 240 ...
+    rd = _mm512_unpackhi_epi64(tc,te); // 193 209 229 241 ...
+    re = _mm512_unpacklo_epi64(td,tf); // 194 210 230 242 ...
+    rf = _mm512_unpackhi_epi64(td,tf); // 195 211 231 243 ...
+
+    t0 = _mm512_shuffle_i32x4(r0, r4, 0x88); //   0  16  32  48   8  24  40  56  64  80  96  112 ...
+    t1 = _mm512_shuffle_i32x4(r1, r5, 0x88); //   1  17  33  49 ...
+    t2 = _mm512_shuffle_i32x4(r2, r6, 0x88); //   2  18  34  50 ...
+    t3 = _mm512_shuffle_i32x4(r3, r7, 0x88); //   3  19  35  51 ...
+    t4 = _mm512_shuffle_i32x4(r0, r4, 0xdd); //   4  20  36  52 ...
+    t5 = _mm512_shuffle_i32x4(r1, r5, 0xdd); //   5  21  37  53 ...
+    t6 = _mm512_shuffle_i32x4(r2, r6, 0xdd); //   6  22  38  54 ...
+    t7 = _mm512_shuffle_i32x4(r3, r7, 0xdd); //   7  23  39  55 ...
+    t8 = _mm512_shuffle_i32x4(r8, rc, 0x88); // 128 144 160 176 ...
+    t9 = _mm512_shuffle_i32x4(r9, rd, 0x88); // 129 145 161 177 ...
+    ta = _mm512_shuffle_i32x4(ra, re, 0x88); // 130 146 162 178 ...
+    tb = _mm512_shuffle_i32x4(rb, rf, 0x88); // 131 147 163 179 ...
+    tc = _mm512_shuffle_i32x4(r8, rc, 0xdd); // 132 148 164 180 ...
+    td = _mm512_shuffle_i32x4(r9, rd, 0xdd); // 133 149 165 181 ...
+    te = _mm512_shuffle_i32x4(ra, re, 0xdd); // 134 150 166 182 ...
+    tf = _mm512_shuffle_i32x4(rb, rf, 0xdd); // 135 151 167 183 ...
+
+    r0 = _mm512_shuffle_i32x4(t0, t8, 0x88); //   0  16  32  48  64  80  96 112 ... 240
+    r1 = _mm512_shuffle_i32x4(t1, t9, 0x88); //   1  17  33  49  66  81  97 113 ... 241
+    r2 = _mm512_shuffle_i32x4(t2, ta, 0x88); //   2  18  34  50  67  82  98 114 ... 242
+    r3 = _mm512_shuffle_i32x4(t3, tb, 0x88); //   3  19  35  51  68  83  99 115 ... 243
+    r4 = _mm512_shuffle_i32x4(t4, tc, 0x88); //   4 ...
+    r5 = _mm512_shuffle_i32x4(t5, td, 0x88); //   5 ...
+    r6 = _mm512_shuffle_i32x4(t6, te, 0x88); //   6 ...
+    r7 = _mm512_shuffle_i32x4(t7, tf, 0x88); //   7 ...
+    r8 = _mm512_shuffle_i32x4(t0, t8, 0xdd); //   8 ...
+    r9 = _mm512_shuffle_i32x4(t1, t9, 0xdd); //   9 ...
+    ra = _mm512_shuffle_i32x4(t2, ta, 0xdd); //  10 ...
+    rb = _mm512_shuffle_i32x4(t3, tb, 0xdd); //  11 ...
+    rc = _mm512_shuffle_i32x4(t4, tc, 0xdd); //  12 ...
+    rd = _mm512_shuffle_i32x4(t5, td, 0xdd); //  13 ...
+    re = _mm512_shuffle_i32x4(t6, te, 0xdd); //  14 ...
+    rf = _mm512_shuffle_i32x4(t7, tf, 0xdd); //  15  31  47  63  79  96 111 127 ... 255
+}
+
+inline void transpose_m512i_16x16(__m512i (&r)[16]) {
+    transpose_m512i_16x16(r[0], r[1], r[2], r[3], r[4], r[5], r[6], r[7],
+                          r[8], r[9], r[10], r[11], r[12], r[13], r[14], r[15]);
+}
+
+// load 16 rows of 64 bytes, bytes beyond valid_bytes & rows beyond valid_rows are zeros
+inline void load_16x64(__m512i (&r)[16], const void * src, int stride, int valid_rows = 16, int valid_bytes = 64) {
+    auto * pA = reinterpret_cast<const uint8_t*>(src);
+    __mmask64 mask = _cvtu64_mask64(valid_bytes >= 64 ? 0xFFFFFFFFFFFFFFFFull : ((1ull << valid_bytes) - 1));
+    for (int i = 0; i < 16; i++) {
+        r[i] = (i < valid_rows) ? _mm512_maskz_loadu_epi8(mask, pA + i * stride) : _mm512_setzero_si512();
+    }
+}
+
+inline void store_16x64(void * _dst, const __m512i (&r)[16]) {
+    auto * dst = reinterpret_cast<uint32_t*>(_dst);
+    for (int i = 0; i < 16; i++) {
+        _mm512_storeu_epi32(dst + i * 16, r[i]);
+    }
+}
+
+inline void transpose_epi32_16x16(void * _dst, const void * src, int stride) {
+    __m512i r[16];
+    load_16x64(r, src, stride);
+    transpose_m512i_16x16(r);
+    store_16x64(_dst, r);
+}
+
+// 16xN, N<=16, non-valid part is filled with zeros
+inline void transpose_epi32_16xN(void * _dst, const void * src, int stride, int valid_bytes) {
+    __m512i r[16];
+    load_16x64(r, src, stride, 16, valid_bytes);
+    transpose_m512i_16x16(r);
+    store_16x64(_dst, r);
+}
+
+// 16xN, N<=16, non-valid part is on the left, filled with zeros
+inline void transpose_epi32_16xN_right_align(void * _dst, const void * src, int stride, int valid_bytes) {
+    __m512i r[16];
+    int invalid_bytes = 64 - valid_bytes;
+    auto * pA = reinterpret_cast<const uint8_t*>(src) - invalid_bytes;
+    __mmask64 mask = _cvtu64_mask64(0xFFFFFFFFFFFFFFFFull << invalid_bytes);
+    for (int i = 0; i < 16; i++) {
+        r[i] = _mm512_maskz_loadu_epi8(mask, pA + i * stride);
+    }
+    transpose_m512i_16x16(r);
+    store_16x64(_dst, r);
+}
+
+// transpose a block of (rows x cols) elements of size ESZ, rows <= 16 and cols <= 64/ESZ,
+// into dst which has cols rows of (rows) elements.
+//  src_valid_bytes : bytes to load from each src row (default cols*ESZ), rest is zero
+template<int ESZ>
+inline void transpose_block(void * _dst, int dst_stride, const void * src, int src_stride,
+                            int rows, int cols, int src_valid_bytes = -1) {
+    static_assert(ESZ == 1 || ESZ == 2 || ESZ == 4, "transpose_block only supports 8/16/32-bit elements");
+    __m512i r[16];
+    load_16x64(r, src, src_stride, rows, src_valid_bytes < 0 ? cols * ESZ : src_valid_bytes);
+    transpose_m512i_16x16(r);
+
+    // each row of r is now a column of source dwords: (ESZ==4 ? 1 : 4/ESZ) columns interleaved
+    auto * dst = reinterpret_cast<int8_t*>(_dst);
+    __mmask16 kstore = _cvtu32_mask16(0xFFFFu >> (16 - rows));
+    if (ESZ == 4) {
+        for (int j = 0; j < cols; j++) {
+            _mm512_mask_storeu_epi32(dst + j * dst_stride, kstore, r[j]);
+        }
+    }
+    if (ESZ == 2) {
+        // words from even columns to lower 256 bits, odd columns to higher 256 bits
+        const auto widx = _mm512_set_epi16(31, 29, 27, 25, 23, 21, 19, 17, 15, 13, 11, 9, 7, 5, 3, 1,
+                                           30, 28, 26, 24, 22, 20, 18, 16, 14, 12, 10, 8, 6, 4, 2, 0);
+        for (int j = 0; 2 * j < cols; j++) {
+            auto x = _mm512_permutexvar_epi16(widx, r[j]);
+            _mm256_mask_storeu_epi16(dst + (2 * j) * dst_stride, kstore, _mm512_castsi512_si256(x));
+            if (2 * j + 1 < cols)
+                _mm256_mask_storeu_epi16(dst + (2 * j + 1) * dst_stride, kstore, _mm512_extracti64x4_epi64(x, 1));
+        }
+    }
+    if (ESZ == 1) {
+        // gather bytes of same column within each 128-bit lane (4 rows), then
+        // do a 4x4 dword transpose across lanes, so lane t contains column (4j+t) of 16 rows
+        const auto bidx = _mm512_set4_epi32(0x0F0B0703, 0x0E0A0602, 0x0D090501, 0x0C080400);
+        const auto didx = _mm512_set_epi32(15, 11, 7, 3, 14, 10, 6, 2, 13, 9, 5, 1, 12, 8, 4, 0);
+        for (int j = 0; 4 * j < cols; j++) {
+            auto x = _mm512_permutexvar_epi32(didx, _mm512_shuffle_epi8(r[j], bidx));
+            int c = 4 * j;
+            _mm_mask_storeu_epi8(dst + c * dst_stride, kstore, _mm512_extracti32x4_epi32(x, 0));
+            if (c + 1 < cols) _mm_mask_storeu_epi8(dst + (c + 1) * dst_stride, kstore, _mm512_extracti32x4_epi32(x, 1));
+            if (c + 2 < cols) _mm_mask_storeu_epi8(dst + (c + 2) * dst_stride, kstore, _mm512_extracti32x4_epi32(x, 2));
+            if (c + 3 < cols) _mm_mask_storeu_epi8(dst + (c + 3) * dst_stride, kstore, _mm512_extracti32x4_epi32(x, 3));
+        }
+    }
+}
+
+#endif
+
+// single-threaded transpose of a (rows x cols) src into (cols x rows) dst, strides are in bytes
+template<typename T>
+void transpose_2d(T * dst, int dst_stride, const T * src, int src_stride, int rows, int cols,
+                  int row0 = 0, int row1 = -1, int col0 = 0, int col1 = -1) {
+    constexpr int ESZ = sizeof(T);
+    if (row1 < 0) row1 = rows;
+    if (col1 < 0) col1 = cols;
+    auto * pdst = reinterpret_cast<int8_t*>(dst);
+    auto * psrc = reinterpret_cast<const int8_t*>(src);
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+    if (ESZ == 1 || ESZ == 2 || ESZ == 4) {
+        constexpr int bcols = 64 / (ESZ > 4 ? 4 : ESZ);
+        for (int i = row0; i < row1; i += 16) {
+            for (int j = col0; j < col1; j += bcols) {
+                transpose_block<(ESZ > 4 ? 4 : ESZ)>(pdst + j * dst_stride + i * ESZ, dst_stride,
+                                                     psrc + i * src_stride + j * ESZ, src_stride,
+                                                     std::min(16, row1 - i), std::min(bcols, col1 - j));
+            }
+        }
+        return;
+    }
+#endif
+    for (int i = row0; i < row1; i++) {
+        for (int j = col0; j < col1; j++) {
+            *reinterpret_cast<T*>(pdst + j * dst_stride + i * ESZ) = *reinterpret_cast<const T*>(psrc + i * src_stride + j * ESZ);
+        }
+    }
+}
+
+// multi-threaded cache-blocked transpose of a (rows x cols) src into (cols x rows) dst
+template<typename T>
+void transpose(T * dst, int dst_stride, const T * src, int src_stride, int rows, int cols) {
+    // cache block : 64 rows x 256 bytes of src
+    constexpr int MR = 64;
+    constexpr int MC = 256 / sizeof(T);
+    int nmr = (rows + MR - 1) / MR;
+    int nmc = (cols + MC - 1) / MC;
+    #pragma omp parallel for collapse(2) if (int64_t(rows) * cols * sizeof(T) >= 256 * 1024)
+    for (int mr = 0; mr < nmr; mr++) {
+        for (int mc = 0; mc < nmc; mc++) {
+            transpose_2d(dst, dst_stride, src, src_stride, rows, cols,
+                         mr * MR, std::min(rows, (mr + 1) * MR),
+                         mc * MC, std::min(cols, (mc + 1) * MC));
+        }
+    }
+}
+
+// plain KxN => vnni (K/V)x(N*V), K tails are zero-padded
+template<typename T>
+void pack_vnni(T * dst, int dst_stride, const T * src, int src_stride, int K, int N) {
+    constexpr int ESZ = sizeof(T);
+    static_assert(ESZ == 1 || ESZ == 2 || ESZ == 4, "pack_vnni only supports 8/16/32-bit elements");
+    constexpr int V = 4 / ESZ;
+    int KV = (K + V - 1) / V;
+    auto * pdst = reinterpret_cast<int8_t*>(dst);
+    auto * psrc = reinterpret_cast<const int8_t*>(src);
+    #pragma omp parallel for if (int64_t(K) * N * ESZ >= 256 * 1024)
+    for (int kv = 0; kv < KV; kv++) {
+        auto * d = reinterpret_cast<uint32_t*>(pdst + kv * dst_stride);
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+        for (int n = 0; n < N; n += 16) {
+            __mmask16 mask = _cvtu32_mask16(0xFFFFu >> (16 - std::min(16, N - n)));
+            auto r = _mm512_setzero_si512();
+            for (int v = 0; v < V; v++) {
+                int k = kv * V + v;
+                if (k >= K) break;
+                const auto * s = psrc + k * src_stride + n * ESZ;
+                __m512i x;
+                if (ESZ == 4) x = _mm512_maskz_loadu_epi32(mask, s);
+                if (ESZ == 2) x = _mm512_cvtepu16_epi32(_mm256_maskz_loadu_epi16(mask, s));
+                if (ESZ == 1) x = _mm512_cvtepu8_epi32(_mm_maskz_loadu_epi8(mask, s));
+                r = _mm512_or_si512(r, _mm512_sllv_epi32(x, _mm512_set1_epi32(v * ESZ * 8)));
+            }
+            _mm512_mask_storeu_epi32(d + n, mask, r);
+        }
+#else
+        for (int n = 0; n < N; n++) {
+            uint32_t r = 0;
+            for (int v = 0; v < V && kv * V + v < K; v++) {
+                uint32_t x = 0;
+                memcpy(&x, psrc + (kv * V + v) * src_stride + n * ESZ, ESZ);
+                r |= x << (v * ESZ * 8);
+            }
+            d[n] = r;
+        }
+#endif
+    }
+}
+
+// vnni (K/V)x(N*V) => plain KxN
+template<typename T>
+void unpack_vnni(T * dst, int dst_stride, const T * src, int src_stride, int K, int N) {
+    constexpr int ESZ = sizeof(T);
+    static_assert(ESZ == 1 || ESZ == 2 || ESZ == 4, "unpack_vnni only supports 8/16/32-bit elements");
+    constexpr int V = 4 / ESZ;
+    int KV = (K + V - 1) / V;
+    auto * pdst = reinterpret_cast<int8_t*>(dst);
+    auto * psrc = reinterpret_cast<const int8_t*>(src);
+    #pragma omp parallel for if (int64_t(K) * N * ESZ >= 256 * 1024)
+    for (int kv = 0; kv < KV; kv++) {
+        auto * s = reinterpret_cast<const uint32_t*>(psrc + kv * src_stride);
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+        for (int n = 0; n < N; n += 16) {
+            __mmask16 mask = _cvtu32_mask16(0xFFFFu >> (16 - std::min(16, N - n)));
+            auto r = _mm512_maskz_loadu_epi32(mask, s + n);
+            for (int v = 0; v < V; v++) {
+                int k = kv * V + v;
+                if (k >= K) break;
+                auto * d = pdst + k * dst_stride + n * ESZ;
+                auto x = _mm512_srlv_epi32(r, _mm512_set1_epi32(v * ESZ * 8));
+                if (ESZ == 4) _mm512_mask_storeu_epi32(d, mask, x);
+                if (ESZ == 2) _mm256_mask_storeu_epi16(d, mask, _mm512_cvtepi32_epi16(x));
+                if (ESZ == 1) _mm_mask_storeu_epi8(d, mask, _mm512_cvtepi32_epi8(x));
+            }
+        }
+#else
+        for (int n = 0; n < N; n++) {
+            for (int v = 0; v < V && kv * V + v < K; v++) {
+                uint32_t x = s[n] >> (v * ESZ * 8);
+                memcpy(pdst + (kv * V + v) * dst_stride + n * ESZ, &x, ESZ);
+            }
+        }
+#endif
+    }
+}
+
+// transposed NxK => vnni (K/V)x(N*V): it's a dword transpose, K tails are zero-padded
+template<typename T>
+void transposed_to_vnni(T * dst, int dst_stride, const T * src, int src_stride, int K, int N) {
+    constexpr int ESZ = sizeof(T);
+    constexpr int V = 4 / ESZ;
+    int KV = (K + V - 1) / V;
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+    auto * pdst = reinterpret_cast<int8_t*>(dst);
+    auto * psrc = reinterpret_cast<const int8_t*>(src);
+    int nkb = (KV + 15) / 16;
+    int nnb = (N + 15) / 16;
+    #pragma omp parallel for collapse(2) if (int64_t(K) * N * ESZ >= 256 * 1024)
+    for (int n = 0; n < nnb; n++) {
+        for (int kb = 0; kb < nkb; kb++) {
+            int kv0 = kb * 16;
+            int kvalid = std::min(16, KV - kv0);
+            int valid_bytes = std::min(64, (K - kv0 * V) * ESZ);
+            transpose_block<4>(pdst + kv0 * dst_stride + n * 16 * 4, dst_stride,
+                               psrc + n * 16 * src_stride + kv0 * 4, src_stride,
+                               std::min(16, N - n * 16), kvalid, valid_bytes);
+        }
+    }
+#else
+    // K tails need zero padding, go through plain layout is simpler
+    for (int kv = 0; kv < KV; kv++) {
+        auto * d = reinterpret_cast<uint32_t*>(reinterpret_cast<int8_t*>(dst) + kv * dst_stride);
+        for (int n = 0; n < N; n++) {
+            uint32_t r = 0;
+            for (int v = 0; v < V && kv * V + v < K; v++) {
+                uint32_t x = 0;
+                memcpy(&x, reinterpret_cast<const int8_t*>(src) + n * src_stride + (kv * V + v) * ESZ, ESZ);
+                r |= x << (v * ESZ * 8);
+            }
+            d[n] = r;
+        }
+    }
+#endif
+}
+
+// generic conversion of a logical KxN matrix between layouts, strides are in bytes
+//
+// note: vnni => transposed writes rndup(K, V) elements in each row of dst
+template<typename T>
+void convert(T * dst, int dst_stride, layout dst_layout,
+             const T * src, int src_stride, layout src_layout,
+             int K, int N) {
+    constexpr int ESZ = sizeof(T);
+    constexpr int V = 4 / ESZ;
+    if (dst_layout == src_layout) {
+        int rows = (src_layout == layout::plain) ? K : ((src_layout == layout::transposed) ? N : (K + V - 1) / V);
+        int bytes = (src_layout == layout::plain) ? N * ESZ : ((src_layout == layout::transposed) ? K * ESZ : N * 4);
+        #pragma omp parallel for if (int64_t(rows) * bytes >= 256 * 1024)
+        for (int i = 0; i < rows; i++)
+            memcpy(reinterpret_cast<int8_t*>(dst) + i * dst_stride, reinterpret_cast<const int8_t*>(src) + i * src_stride, bytes);
+        return;
+    }
+    if (src_layout == layout::plain && dst_layout == layout::transposed)
+        return transpose(dst, dst_stride, src, src_stride, K, N);
+    if (src_layout == layout::transposed && dst_layout == layout::plain)
+        return transpose(dst, dst_stride, src, src_stride, N, K);
+    if (src_layout == layout::plain && dst_layout == layout::vnni)
+        return pack_vnni(dst, dst_stride, src, src_stride, K, N);
+    if (src_layout == layout::vnni && dst_layout == layout::plain)
+        return unpack_vnni(dst, dst_stride, src, src_stride, K, N);
+    if (src_layout == layout::transposed && dst_layout == layout::vnni)
+        return transposed_to_vnni(dst, dst_stride, src, src_stride, K, N);
+    if (src_layout == layout::vnni && dst_layout == layout::transposed)
+        return transpose(reinterpret_cast<uint32_t*>(dst), dst_stride,
+                         reinterpret_cast<const uint32_t*>(src), src_stride, (K + V - 1) / V, N);
+}
+
+} // namespace reorder
@@ -0,0 +1,246 @@
+#pragma once
+
+// zero-copy loader of safetensors files (https://github.com/huggingface/safetensors)
+//
+//   [8 bytes]  N : header size, little-endian uint64
+//   [N bytes]  JSON header : {"name":{"dtype":"BF16","shape":[K,N],"data_offsets":[b,e]}, "__metadata__":{...}}
+//   [...]      tensor data, data_offsets are relative to the end of header
+//
+// the file is mmapped (read-only, private), tensors are exposed as non-owning tensor2D
+// over the mapping, so nothing is read from disk until kernels touch the data, and
+// the mapping is kept alive as long as any tensor returned is alive.
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <map>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include "tensor2D.hpp"
+
+template<typename T>
+struct safetensors_dtype {};
+template<>
+struct safetensors_dtype<float> { static constexpr const char * name = "F32"; };
+template<>
+struct safetensors_dtype<ov::bfloat16> { static constexpr const char * name = "BF16"; };
+template<>
+struct safetensors_dtype<int8_t> { static constexpr const char * name = "I8"; };
+template<>
+struct safetensors_dtype<uint8_t> { static constexpr const char * name = "U8"; };
+
+struct safetensors {
+    struct entry {
+        std::string dtype;
+        std::vector<int64_t> shape;
+        size_t offset = 0;  // relative to data section
+        size_t size = 0;
+    };
+
+    std::string path;
+    std::shared_ptr<uint8_t> mapping;
+    size_t length = 0;
+    const uint8_t * payload = nullptr;
+    std::map<std::string, entry> entries;
+    std::map<std::string, std::string> metadata;
+
+    safetensors(const std::string & _path) : path(_path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("safetensors: cannot open " + path);
+        struct stat st;
+        if (fstat(fd, &st) < 0 || st.st_size < 8) {
+            close(fd);
+            throw std::runtime_error("safetensors: invalid file " + path);
+        }
+        length = st.st_size;
+        void * p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED)
+            throw std::runtime_error("safetensors: mmap failed " + path);
+        auto len = length;
+        mapping = std::shared_ptr<uint8_t>(reinterpret_cast<uint8_t*>(p), [len](uint8_t * p) { munmap(p, len); });
+
+        uint64_t header_size = 0;
+        memcpy(&header_size, mapping.get(), 8);
+        if (header_size > length - 8)
+            throw std::runtime_error("safetensors: header size overflow " + path);
+        payload = mapping.get() + 8 + header_size;
+
+        json_parser parser(reinterpret_cast<const char*>(mapping.get()) + 8, header_size);
+        parse_header(parser);
+
+        size_t data_size = length - 8 - header_size;
+        for(auto & e : entries) {
+            if (e.second.offset + e.second.size > data_size)
+                throw std::runtime_error("safetensors: data_offsets out of range for " + e.first);
+        }
+    }
+
+    bool has(const std::string & name) const {
+        return entries.count(name) > 0;
+    }
+
+    std::vector<std::string> keys() const {
+        std::vector<std::string> ret;
+        for(auto & e : entries)
+            ret.push_back(e.first);
+        return ret;
+    }
+
+    const entry & info(const std::string & name) const {
+        auto it = entries.find(name);
+        if (it == entries.end())
+            throw std::runtime_error("safetensors: tensor not found " + name);
+        return it->second;
+    }
+
+    // non-owning 2D view over the mapping, higher rank tensors are flattened
+    // into [prod(shape[:-1]), shape[-1]], 1D tensors into [1, shape[0]]
+    template<typename T>
+    tensor2D<T> get(const std::string & name) const {
+        auto & e = info(name);
+        if (e.dtype != safetensors_dtype<T>::name)
+            throw std::runtime_error("safetensors: " + name + " has dtype " + e.dtype + ", expecting " + safetensors_dtype<T>::name);
+        int64_t d0 = 1;
+        int64_t d1 = e.shape.empty() ? 1 : e.shape.back();
+        for(size_t i = 0; i + 1 < e.shape.size(); i++)
+            d0 *= e.shape[i];
+        if (d0 * d1 * static_cast<int64_t>(sizeof(T)) != static_cast<int64_t>(e.size))
+            throw std::runtime_error("safetensors: shape & data_offsets mismatch for " + name);
+        auto * ptr = reinterpret_cast<T*>(const_cast<uint8_t*>(payload + e.offset));
+        tensor2D<T> ret(d0, d1, ptr, d1 * sizeof(T));
+        // aliasing constructor: shares ownership of the mapping
+        ret.data = std::shared_ptr<T>(mapping, ptr);
+        return ret;
+    }
+
+private:
+    // minimal JSON parser, enough for safetensors header
+    struct json_parser {
+        const char * p;
+        const char * end;
+
+        json_parser(const char * s, size_t n) : p(s), end(s + n) {}
+
+        void error(const char * what) {
+            throw std::runtime_error(std::string("safetensors: bad header, ") + what);
+        }
+        void skip_ws() {
+            while(p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+                p++;
+        }
+        bool peek(char c) {
+            skip_ws();
+            return p < end && *p == c;
+        }
+        void expect(char c) {
+            if (!peek(c))
+                error("unexpected character");
+            p++;
+        }
+        std::string string() {
+            expect('"');
+            std::string ret;
+            while(p < end && *p != '"') {
+                if (*p == '\\') {
+                    if (++p >= end) break;
+                    switch(*p) {
+                        case 'n': ret += '\n'; break;
+                        case 't': ret += '\t'; break;
+                        case 'r': ret += '\r'; break;
+                        case 'b': ret += '\b'; break;
+                        case 'f': ret += '\f'; break;
+                        case 'u': {
+                            // only code points in BMP are supported
+                            if (end - p < 5) error("bad escape");
+                            unsigned cp = std::stoul(std::string(p + 1, 4), nullptr, 16);
+                            if (cp < 0x80) {
+                                ret += static_cast<char>(cp);
+                            } else if (cp < 0x800) {
+                                ret += static_cast<char>(0xC0 | (cp >> 6));
+                                ret += static_cast<char>(0x80 | (cp & 0x3F));
+                            } else {
+                                ret += static_cast<char>(0xE0 | (cp >> 12));
+                                ret += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                                ret += static_cast<char>(0x80 | (cp & 0x3F));
+                            }
+                            p += 4;
+                            break;
+                        }
+                        default: ret += *p; break;
+                    }
+                    p++;
+                } else {
+                    ret += *p++;
+                }
+            }
+            expect('"');
+            return ret;
+        }
+        int64_t integer() {
+            skip_ws();
+            const char * s = p;
+            if (p < end && *p == '-') p++;
+            while(p < end && *p >= '0' && *p <= '9') p++;
+            if (s == p) error("expecting integer");
+            return std::stoll(std::string(s, p));
+        }
+        std::vector<int64_t> int_array() {
+            std::vector<int64_t> ret;
+            expect('[');
+            if (!peek(']')) {
+                do {
+                    ret.push_back(integer());
+                } while(peek(',') && (p++, true));
+            }
+            expect(']');
+            return ret;
+        }
+        // iterate key/value pairs of an object, value must be consumed by f
+        template<class F>
+        void object(F f) {
+            expect('{');
+            if (!peek('}')) {
+                do {
+                    auto key = string();
+                    expect(':');
+                    f(key);
+                } while(peek(',') && (p++, true));
+            }
+            expect('}');
+        }
+    };
+
+    void parse_header(json_parser & parser) {
+        parser.object([&](const std::string & name) {
+            if (name == "__metadata__") {
+                parser.object([&](const std::string & key) {
+                    metadata[key] = parser.string();
+                });
+                return;
+            }
+            entry e;
+            std::vector<int64_t> offsets;
+            parser.object([&](const std::string & key) {
+                if (key == "dtype")
+                    e.dtype = parser.string();
+                else if (key == "shape")
+                    e.shape = parser.int_array();
+                else if (key == "data_offsets")
+                    offsets = parser.int_array();
+                else
+                    parser.error("unknown tensor field");
+            });
+            if (offsets.size() != 2 || offsets[0] < 0 || offsets[1] < offsets[0])
+                parser.error("bad data_offsets");
+            e.offset = offsets[0];
+            e.size = offsets[1] - offsets[0];
+            entries[name] = e;
+        });
+    }
+};
@@ -4,9 +4,11 @@
 #include <cstring>
 #include <iostream>
 #include <functional>
+#include <type_traits>
 
 #include "bf16.hpp"
 #include "misc.hpp"
+#include "reorder.hpp"
 
 #ifdef ENABLE_NUMA
 #include "numa.h"
@@ -26,6 +28,44 @@ static inline bool isnan2(float a)     { return load_ieee754_rep(a) << 1  > inf_
 static inline bool isinf2(float a)     { return load_ieee754_rep(a) << 1 == inf_float_shl1; }
 static inline bool isfinite2(float a)  { return load_ieee754_rep(a) << 1  < inf_float_shl1; }
 
+// non-owning view of a 2D tensor: raw pointer + dims + stride (in bytes).
+// it's trivially copyable, so creating per-thread/per-head sub-views and
+// passing them by value into kernels costs nothing (no control-block
+// allocation & no atomic refcount as tensor2D's shared_ptr does)
+template<typename T>
+struct tensor_view {
+    int dims[2] = {0};
+    T * data = nullptr;
+    int stride = 0;
+    int padded_dim1 = 0;
+
+    tensor_view() = default;
+
+    tensor_view(int d0, int d1, T * ext, int _stride) : data(ext), stride(_stride) {
+        dims[0] = d0;
+        dims[1] = d1;
+        padded_dim1 = stride / sizeof(T);
+    }
+
+    operator bool() const {
+        return dims[0] * dims[1] > 0;
+    }
+
+    T & operator[](int i) const {
+        return data[i];
+    }
+
+    T & operator()(int i0, int i1) const {
+        return data[i0 * padded_dim1 + i1];
+    }
+
+    // sub-view of rows [i0, i1) and columns [j0, j1)
+    tensor_view<T> Slice(int i0, int i1, int j0, int j1) const {
+        return tensor_view<T>(i1 - i0, j1 - j0, &(*this)(i0, j0), stride);
+    }
+};
+static_assert(std::is_trivially_copyable<tensor_view<float>>::value, "tensor_view must be trivially copyable");
+
 template<typename T>
 struct tensor2D {
     int dims[2] = {0};
@@ -56,26 +96,37 @@ struct tensor2D {
         padded_dim1 = stride / sizeof(T);
     }
 
+    // owning tensor can be passed to any kernel accepting tensor_view
+    operator tensor_view<T>() const {
+        return tensor_view<T>(dims[0], dims[1], data.get(), stride);
+    }
+
+    tensor_view<T> view() const {
+        return *this;
+    }
+
     tensor2D<T> Tr() {
-        tensor2D<T> ret(dims[1], dims[0]);
-        for(int c0=0; c0 < dims[0]; ++c0) {
-            for(int c1=0; c1 < dims[1]; ++c1) {
-                ret(c1, c0) = (*this)(c0, c1);
-            }
-        }
+        tensor2D<T> ret;
+        ret.resize(dims[1], dims[0]);
+        reorder::transpose(&ret[0], ret.stride, &(*this)[0], stride, dims[0], dims[1]);
+        ret.zero_padding(dims[0]);
         return ret;
     }
     tensor2D<T> Tr_Align_Dim0() {
         int aligned_dim0 = (dims[0] + 15) / 16 * 16;
-        tensor2D<T> ret(dims[1], aligned_dim0);
-        for(int c0=0; c0 < dims[0]; ++c0) {
-            for(int c1=0; c1 < dims[1]; ++c1) {
-                ret(c1, c0) = (*this)(c0, c1);
-            }
-        }
+        tensor2D<T> ret;
+        ret.resize(dims[1], aligned_dim0);
+        reorder::transpose(&ret[0], ret.stride, &(*this)[0], stride, dims[0], dims[1]);
+        ret.zero_padding(dims[0]);
         ret.dims[0] = dims[0];
         return ret;
     }
+    // zero columns [d1, padded_dim1) of each row
+    void zero_padding(int d1) {
+        if (d1 >= padded_dim1) return;
+        for(int i = 0; i < dims[0]; i++)
+            memset(&(*this)(i, d1), 0, (padded_dim1 - d1) * sizeof(T));
+    }
     tensor2D<T> clone() const {
         tensor2D<T> ret;
         ret.resize(dims[0], dims[1], force_compact);
@@ -289,16 +340,18 @@ struct tensor2D {
         return true;
     }
 
+    // free functions of misc.hpp, which may be in a namespace (see linear/linear_isa.hpp)
     void clflush() {
-        ::clflush(data.get(), capacity);
+        void clflush(void* pv, int bytes);  // hidden by this member otherwise
+        clflush(data.get(), capacity);
     };
 
     void sw_prefetch() {
-        ::sw_prefetch_L2(data.get(), capacity);
+        sw_prefetch_L2(data.get(), capacity);
     };
 
     void load_prefetch() {
-        ::load_prefetch_L2(data.get(), capacity);
+        load_prefetch_L2(data.get(), capacity);
     };
 
     bool compare(const tensor2D<T> & rhs, float tolerance) {
@@ -339,6 +392,119 @@ struct tensor2D {
     }
 };
 
+// tile-blocked view of a 2D matrix: split into blocks of 16 rows x 64 bytes (exactly
+// one AMX A/C tile), which are stored contiguously in row-block major order, so tiles
+// can be loaded densely with stride 64 and consecutive k-steps are sequential in memory.
+//
+// dims[0] is padded to multiple of 16 with zero rows; when dims[1] is not multiple of bK,
+// the tail is put right-aligned into last column of blocks with zero-padded left part,
+// which is the same convention of K-tails used by Matmul & repackB_1x2.
+template<typename T>
+struct tensor_blocked {
+    enum { bM = 16, bK = 64 / sizeof(T) };
+    int dims[2] = {0};
+    int blocks[2] = {0};    // number of blocks along each dimension
+    T * data = nullptr;
+
+    tensor_blocked() = default;
+
+    tensor_blocked(int d0, int d1, T * ext) : data(ext) {
+        dims[0] = d0;
+        dims[1] = d1;
+        blocks[0] = (d0 + bM - 1) / bM;
+        blocks[1] = (d1 + bK - 1) / bK;
+    }
+
+    operator bool() const {
+        return dims[0] * dims[1] > 0;
+    }
+
+    // 1KB tile at block (mb, kb)
+    T * tile(int mb, int kb) const {
+        return data + (static_cast<size_t>(mb) * blocks[1] + kb) * (bM * bK);
+    }
+
+    // block column & offset inside block of column k
+    void locate(int k, int & kb, int & pos) const {
+        int Ktails = dims[1] % bK;
+        int Kbody = dims[1] - Ktails;
+        if (k < Kbody) {
+            kb = k / bK;
+            pos = k % bK;
+        } else {
+            kb = blocks[1] - 1;
+            pos = k - Kbody + (bK - Ktails);
+        }
+    }
+
+    T & operator()(int m, int k) const {
+        int kb, pos;
+        locate(k, kb, pos);
+        return tile(m / bM, kb)[(m % bM) * bK + pos];
+    }
+};
+static_assert(std::is_trivially_copyable<tensor_blocked<float>>::value, "tensor_blocked must be trivially copyable");
+
+// owning tile-blocked tensor, can be passed to any kernel accepting tensor_blocked
+template<typename T>
+struct tensor2D_blocked : public tensor_blocked<T> {
+    using tensor_blocked<T>::dims;
+    using tensor_blocked<T>::blocks;
+    using tensor_blocked<T>::data;
+    using tensor_blocked<T>::bM;
+    using tensor_blocked<T>::bK;
+    std::shared_ptr<T> buff;
+    size_t capacity = 0;
+
+    tensor2D_blocked() = default;
+
+    tensor2D_blocked(int d0, int d1) {
+        resize(d0, d1);
+    }
+
+    // padding is always zero after resize
+    void resize(int d0, int d1) {
+        static_cast<tensor_blocked<T>&>(*this) = tensor_blocked<T>(d0, d1, data);
+        size_t need_capacity = static_cast<size_t>(blocks[0]) * blocks[1] * bM * 64;
+        if (capacity < need_capacity) {
+            capacity = need_capacity;
+            buff = std::shared_ptr<T>(reinterpret_cast<T*>(aligned_alloc(64, capacity)), [](void * p) { ::free(p); });
+        }
+        data = buff.get();
+        memset(data, 0, need_capacity);
+    }
+
+    void from_plain(tensor_view<T> src) {
+        resize(src.dims[0], src.dims[1]);
+        int Ktails = dims[1] % bK;
+        int Kbody = dims[1] - Ktails;
+        for(int m = 0; m < dims[0]; m++) {
+            auto * dst = tile(m / bM, 0) + (m % bM) * bK;
+            for(int k = 0; k < Kbody; k += bK, dst += bM * bK)
+                memcpy(dst, &src(m, k), 64);
+            if (Ktails)
+                memcpy(dst + bK - Ktails, &src(m, Kbody), Ktails * sizeof(T));
+        }
+    }
+
+    tensor2D<T> to_plain() const {
+        tensor2D<T> ret;
+        ret.resize(dims[0], dims[1]);
+        int Ktails = dims[1] % bK;
+        int Kbody = dims[1] - Ktails;
+        for(int m = 0; m < dims[0]; m++) {
+            auto * src = tile(m / bM, 0) + (m % bM) * bK;
+            for(int k = 0; k < Kbody; k += bK, src += bM * bK)
+                memcpy(&ret(m, k), src, 64);
+            if (Ktails)
+                memcpy(&ret(m, Kbody), src + bK - Ktails, Ktails * sizeof(T));
+        }
+        return ret;
+    }
+
+    using tensor_blocked<T>::tile;
+};
+
 using func_act = std::function<float(float)>;
 
 template<typename TC>
@@ -381,7 +547,7 @@ void matmul(tensor2D<ov::bfloat16> & A,
     }
 }
 
-void matmul(tensor2D<float> & A,
+inline void matmul(tensor2D<float> & A,
             tensor2D<float> & B,
             tensor2D<float> & C,
             float * bias = nullptr,
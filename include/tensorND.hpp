@@ -45,6 +45,120 @@ struct slice {
 struct fullslice {
 
 };
+
+// non-owning, trivially copyable view of N-dimensional strided data
+// (strides are in bytes). Slicing an owning tensorND gives this view,
+// so per-head/per-thread sub-tensors can be freely created & passed
+// by value into kernels.
+template<typename T, int RMAX = 8>
+struct tensorND_view {
+    T* data = nullptr;
+    int ndim = 0;
+    int shape[RMAX];
+    int64_t strides[RMAX];
+
+    tensorND_view() = default;
+
+    tensorND_view(T* _data, int _ndim, const int* _shape, const int64_t* _strides) : data(_data), ndim(_ndim) {
+        assert(_ndim <= RMAX);
+        std::copy(_shape, _shape + _ndim, shape);
+        std::copy(_strides, _strides + _ndim, strides);
+    }
+
+    T& operator[](size_t idx) const {
+        return data[idx];
+    }
+
+    T& at_byte_offset(size_t offset) const {
+        return *reinterpret_cast<T*>(reinterpret_cast<int8_t*>(data) + offset);
+    }
+
+    template<typename ... IDX>
+    T& operator()(IDX ... idxs) const {
+        assert(sizeof...(IDX) == ndim);
+        return at_byte_offset(get_element_offset<0>(idxs...));
+    }
+
+    template < typename ... IDX>
+    tensorND_view<T, RMAX> Slice(IDX ... idxs) const {
+        tensorND_view<T, RMAX> ret;
+        assert(sizeof...(idxs) == ndim);
+        ret.data = data;
+        ret.ndim = 0;
+        get_subview<0, 0>(ret, idxs...);
+        return ret;
+    }
+
+    friend std::ostream& operator<<(std::ostream& os, const tensorND_view<T, RMAX>& t) {
+        os << "tensor" << t.ndim << "D_view<" << typeid(T).name() << ">_shape=(" << t.shape[0];
+        for (int i = 1; i < t.ndim; i++) os << "," << t.shape[i];
+        os << ")_strides=(" << t.strides[0];
+        for (int i = 1; i < t.ndim; i++) os << "," << t.strides[i];
+        os << ")_address=" << t.data << std::endl;
+        return os;
+    }
+
+private:
+    template<int N>
+    int64_t get_element_offset() const {
+        return 0;
+    }
+
+    template<int N, typename I0, typename ... IDX>
+    int64_t get_element_offset(I0 i0, IDX ... idxs) const {
+        return i0 * strides[N] + get_element_offset<N + 1>(idxs...);
+    }
+
+    // I0 is range
+    template<int isrc, int idst, typename TV, typename ... IDX>
+    void get_subview(TV& t, slice i0, IDX ... idxs) const {
+        // i0 is range, so it will occupy idst'th output shape & strides
+        t.data = reinterpret_cast<T*>(reinterpret_cast<int8_t*>(t.data) + i0.i0 * strides[isrc]);
+        t.shape[idst] = std::min(shape[isrc], i0.i1) - i0.i0;
+        t.strides[idst] = strides[isrc];
+        t.ndim++;
+        get_subview<isrc + 1, idst + 1>(t, idxs...);
+    }
+
+    template<int isrc, int idst, typename TV, typename ... IDX>
+    void get_subview(TV& t, fullslice i0, IDX ... idxs) const {
+        t.shape[idst] = shape[isrc];
+        t.strides[idst] = strides[isrc];
+        t.ndim++;
+        get_subview<isrc + 1, idst + 1>(t, idxs...);
+    }
+
+    template<int isrc, int idst, typename TV>
+    void get_subview(TV& t, slice i0) const {
+        t.data = reinterpret_cast<T*>(reinterpret_cast<int8_t*>(t.data) + i0.i0 * strides[isrc]);
+        t.shape[idst] = std::min(shape[isrc], i0.i1) - i0.i0;
+        t.strides[idst] = strides[isrc];
+        t.ndim++;
+    }
+
+    template<int isrc, int idst, typename TV>
+    void get_subview(TV& t, fullslice i0) const {
+        t.shape[idst] = shape[isrc];
+        t.strides[idst] = strides[isrc];
+        t.ndim++;
+    }
+
+    // I0 is not range
+    template<int isrc, int idst, typename TV, typename ... IDX>
+    void get_subview(TV& t, int i0, IDX ... idxs) const {
+        // i0 is int, so it will change ptr
+        t.data = reinterpret_cast<T*>(reinterpret_cast<int8_t*>(t.data) + i0 * strides[isrc]);
+        get_subview<isrc + 1, idst>(t, idxs...);
+    }
+
+    template<int isrc, int idst, typename TV>
+    void get_subview(TV& t, int i0) const {
+        // i0 is int, so it will change ptr
+        t.data = reinterpret_cast<T*>(reinterpret_cast<int8_t*>(t.data) + i0 * strides[isrc]);
+    }
+};
+static_assert(std::is_trivially_copyable<tensorND_view<float>>::value, "tensorND_view must be trivially copyable");
+
 template<typename T, int RMAX = 8>
 struct tensorND {
     constexpr static size_t cache_line_size = 64;
@@ -266,20 +380,20 @@ struct tensorND {
         return at_byte_offset(get_element_offset<0>(idxs...));
     }
 
+    // owning tensor can be passed to any kernel accepting tensorND_view
+    operator tensorND_view<T, RMAX>() const {
+        return tensorND_view<T, RMAX>(data, ndim, shape, strides);
+    }
+
+    // Slice do not own the data, so it returns a view
     template < typename ... IDX>
-    tensorND<T> Slice(IDX ... idxs) {
-        tensorND<T> ret;
-        assert(sizeof...(idxs) == ndim);
-        ret.data = data;
-        ret.ndim = 0;
-        ret.capacity = 0; // Slice do not own the data
-        get_subview<0, 0>(ret, idxs...);
-        return ret;
+    tensorND_view<T, RMAX> Slice(IDX ... idxs) const {
+        return tensorND_view<T, RMAX>(*this).Slice(idxs...);
     }
 
-    // overloaded Slice to create a clone without take ownership of the data
-    tensorND<T> Slice() {
-        return tensorND<T>(data, shape, shape + ndim, strides, strides + ndim);
+    // overloaded Slice to create a view of the whole tensor
+    tensorND_view<T, RMAX> Slice() const {
+        return *this;
     }
 
     std::string toString() {
@@ -352,54 +466,6 @@ private:
         return i0 * strides[N] + get_element_offset<N + 1>(idxs...);
     }
 
-    // I0 is range
-    template<int isrc, int idst, typename TV, typename ... IDX>
-    void get_subview(TV& t, slice i0, IDX ... idxs) const {
-        // i0 is range, so it will occupy idst'th output shape & strides
-        t.data = reinterpret_cast<T*>(reinterpret_cast<int8_t*>(t.data) + i0.i0 * strides[isrc]);
-        t.shape[idst] = std::min(shape[isrc], i0.i1) - i0.i0;
-        t.strides[idst] = strides[isrc];
-        t.ndim++;
-        get_subview<isrc + 1, idst + 1>(t, idxs...);
-    }
-
-    template<int isrc, int idst, typename TV, typename ... IDX>
-    void get_subview(TV& t, fullslice i0, IDX ... idxs) const {
-        t.shape[idst] = shape[isrc];
-        t.strides[idst] = strides[isrc];
-        t.ndim++;
-        get_subview<isrc + 1, idst + 1>(t, idxs...);
-    }
-
-    template<int isrc, int idst, typename TV>
-    void get_subview(TV& t, slice i0) const {
-        t.data = reinterpret_cast<T*>(reinterpret_cast<int8_t*>(t.data) + i0.i0 * strides[isrc]);
-        t.shape[idst] = std::min(shape[isrc], i0.i1) - i0.i0;
-        t.strides[idst] = strides[isrc];
-        t.ndim++;
-    }
-
-    template<int isrc, int idst, typename TV>
-    void get_subview(TV& t, fullslice i0) const {
-        t.shape[idst] = shape[isrc];
-        t.strides[idst] = strides[isrc];
-        t.ndim++;
-    }
-
-    // I0 is not range
-    template<int isrc, int idst, typename TV, typename ... IDX>
-    void get_subview(TV& t, int i0, IDX ... idxs) const {
-        // i0 is int, so it will change ptr
-        t.data = reinterpret_cast<T*>(reinterpret_cast<int8_t*>(t.data) + i0 * strides[isrc]);
-        get_subview<isrc + 1, idst>(t, idxs...);
-    }
-
-    template<int isrc, int idst, typename TV>
-    void get_subview(TV& t, int i0) const {
-        // i0 is int, so it will change ptr
-        t.data = reinterpret_cast<T*>(reinterpret_cast<int8_t*>(t.data) + i0 * strides[isrc]);
-    }
-
 #ifdef EXPORT_TENSORND_TO_PYBIND11
 public:
     static inline void bind2py(pybind11::handle m)
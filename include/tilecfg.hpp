@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+// thread-local record of the tile configuration loaded by tileconfig_t/TileConfigScope, so that
+// back-to-back kernels of the same tile shapes (heads, experts, GEMVs...) pay neither ldtilecfg nor
+// tilerelease per call: loading the same 64 bytes again is skipped, and tilerelease is deferred
+// until the thread goes idle (flush()/flush_omp(), or thread exit)
+//  - a skipped load keeps the tile data (ldtilecfg would zero it), kernels must zero their
+//    accumulators as all kernels here do (_tile_zero/zero_tiles)
+//  - anything loading configurations by other means (TileConfiger directly) must invalidate()
+//  - TILECFG_CACHE=0 loads & releases on every scope, as before
+//  - one record per thread for the whole program : translation units compiling the kernels inside
+//    a namespace of their own ISA (linear/linear_<isa>.cpp) include this header at global scope
+struct tilecfg_cache {
+    struct counters_t {
+        uint64_t loads = 0;             // ldtilecfg executed
+        uint64_t loads_avoided = 0;     // same config as loaded
+        uint64_t releases = 0;          // tilerelease executed
+        uint64_t releases_deferred = 0; // scope ends leaving the config loaded
+        counters_t & operator+=(const counters_t & rhs) {
+            loads += rhs.loads;
+            loads_avoided += rhs.loads_avoided;
+            releases += rhs.releases;
+            releases_deferred += rhs.releases_deferred;
+            return *this;
+        }
+        friend std::ostream& operator<<(std::ostream& out, const counters_t& c) {
+            out << "tilecfg loads=" << c.loads << " avoided=" << c.loads_avoided << " releases=" << c.releases
+                << " deferred=" << c.releases_deferred;
+            return out;
+        }
+    };
+
+    uint8_t cfg[64];
+    bool loaded = false;
+    counters_t counters;
+
+    static bool & enabled() {
+        static bool _enabled = std::getenv("TILECFG_CACHE") ? atoi(std::getenv("TILECFG_CACHE")) != 0 : true;
+        return _enabled;
+    }
+
+    static tilecfg_cache & get() {
+        static thread_local tilecfg_cache cache;
+        return cache;
+    }
+
+    ~tilecfg_cache() { flush(); }
+
+    void load(const void * p) {
+        if (enabled() && loaded && memcmp(cfg, p, sizeof(cfg)) == 0) {
+            counters.loads_avoided++;
+            return;
+        }
+        _tile_loadconfig(p);
+        memcpy(cfg, p, sizeof(cfg));
+        loaded = true;
+        counters.loads++;
+    }
+
+    void release() {
+        if (enabled()) {
+            counters.releases_deferred++;
+            return;
+        }
+        _tile_release();
+        loaded = false;
+        counters.releases++;
+    }
+
+    // the thread is going idle: give tile state back to the OS
+    void flush() {
+        if (!loaded)
+            return;
+        _tile_release();
+        loaded = false;
+        counters.releases++;
+    }
+
+    void invalidate() { loaded = false; }
+
+    // over the threads of an OpenMP team (those running the kernels here)
+    static void flush_omp() {
+#pragma omp parallel
+        get().flush();
+    }
+
+    static counters_t sum_omp() {
+        counters_t total;
+#pragma omp parallel
+        {
+            auto c = get().counters;
+#pragma omp critical
+            total += c;
+        }
+        return total;
+    }
+};
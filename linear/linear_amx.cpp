@@ -0,0 +1,63 @@
+// AMX kernels of linear::Linear, the only translation unit compiled with AMX flags:
+//
+//   g++ -O2 -std=c++14 -mavx512f -mavx512bw -mavx512vl -mavx512dq -mavx512bf16 -mamx-tile -mamx-bf16 -mamx-int8 -I./include -c linear/linear_amx.cpp -o linear_amx.o
+//
+#if !defined(__AMX_TILE__) || !defined(__AMX_BF16__) || !defined(__AVX512BF16__)
+#error "linear_amx.cpp must be compiled with -mamx-tile -mamx-bf16 -mavx512bf16 (and AVX-512 flags)"
+#endif
+
+#include "linear_isa.hpp"
+
+// kernel headers are compiled into a namespace of this ISA, see linear_isa.hpp
+namespace isa_amx {
+#include "misc.hpp"
+#include "kernels_amx.hpp"
+}
+
+namespace linear {
+
+namespace {
+
+using namespace isa_amx;
+
+template<amx_kernel::PP::Steps steps>
+struct LinearAMX : public Linear {
+    amx_kernel::Matmul<ov::bfloat16, ov::bfloat16> mm;
+    tensor2D<ov::bfloat16> w;       // K x N, or N x K if transposeW
+    std::vector<float> bias;        // zero if not given, padded to multiple of 32 (read in 32 columns)
+
+    LinearAMX(const Config & cfg) : Linear(cfg), mm(true, cfg.transposeW), bias(rndup(cfg.N, 32), 0.0f) {
+        int rows = cfg.transposeW ? cfg.N : cfg.K;
+        int cols = cfg.transposeW ? cfg.K : cfg.N;
+        int ldw = cfg.weight_stride();
+        w.resize(rows, cols);
+        for(int r = 0; r < rows; r++)
+            for(int c = 0; c < cols; c += 32)
+                amx_kernel::functional::cvt_bf16_x32(&w(r, c), cfg.weight + static_cast<int64_t>(r) * ldw + c, std::min(32, cols - c));
+        if (cfg.bias)
+            std::copy(cfg.bias, cfg.bias + cfg.N, bias.begin());
+    }
+
+    // x is converted to bf16 inside Matmul, one L2-sized band of rows at a time
+    void operator()(const float * x, int M, int ldx, float * y, int ldy) override {
+        amx_kernel::PP::BiasGeluStore<float, steps> pp(tensor_view<float>(M, cfg.N, y, ldy * sizeof(float)), bias.data());
+        mm(tensor_view<float>(M, cfg.K, const_cast<float*>(x), ldx * sizeof(float)), w, 0, cfg.N, pp);
+    }
+
+    ISA isa() const override {
+        return ISA::amx;
+    }
+};
+
+}
+
+std::unique_ptr<Linear> create_amx(const Config & cfg) {
+    using namespace amx_kernel::PP;
+    switch(cfg.act) {
+        case Act::relu: return std::unique_ptr<Linear>(new LinearAMX<BIAS_RELU>(cfg));
+        case Act::gelu: return std::unique_ptr<Linear>(new LinearAMX<BIAS_GELU>(cfg));
+        default: return std::unique_ptr<Linear>(new LinearAMX<BIAS>(cfg));
+    }
+}
+
+}
@@ -0,0 +1,66 @@
+// AVX2 kernels of linear::Linear, the only translation unit compiled with AVX2 flags:
+//
+//   g++ -O2 -std=c++14 -mavx2 -mfma -mf16c -I./include -c linear/linear_avx2.cpp -o linear_avx2.o
+//
+#if !defined(__AVX2__) || !defined(__FMA__)
+#error "linear_avx2.cpp must be compiled with -mavx2 -mfma"
+#endif
+
+#include "linear_isa.hpp"
+
+// kernel headers are compiled into a namespace of this ISA, see linear_isa.hpp
+namespace isa_avx2 {
+#include "misc.hpp"
+#include "kernels_avx2.hpp"
+}
+
+namespace linear {
+
+namespace {
+
+using namespace isa_avx2;
+
+tensorND_view<float> view2D(const float * p, int rows, int cols, int ld) {
+    int shape[2] = {rows, cols};
+    int64_t strides[2] = {static_cast<int64_t>(ld * sizeof(float)), static_cast<int64_t>(sizeof(float))};
+    return tensorND_view<float>(const_cast<float *>(p), 2, shape, strides);
+}
+
+template<avx2::PP::Act act>
+struct LinearAVX2 : public Linear {
+    avx2::Matmul mm;
+    std::vector<float> bias;     // zero if not given, padded at front (tail columns of N < 8 are shifted left)
+    enum { bias_pad = 16 };
+
+    LinearAVX2(const Config & cfg) : Linear(cfg), mm(true, cfg.transposeW), bias(bias_pad + cfg.N, 0.0f) {
+        if (cfg.bias)
+            std::copy(cfg.bias, cfg.bias + cfg.N, bias.begin() + bias_pad);
+        // repack weights now, so they are not referenced after creation
+        auto w = cfg.transposeW ? view2D(cfg.weight, cfg.N, cfg.K, cfg.weight_stride())
+                                : view2D(cfg.weight, cfg.K, cfg.N, cfg.weight_stride());
+        mm.reorderB(w, 0, cfg.N);
+    }
+
+    void operator()(const float * x, int M, int ldx, float * y, int ldy) override {
+        avx2::PP::AddbiasAct<act> pp(bias.data() + bias_pad);
+        // weights are already in internalB, B view only carries the shape
+        auto w = cfg.transposeW ? view2D(nullptr, cfg.N, cfg.K, cfg.K) : view2D(nullptr, cfg.K, cfg.N, cfg.N);
+        mm(view2D(x, M, cfg.K, ldx), w, view2D(y, M, cfg.N, ldy), 0, cfg.N, pp);
+    }
+
+    ISA isa() const override {
+        return ISA::avx2;
+    }
+};
+
+}
+
+std::unique_ptr<Linear> create_avx2(const Config & cfg) {
+    switch(cfg.act) {
+        case Act::relu: return std::unique_ptr<Linear>(new LinearAVX2<avx2::PP::Act_RELU>(cfg));
+        case Act::gelu: return std::unique_ptr<Linear>(new LinearAVX2<avx2::PP::Act_GELU>(cfg));
+        default: return std::unique_ptr<Linear>(new LinearAVX2<avx2::PP::Act_NONE>(cfg));
+    }
+}
+
+}
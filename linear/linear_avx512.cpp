@@ -0,0 +1,69 @@
+// AVX-512 kernels of linear::Linear, the only translation unit compiled with AVX-512 flags:
+//
+//   g++ -O2 -std=c++14 -mavx512f -mavx512bw -mavx512vl -mavx512dq -mfma -I./include -c linear/linear_avx512.cpp -o linear_avx512.o
+//
+#if !defined(__AVX512F__) || !defined(__AVX512BW__) || !defined(__AVX512VL__) || !defined(__AVX512DQ__)
+#error "linear_avx512.cpp must be compiled with -mavx512f -mavx512bw -mavx512vl -mavx512dq"
+#endif
+
+#include "linear_isa.hpp"
+
+// kernel headers are compiled into a namespace of this ISA, see linear_isa.hpp
+namespace isa_avx512 {
+#include "misc.hpp"
+#include "kernels_avx512.hpp"
+}
+
+namespace linear {
+
+namespace {
+
+using namespace isa_avx512;
+
+template<avx512::PP::Act act>
+struct LinearAVX512 : public Linear {
+    avx512::Matmul mm;
+    // W is repacked into panels of 64 columns, each is K x 64 & dense, so the 4x16 columns
+    // loaded per k by the kernel are in one cache line pair instead of a strided row of W
+    enum { panel_n = 64 };
+    tensor2D<float> w;      // [N/64 * K, 64]
+    std::vector<float> bias;
+
+    LinearAVX512(const Config & cfg) : Linear(cfg), w((cfg.N + panel_n - 1) / panel_n * cfg.K, panel_n, true) {
+        int ldw = cfg.weight_stride();
+        w = 0;
+        for(int n = 0; n < cfg.N; n++)
+            for(int k = 0; k < cfg.K; k++)
+                w(n / panel_n * cfg.K + k, n % panel_n) = cfg.transposeW ? cfg.weight[n * ldw + k] : cfg.weight[k * ldw + n];
+        if (cfg.bias)
+            bias.assign(cfg.bias, cfg.bias + cfg.N);
+    }
+
+    void operator()(const float * x, int M, int ldx, float * y, int ldy) override {
+        tensor_view<float> A(M, cfg.K, const_cast<float *>(x), ldx * sizeof(float));
+        for(int n0 = 0; n0 < cfg.N; n0 += panel_n) {
+            int valid_n = std::min(static_cast<int>(panel_n), cfg.N - n0);
+            avx512::PP::AddbiasAct<act> pp(bias.empty() ? nullptr : bias.data() + n0);
+            mm(A,
+               tensor_view<float>(cfg.K, valid_n, &w(n0 / panel_n * cfg.K, 0), w.stride),
+               tensor_view<float>(M, valid_n, y + n0, ldy * sizeof(float)),
+               pp);
+        }
+    }
+
+    ISA isa() const override {
+        return ISA::avx512;
+    }
+};
+
+}
+
+std::unique_ptr<Linear> create_avx512(const Config & cfg) {
+    switch(cfg.act) {
+        case Act::relu: return std::unique_ptr<Linear>(new LinearAVX512<avx512::PP::Act_RELU>(cfg));
+        case Act::gelu: return std::unique_ptr<Linear>(new LinearAVX512<avx512::PP::Act_GELU>(cfg));
+        default: return std::unique_ptr<Linear>(new LinearAVX512<avx512::PP::Act_NONE>(cfg));
+    }
+}
+
+}
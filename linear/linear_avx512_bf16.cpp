@@ -0,0 +1,72 @@
+// AVX512_BF16 kernels of linear::Linear (CPUs with AVX512_BF16 but w/o AMX, e.g. Cooperlake),
+// the only translation unit compiled with -mavx512bf16 and w/o AMX flags:
+//
+//   g++ -O2 -std=c++14 -mavx512f -mavx512bw -mavx512vl -mavx512dq -mavx512bf16 -mavx512vnni -mfma -I./include -c linear/linear_avx512_bf16.cpp -o linear_avx512_bf16.o
+//
+#if !defined(__AVX512F__) || !defined(__AVX512BW__) || !defined(__AVX512VL__) || !defined(__AVX512DQ__) || !defined(__AVX512BF16__)
+#error "linear_avx512_bf16.cpp must be compiled with -mavx512bf16 (and AVX-512 flags)"
+#endif
+#if defined(__AMX_TILE__)
+#error "linear_avx512_bf16.cpp must be compiled w/o AMX flags, its kernels are for CPUs w/o AMX"
+#endif
+
+#include "linear_isa.hpp"
+
+// kernel headers are compiled into a namespace of this ISA, see linear_isa.hpp
+namespace isa_avx512_bf16 {
+#include "misc.hpp"
+#include "kernels_avx512_vnni.hpp"
+}
+
+namespace linear {
+
+namespace {
+
+using namespace isa_avx512_bf16;
+
+// same bf16 weights & post-ops as LinearAMX, computed by vdpbf16ps instead of tiles
+template<amx_kernel::PP::Steps steps>
+struct LinearAVX512BF16 : public Linear {
+    avx512_vnni::Matmul<ov::bfloat16, ov::bfloat16> mm;
+    tensor2D<ov::bfloat16> w;       // K x N, or N x K if transposeW
+    tensor2D<ov::bfloat16> xb;      // bf16 copy of x
+    std::vector<float> bias;        // zero if not given, padded to multiple of 32 (read in 32 columns)
+
+    LinearAVX512BF16(const Config & cfg) : Linear(cfg), mm(true, cfg.transposeW), bias(rndup(cfg.N, 32), 0.0f) {
+        int rows = cfg.transposeW ? cfg.N : cfg.K;
+        int cols = cfg.transposeW ? cfg.K : cfg.N;
+        int ldw = cfg.weight_stride();
+        w.resize(rows, cols);
+        for(int r = 0; r < rows; r++)
+            for(int c = 0; c < cols; c += 32)
+                amx_kernel::functional::cvt_bf16_x32(&w(r, c), cfg.weight + static_cast<int64_t>(r) * ldw + c, std::min(32, cols - c));
+        if (cfg.bias)
+            std::copy(cfg.bias, cfg.bias + cfg.N, bias.begin());
+    }
+
+    void operator()(const float * x, int M, int ldx, float * y, int ldy) override {
+        xb.resize(M, cfg.K);
+        for(int m = 0; m < M; m++)
+            for(int k = 0; k < cfg.K; k += 32)
+                amx_kernel::functional::cvt_bf16_x32(&xb(m, k), x + static_cast<int64_t>(m) * ldx + k, std::min(32, cfg.K - k));
+        amx_kernel::PP::BiasGeluStore<float, steps> pp(tensor_view<float>(M, cfg.N, y, ldy * sizeof(float)), bias.data());
+        mm(xb, w, 0, cfg.N, pp);
+    }
+
+    ISA isa() const override {
+        return ISA::avx512_bf16;
+    }
+};
+
+}
+
+std::unique_ptr<Linear> create_avx512_bf16(const Config & cfg) {
+    using namespace amx_kernel::PP;
+    switch(cfg.act) {
+        case Act::relu: return std::unique_ptr<Linear>(new LinearAVX512BF16<BIAS_RELU>(cfg));
+        case Act::gelu: return std::unique_ptr<Linear>(new LinearAVX512BF16<BIAS_GELU>(cfg));
+        default: return std::unique_ptr<Linear>(new LinearAVX512BF16<BIAS>(cfg));
+    }
+}
+
+}
@@ -0,0 +1,77 @@
+// included first by each linear/linear_<isa>.cpp, which then includes the kernel headers inside a
+// namespace of its own ISA (isa_avx2, isa_avx512, isa_avx512_bf16, isa_amx):
+//
+//   #include "linear_isa.hpp"
+//   namespace isa_avx512 {
+//   #include "kernels_avx512.hpp"
+//   }
+//
+// so every inline function & template instantiation it emits from them (tensor2D<float>::resize,
+// get_nthr(), avx512::Matmul::kernel<>...) carries the ISA in its mangled name. the linker then
+// never picks a copy built with -mavx512*/-mamx* for callers of another ISA or baseline code,
+// whatever the link order.
+//
+// headers which must not go into that namespace are included here at global scope, their include
+// guards keep them out of it afterwards:
+//   - standard & system headers
+//   - bf16.hpp     : specializes std::numeric_limits (the scalar ov::bfloat16 is shared)
+//   - fp16.hpp     : the scalar ov::float16, same as bf16.hpp
+//   - tilecfg.hpp  : the record of loaded tile configuration is per thread, not per ISA
+//   - linear.hpp   : the interface itself, which compiles no kernel code
+//
+// instantiations of the standard library stay shared between translation units, the kernels only
+// use trivial ones (shared_ptr & vector destructors, iostream) which compile to the same code.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <initializer_list>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <typeinfo>
+#include <vector>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+#ifdef _WIN32
+#include <intrin.h>
+#else
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <immintrin.h>
+#include <x86intrin.h>
+#endif
+
+#ifdef ENABLE_NUMA
+#include <numa.h>
+#endif
+
+#include "bf16.hpp"
+#include "fp16.hpp"
+#include "tilecfg.hpp"
+#include "linear.hpp"
@@ -194,6 +194,7 @@ int amx_jit(const int M, const int N, const int K, int times = -1000) {
         TileConfiger tile_config;
         auto ptr_conf = mm_jit.tile_config();
         tile_config(&ptr_conf);
+        tilecfg_cache::get().invalidate();
     }
     // the memory layout would be changed to KN2n16k16n2k
     for (int k = 0,i = 0; k < K; k += 32) {
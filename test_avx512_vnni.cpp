@@ -0,0 +1,184 @@
+// avx512_vnni::Matmul (AVX-512 fallback of amx_kernel::Matmul) vs. reference & AMX
+//
+//   g++ -O2 -march=native -std=c++14 -fopenmp -I./include test_avx512_vnni.cpp -o test_avx512_vnni
+//
+// bf16 path w/o AVX512_BF16 (Icelake) can be tested on newer CPUs by adding -mno-avx512bf16
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <iostream>
+#include <cmath>
+
+#include "kernels_avx512_vnni.hpp"
+#include "cpu_features.hpp"
+#include "tensor2D.hpp"
+#include "timeit.hpp"
+
+timeit timer(
+    {
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "HW_CYCLES"},
+    }
+);
+
+using ov::bfloat16;
+
+template<typename T>
+void fill_rand(tensor2D<T> & t) {
+    for(int i = 0; i < t.dims[0]; i++)
+        for(int j = 0; j < t.dims[1]; j++) {
+            if (std::is_same<T, bfloat16>::value)
+                t(i, j) = (rand() % 200 - 100) / 64.0f;
+            else
+                t(i, j) = static_cast<T>(rand() % 256 + (std::is_signed<T>::value ? -128 : 0));
+        }
+}
+
+// copy raw accumulators out of buffC
+template<typename TC>
+struct CopyStore {
+    tensor2D<TC> & C;
+    CopyStore(tensor2D<TC> & C) : C(C) {}
+    void operator()(tensor2D<TC> & buffC, int m, int n, int valid_m, int valid_n) {
+        for(int i = 0; i < valid_m; i++)
+            for(int j = 0; j < valid_n; j++)
+                C(m + i, n + j) = buffC(i, j);
+    }
+};
+
+template<typename TA, typename TB>
+void test_matmul(int M, int K, int N, bool transposeB, bool blockedA = false, int times = 0) {
+    using TC = amx_kernel::acc_type_t<TA>;
+    tensor2D<TA> A(M, K);
+    tensor2D<TB> B(transposeB ? N : K, transposeB ? K : N);
+    tensor2D<TC> C(M, N), C_amx(M, N);
+    fill_rand(A);
+    fill_rand(B);
+
+    avx512_vnni::Matmul<TA, TB> mm(true, transposeB);
+    tensor2D_blocked<TA> Ab;
+    if (blockedA) {
+        Ab.from_plain(A);
+        mm(Ab, B, 0, N, CopyStore<TC>(C));
+    } else {
+        mm(A, B, 0, N, CopyStore<TC>(C));
+    }
+
+    double maxdiff = 0;
+    for(int m = 0; m < M; m++) {
+        for(int n = 0; n < N; n++) {
+            double sum = 0;
+            for(int k = 0; k < K; k++)
+                sum += double(A(m, k)) * double(transposeB ? B(n, k) : B(k, n));
+            maxdiff = std::max(maxdiff, std::abs(sum - double(C(m, n))));
+        }
+    }
+    // bf16 inputs are exact in fp32, only accumulation order differs
+    bool ok = maxdiff < (std::is_same<TC, float>::value ? 1e-2 : 0.5);
+
+    std::cout << __func__ << "<" << TypeName<TA>::get() << "," << TypeName<TB>::get() << ">(" << M << "," << K << "," << N
+              << ",transposeB=" << transposeB << ",blockedA=" << blockedA << ")  "
+              << ANSIcolor(ok ? "1;32" : "1;31") << (ok ? "Match!" : "Mismatch!") << ANSIcolor()
+              << " maxdiff:" << maxdiff;
+
+    // same packed B & ppkernel on AMX
+#ifdef __AMX_TILE__
+    if (isa_supported(ISA::amx) && K >= mm.kStep) {
+        amx_kernel::Matmul<TA, TB> mm_amx(true, transposeB);
+        auto packedB = amx_kernel::repackB_1x2(B.view(), transposeB);
+        mm_amx.compute(A.view(), packedB.view(), N, 0, CopyStore<TC>(C_amx));
+        double d = 0;
+        for(int m = 0; m < M; m++)
+            for(int n = 0; n < N; n++)
+                d = std::max(d, std::abs(double(C(m, n)) - double(C_amx(m, n))));
+        bool same = d <= (std::is_same<TC, float>::value ? 1e-3 : 0);
+        std::cout << "  vs. AMX " << ANSIcolor(same ? "1;32" : "1;31") << (same ? "Match!" : "Mismatch!") << ANSIcolor();
+    }
+#endif
+    std::cout << std::endl;
+
+    if (times != 0) {
+        tensor2D<float> Cf(M, N);
+        amx_kernel::PP::BiasGeluStore<float, amx_kernel::PP::NONE> pp(Cf);
+        timer.tag(__func__, TypeName<TA>::get(), M, K, N)(times, [&](){
+            mm(A, B, 0, N, pp);
+        }, 2.0 * M * N * K);
+    }
+}
+
+// B shared by "threads" working on different N slices, repacked lazily
+void test_lazyB(int M, int K, int N, int n_split) {
+    tensor2D<bfloat16> A(M, K);
+    tensor2D<bfloat16> B(K, N);
+    tensor2D<float> C(M, N), C0(M, N);
+    fill_rand(A);
+    fill_rand(B);
+
+    amx_kernel::LazyRepackedB<bfloat16> lazyB(B, false);
+    avx512_vnni::Matmul<bfloat16, bfloat16> mm0, mm1;
+    mm0(A, lazyB, 0, n_split, CopyStore<float>(C));
+    mm1(A, lazyB, n_split, N, CopyStore<float>(C));
+
+    C0 = 0;
+    matmul(A, B, C0);
+    bool ok = C.compare(C0, 1e-2f);
+    std::cout << __func__ << "(" << M << "," << K << "," << N << "," << n_split << ")  "
+              << ANSIcolor(ok ? "1;32" : "1;31") << (ok ? "Match!" : "Mismatch!") << ANSIcolor() << std::endl;
+}
+
+// epilogues of amx_kernel::PP run unchanged
+void test_pp(int M, int K, int N) {
+    tensor2D<bfloat16> A(M, K);
+    tensor2D<bfloat16> B(K, N);
+    tensor2D<float> C(M, N), C0(M, N);
+    tensor2D<float> Bias(1, N);
+    fill_rand(A);
+    fill_rand(B);
+
+    avx512_vnni::Matmul<bfloat16, bfloat16> mm(true, false);
+    amx_kernel::PP::BiasGeluStore<float, amx_kernel::PP::BIAS_RELU> pp(C, &Bias(0,0));
+    mm(A, B, 0, N, pp);
+
+    C0 = 0;
+    matmul(A, B, C0, &Bias(0,0), [](float x) { return std::max(x, 0.0f); });
+    bool ok = C.compare(C0, 1e-2f);
+    std::cout << __func__ << "(" << M << "," << K << "," << N << ")  "
+              << ANSIcolor(ok ? "1;32" : "1;31") << (ok ? "Match!" : "Mismatch!") << ANSIcolor() << std::endl;
+}
+
+int main(int argc, const char *argv[]) {
+    timer.set_app(argv[0]);
+    auto & f = CpuFeatures::get();
+    std::cout << "avx512_vnni:" << f.avx512_vnni << " avx512_bf16:" << f.avx512_bf16 << " amx:" << isa_supported(ISA::amx)
+#ifdef __AVX512BF16__
+              << "  bf16 path: vdpbf16ps"
+#else
+              << "  bf16 path: fp32 FMA"
+#endif
+              << std::endl;
+
+    for(auto transposeB : {false, true}) {
+        for(auto shape : std::vector<std::vector<int>>{{1, 64, 32}, {7, 100, 45}, {33, 256, 130}, {100, 96, 200},
+                                                       {16, 160, 16}, {40, 31, 20}, {17, 1000, 64}}) {
+            int M = shape[0], K = shape[1], N = shape[2];
+            test_matmul<bfloat16, bfloat16>(M, K, N, transposeB);
+            test_matmul<int8_t, int8_t>(M, K, N, transposeB);
+            test_matmul<uint8_t, int8_t>(M, K, N, transposeB);
+            test_matmul<int8_t, uint8_t>(M, K, N, transposeB);
+            test_matmul<uint8_t, uint8_t>(M, K, N, transposeB);
+        }
+    }
+    for(auto M : {1, 20, 45}) {
+        test_matmul<bfloat16, bfloat16>(M, 80, 100, false, true);
+        test_matmul<int8_t, int8_t>(M, 160, 100, false, true);
+    }
+    test_lazyB(37, 200, 150, 64);
+    test_pp(45, 80, 70);
+
+    test_matmul<bfloat16, bfloat16>(1, 4096, 1024, false, false, -1000);
+    test_matmul<int8_t, int8_t>(1, 4096, 1024, false, false, -1000);
+    test_matmul<bfloat16, bfloat16>(256, 1024, 1024, false, false, -1000);
+    test_matmul<int8_t, int8_t>(256, 1024, 1024, false, false, -1000);
+    return 0;
+}
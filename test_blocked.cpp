@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <iostream>
+#include <cassert>
+#include <cstring>
+
+#include "kernels_amx.hpp"
+#include "tensor2D.hpp"
+#include "timeit.hpp"
+
+#include <omp.h>
+
+timeit timer(
+    {
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "HW_CYCLES"},
+    }
+);
+
+static bool initAMX = initXTILE();
+
+using ov::bfloat16;
+using namespace amx_kernel;
+
+// two chained linear layers: C2 = (A*B1)*B2
+// plain   : C1 is stored row-major & re-read as strided A
+// blocked : A & C1 are in tile-blocked layout, all A tiles are dense loads
+template<typename TA, PP::Steps steps1, PP::Steps steps2>
+void test_chain(int M, int K, int N1, int N2, int times = -1000) {
+    tensor2D<TA> A(M, K);
+    tensor2D<TA> B1(K, N1);
+    tensor2D<TA> B2(N1, N2);
+    tensor2D<TA> C1(M, N1);
+    tensor2D<float> C2(M, N2);
+    tensor2D<float> C2b(M, N2);
+    tensor2D_blocked<TA> Ab;
+    tensor2D_blocked<TA> C1b(M, N1);
+    Ab.from_plain(A);
+
+    Matmul<TA, TA> mm1(true, false), mm2(true, false);
+    Matmul<TA, TA> mm1b(true, false), mm2b(true, false);
+    PP::BiasGeluStore<TA, steps1> pp1(C1);
+    PP::BiasGeluStore<float, steps2> pp2(C2);
+    PP::BiasGeluStore<TA, steps1> pp1b(C1b);
+    PP::BiasGeluStore<float, steps2> pp2b(C2b);
+    if (steps1 & PP::QUANT) {
+        // int8 chain: C1 = quant(dequant(A*B1))
+        pp1.set_deq_scale(0.5f); pp1.set_q_scale(0.25f);
+        pp1b.set_deq_scale(0.5f); pp1b.set_q_scale(0.25f);
+    }
+
+    std::cout << __func__ << "<" << TypeName<TA>::get() << ">(" << M << "," << K << "," << N1 << "," << N2 << ")  ";
+    mm1(A, B1, 0, N1, pp1);
+    mm2(C1, B2, 0, N2, pp2);
+    mm1b(Ab, B1, 0, N1, pp1b);
+    mm2b(C1b, B2, 0, N2, pp2b);
+
+    auto C1p = C1b.to_plain();
+    bool ok1 = true;
+    for(int m = 0; m < M; m++)
+        if (memcmp(&C1(m, 0), &C1p(m, 0), N1 * sizeof(TA))) ok1 = false;
+    bool ok2 = true;
+    for(int m = 0; m < M; m++)
+        if (memcmp(&C2(m, 0), &C2b(m, 0), N2 * sizeof(float))) ok2 = false;
+    if (ok1 && ok2) {
+        std::cout << ANSIcolor("1;32") << "Match!" << ANSIcolor() << std::endl;
+    } else {
+        std::cout << ANSIcolor("1;31") << "Mismatch! C1:" << ok1 << " C2:" << ok2 << ANSIcolor() << std::endl;
+    }
+
+    if (times == 0) return;
+    double flops = 2.0 * M * (double(K) * N1 + double(N1) * N2);
+    timer.tag(__func__, M, K, N1, N2, TypeName<TA>::get(), "plain")(times, [&](){
+        mm1(A, B1, 0, N1, pp1);
+        mm2(C1, B2, 0, N2, pp2);
+    }, flops);
+    timer.tag(__func__, M, K, N1, N2, TypeName<TA>::get(), "blocked")(times, [&](){
+        mm1b(Ab, B1, 0, N1, pp1b);
+        mm2b(C1b, B2, 0, N2, pp2b);
+    }, flops);
+}
+
+int main(int argc, const char *argv[]) {
+    timer.set_app(argv[0]);
+    std::cout << ANSIcolor("31") << "omp_get_max_threads() = " << omp_get_max_threads() << std::endl << ANSIcolor();
+
+    for (auto M : {1, 16, 17, 45, 100}) {
+        test_chain<bfloat16, PP::Steps::NONE, PP::Steps::NONE>(M, 80, 100, 70, 0);
+        test_chain<int8_t, PP::Steps(PP::DEQUANT | PP::QUANT), PP::Steps::NONE>(M, 160, 200, 70, 0);
+    }
+
+    test_chain<bfloat16, PP::Steps::NONE, PP::Steps::NONE>(256, 256, 256, 256);
+    test_chain<bfloat16, PP::Steps::NONE, PP::Steps::NONE>(256, 2560, 256, 2560);
+    return 0;
+}
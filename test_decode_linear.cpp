@@ -0,0 +1,141 @@
+// amx_kernel::DecodeLinear: bf16/int8 weights split over threads, with bias/activation epilogues
+//
+//   g++ -O2 -march=native -std=c++14 -fopenmp -I./include test_decode_linear.cpp -o test_decode_linear
+//   OMP_PROC_BIND=close ./test_decode_linear          (USE_NUMA=1 for numa_alloc_local in ENABLE_NUMA builds)
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <iostream>
+#include <cmath>
+
+#include "decode_linear.hpp"
+#include "tensor2D.hpp"
+#include "timeit.hpp"
+
+#include <omp.h>
+
+timeit timer(
+    {
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "HW_CYCLES"},
+    }
+);
+
+static bool initAMX = initXTILE();
+
+using ov::bfloat16;
+using namespace amx_kernel;
+
+tensor2D<bfloat16> rand_W(int rows, int cols) {
+    tensor2D<bfloat16> W(rows, cols);
+    for(int i = 0; i < rows; i++)
+        for(int j = 0; j < cols; j++)
+            W(i, j) = (rand() % 2000 - 1000) / 1000.0f * (1 + j % 5);
+    return W;
+}
+
+// bf16 result must be bitwise same as Matmul<bf16,bf16> with the same PP,
+// int8 within rounding of the reference using dequantized weights
+template<typename WType, PP::Steps steps>
+void test_decode_linear(int M, int K, int N, bool transposeW) {
+    auto W = rand_W(transposeW ? N : K, transposeW ? K : N);
+    tensor2D<bfloat16> A(M, K);
+    tensor2D<float> C(M, N), C0(M, N), bias(1, rndup(N, 32));
+    for(int m = 0; m < M; m++)
+        for(int k = 0; k < K; k++)
+            A(m, k) = (rand() % 200 - 100) / 100.0f;
+    for(int n = 0; n < N; n++)
+        bias(0, n) = (rand() % 200 - 100) / 10.0f;
+
+    DecodeLinear<WType> fc(W.view(), transposeW);
+    PP::BiasGeluStore<float, steps> pp(C, &bias(0, 0));
+    fc(A.view(), pp);
+
+    bool ok;
+    if (std::is_same<WType, bfloat16>::value) {
+        Matmul<bfloat16, bfloat16> mm(true, transposeW);
+        PP::BiasGeluStore<float, steps> pp0(C0, &bias(0, 0));
+        mm(A, W, 0, N, pp0);
+        ok = C == C0;
+    } else {
+        // per-column symmetric int8 reference
+        auto w = [&](int k, int n) { return float(transposeW ? W(n, k) : W(k, n)); };
+        for(int n = 0; n < N; n++) {
+            float amax = 0;
+            for(int k = 0; k < K; k++)
+                amax = std::max(amax, std::abs(w(k, n)));
+            float scale = amax > 0 ? amax / 127 : 1.0f;
+            for(int m = 0; m < M; m++) {
+                float sum = 0;
+                for(int k = 0; k < K; k++)
+                    sum += float(A(m, k)) * std::nearbyint(w(k, n) / scale);
+                float v = sum * scale;
+                if (steps & PP::BIAS)
+                    v += bias(0, n);
+                if (steps & PP::GELU)
+                    v = 0.5f * v * (1.0f + std::erf(v / std::sqrt(2.0f)));
+                if (steps & PP::RELU)
+                    v = std::max(v, 0.0f);
+                C0(m, n) = v;
+            }
+        }
+        ok = C.compare(C0, 1e-3f);
+    }
+    std::cout << __func__ << "<" << TypeName<WType>::get() << "," << steps << ">(" << M << "," << K << "," << N
+              << ",transposeW=" << transposeW << ")  " << ANSIcolor(ok ? "1;32" : "1;31") << (ok ? "Match!" : "Mismatch!")
+              << ANSIcolor() << std::endl;
+}
+
+// weight bandwidth vs. one Matmul per thread over its N-panels (the fc16m_test_mt1 setup)
+void perf_decode_linear(int M, int K, int N) {
+    auto W = rand_W(N, K);
+    tensor2D<bfloat16> A(M, K);
+    tensor2D<float> C(M, N), bias(1, N);
+    PP::BiasGeluStore<float, PP::BIAS_GELU> pp(C, &bias(0, 0));
+    std::cout << "# M=" << M << " K=" << K << " N=" << N << " sizeof(W)=" << pretty_size(2.0 * K * N, "B") << std::endl;
+
+    std::vector<std::shared_ptr<Matmul<bfloat16, bfloat16>>> mm(get_nthr());
+    for(auto & m : mm)
+        m.reset(new Matmul<bfloat16, bfloat16>(true, true));
+    timer.tag(__func__, "Matmul_bf16", M, K, N)(-1000, [&](){
+        #pragma omp parallel
+        {
+            int n0, n1;
+            splitter(N / 32, omp_get_num_threads(), omp_get_thread_num(), n0, n1);
+            (*mm[omp_get_thread_num()])(A, W, n0 * 32, n1 * 32, pp);
+        }
+    }, 2.0 * K * N);
+
+    DecodeLinear<bfloat16> fc_bf16(W.view(), true);
+    timer.tag(__func__, "bf16", M, K, N)(-1000, [&](){
+        fc_bf16(A.view(), pp);
+    }, fc_bf16.weight_bytes());
+
+    DecodeLinear<int8_t> fc_i8(W.view(), true);
+    timer.tag(__func__, "int8", M, K, N)(-1000, [&](){
+        fc_i8(A.view(), pp);
+    }, fc_i8.weight_bytes());
+}
+
+int main(int argc, const char *argv[]) {
+    timer.set_app(argv[0]);
+    timer.set_unit("B/s");
+    std::cout << ANSIcolor("31") << "omp_get_max_threads() = " << omp_get_max_threads() << std::endl << ANSIcolor();
+
+    for(auto transposeW : {false, true}) {
+        for(auto M : {1, 2, 16, 21}) {
+            test_decode_linear<bfloat16, PP::NONE>(M, 128, 200, transposeW);
+            test_decode_linear<int8_t, PP::NONE>(M, 128, 200, transposeW);
+        }
+        test_decode_linear<bfloat16, PP::BIAS_GELU>(3, 80, 100, transposeW);     // K tails
+        test_decode_linear<int8_t, PP::BIAS_GELU>(3, 80, 100, transposeW);
+        test_decode_linear<bfloat16, PP::BIAS_RELU>(5, 1024, 1000, transposeW);
+        test_decode_linear<int8_t, PP::BIAS_RELU>(5, 1024, 1000, transposeW);
+    }
+    test_decode_linear<bfloat16, PP::BIAS>(2, 64, 20, true);                     // fewer panels than threads
+
+    perf_decode_linear(2, 4096, 4096);
+    perf_decode_linear(2, 4096, 16384);
+    return 0;
+}
@@ -0,0 +1,113 @@
+// linear::Linear on every ISA the current CPU supports, vs. fp32 reference
+//
+// this file is built for baseline x86-64 (no -march=native), kernels come from linear/*.cpp:
+//
+//   F="-O2 -std=c++14 -I./include"
+//   g++ $F -mavx2 -mfma -mf16c -c linear/linear_avx2.cpp -o linear_avx2.o
+//   g++ $F -mavx512f -mavx512bw -mavx512vl -mavx512dq -mfma -c linear/linear_avx512.cpp -o linear_avx512.o
+//   g++ $F -mavx512f -mavx512bw -mavx512vl -mavx512dq -mavx512bf16 -mavx512vnni -mfma -c linear/linear_avx512_bf16.cpp -o linear_avx512_bf16.o
+//   g++ $F -mavx512f -mavx512bw -mavx512vl -mavx512dq -mavx512bf16 -mamx-tile -mamx-bf16 -mamx-int8 -c linear/linear_amx.cpp -o linear_amx.o
+//   g++ $F -fopenmp test_linear.cpp linear_avx2.o linear_avx512.o linear_avx512_bf16.o linear_amx.o -o test_linear
+//
+// MAX_ISA=avx2/avx512 limits the kernels tested (as if running on an older CPU)
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <vector>
+#include <iostream>
+#include <cmath>
+
+#include "misc.hpp"
+#include "linear.hpp"
+#include "timeit.hpp"
+
+timeit timer(
+    {
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "HW_CYCLES"},
+    }
+);
+
+static float act_ref(linear::Act act, float x) {
+    if (act == linear::Act::relu) return std::max(x, 0.0f);
+    if (act == linear::Act::gelu) return x * 0.5f * (1.0f + std::erf(x / std::sqrt(2.0f)));
+    return x;
+}
+
+static float to_bf16(float x) {
+    return static_cast<float>(ov::bfloat16(x));
+}
+
+void test_linear(ISA isa, int M, int K, int N, bool transposeW, bool with_bias, linear::Act act, int times = 0) {
+    // padded strides of x/y/W are exercised too
+    int ldx = K + 3, ldy = N + 5, ldw = (transposeW ? K : N) + 7;
+    std::vector<float> x(M * ldx), w((transposeW ? N : K) * ldw), bias(N), y(M * ldy, 0.0f);
+    for(auto & v : x) v = (rand() % 200 - 100) / 100.0f;
+    for(auto & v : w) v = (rand() % 200 - 100) / 1000.0f;
+    for(auto & v : bias) v = (rand() % 200 - 100) / 100.0f;
+
+    linear::Config cfg;
+    cfg.K = K;
+    cfg.N = N;
+    cfg.weight = w.data();
+    cfg.ldw = ldw;
+    cfg.transposeW = transposeW;
+    cfg.bias = with_bias ? bias.data() : nullptr;
+    cfg.act = act;
+    auto fc = linear::create(cfg, isa);
+    (*fc)(x.data(), M, ldx, y.data(), ldy);
+
+    // AMX & AVX512_BF16 compute in bf16, so their reference is of bf16 x & W
+    bool bf16 = fc->isa() == ISA::amx || fc->isa() == ISA::avx512_bf16;
+    float d = 0;
+    for(int m = 0; m < M; m++) {
+        for(int n = 0; n < N; n++) {
+            double sum = with_bias ? bias[n] : 0.0;
+            for(int k = 0; k < K; k++) {
+                float a = x[m * ldx + k];
+                float b = transposeW ? w[n * ldw + k] : w[k * ldw + n];
+                sum += bf16 ? double(to_bf16(a)) * to_bf16(b) : double(a) * b;
+            }
+            d = std::max(d, std::abs(y[m * ldy + n] - act_ref(act, static_cast<float>(sum))));
+        }
+    }
+    bool ok = d < 1e-3f;
+    std::cout << __func__ << "(" << isa_name(fc->isa()) << ",M=" << M << ",K=" << K << ",N=" << N
+              << ",transposeW=" << transposeW << ",bias=" << with_bias << ",act=" << static_cast<int>(act) << ")  "
+              << ANSIcolor(ok ? "1;32" : "1;31") << (ok ? "Match!" : "Mismatch!") << ANSIcolor()
+              << " maxdiff:" << d << std::endl;
+
+    if (times != 0) {
+        timer.tag(__func__, isa_name(isa), M, K, N)(times, [&](){
+            (*fc)(x.data(), M, ldx, y.data(), ldy);
+        }, 2.0 * M * N * K);
+    }
+}
+
+int main(int argc, const char *argv[]) {
+    timer.set_app(argv[0]);
+    auto & f = CpuFeatures::get();
+    std::cout << "avx2:" << f.avx2 << " fma:" << f.fma << " avx512f:" << f.avx512f << " avx512bw:" << f.avx512bw
+              << " avx512_vnni:" << f.avx512_vnni << " avx512_bf16:" << f.avx512_bf16
+              << " amx_tile:" << f.amx_tile << " amx_bf16:" << f.amx_bf16 << " amx_int8:" << f.amx_int8 << std::endl;
+    std::cout << ANSIcolor("32") << "max_isa() = " << isa_name(max_isa()) << ANSIcolor() << std::endl;
+
+    std::vector<ISA> isas;
+    // avx512_bf16 is opt-in, never max_isa(), so it's tested whenever avx512 is
+    for(auto isa : {ISA::avx2, ISA::avx512, ISA::avx512_bf16, ISA::amx})
+        if ((isa == ISA::avx512_bf16 ? ISA::avx512 : isa) <= max_isa() && isa_supported(isa)) isas.push_back(isa);
+
+    for(auto isa : isas) {
+        for(auto transposeW : {false, true}) {
+            test_linear(isa, 1, 64, 32, transposeW, true, linear::Act::none);
+            test_linear(isa, 7, 100, 45, transposeW, false, linear::Act::relu);
+            test_linear(isa, 33, 256, 130, transposeW, true, linear::Act::gelu);
+            test_linear(isa, 100, 96, 200, transposeW, true, linear::Act::relu);
+            test_linear(isa, 6, 160, 5, transposeW, true, linear::Act::none);
+        }
+    }
+    for(auto isa : isas) {
+        test_linear(isa, 1, 4096, 1024, false, true, linear::Act::none, -1000);
+        test_linear(isa, 256, 1024, 1024, false, true, linear::Act::gelu, -1000);
+    }
+    return 0;
+}
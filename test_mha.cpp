@@ -0,0 +1,503 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <deque>
+#include <iostream>
+#include <cassert>
+#include <cstring>
+#include <cmath>
+#include <tuple>
+
+#include <omp.h>
+
+#include "misc.hpp"
+#include "kernels_avx2.hpp"
+
+template<typename F>
+void parallel_nt_static_omp(const F& func) {
+    #pragma omp parallel
+    {
+        func(omp_get_thread_num(), omp_get_num_threads());
+    }
+}
+#define PARALLEL_NT_STATIC(...) parallel_nt_static_omp(__VA_ARGS__)
+
+#include "kernels_mha.hpp"
+#include "timeit.hpp"
+
+timeit timer(
+    {
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "HW_CYCLES"},
+    }
+);
+
+using ov::bfloat16;
+
+// reference: wv = softmax(scale * q*k' + alibi + mask) * v in fp32
+// q[m] is the query of position (causal_m0 + m), it attends keys (pos - window, pos] if window > 0
+// alibi : slope per head, slope * (n - pos) is added to scaled q*k'
+void mha_ref(tensorND<float> & q, tensorND<float> & k, tensorND<float> & v, tensorND<float> & wv,
+             bool kv_head_transposed, bool causal, float scale, int causal_m0 = 0,
+             int window = 0, const float * alibi = nullptr) {
+    int B = q.shape[0], M = q.shape[1], H = q.shape[2], K = q.shape[3];
+    int N = k.shape[kv_head_transposed ? 2 : 1];
+    int group = H / k.shape[kv_head_transposed ? 1 : 2];
+    causal = causal && M > 1;
+    std::vector<float> s(N);
+    for(int b = 0; b < B; b++)
+    for(int h = 0; h < H; h++)
+    for(int m = 0; m < M; m++) {
+        int pos = causal_m0 + m;
+        int n0 = window > 0 ? std::max(0, pos - window + 1) : 0;
+        int valid_n = causal ? std::min(N, pos + 1) : N;
+        float mx = std::numeric_limits<float>::lowest();
+        for(int n = n0; n < valid_n; n++) {
+            float a = 0;
+            for(int i = 0; i < K; i++)
+                a += q(b, m, h, i) * (kv_head_transposed ? k(b, h / group, n, i) : k(b, n, h / group, i));
+            s[n] = a * scale + (alibi ? alibi[h] * (n - pos) : 0.0f);
+            mx = std::max(mx, s[n]);
+        }
+        float sum = 0;
+        for(int n = n0; n < valid_n; n++) {
+            s[n] = std::exp(s[n] - mx);
+            sum += s[n];
+        }
+        for(int i = 0; i < K; i++) {
+            float a = 0;
+            for(int n = n0; n < valid_n; n++)
+                a += s[n] * (kv_head_transposed ? v(b, h / group, n, i) : v(b, n, h / group, i));
+            wv(b, m, h, i) = a / sum;
+        }
+    }
+}
+
+// ALiBi slopes of H heads : 2^(-8(h+1)/H)
+std::vector<float> alibi_slopes(int H) {
+    std::vector<float> slopes(H);
+    for(int h = 0; h < H; h++)
+        slopes[h] = std::pow(2.0f, -8.0f * (h + 1) / H);
+    return slopes;
+}
+
+// sliding-window & ALiBi are set on both kernels during a test
+struct MaskVariant {
+    MHA2Kernels & mha;
+    MHA2Kernels & mha_avx2;
+    std::vector<float> slopes;
+    MaskVariant(MHA2Kernels & mha, MHA2Kernels & mha_avx2, int H, int window, bool alibi) : mha(mha), mha_avx2(mha_avx2) {
+        if (alibi) slopes = alibi_slopes(H);
+        for(auto * p : {&mha, &mha_avx2}) {
+            p->window = window;
+            p->alibi_slopes = alibi ? slopes.data() : nullptr;
+        }
+    }
+    ~MaskVariant() {
+        for(auto * p : {&mha, &mha_avx2}) {
+            p->window = 0;
+            p->alibi_slopes = nullptr;
+        }
+    }
+    const float * alibi() const {
+        return slopes.empty() ? nullptr : slopes.data();
+    }
+};
+
+template<typename T>
+void fill_rnd(tensorND<T> & t) {
+    t.for_each([&](size_t i, int * c) {
+        t(c) = T((rand() % 200 - 100) / 100.0f);
+        return true;
+    });
+}
+
+template<typename T>
+float max_diff(tensorND<T> & a, tensorND<float> & ref) {
+    float d = 0;
+    ref.for_each([&](size_t i, int * c) {
+        d = std::max(d, std::abs(float(a(c)) - ref(c)));
+        return true;
+    });
+    return d;
+}
+
+template<typename T>
+tensorND<T> convert(tensorND<float> & src) {
+    tensorND<T> ret(std::vector<int>(src.shape, src.shape + src.ndim), true);
+    src.for_each([&](size_t i, int * c) {
+        ret(c) = T(src(c));
+        return true;
+    });
+    return ret;
+}
+
+// Hkv < H : GQA/MQA
+void test_mha(MHA2Kernels & mha, MHA2Kernels & mha_avx2, int B, int M, int N, int H, int K,
+              bool kv_head_transposed, bool causal, int times = 0, int Hkv = 0, int window = 0, bool alibi = false) {
+    float scale = 1.0f / std::sqrt(K);
+    MaskVariant variant(mha, mha_avx2, H, window, alibi);
+    if (Hkv == 0) Hkv = H;
+    auto kv_shape = kv_head_transposed ? std::vector<int>{B, Hkv, N, K} : std::vector<int>{B, N, Hkv, K};
+    tensorND<float> q({B, M, H, K}, true), k(kv_shape, true), v(kv_shape, true);
+    tensorND<float> wv({B, M, H, K}, true), wv_avx2({B, M, H, K}, true), wv_ref({B, M, H, K}, true);
+    fill_rnd(q);
+    fill_rnd(k);
+    fill_rnd(v);
+    // queries are the last M tokens
+    mha_ref(q, k, v, wv_ref, kv_head_transposed, causal, scale, N - M, window, variant.alibi());
+
+    mha(q, k, v, wv, kv_head_transposed, causal, scale);
+    mha_avx2(q, k, v, wv_avx2, kv_head_transposed, causal, scale);
+
+    auto qb = convert<bfloat16>(q), kb = convert<bfloat16>(k), vb = convert<bfloat16>(v);
+    tensorND<bfloat16> wvb({B, M, H, K}, true);
+    if (mha.use_amx)
+        mha(qb, kb, vb, wvb, kv_head_transposed, causal, scale);
+
+    // bf16 q*k' & softmax probabilities limit accuracy of AMX path
+    float d_amx = max_diff(wv, wv_ref);
+    float d_bf16 = mha.use_amx ? max_diff(wvb, wv_ref) : 0;
+    float d_avx2 = max_diff(wv_avx2, wv_ref);
+    bool ok = d_amx < 0.03f && d_bf16 < 0.03f && d_avx2 < 1e-3f;
+    std::cout << __func__ << "(B=" << B << ",M=" << M << ",N=" << N << ",H=" << H << ",Hkv=" << Hkv << ",K=" << K
+              << ",kv_head_transposed=" << kv_head_transposed << ",causal=" << causal
+              << ",window=" << window << ",alibi=" << alibi << ")  "
+              << ANSIcolor(ok ? "1;32" : "1;31") << (ok ? "Match!" : "Mismatch!") << ANSIcolor()
+              << " maxdiff amx:" << d_amx << " amx-bf16:" << d_bf16 << " avx2:" << d_avx2 << std::endl;
+
+    if (times == 0) return;
+    double flops = 4.0 * B * H * M * N * K;
+    timer.tag(__func__, B, M, N, H, Hkv, K, "avx2")(times, [&](){
+        mha_avx2(q, k, v, wv_avx2, kv_head_transposed, causal, scale);
+    }, flops);
+    if (!mha.use_amx) return;
+    timer.tag(__func__, B, M, N, H, Hkv, K, "amx_f32")(times, [&](){
+        mha(q, k, v, wv, kv_head_transposed, causal, scale);
+    }, flops);
+    timer.tag(__func__, B, M, N, H, Hkv, K, "amx_bf16")(times, [&](){
+        mha(qb, kb, vb, wvb, kv_head_transposed, causal, scale);
+    }, flops);
+}
+
+// sequences of different lengths in a paged KV-cache, the last one is forked from the first one
+// after prefill, all are then extended token by token like incremental decoding
+template<typename T, typename TS>
+void build_cache(PagedKVCache<T> & cache, std::vector<int> & seqs,
+                 std::deque<tensorND<TS>> & k, std::deque<tensorND<TS>> & v, int prefill) {
+    int nseq = k.size();
+    seqs.resize(nseq);
+    std::vector<int> len(nseq);
+    auto append = [&](int b, int n1) {
+        cache.append(seqs[b], k[b].Slice(0, slice(len[b], n1), fullslice(), fullslice()),
+                              v[b].Slice(0, slice(len[b], n1), fullslice(), fullslice()));
+        len[b] = n1;
+    };
+    for(int b = 0; b < nseq - 1; b++) {
+        seqs[b] = cache.add_sequence();
+        append(b, std::min(k[b].shape[1], prefill));
+    }
+    seqs[nseq - 1] = cache.fork(seqs[0]);
+    len[nseq - 1] = len[0];
+    for(int b = 0; b < nseq; b++)
+        while(len[b] < k[b].shape[1])
+            append(b, len[b] + 1);
+}
+
+void test_paged(MHA2Kernels & mha, MHA2Kernels & mha_avx2, std::vector<int> lens, int M, int H, int K,
+                bool causal, int block_size = 32, int Hkv = 0, int times = 0, int window = 0, bool alibi = false) {
+    const int prefill = 37;
+    MaskVariant variant(mha, mha_avx2, H, window, alibi);
+    if (Hkv == 0) Hkv = H;
+    float scale = 1.0f / std::sqrt(K);
+    int B = lens.size();
+    std::deque<tensorND<float>> k, v;
+    std::deque<tensorND<bfloat16>> kb, vb;
+    for(int b = 0; b < B; b++) {
+        k.emplace_back(std::vector<int>{1, lens[b], Hkv, K}, true);
+        v.emplace_back(std::vector<int>{1, lens[b], Hkv, K}, true);
+        fill_rnd(k[b]);
+        fill_rnd(v[b]);
+    }
+    // forked sequence shares the prefill part with first sequence
+    assert(lens[0] >= prefill && lens[B - 1] >= prefill);
+    memcpy(&k[B - 1](0, 0, 0, 0), &k[0](0, 0, 0, 0), prefill * k[0].strides[1]);
+    memcpy(&v[B - 1](0, 0, 0, 0), &v[0](0, 0, 0, 0), prefill * v[0].strides[1]);
+    for(int b = 0; b < B; b++) {
+        kb.push_back(convert<bfloat16>(k[b]));
+        vb.push_back(convert<bfloat16>(v[b]));
+    }
+
+    int num_blocks = 0;
+    for(auto len : lens) num_blocks += (len + block_size - 1) / block_size;
+    PagedKVCache<float> cache(num_blocks, Hkv, K, block_size);
+    PagedKVCache<bfloat16> cache_bf16(num_blocks, Hkv, K, block_size);
+    PagedKVCache<int8_t> cache_i8(num_blocks, Hkv, K, block_size);
+    std::vector<int> seqs, seqs_bf16, seqs_i8;
+    build_cache(cache, seqs, k, v, prefill);
+    build_cache(cache_bf16, seqs_bf16, kb, vb, prefill);
+    build_cache(cache_i8, seqs_i8, k, v, prefill);
+
+    // query the last M tokens of each sequence
+    tensorND<float> q({B, M, H, K}, true), wv({B, M, H, K}, true), wv_avx2({B, M, H, K}, true), wv_ref({B, M, H, K}, true);
+    fill_rnd(q);
+    for(int b = 0; b < B; b++) {
+        tensorND<float> qi({1, M, H, K}, true), wvi({1, M, H, K}, true);
+        memcpy(&qi(0, 0, 0, 0), &q(b, 0, 0, 0), q.strides[0]);
+        mha_ref(qi, k[b], v[b], wvi, false, causal, scale, lens[b] - M, window, variant.alibi());
+        memcpy(&wv_ref(b, 0, 0, 0), &wvi(0, 0, 0, 0), wv_ref.strides[0]);
+    }
+    mha(q, cache, seqs, wv, causal, scale);
+    mha_avx2(q, cache, seqs, wv_avx2, causal, scale);
+
+    auto qb = convert<bfloat16>(q);
+    tensorND<bfloat16> wvb({B, M, H, K}, true);
+    if (mha.use_amx)
+        mha(qb, cache_bf16, seqs_bf16, wvb, causal, scale);
+
+    // int8 KV-cache, dequantized on the fly
+    tensorND<float> wv_i8({B, M, H, K}, true), wv_i8_avx2({B, M, H, K}, true);
+    mha(q, cache_i8, seqs_i8, wv_i8, causal, scale);
+    mha_avx2(q, cache_i8, seqs_i8, wv_i8_avx2, causal, scale);
+
+    float d_amx = max_diff(wv, wv_ref);
+    float d_bf16 = mha.use_amx ? max_diff(wvb, wv_ref) : 0;
+    float d_avx2 = max_diff(wv_avx2, wv_ref);
+    float d_i8 = std::max(max_diff(wv_i8, wv_ref), max_diff(wv_i8_avx2, wv_ref));
+    bool ok = d_amx < 0.03f && d_bf16 < 0.03f && d_avx2 < 1e-3f && d_i8 < 0.03f;
+
+    if (times) {
+        double flops = 0;
+        for(auto len : lens) flops += 4.0 * H * M * len * K;
+        timer.tag(__func__, B, M, H, Hkv, K, "avx2_f32")(times, [&](){
+            mha_avx2(q, cache, seqs, wv_avx2, causal, scale);
+        }, flops);
+        timer.tag(__func__, B, M, H, Hkv, K, "avx2_i8")(times, [&](){
+            mha_avx2(q, cache_i8, seqs_i8, wv_i8_avx2, causal, scale);
+        }, flops);
+        if (mha.use_amx) {
+            timer.tag(__func__, B, M, H, Hkv, K, "amx_bf16")(times, [&](){
+                mha(qb, cache_bf16, seqs_bf16, wvb, causal, scale);
+            }, flops);
+            timer.tag(__func__, B, M, H, Hkv, K, "amx_i8")(times, [&](){
+                mha(q, cache_i8, seqs_i8, wv_i8, causal, scale);
+            }, flops);
+        }
+    }
+
+    // all blocks go back to pool after sequences are freed
+    for(auto seq : seqs) cache.free_sequence(seq);
+    ok = ok && (cache.num_free_blocks() == num_blocks);
+
+    std::cout << __func__ << "(B=" << B << ",M=" << M << ",H=" << H << ",Hkv=" << Hkv << ",K=" << K << ",causal=" << causal
+              << ",block_size=" << block_size << ",window=" << window << ",alibi=" << alibi << ")  "
+              << ANSIcolor(ok ? "1;32" : "1;31") << (ok ? "Match!" : "Mismatch!") << ANSIcolor()
+              << " maxdiff amx:" << d_amx << " amx-bf16:" << d_bf16 << " avx2:" << d_avx2 << " int8:" << d_i8 << std::endl;
+}
+
+// fused single-pass softmax kernels : scale, causal limit, additive bias & ALiBi, fp32/bf16 output
+void test_softmax(int M, int N, float scale, bool with_bias, bool alibi, int times = 0) {
+    tensorND<float> x({M, N}, true), bias({M, N}, true), ref({M, N}, true);
+    fill_rnd(x);
+    fill_rnd(bias);
+    // row m is causally limited to its first valid(m) elements
+    auto valid = [&](int m) { return N - (M - 1 - m) * N / (2 * M); };
+    auto slope = [&](int m) { return alibi ? 0.05f * (m + 1) : 0.0f; };
+    int dist0 = -N / 2;
+    for(int m = 0; m < M; m++) {
+        int nv = valid(m);
+        float x_max = std::numeric_limits<float>::lowest(), sum = 0;
+        std::vector<float> y(N);
+        for(int n = 0; n < nv; n++) {
+            y[n] = x(m, n) * scale + (with_bias ? bias(m, n) : 0.0f) + slope(m) * (n + dist0);
+            x_max = std::max(x_max, y[n]);
+        }
+        for(int n = 0; n < nv; n++) {
+            y[n] = std::exp(y[n] - x_max);
+            sum += y[n];
+        }
+        for(int n = 0; n < N; n++)
+            ref(m, n) = n < nv ? y[n] / sum : 0.0f;
+    }
+
+    tensorND<float> y_f32({M, N}, true);
+    tensorND<bfloat16> y_bf16({M, N}, true);
+    auto run = [&](auto softmax, auto & y) {
+        for(int m = 0; m < M; m++)
+            softmax(&y(m, 0), &x(m, 0), N, valid(m), scale, with_bias ? &bias(m, 0) : nullptr, slope(m), dist0);
+    };
+    auto avx2_f32 = [&](float * dst, const float * src, int n, int nv, float s, const float * b, float sl, int d0) {
+        avx2::functional::softmax_online(dst, src, n, nv, s, b, sl, d0);
+    };
+    auto avx2_bf16 = [&](bfloat16 * dst, const float * src, int n, int nv, float s, const float * b, float sl, int d0) {
+        avx2::functional::softmax_online(dst, src, n, nv, s, b, sl, d0);
+    };
+    run(avx2_f32, y_f32);
+    run(avx2_bf16, y_bf16);
+    float d_avx2 = max_diff(y_f32, ref);
+    float d_avx2_bf16 = max_diff(y_bf16, ref);
+    float d_avx512 = 0, d_avx512_bf16 = 0;
+#ifdef MHA_WITH_AMX
+    auto avx512_f32 = [&](float * dst, const float * src, int n, int nv, float s, const float * b, float sl, int d0) {
+        amx_kernel::functional::softmax_online(dst, src, n, nv, s, b, sl, d0);
+    };
+    auto avx512_bf16 = [&](bfloat16 * dst, const float * src, int n, int nv, float s, const float * b, float sl, int d0) {
+        amx_kernel::functional::softmax_online(dst, src, n, nv, s, b, sl, d0);
+    };
+    run(avx512_f32, y_f32);
+    run(avx512_bf16, y_bf16);
+    d_avx512 = max_diff(y_f32, ref);
+    d_avx512_bf16 = max_diff(y_bf16, ref);
+#endif
+    bool ok = std::max(d_avx2, d_avx512) < 1e-5f && std::max(d_avx2_bf16, d_avx512_bf16) < 4e-3f;
+    std::cout << __func__ << "(M=" << M << ",N=" << N << ",scale=" << scale << ",bias=" << with_bias << ",alibi=" << alibi << ")  "
+              << ANSIcolor(ok ? "1;32" : "1;31") << (ok ? "Match!" : "Mismatch!") << ANSIcolor()
+              << " maxdiff avx2:" << d_avx2 << " avx2-bf16:" << d_avx2_bf16
+              << " avx512:" << d_avx512 << " avx512-bf16:" << d_avx512_bf16 << std::endl;
+
+    if (times != 0) {
+        timer.tag(__func__, M, N, "avx2_f32")(times, [&](){ run(avx2_f32, y_f32); });
+        timer.tag(__func__, M, N, "avx2_bf16")(times, [&](){ run(avx2_bf16, y_bf16); });
+#ifdef MHA_WITH_AMX
+        timer.tag(__func__, M, N, "avx512_f32")(times, [&](){ run(avx512_f32, y_f32); });
+        timer.tag(__func__, M, N, "avx512_bf16")(times, [&](){ run(avx512_bf16, y_bf16); });
+#endif
+    }
+}
+
+#ifdef MHA_WITH_AMX
+// fused QKV projection of M new tokens per sequence, RoPE is applied in the epilogue which
+// writes q into {B, M, H, K} and appends k/v into the paged KV-cache directly
+void test_rope(std::vector<int> lens, int M, int D, int H, int Hkv, int K) {
+    int B = lens.size();
+    int N = (H + 2 * Hkv) * K;
+    int max_pos = 0;
+    for(auto len : lens) max_pos = std::max(max_pos, len + M);
+    amx_kernel::PP::RopeTable rope(max_pos, K);
+
+    tensor2D<bfloat16> x(B * M, D), w(D, N);
+    int num_blocks = 0;
+    for(auto len : lens) num_blocks += (len + M + 31) / 32;
+    PagedKVCache<float> cache(num_blocks, Hkv, K);
+    std::vector<int> seqs, positions;
+    for(int b = 0; b < B; b++) {
+        seqs.push_back(cache.add_sequence());
+        if (lens[b] > 0) {
+            tensorND<float> kv({lens[b], Hkv, K}, true);
+            fill_rnd(kv);
+            cache.append(seqs[b], kv.Slice(), kv.Slice());
+        }
+        cache.extend(seqs[b], M);
+        for(int m = 0; m < M; m++) positions.push_back(lens[b] + m);
+    }
+
+    tensorND<float> q({B, M, H, K}, true);
+    auto pp = amx_kernel::PP::make_rope_store<float>(rope, positions.data(), H + Hkv, [&](int m, int h) {
+        int b = m / M;
+        int pos = positions[m];
+        if (h < H) return &q(b, m % M, h, 0);
+        if (h < H + Hkv) return cache.key_row(seqs[b], pos, h - H);
+        return cache.value_row(seqs[b], pos, h - H - Hkv);
+    });
+    amx_kernel::Matmul<bfloat16, bfloat16> mm(true, false);
+    mm(x, w, 0, N, pp);
+
+    // reference: projection, then rotate pairs (2i, 2i+1) of q & k
+    tensor2D<float> c(B * M, N);
+    amx_kernel::Matmul<bfloat16, bfloat16> mm_ref(true, false);
+    amx_kernel::PP::BiasGeluStore<float, amx_kernel::PP::Steps::NONE> pp_ref(c);
+    mm_ref(x, w, 0, N, pp_ref);
+    float d = 0;
+    for(int m = 0; m < B * M; m++) {
+        int b = m / M;
+        int pos = positions[m];
+        for(int h = 0; h < H + 2 * Hkv; h++) {
+            float * got = h < H ? &q(b, m % M, h, 0) :
+                          h < H + Hkv ? cache.key_row(seqs[b], pos, h - H) : cache.value_row(seqs[b], pos, h - H - Hkv);
+            for(int i = 0; i < K; i += 2) {
+                float x0 = c(m, h * K + i), x1 = c(m, h * K + i + 1);
+                if (h < H + Hkv) {
+                    float angle = pos * std::pow(10000.0f, -static_cast<float>(i) / K);
+                    float c0 = std::cos(angle), s0 = std::sin(angle);
+                    std::tie(x0, x1) = std::make_tuple(x0 * c0 - x1 * s0, x1 * c0 + x0 * s0);
+                }
+                d = std::max(d, std::max(std::abs(got[i] - x0), std::abs(got[i + 1] - x1)));
+            }
+        }
+    }
+    bool ok = d < 1e-3f;
+    std::cout << __func__ << "(B=" << B << ",M=" << M << ",D=" << D << ",H=" << H << ",Hkv=" << Hkv << ",K=" << K << ")  "
+              << ANSIcolor(ok ? "1;32" : "1;31") << (ok ? "Match!" : "Mismatch!") << ANSIcolor()
+              << " maxdiff:" << d << std::endl;
+}
+#endif
+
+int main(int argc, const char *argv[]) {
+    timer.set_app(argv[0]);
+    std::cout << ANSIcolor("31") << "omp_get_max_threads() = " << omp_get_max_threads() << std::endl << ANSIcolor();
+
+    MHA2Kernels mha(MHA2Kernels::Backend::amx_bf16);
+    MHA2Kernels mha_avx2;
+
+    for (auto N : {1, 7, 8, 31, 33, 64, 100, 129, 1000}) {
+        test_softmax(5, N, 1.0f, false, false);
+        test_softmax(5, N, 0.125f, true, true);
+    }
+
+    for (auto kv_head_transposed : {true, false}) {
+        for (auto causal : {false, true}) {
+            test_mha(mha, mha_avx2, 1, 1, 300, 2, 64, kv_head_transposed, causal);
+            test_mha(mha, mha_avx2, 2, 17, 129, 3, 80, kv_head_transposed, causal);
+            test_mha(mha, mha_avx2, 1, 45, 45, 2, 64, kv_head_transposed, causal);
+            test_mha(mha, mha_avx2, 1, 100, 300, 1, 128, kv_head_transposed, causal);
+            // GQA & MQA
+            test_mha(mha, mha_avx2, 2, 1, 300, 8, 64, kv_head_transposed, causal, 0, 2);
+            test_mha(mha, mha_avx2, 2, 45, 129, 6, 64, kv_head_transposed, causal, 0, 3);
+            test_mha(mha, mha_avx2, 1, 17, 300, 4, 80, kv_head_transposed, causal, 0, 1);
+            // flash-decoding: long N split into blocks
+            test_mha(mha, mha_avx2, 1, 1, 3000, 2, 128, kv_head_transposed, causal);
+            test_mha(mha, mha_avx2, 2, 4, 3000, 4, 128, kv_head_transposed, causal, 0, 2);
+            test_mha(mha, mha_avx2, 1, 17, 5000, 2, 64, kv_head_transposed, causal);
+            // sliding-window & ALiBi, in prefill (row split) & flash-decoding
+            test_mha(mha, mha_avx2, 2, 100, 300, 2, 64, kv_head_transposed, causal, 0, 0, 50);
+            test_mha(mha, mha_avx2, 1, 45, 129, 4, 80, kv_head_transposed, causal, 0, 2, 0, true);
+            test_mha(mha, mha_avx2, 1, 70, 200, 3, 64, kv_head_transposed, causal, 0, 0, 33, true);
+            test_mha(mha, mha_avx2, 1, 1, 3000, 8, 128, kv_head_transposed, causal, 0, 2, 1000, true);
+            test_mha(mha, mha_avx2, 2, 4, 3000, 4, 128, kv_head_transposed, causal, 0, 0, 700);
+        }
+    }
+
+    for (auto causal : {false, true}) {
+        test_paged(mha, mha_avx2, {100, 1, 45, 300, 70}, 1, 2, 64, causal);
+        test_paged(mha, mha_avx2, {100, 40, 45, 300, 70}, 17, 3, 80, causal);
+        test_paged(mha, mha_avx2, {300, 37, 129}, 37, 2, 64, causal, 64);
+        test_paged(mha, mha_avx2, {100, 1, 45, 300, 70}, 1, 8, 64, causal, 32, 2);
+        test_paged(mha, mha_avx2, {100, 40, 45, 300, 70}, 17, 4, 64, causal, 32, 1);
+        test_paged(mha, mha_avx2, {3000, 100, 2500}, 8, 4, 128, causal, 32, 2);
+        test_paged(mha, mha_avx2, {3000, 100, 2500}, 8, 4, 128, causal, 32, 2, 0, 500, true);
+        test_paged(mha, mha_avx2, {100, 40, 45, 300, 70}, 17, 3, 64, causal, 32, 0, 0, 40, true);
+    }
+
+#ifdef MHA_WITH_AMX
+    test_rope({100, 37, 1}, 1, 256, 4, 2, 64);
+    test_rope({0, 45}, 17, 160, 3, 1, 80);
+    test_rope({300}, 40, 512, 8, 8, 128);
+#endif
+
+    test_softmax(32, 2048, 0.125f, false, true, -1000);
+    test_mha(mha, mha_avx2, 1, 448, 448, 6, 64, true, true, -1000);
+    test_mha(mha, mha_avx2, 1, 1500, 1500, 6, 64, true, false, -1000);
+    // decoding of a GQA model
+    test_mha(mha, mha_avx2, 1, 1, 2048, 32, 128, true, true, -1000, 8);
+    test_mha(mha, mha_avx2, 1, 1, 2048, 32, 128, true, false, -1000, 8);
+    // local attention : only the last 512 keys are encoded
+    test_mha(mha, mha_avx2, 1, 1, 2048, 32, 128, true, false, -1000, 8, 512);
+    // decoding over paged KV-cache : fp32/bf16 vs int8
+    test_paged(mha, mha_avx2, {4096, 4096}, 1, 32, 128, false, 32, 8, -1000);
+    // chunked prefill over paged KV-cache : M > max_split_M, keys of the whole sequence are not split
+    test_paged(mha, mha_avx2, {4096, 4096}, 64, 32, 128, true, 32, 8, -1000);
+    // speculative decoding / chunked prefill : a few queries over a long context
+    test_mha(mha, mha_avx2, 1, 8, 2048, 32, 128, true, true, -1000, 8);
+    return 0;
+}
@@ -0,0 +1,346 @@
+// fp32/fp16 A of amx_kernel::Matmul<bf16,bf16>, converted (or LayerNorm/RMSNorm normalized) to bf16 inside Matmul
+//
+//   g++ -O2 -march=native -std=c++14 -fopenmp -I./include test_mixed_a.cpp -o test_mixed_a
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <iostream>
+#include <cmath>
+
+#include "kernels_amx.hpp"
+#include "tensor2D.hpp"
+#include "timeit.hpp"
+
+#include <omp.h>
+
+timeit timer(
+    {
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "HW_CYCLES"},
+    }
+);
+
+static bool initAMX = initXTILE();
+
+using ov::bfloat16;
+using ov::float16;
+using namespace amx_kernel;
+
+// scalar ov::float16 conversion vs. F16C
+void test_fp16_scalar() {
+    int errors = 0;
+    for(uint32_t bits = 0; bits < 0x10000; bits++) {
+        auto h = float16::from_bits(static_cast<uint16_t>(bits));
+        float f = h;
+        float ref = _cvtsh_ss(static_cast<uint16_t>(bits));
+        bool nan = std::isnan(ref);
+        if (nan ? !std::isnan(f) : memcmp(&f, &ref, sizeof(f)) != 0)
+            errors++;
+        if (!nan && float16(f).to_bits() != bits)
+            errors++;
+    }
+    for(int i = 0; i < 1000000; i++) {
+        uint32_t x = (static_cast<uint32_t>(rand()) << 16) ^ static_cast<uint32_t>(rand());
+        float f;
+        memcpy(&f, &x, sizeof(f));
+        if (std::isnan(f))
+            continue;
+        if (float16(f).to_bits() != _cvtss_sh(f, _MM_FROUND_TO_NEAREST_INT))
+            errors++;
+    }
+    std::cout << __func__ << "  " << ANSIcolor(errors ? "1;31" : "1;32") << (errors ? "Mismatch!" : "Match!")
+              << ANSIcolor() << " errors:" << errors << std::endl;
+}
+
+template<typename TS>
+tensor2D<TS> rand_A(int M, int K) {
+    tensor2D<TS> A(M, K);
+    for(int m = 0; m < M; m++)
+        for(int k = 0; k < K; k++)
+            A(m, k) = (rand() % 2000 - 1000) / 333.0f;
+    return A;
+}
+
+// result must be bitwise same as converting A to bf16 first
+template<typename TS>
+void test_mixed_a(int M, int K, int N, bool transposeB, bool lazyB = false) {
+    auto A = rand_A<TS>(M, K);
+    tensor2D<bfloat16> Ab(M, K);
+    tensor2D<bfloat16> B(transposeB ? N : K, transposeB ? K : N);
+    tensor2D<float> C(M, N), C0(M, N);
+    for(int m = 0; m < M; m++)
+        for(int k = 0; k < K; k++)
+            Ab(m, k) = static_cast<float>(A(m, k));
+
+    Matmul<bfloat16, bfloat16> mm(true, transposeB), mm0(true, transposeB);
+    PP::BiasGeluStore<float, PP::NONE> pp(C), pp0(C0);
+    if (lazyB) {
+        LazyRepackedB<bfloat16> lazy(B, transposeB);
+        int n_split = N / 2 / 32 * 32;
+        mm(A, lazy, 0, n_split, pp);
+        mm(A, lazy, n_split, N, pp);
+    } else {
+        mm(A, B, 0, N, pp);
+    }
+    if (K < 32) {
+        // plain bf16 A requires K >= 32
+        tensor2D_blocked<bfloat16> Abb;
+        Abb.from_plain(Ab);
+        mm0(Abb, B, 0, N, pp0);
+    } else {
+        mm0(Ab, B, 0, N, pp0);
+    }
+
+    std::cout << __func__ << "<" << (std::is_same<TS, float>::value ? "float" : "float16") << ">(" << M << "," << K << "," << N
+              << ",transposeB=" << transposeB << ",lazyB=" << lazyB << ")  ";
+    if (C == C0) {
+        std::cout << ANSIcolor("1;32") << "Match!\n" << ANSIcolor();
+    } else {
+        std::cout << ANSIcolor("1;31") << "Mismatch!\n" << ANSIcolor();
+    }
+}
+
+// fused conversion vs. a separate conversion pass before bf16 Matmul
+template<typename TS>
+void perf_mixed_a(int M, int K, int N, int times = -1000) {
+    auto A = rand_A<TS>(M, K);
+    tensor2D<bfloat16> Ab(M, K);
+    tensor2D<bfloat16> B(K, N);
+    tensor2D<float> C(M, N);
+    Matmul<bfloat16, bfloat16> mm(true, false), mm0(true, false);
+    PP::BiasGeluStore<float, PP::NONE> pp(C);
+    auto name = std::is_same<TS, float>::value ? "float" : "float16";
+
+    timer.tag(__func__, name, "separate", M, K, N)(times, [&](){
+        for(int m = 0; m < M; m++)
+            for(int k = 0; k < K; k += 32)
+                functional::cvt_bf16_x32(&Ab(m, k), &A(m, k), std::min(32, K - k));
+        mm0(Ab, B, 0, N, pp);
+    }, 2.0 * M * N * K);
+
+    timer.tag(__func__, name, "fused", M, K, N)(times, [&](){
+        mm(A, B, 0, N, pp);
+    }, 2.0 * M * N * K);
+}
+
+// C = A * B with N-panels split among OpenMP threads, each thread owns a Matmul
+template<typename TA>
+void matmul_omp(std::vector<std::shared_ptr<Matmul<bfloat16, bfloat16>>> & mm, TA & A, tensor2D<bfloat16> & B,
+                PP::BiasGeluStore<float, PP::NONE> & pp) {
+    int N = B.dims[1];
+    #pragma omp parallel
+    {
+        int n0, n1;
+        splitter(rndup(N, 32) / 32, omp_get_num_threads(), omp_get_thread_num(), n0, n1);
+        n1 = std::min(n1 * 32, N);
+        if (n0 * 32 < n1)
+            (*mm[omp_get_thread_num()])(A, B, n0 * 32, n1, pp);
+    }
+}
+
+// A converted once by all threads (cvt_bf16_blocked_omp) vs. converted by each thread's Matmul
+template<typename TS>
+void test_mixed_a_omp(int M, int K, int N) {
+    auto A = rand_A<TS>(M, K);
+    tensor2D<bfloat16> B(K, N);
+    tensor2D<float> C(M, N), C0(M, N);
+    tensor2D_blocked<bfloat16> Ab;
+    PP::BiasGeluStore<float, PP::NONE> pp(C), pp0(C0);
+    std::vector<std::shared_ptr<Matmul<bfloat16, bfloat16>>> mm(get_nthr());
+    for(auto & m : mm)
+        m.reset(new Matmul<bfloat16, bfloat16>(true, false));
+
+    functional::cvt_bf16_blocked_omp(Ab, A.view());
+    matmul_omp(mm, Ab, B, pp);
+    matmul_omp(mm, A, B, pp0);
+
+    std::cout << __func__ << "<" << (std::is_same<TS, float>::value ? "float" : "float16") << ">(" << M << "," << K << "," << N << ")  ";
+    if (C == C0) {
+        std::cout << ANSIcolor("1;32") << "Match!\n" << ANSIcolor();
+    } else {
+        std::cout << ANSIcolor("1;31") << "Mismatch!\n" << ANSIcolor();
+    }
+}
+
+// multi-threaded prefill: every thread converting whole A in its Matmul vs. converting it once
+void perf_mixed_a_omp(int M, int K, int N, int times = -1000) {
+    auto A = rand_A<float>(M, K);
+    tensor2D<bfloat16> B(K, N);
+    tensor2D<float> C(M, N);
+    tensor2D_blocked<bfloat16> Ab;
+    PP::BiasGeluStore<float, PP::NONE> pp(C);
+    std::vector<std::shared_ptr<Matmul<bfloat16, bfloat16>>> mm(get_nthr());
+    for(auto & m : mm)
+        m.reset(new Matmul<bfloat16, bfloat16>(true, false));
+
+    timer.tag(__func__, "per-thread", M, K, N)(times, [&](){
+        matmul_omp(mm, A, B, pp);
+    }, 2.0 * M * N * K);
+
+    timer.tag(__func__, "shared", M, K, N)(times, [&](){
+        functional::cvt_bf16_blocked_omp(Ab, A.view());
+        matmul_omp(mm, Ab, B, pp);
+    }, 2.0 * M * N * K);
+}
+
+// norm A-prologue must give the same result as avx512::norm into a bf16 tensor + bf16 Matmul
+template<typename TS>
+void test_norm_a(avx512::NormType type, int M, int K, int N, bool with_beta, bool lazyB = false) {
+    auto A = rand_A<TS>(M, K);
+    tensor2D<bfloat16> An(M, K);
+    tensor2D<bfloat16> B(K, N);
+    tensor2D<float> C(M, N), C0(M, N), gamma(1, K), beta(1, K);
+    for(int k = 0; k < K; k++) {
+        gamma(0, k) = (rand() % 2000) / 1000.0f;
+        beta(0, k) = (rand() % 2000 - 1000) / 1000.0f;
+    }
+    NormA norm{type, 1e-5f, &gamma(0, 0), with_beta ? &beta(0, 0) : nullptr};
+
+    Matmul<bfloat16, bfloat16> mm(true, false), mm0(true, false);
+    PP::BiasGeluStore<float, PP::NONE> pp(C), pp0(C0);
+    if (lazyB) {
+        LazyRepackedB<bfloat16> lazy(B, false);
+        int n_split = N / 2 / 32 * 32;
+        mm(A.view(), norm, lazy, 0, n_split, pp);
+        mm(A.view(), norm, lazy, n_split, N, pp);
+    } else {
+        mm(A.view(), norm, B, 0, N, pp);
+    }
+
+    avx512::norm(type, An.view(), A.view(), norm.eps, norm.gamma, norm.beta);
+    if (K < 32) {
+        tensor2D_blocked<bfloat16> Anb;
+        Anb.from_plain(An);
+        mm0(Anb, B, 0, N, pp0);
+    } else {
+        mm0(An, B, 0, N, pp0);
+    }
+
+    std::cout << __func__ << "<" << TypeName<TS>::get() << ">(" << (type == avx512::NormType::layer ? "layer" : "rms")
+              << "," << M << "," << K << "," << N << ",beta=" << with_beta << ",lazyB=" << lazyB << ")  ";
+    if (C == C0) {
+        std::cout << ANSIcolor("1;32") << "Match!\n" << ANSIcolor();
+    } else {
+        std::cout << ANSIcolor("1;31") << "Mismatch!\n" << ANSIcolor();
+    }
+}
+
+// A normalized once by all threads (norm_bf16_blocked_omp) vs. normalized by each thread's Matmul
+void test_norm_a_omp(avx512::NormType type, int M, int K, int N) {
+    auto A = rand_A<float>(M, K);
+    tensor2D<bfloat16> B(K, N);
+    tensor2D<float> C(M, N), C0(M, N), gamma(1, K), beta(1, K);
+    tensor2D_blocked<bfloat16> An;
+    for(int k = 0; k < K; k++) {
+        gamma(0, k) = (rand() % 2000) / 1000.0f;
+        beta(0, k) = (rand() % 2000 - 1000) / 1000.0f;
+    }
+    NormA norm{type, 1e-5f, &gamma(0, 0), &beta(0, 0)};
+    PP::BiasGeluStore<float, PP::NONE> pp(C), pp0(C0);
+    std::vector<std::shared_ptr<Matmul<bfloat16, bfloat16>>> mm(get_nthr());
+    for(auto & m : mm)
+        m.reset(new Matmul<bfloat16, bfloat16>(true, false));
+
+    functional::norm_bf16_blocked_omp(An, A.view(), norm);
+    matmul_omp(mm, An, B, pp);
+    Matmul<bfloat16, bfloat16> mm0(true, false);
+    mm0(A.view(), norm, B, 0, N, pp0);
+
+    std::cout << __func__ << "(" << (type == avx512::NormType::layer ? "layer" : "rms")
+              << "," << M << "," << K << "," << N << ")  ";
+    if (C == C0) {
+        std::cout << ANSIcolor("1;32") << "Match!\n" << ANSIcolor();
+    } else {
+        std::cout << ANSIcolor("1;31") << "Mismatch!\n" << ANSIcolor();
+    }
+}
+
+// fused norm A-prologue vs. a separate normalization pass before bf16 Matmul
+void perf_norm_a(int M, int K, int N, int times = -1000) {
+    auto A = rand_A<float>(M, K);
+    tensor2D<bfloat16> An(M, K);
+    tensor2D<bfloat16> B(K, N);
+    tensor2D<float> C(M, N), gamma(1, K);
+    gamma = 1.0f;
+    NormA norm{avx512::NormType::rms, 1e-5f, &gamma(0, 0), nullptr};
+    Matmul<bfloat16, bfloat16> mm(true, false), mm0(true, false);
+    PP::BiasGeluStore<float, PP::NONE> pp(C);
+
+    timer.tag(__func__, "separate", M, K, N)(times, [&](){
+        avx512::norm(norm.type, An.view(), A.view(), norm.eps, norm.gamma, norm.beta);
+        mm0(An, B, 0, N, pp);
+    }, 2.0 * M * N * K);
+
+    timer.tag(__func__, "fused", M, K, N)(times, [&](){
+        mm(A.view(), norm, B, 0, N, pp);
+    }, 2.0 * M * N * K);
+}
+
+// multi-threaded prefill: every thread normalizing whole A in its Matmul vs. normalizing it once
+void perf_norm_a_omp(int M, int K, int N, int times = -1000) {
+    auto A = rand_A<float>(M, K);
+    tensor2D<bfloat16> B(K, N);
+    tensor2D<float> C(M, N), gamma(1, K);
+    tensor2D_blocked<bfloat16> An;
+    gamma = 1.0f;
+    NormA norm{avx512::NormType::rms, 1e-5f, &gamma(0, 0), nullptr};
+    PP::BiasGeluStore<float, PP::NONE> pp(C);
+    std::vector<std::shared_ptr<Matmul<bfloat16, bfloat16>>> mm(get_nthr());
+    for(auto & m : mm)
+        m.reset(new Matmul<bfloat16, bfloat16>(true, false));
+
+    timer.tag(__func__, "per-thread", M, K, N)(times, [&](){
+        #pragma omp parallel
+        {
+            int n0, n1;
+            splitter(N / 32, omp_get_num_threads(), omp_get_thread_num(), n0, n1);
+            if (n0 < n1)
+                (*mm[omp_get_thread_num()])(A.view(), norm, B, n0 * 32, n1 * 32, pp);
+        }
+    }, 2.0 * M * N * K);
+
+    timer.tag(__func__, "shared", M, K, N)(times, [&](){
+        functional::norm_bf16_blocked_omp(An, A.view(), norm);
+        matmul_omp(mm, An, B, pp);
+    }, 2.0 * M * N * K);
+}
+
+int main(int argc, const char *argv[]) {
+    timer.set_app(argv[0]);
+    std::cout << ANSIcolor("31") << "omp_get_max_threads() = " << omp_get_max_threads() << std::endl << ANSIcolor();
+
+    test_fp16_scalar();
+    for(auto transposeB : {false, true}) {
+        for(auto M : {1, 16, 17, 45, 100}) {
+            test_mixed_a<float>(M, 80, 100, transposeB);
+            test_mixed_a<float16>(M, 80, 100, transposeB);
+        }
+        test_mixed_a<float>(33, 20, 50, transposeB);     // K < 32
+        test_mixed_a<float>(300, 4096, 64, transposeB);  // several bands
+        test_mixed_a<float16>(300, 4096, 64, transposeB);
+        test_mixed_a<float>(70, 200, 300, transposeB, true);
+    }
+    test_mixed_a_omp<float>(100, 80, 1000);
+    test_mixed_a_omp<float16>(300, 4096, 300);
+    for(auto type : {avx512::NormType::layer, avx512::NormType::rms}) {
+        for(auto M : {1, 17, 45}) {
+            test_norm_a<float>(type, M, 80, 100, true);
+            test_norm_a<bfloat16>(type, M, 80, 100, false);
+        }
+        test_norm_a<float>(type, 33, 20, 50, true);         // K < 32
+        test_norm_a<float>(type, 300, 4096, 64, true);      // several bands
+        test_norm_a<bfloat16>(type, 70, 200, 300, true, true);
+        test_norm_a_omp(type, 100, 80, 1000);
+    }
+
+    perf_mixed_a<float>(1, 4096, 4096);
+    perf_mixed_a<float>(256, 4096, 1024);
+    perf_mixed_a<float>(1024, 4096, 1024);
+    perf_mixed_a<float16>(1024, 4096, 1024);
+    perf_mixed_a_omp(1024, 4096, 4096);
+    perf_norm_a(1, 4096, 4096);
+    perf_norm_a(1024, 4096, 1024);
+    perf_norm_a_omp(1024, 4096, 4096);
+    return 0;
+}
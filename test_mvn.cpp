@@ -14,6 +14,7 @@
 
 #include "misc.hpp"
 #include "mvn_avx2.hpp"
+#include "mvn_avx512.hpp"
 #include "tensor2D.hpp"
 #include "timeit.hpp"
 #include <omp.h>
@@ -90,6 +91,89 @@ int test_mvn() {
     return 0;
 }
 
+// avx512::norm vs. double-precision reference, fp32/bf16 in & out, with/without residual,
+// in_place: res_out aliases residual (as in a decoder layer updating its residual stream)
+template<typename TI, typename TO>
+void test_norm_avx512(avx512::NormType type, int M, int N, float offset, bool with_residual, bool in_place = false) {
+    float eps = 1e-5f;
+    tensor2D<TI> x(M, N), res(M, N), res_out(M, N);
+    tensor2D<TO> y(M, N);
+    tensor2D<float> gamma(1, N), beta(1, N);
+    for(int m = 0; m < M; m++)
+        for(int n = 0; n < N; n++) {
+            x(m, n) = offset + (rand() % 2000 - 1000) / 500.0f;
+            res(m, n) = (rand() % 2000 - 1000) / 500.0f;
+        }
+    for(int n = 0; n < N; n++) {
+        gamma(0, n) = (rand() % 2000) / 1000.0f;
+        beta(0, n) = (rand() % 2000 - 1000) / 1000.0f;
+    }
+    auto res0 = res.clone();
+    auto & out = in_place ? res : res_out;
+    avx512::norm(type, y.view(), x.view(), eps, &gamma(0, 0), &beta(0, 0),
+                 with_residual ? res.view() : tensor_view<TI>(),
+                 with_residual ? out.view() : tensor_view<TI>());
+
+    bool is_bf16 = std::is_same<TI, ov::bfloat16>::value || std::is_same<TO, ov::bfloat16>::value;
+    double maxdiff = 0;
+    for(int m = 0; m < M; m++) {
+        std::vector<double> v(N);
+        for(int n = 0; n < N; n++) {
+            float xr = float(x(m, n)) + (with_residual ? float(res0(m, n)) : 0.0f);
+            if (with_residual) {
+                // res_out is rounded to TI, and normalized from there
+                maxdiff = std::max(maxdiff, std::abs(double(out(m, n)) - double(TI(xr))));
+                xr = float(TI(xr));
+            }
+            v[n] = xr;
+        }
+        double mean = 0, var = 0;
+        if (type == avx512::NormType::layer) {
+            for(auto a : v) mean += a;
+            mean /= N;
+        }
+        for(auto a : v) var += (a - mean) * (a - mean);
+        double rstd = 1.0 / std::sqrt(var / N + eps);
+        for(int n = 0; n < N; n++) {
+            double ref = (v[n] - mean) * rstd * gamma(0, n) + beta(0, n);
+            maxdiff = std::max(maxdiff, std::abs(ref - double(y(m, n))) / std::max(1.0, std::abs(ref)));
+        }
+    }
+    bool ok = maxdiff < (is_bf16 ? 1e-2 : 1e-4);
+    std::cout << __func__ << "<" << TypeName<TI>::get() << "," << TypeName<TO>::get() << ">("
+              << (type == avx512::NormType::layer ? "layer" : "rms") << "," << M << "," << N << ",offset=" << offset
+              << ",residual=" << with_residual << (in_place ? ",in_place" : "") << ")  " << ANSIcolor(ok ? "1;32" : "1;31") << (ok ? "Match!" : "Mismatch!")
+              << ANSIcolor() << " maxdiff:" << maxdiff << std::endl;
+}
+
+// 3-pass AVX2 mvn vs. single-read AVX-512 LayerNorm/RMSNorm
+void perf_norm(int M, int N) {
+    tensor2D<float> x(M, N), y(M, N), res(M, N), scale(1, N), bias(1, N);
+    tensor2D<ov::bfloat16> yb(M, N);
+    x.fill_rnd();
+    res.fill_rnd();
+    scale.fill_rnd();
+    bias.fill_rnd();
+    double bytes = 8.0 * M * N;
+    benchmark.tag(__func__, M, N, "avx2_mvn")(-1000, [&](){
+        #pragma omp parallel for if (M > 1)
+        for(int m = 0; m < M; m++)
+            mvn_line_scale_bias(&x(m, 0), N, 1e-5f, true, &y(m, 0), &scale(0, 0), &bias(0, 0));
+    }, bytes);
+    benchmark.tag(__func__, M, N, "layer_f32")(-1000, [&](){
+        avx512::norm(avx512::NormType::layer, y.view(), x.view(), 1e-5f, &scale(0, 0), &bias(0, 0));
+    }, bytes);
+    benchmark.tag(__func__, M, N, "layer_bf16")(-1000, [&](){
+        avx512::norm(avx512::NormType::layer, yb.view(), x.view(), 1e-5f, &scale(0, 0), &bias(0, 0));
+    }, bytes);
+    benchmark.tag(__func__, M, N, "rms_bf16")(-1000, [&](){
+        avx512::norm(avx512::NormType::rms, yb.view(), x.view(), 1e-5f, &scale(0, 0));
+    }, bytes);
+    benchmark.tag(__func__, M, N, "rms_bf16_residual")(-1000, [&](){
+        avx512::norm(avx512::NormType::rms, yb.view(), x.view(), 1e-5f, &scale(0, 0), nullptr, res.view(), res.view());
+    }, bytes);
+}
+
 int main(int argc, const char *argv[]) {
     benchmark.set_app(argv[0]);
 
@@ -104,5 +188,22 @@ int main(int argc, const char *argv[]) {
     //test_all_bw(3);
     test_mvn();
 
+    using ov::bfloat16;
+    for(auto type : {avx512::NormType::layer, avx512::NormType::rms}) {
+        for(auto N : {1, 7, 16, 31, 33, 100, 4096}) {
+            test_norm_avx512<float, float>(type, 3, N, 0.0f, false);
+            test_norm_avx512<float, bfloat16>(type, 3, N, 0.0f, true);
+            test_norm_avx512<bfloat16, bfloat16>(type, 3, N, 0.0f, true);
+            test_norm_avx512<bfloat16, float>(type, 3, N, 0.0f, false);
+            test_norm_avx512<float, float>(type, 3, N, 0.0f, true, true);
+            test_norm_avx512<bfloat16, bfloat16>(type, 3, N, 0.0f, true, true);
+        }
+        // |mean| >> std: shifted sums keep the variance
+        test_norm_avx512<float, float>(type, 2, 4096, 1000.0f, false);
+        test_norm_avx512<float, bfloat16>(type, 300, 1000, 0.0f, true);
+    }
+    perf_norm(1, 4096);
+    perf_norm(1024, 4096);
+
     return 0;
 }
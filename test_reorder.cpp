@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <iostream>
+#include <cassert>
+#include <cstring>
+
+#include "tensor2D.hpp"
+#include "reorder.hpp"
+#include "timeit.hpp"
+
+#include <omp.h>
+
+timeit timer(
+    {
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "HW_CYCLES"},
+    }
+);
+
+template<typename T>
+tensor2D<T> Tr_ref(tensor2D<T> & A) {
+    tensor2D<T> ret(A.dims[1], A.dims[0]);
+    for(int c0=0; c0 < A.dims[0]; ++c0) {
+        for(int c1=0; c1 < A.dims[1]; ++c1) {
+            ret(c1, c0) = A(c0, c1);
+        }
+    }
+    return ret;
+}
+
+template<typename T>
+bool same_bits(tensor2D<T> & a, tensor2D<T> & b) {
+    if (a.dims[0] != b.dims[0] || a.dims[1] != b.dims[1]) return false;
+    for(int i = 0; i < a.dims[0]; i++)
+        if (memcmp(&a(i, 0), &b(i, 0), a.dims[1] * sizeof(T)))
+            return false;
+    return true;
+}
+
+template<typename T>
+void fill_seq(tensor2D<T> & a) {
+    for(int i = 0; i < a.dims[0]; i++)
+        for(int j = 0; j < a.dims[1]; j++) {
+            uint32_t v = i * 1315423911u + j * 2654435761u;
+            memcpy(&a(i, j), &v, sizeof(T));
+        }
+}
+
+template<typename T>
+void test_reorder_acc(int K, int N) {
+    constexpr int V = 4 / sizeof(T);
+    int KV = (K + V - 1) / V;
+    tensor2D<T> A(K, N);
+    fill_seq(A);
+    std::cout << __func__ << "<" << TypeName<T>::get() << ">(" << K << "," << N << ")  ";
+
+    // plain => transposed
+    auto AT = A.Tr();
+    auto AT0 = Tr_ref(A);
+    bool ok_tr = same_bits(AT, AT0);
+
+    // plain => vnni => plain
+    tensor2D<T> Av(KV, N * V);
+    tensor2D<T> A2(K, N);
+    reorder::convert(&Av[0], Av.stride, reorder::layout::vnni, &A[0], A.stride, reorder::layout::plain, K, N);
+    reorder::convert(&A2[0], A2.stride, reorder::layout::plain, &Av[0], Av.stride, reorder::layout::vnni, K, N);
+    bool ok_vnni = same_bits(A, A2);
+    // K tails in vnni layout must be zero
+    for(int n = 0; n < N && ok_vnni; n++)
+        for(int k = K; k < KV * V; k++)
+            if (Av(KV - 1, n * V + (k % V)) != T(0)) ok_vnni = false;
+
+    // transposed => vnni, should be identical with plain => vnni
+    tensor2D<T> Av2(KV, N * V);
+    reorder::convert(&Av2[0], Av2.stride, reorder::layout::vnni, &AT[0], AT.stride, reorder::layout::transposed, K, N);
+    bool ok_tvnni = same_bits(Av, Av2);
+
+    // vnni => transposed
+    tensor2D<T> AT2(N, KV * V);
+    reorder::convert(&AT2[0], AT2.stride, reorder::layout::transposed, &Av[0], Av.stride, reorder::layout::vnni, K, N);
+    AT2.dims[1] = K;
+    bool ok_vnnit = same_bits(AT2, AT0);
+
+    auto show = [](const char * name, bool ok) {
+        if (ok)
+            std::cout << ANSIcolor("1;32") << name << ":Match! " << ANSIcolor();
+        else
+            std::cout << ANSIcolor("1;31") << name << ":Mismatch! " << ANSIcolor();
+    };
+    show("Tr", ok_tr);
+    show("vnni", ok_vnni);
+    show("Tr2vnni", ok_tvnni);
+    show("vnni2Tr", ok_vnnit);
+    std::cout << std::endl;
+}
+
+template<typename T>
+void test_reorder_perf(int K, int N, int times = -100) {
+    tensor2D<T> A(K, N);
+    tensor2D<T> AT(N, K);
+    double bytes = double(K) * N * sizeof(T) * 2;
+    timer.tag(__func__, K, N, TypeName<T>::get(), "scalar")(times, [&](){
+        for(int c0=0; c0 < K; ++c0)
+            for(int c1=0; c1 < N; ++c1)
+                AT(c1, c0) = A(c0, c1);
+    }, bytes);
+    timer.tag(__func__, K, N, TypeName<T>::get(), "reorder")(times, [&](){
+        reorder::transpose(&AT[0], AT.stride, &A[0], A.stride, K, N);
+    }, bytes);
+}
+
+int main(int argc, const char *argv[]) {
+    timer.set_app(argv[0]);
+    std::cout << ANSIcolor("31") << "omp_get_max_threads() = " << omp_get_max_threads() << std::endl << ANSIcolor();
+
+    for (auto shape : std::vector<std::pair<int,int>>{{1, 1}, {16, 16}, {17, 33}, {64, 64}, {100, 75}, {259, 130}}) {
+        test_reorder_acc<float>(shape.first, shape.second);
+        test_reorder_acc<ov::bfloat16>(shape.first, shape.second);
+        test_reorder_acc<int8_t>(shape.first, shape.second);
+    }
+
+    test_reorder_perf<float>(1024, 1024);
+    test_reorder_perf<ov::bfloat16>(2048, 2048);
+    test_reorder_perf<int8_t>(2048, 2048);
+    return 0;
+}
@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <chrono>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cassert>
+#include <cstring>
+
+#include "kernels_amx.hpp"
+#include "safetensors.hpp"
+#include "tensor2D.hpp"
+
+#include <omp.h>
+
+static bool initAMX = initXTILE();
+
+using ov::bfloat16;
+
+// write tensors into a safetensors file (for test only)
+void save_safetensors(const char * path, std::vector<std::pair<std::string, tensor2D<bfloat16>*>> tensors) {
+    std::stringstream header;
+    size_t offset = 0;
+    header << "{\"__metadata__\":{\"format\":\"pt\"}";
+    for(auto & t : tensors) {
+        size_t bytes = t.second->dims[0] * t.second->dims[1] * sizeof(bfloat16);
+        header << ",\"" << t.first << "\":{\"dtype\":\"BF16\",\"shape\":[" << t.second->dims[0] << ", " << t.second->dims[1]
+               << "],\"data_offsets\":[" << offset << "," << offset + bytes << "]}";
+        offset += bytes;
+    }
+    header << "}";
+    auto hs = header.str();
+    uint64_t header_size = hs.size();
+    std::ofstream fw(path, std::ios::binary);
+    fw.write(reinterpret_cast<const char*>(&header_size), 8);
+    fw.write(hs.c_str(), hs.size());
+    for(auto & t : tensors) {
+        auto & w = *t.second;
+        for(int i = 0; i < w.dims[0]; i++)
+            fw.write(reinterpret_cast<const char*>(&w(i, 0)), w.dims[1] * sizeof(bfloat16));
+    }
+}
+
+// each OMP thread consumes its own N-panels of the lazily repacked weight
+void test_lazy_repack(safetensors & st, const char * name, bool transposeB, int M) {
+    auto B = st.get<bfloat16>(name);
+    int K = B.dims[transposeB ? 1 : 0];
+    int N = B.dims[transposeB ? 0 : 1];
+    tensor2D<bfloat16> A(M, K);
+    tensor2D<float> C(M, N);
+    tensor2D<float> C0(M, N);
+    std::cout << __func__ << "(" << name << ", M=" << M << ", K=" << K << ", N=" << N << ", transposeB=" << transposeB << ")  ";
+
+    tensor2D<bfloat16> Bplain = transposeB ? B.Tr() : B.clone();
+    C0 = 0;
+    matmul(A, Bplain, C0);
+
+    amx_kernel::LazyRepackedB<bfloat16> lazyB(B, transposeB);
+    amx_kernel::PP::BiasGeluStore<float, amx_kernel::PP::Steps::NONE> pp(C);
+    int work_amount = rndup(N, 32)/32;
+    auto t0 = std::chrono::high_resolution_clock::now();
+    #pragma omp parallel
+    {
+        int start, end;
+        splitter(work_amount, omp_get_num_threads(), omp_get_thread_num(), start, end);
+        int n0 = start*32;
+        int n1 = std::min(end*32, N);
+        if (n0 < n1) {
+            amx_kernel::Matmul<bfloat16, bfloat16> mm(true, transposeB);
+            mm(A, lazyB, n0, n1, pp);
+        }
+    }
+    auto t1 = std::chrono::high_resolution_clock::now();
+
+    if (C0 == C) {
+        std::cout << ANSIcolor("1;32") << "Match!" << ANSIcolor();
+    } else {
+        std::cout << ANSIcolor("1;31") << "Mismatch!" << ANSIcolor();
+    }
+    std::cout << "  first call (with lazy repack) " << std::chrono::duration<double, std::micro>(t1 - t0).count() << " us" << std::endl;
+}
+
+int main(int argc, const char *argv[]) {
+    std::cout << ANSIcolor("31") << "omp_get_max_threads() = " << omp_get_max_threads() << std::endl << ANSIcolor();
+    const char * path = argc > 1 ? argv[1] : "/tmp/test_safetensors.safetensors";
+
+    tensor2D<bfloat16> fc_weight(300, 160);     // torch Linear layout: [N, K]
+    tensor2D<bfloat16> proj(128, 96);           // [K, N]
+    save_safetensors(path, {{"fc.weight", &fc_weight}, {"proj", &proj}});
+
+    safetensors st(path);
+    for(auto & k : st.keys()) {
+        auto & e = st.info(k);
+        std::cout << "  " << k << " : " << e.dtype << " [";
+        for(auto d : e.shape) std::cout << d << ",";
+        std::cout << "]" << std::endl;
+    }
+    auto w = st.get<bfloat16>("fc.weight");
+    bool same = true;
+    for(int i = 0; i < w.dims[0]; i++)
+        if (memcmp(&w(i, 0), &fc_weight(i, 0), w.dims[1] * sizeof(bfloat16))) same = false;
+    std::cout << "zero-copy view: " << (same ? "Match!" : "Mismatch!") << " metadata format=" << st.metadata["format"] << std::endl;
+
+    test_lazy_repack(st, "fc.weight", true, 1);
+    test_lazy_repack(st, "fc.weight", true, 100);
+    test_lazy_repack(st, "proj", false, 33);
+    test_lazy_repack(st, "proj", false, 16);
+    return 0;
+}
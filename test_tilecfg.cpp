@@ -0,0 +1,143 @@
+// tilecfg_cache: many small Matmuls per token (heads) with & without the thread-local tile config cache
+//
+//   g++ -O2 -march=native -std=c++14 -fopenmp -I./include test_tilecfg.cpp -o test_tilecfg
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <iostream>
+#include <memory>
+
+#include "kernels_amx.hpp"
+#include "tensor2D.hpp"
+#include "timeit.hpp"
+
+#include <omp.h>
+
+timeit timer(
+    {
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "HW_CYCLES"},
+    }
+);
+
+static bool initAMX = initXTILE();
+
+using ov::bfloat16;
+using namespace amx_kernel;
+
+// H independent Matmuls of M x K x N (heads), on the calling thread
+struct Heads {
+    int M, K, N;
+    std::vector<tensor2D<bfloat16>> A, B;
+    std::vector<tensor2D<float>> C;
+    std::vector<std::shared_ptr<Matmul<bfloat16, bfloat16>>> mm;
+    Heads(int H, int M, int K, int N) : M(M), K(K), N(N), A(H), B(H), C(H), mm(H) {
+        for(int h = 0; h < H; h++) {
+            A[h].resize(M, K);
+            B[h].resize(K, N);
+            C[h].resize(M, N);
+            for(int i = 0; i < M * K; i++)
+                A[h][i] = (rand() % 200 - 100) / 100.0f;
+            for(int i = 0; i < K * N; i++)
+                B[h][i] = (rand() % 200 - 100) / 100.0f;
+            mm[h].reset(new Matmul<bfloat16, bfloat16>(true, false));
+        }
+    }
+    void operator()() {
+        for(size_t h = 0; h < mm.size(); h++) {
+            PP::BiasGeluStore<float, PP::NONE> pp(C[h]);
+            (*mm[h])(A[h], B[h], 0, N, pp);
+        }
+    }
+};
+
+// results must be bitwise the same with & without the cache, also when shapes (configs) alternate
+void test_tilecfg_cache() {
+    Heads h0(8, 4, 128, 64), h1(4, 16, 64, 96), h2(2, 37, 96, 64);
+    auto run = [&](bool enabled) {
+        tilecfg_cache::enabled() = enabled;
+        tilecfg_cache::get().flush();
+        tilecfg_cache::get().counters = tilecfg_cache::counters_t();
+        std::vector<tensor2D<float>> C;
+        for(int i = 0; i < 3; i++) {
+            h0(); h0(); h1(); h0(); h2(); h1();
+            for(auto * h : {&h0, &h1, &h2})
+                for(auto & c : h->C)
+                    C.push_back(c.clone());
+        }
+        return C;
+    };
+    auto C0 = run(false);
+    auto c0 = tilecfg_cache::get().counters;
+    auto C1 = run(true);
+    auto c1 = tilecfg_cache::get().counters;
+    tilecfg_cache::get().flush();
+
+    // bitwise & quiet (tensor2D::operator== prints a line per call)
+    auto same = [](const tensor2D<float> & a, const tensor2D<float> & b) {
+        if (a.dims[0] != b.dims[0] || a.dims[1] != b.dims[1])
+            return false;
+        for(int m = 0; m < a.dims[0]; m++)
+            if (memcmp(&a(m, 0), &b(m, 0), a.dims[1] * sizeof(float)) != 0)
+                return false;
+        return true;
+    };
+    bool ok = C0.size() == C1.size();
+    for(size_t i = 0; ok && i < C0.size(); i++)
+        ok = same(C0[i], C1[i]);
+    // uncached: every scope loads & releases; cached: only changes of shape load, nothing released
+    ok = ok && c0.loads_avoided == 0 && c0.releases == c0.loads && c1.loads + c1.loads_avoided == c0.loads &&
+         c1.loads_avoided > c1.loads && c1.releases == 0 && c1.releases_deferred == c0.releases;
+    std::cout << __func__ << "()  " << ANSIcolor(ok ? "1;32" : "1;31") << (ok ? "Match!" : "Mismatch!") << ANSIcolor()
+              << "  uncached " << c0 << " | cached " << c1 << std::endl;
+}
+
+// latency of H small Matmuls per token, per OpenMP thread (each has its own heads)
+void perf_tilecfg(int H, int M, int K, int N) {
+    std::vector<std::shared_ptr<Heads>> heads(get_nthr());
+    #pragma omp parallel
+    heads[omp_get_thread_num()].reset(new Heads(H, M, K, N));
+    std::cout << "# H=" << H << " M=" << M << " K=" << K << " N=" << N << std::endl;
+    for(auto enabled : {false, true}) {
+        tilecfg_cache::enabled() = enabled;
+        tilecfg_cache::flush_omp();
+        #pragma omp parallel
+        tilecfg_cache::get().counters = tilecfg_cache::counters_t();
+        timer.tag(__func__, enabled ? "cached" : "uncached", H, M, K, N)(-1000, [&](){
+            #pragma omp parallel
+            (*heads[omp_get_thread_num()])();
+        }, 2.0 * H * M * K * N);
+        std::cout << "  " << tilecfg_cache::sum_omp() << std::endl;
+    }
+    tilecfg_cache::flush_omp();
+}
+
+// cost of a tile config scope alone (as each Matmul call has), metric is scopes
+void perf_scope() {
+    for(auto enabled : {false, true}) {
+        tilecfg_cache::enabled() = enabled;
+        tilecfg_cache::get().flush();
+        timer.tag(__func__, enabled ? "cached" : "uncached")(-1000, [&](){
+            for(int i = 0; i < 1000; i++) {
+                tileconfig_t tfg(1, 0, 8, 16, 64);
+                _tile_zero(0);
+            }
+        }, 1000.0);
+    }
+    tilecfg_cache::get().flush();
+}
+
+int main(int argc, const char *argv[]) {
+    timer.set_app(argv[0]);
+    std::cout << ANSIcolor("31") << "omp_get_max_threads() = " << omp_get_max_threads() << std::endl << ANSIcolor();
+
+    test_tilecfg_cache();
+
+    perf_scope();
+
+    perf_tilecfg(32, 1, 128, 128);
+    perf_tilecfg(32, 4, 128, 128);
+    perf_tilecfg(8, 16, 64, 64);
+    return 0;
+}
@@ -0,0 +1,249 @@
+#pragma once
+
+// lossless compression of bf16 weights for the fc16m (M <= 16) AMX kernels: decoded weights are
+// bitwise the original ones, so results are the same as of uncompressed bf16 weights.
+//
+// the high byte of bf16 (sign + 7 exponent bits) of trained weights takes only a few values,
+// while the low byte (exponent LSB + mantissa) is close to random. so byte planes are split:
+//   low byte  : stored as is, 8 bits
+//   high byte : 4-bit index into a dictionary of the 15 most frequent high bytes of the panel,
+//               index 15 is an escape, whose high byte follows the tile as an exception
+// which is ~12 bits per weight (75%) plus exceptions, 1280 bytes per tile at worst.
+//
+// data of a tensor is one stream in the order the kernel consumes it:
+//   for each 32-column N-panel                    (N is zero-padded to multiple of 32, K must be multiple of 32)
+//     [32 bytes]     dictionary of high bytes      (entries 0~14, 15 unused)
+//     for each 32 rows along K
+//       [tile B0][tile B1], each 16 x (16 columns x 2 k-rows) as:
+//         [256 bytes]  indices : byte i holds element i in low nibble & element i + 256 in high nibble
+//         [512 bytes]  low bytes of the 512 elements
+//         [n bytes]    high bytes of the n escaped elements, in decoding order (rows 0,8,1,9,...,7,15)
+//   tiles are of variable size, so offsets of panels are kept for splitting panels among threads.
+//
+// decoding of a tile row is vpermb (dictionary lookup) + vpexpandb (exceptions) + zero-extend/or,
+// so AVX512_VBMI & AVX512_VBMI2 are required.
+
+#include <cmath>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+#include "misc.hpp"
+#include "tensor2D.hpp"
+#include "bf16.hpp"
+#include "matmul16m.hpp"
+#include <omp.h>
+
+namespace bf16z {
+
+struct CompressedWeight {
+    int K = 0;
+    int N = 0;
+    std::vector<size_t> offsets;    // of each panel in data, offsets[panels()] is the size
+    std::shared_ptr<uint8_t> data;
+
+    int panels() const {
+        return rndup(N, 32) / 32;
+    }
+    size_t size() const {
+        return offsets.empty() ? 0 : offsets.back();
+    }
+    const uint8_t * panel(int p) const {
+        return data.get() + offsets[p];
+    }
+};
+
+// W : K x N (or N x K if transposeW)
+inline CompressedWeight compress(tensor_view<ov::bfloat16> W, bool transposeW) {
+    CompressedWeight ret;
+    int K = W.dims[transposeW ? 1 : 0];
+    int N = W.dims[transposeW ? 0 : 1];
+    if (K % 32)
+        throw std::runtime_error("bf16z: K (" + std::to_string(K) + ") must be multiple of 32");
+    ret.K = K;
+    ret.N = N;
+    auto bits = [&](int k, int n) -> uint16_t {
+        if (n >= N) return 0;
+        auto v = transposeW ? W(n, k) : W(k, n);
+        return reinterpret_cast<uint16_t&>(v);
+    };
+
+    // panels are compressed in parallel into their own buffers, then concatenated
+    std::vector<std::vector<uint8_t>> panels(ret.panels());
+    #pragma omp parallel for
+    for(int p = 0; p < ret.panels(); p++) {
+        int n0 = p * 32;
+        auto & dst = panels[p];
+        uint32_t freq[256] = {0};
+        for(int k = 0; k < K; k++)
+            for(int n = 0; n < 32; n++)
+                freq[bits(k, n0 + n) >> 8]++;
+        uint8_t dict[32] = {0};
+        int code[256];
+        for(int c = 0; c < 256; c++)
+            code[c] = 15;
+        for(int j = 0; j < 15; j++) {
+            int best = 0;
+            for(int c = 1; c < 256; c++)
+                if (freq[c] > freq[best])
+                    best = c;
+            if (freq[best] == 0)
+                break;
+            dict[j] = static_cast<uint8_t>(best);
+            code[best] = j;
+            freq[best] = 0;
+        }
+        dst.insert(dst.end(), dict, dict + 32);
+
+        uint16_t e[512];
+        for(int k0 = 0; k0 < K; k0 += 32) {
+            for(int t = 0; t < 2; t++) {
+                // element i of bf16 tile: row i/32 is k-pair, (i%32)/2 is column & i%2 is k in pair
+                for(int i = 0; i < 512; i++)
+                    e[i] = bits(k0 + (i / 32) * 2 + (i & 1), n0 + t * 16 + (i % 32) / 2);
+                for(int i = 0; i < 256; i++)
+                    dst.push_back(static_cast<uint8_t>(code[e[i] >> 8] | (code[e[i + 256] >> 8] << 4)));
+                for(int i = 0; i < 512; i++)
+                    dst.push_back(static_cast<uint8_t>(e[i]));
+                for(int r = 0; r < 8; r++)
+                    for(int row : {r, r + 8})
+                        for(int i = row * 32; i < row * 32 + 32; i++)
+                            if (code[e[i] >> 8] == 15)
+                                dst.push_back(static_cast<uint8_t>(e[i] >> 8));
+            }
+        }
+    }
+
+    ret.offsets.resize(ret.panels() + 1);
+    ret.offsets[0] = 0;
+    for(int p = 0; p < ret.panels(); p++)
+        ret.offsets[p + 1] = ret.offsets[p] + panels[p].size();
+    // 64 bytes of padding: decoder of the last tile may read a few bytes ahead
+    auto * buff = reinterpret_cast<uint8_t*>(aligned_alloc(64, rndup(ret.size() + 64, 64)));
+    ret.data = std::shared_ptr<uint8_t>(buff, [](uint8_t * p) { free(p); });
+    #pragma omp parallel for
+    for(int p = 0; p < ret.panels(); p++)
+        memcpy(buff + ret.offsets[p], panels[p].data(), panels[p].size());
+    memset(buff + ret.size(), 0, 64);
+    return ret;
+}
+
+// scalar decode into K x N (for verification)
+inline tensor2D<ov::bfloat16> decompress(const CompressedWeight & W) {
+    tensor2D<ov::bfloat16> ret(W.K, W.N);
+    for(int p = 0; p < W.panels(); p++) {
+        auto * src = W.panel(p);
+        auto * dict = src;
+        src += 32;
+        for(int k0 = 0; k0 < W.K; k0 += 32) {
+            for(int t = 0; t < 2; t++) {
+                auto * idx = src;
+                auto * lo = src + 256;
+                auto * esc = src + 768;
+                uint16_t e[512];
+                for(int r = 0; r < 8; r++) {
+                    for(int row : {r, r + 8}) {
+                        for(int i = row * 32; i < row * 32 + 32; i++) {
+                            int c = i < 256 ? (idx[i] & 0xF) : (idx[i - 256] >> 4);
+                            int hi = c == 15 ? *esc++ : dict[c];
+                            e[i] = static_cast<uint16_t>((hi << 8) | lo[i]);
+                        }
+                    }
+                }
+                src = esc;
+                for(int i = 0; i < 512; i++) {
+                    int k = k0 + (i / 32) * 2 + (i & 1);
+                    int n = p * 32 + t * 16 + (i % 32) / 2;
+                    if (n < W.N)
+                        reinterpret_cast<uint16_t&>(ret(k, n)) = e[i];
+                }
+            }
+        }
+    }
+    return ret;
+}
+
+namespace functional {
+    // one row of 32 bf16: high bytes looked up by idx (32 x 4-bit in bytes), escaped ones expanded from esc
+    inline void decode_row(const uint8_t * lo, __m256i idx, __m256i dict, const uint8_t *& esc, ov::bfloat16 * dst) {
+        auto hi = _mm256_permutexvar_epi8(idx, dict);
+        auto escaped = _mm256_cmpeq_epi8_mask(idx, _mm256_set1_epi8(15));
+        hi = _mm256_mask_expandloadu_epi8(hi, escaped, esc);
+        esc += _mm_popcnt_u32(escaped);
+        auto w = _mm512_or_si512(_mm512_slli_epi16(_mm512_cvtepu8_epi16(hi), 8),
+                                 _mm512_cvtepu8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(lo))));
+        _mm512_store_si512(dst, w);
+    }
+
+    // decode one tile into bf16 tile (1KB), src is moved to the next tile
+    inline void decode_tile(const uint8_t *& src, ov::bfloat16 * dst, __m256i dict) {
+        auto * lo = src + 256;
+        auto * esc = src + 768;
+        auto nibble = _mm256_set1_epi8(0x0F);
+        for(int r = 0; r < 8; r++) {
+            auto x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + r * 32));
+            decode_row(lo + r * 32, _mm256_and_si256(x, nibble), dict, esc, dst + r * 32);
+            decode_row(lo + (r + 8) * 32, _mm256_and_si256(_mm256_srli_epi16(x, 4), nibble), dict, esc, dst + (r + 8) * 32);
+        }
+        src = esc;
+    }
+}
+
+// C[:, 32*p0 : 32*p1) = A * W for bf16 A of M <= 16 rows (K columns).
+// tiles are decoded 2 ahead by amx_kernel::matmul16m_pingpong(), as wpack::matmul16m does
+inline void matmul16m(tensor_view<ov::bfloat16> A, const CompressedWeight & W, tensor_view<float> C, int p0, int p1) {
+    int M = A.dims[0];
+    int K = W.K;
+    int N = W.N;
+    int KB = K / 32;
+    assert(M <= 16 && A.dims[1] == K);
+    if (p0 >= p1)
+        return;
+
+    // decoder walks the stream of panels [p0, p1) sequentially
+    auto * src = W.panel(p0);
+    int kb_next = 0;
+    __m256i dict;
+    auto decode_tile = [&](ov::bfloat16 * dst, int t) {
+        if (t == 0 && kb_next == 0) {
+            dict = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+            src += 32;
+        }
+        amx_kernel::prefetch_bytes<768, _MM_HINT_T1, 4096 * 16>(src);
+        functional::decode_tile(src, dst, dict);
+        if (t == 1 && ++kb_next == KB)
+            kb_next = 0;
+    };
+    amx_kernel::matmul16m_pingpong(A, p0, p1, decode_tile, [&](int p) {
+        amx_kernel::store_16m(M, C, p * 32, N);
+    });
+}
+
+// panels of W are split among OpenMP threads by compressed bytes, so each thread streams about
+// the same amount of memory
+inline void matmul16m(tensor_view<ov::bfloat16> A, const CompressedWeight & W, tensor_view<float> C) {
+    #pragma omp parallel
+    {
+        int nthr = omp_get_num_threads();
+        int ithr = omp_get_thread_num();
+        auto owner = [&](int p) {
+            return static_cast<int>(W.offsets[p] * nthr / W.size());
+        };
+        int p0 = 0, p1 = 0;
+        for(int p = 0; p < W.panels(); p++) {
+            if (owner(p) < ithr) p0 = p + 1;
+            if (owner(p) <= ithr) p1 = p + 1;
+        }
+        matmul16m(A, W, C, p0, p1);
+    }
+}
+
+}
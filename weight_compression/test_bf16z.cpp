@@ -0,0 +1,174 @@
+// bf16z lossless weights: round-trip, matmul16m vs. Matmul<bf16,bf16>, compression ratio & bandwidth
+//
+//   g++ -O2 -march=native -std=c++14 -fopenmp -I../include test_bf16z.cpp -o test_bf16z
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <iostream>
+#include <cmath>
+
+#include "kernels_amx.hpp"
+#include "timeit.hpp"
+#include "bf16z.hpp"
+
+timeit benchmark(
+    {
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "HW_CYCLES"},
+    }
+);
+
+static bool initAMX = initXTILE();
+
+using ov::bfloat16;
+
+// normal distribution (Box-Muller) of stddev sigma, like weights of trained LLMs
+tensor2D<bfloat16> randn_W(int rows, int cols, float sigma = 0.02f) {
+    tensor2D<bfloat16> W(rows, cols);
+    for(int i = 0; i < rows; i++) {
+        for(int j = 0; j < cols; j++) {
+            float u1 = (rand() + 1.0f) / (RAND_MAX + 2.0f);
+            float u2 = rand() / (RAND_MAX + 1.0f);
+            W(i, j) = sigma * std::sqrt(-2.0f * std::log(u1)) * std::cos(6.2831853f * u2);
+        }
+    }
+    return W;
+}
+
+bool same_bits(const bfloat16 & a, const bfloat16 & b) {
+    return memcmp(&a, &b, sizeof(bfloat16)) == 0;
+}
+
+// decoded weights & results must be bitwise the same as of the original bf16 weights
+void test_bf16z(int M, int K, int N, bool transposeW, bool special) {
+    auto W = randn_W(transposeW ? N : K, transposeW ? K : N);
+    if (special) {
+        // values escaping the dictionary: inf, nan, denormals, zeros of both signs, large ones
+        const uint16_t bits[] = {0x7F80, 0xFF80, 0x7FC1, 0x0001, 0x8070, 0x0000, 0x8000, 0x4B00, 0xC2F7};
+        for(int i = 0; i < W.dims[0]; i += 3)
+            for(int j = i % 5; j < W.dims[1]; j += 7)
+                reinterpret_cast<uint16_t&>(W(i, j)) = bits[(i + j) % 9];
+    }
+    auto Wz = bf16z::compress(W.view(), transposeW);
+    auto Wd = bf16z::decompress(Wz);
+    bool ok = true;
+    for(int k = 0; k < K; k++)
+        for(int n = 0; n < N; n++)
+            ok = ok && same_bits(Wd(k, n), transposeW ? W(n, k) : W(k, n));
+
+    if (!special) {
+        tensor2D<bfloat16> A(M, K);
+        tensor2D<float> C(M, N), C0(M, N);
+        for(int m = 0; m < M; m++)
+            for(int k = 0; k < K; k++)
+                A(m, k) = (rand() % 200 - 100) / 100.0f;
+        bf16z::matmul16m(A, Wz, C);
+        amx_kernel::Matmul<bfloat16, bfloat16> mm(true, transposeW);
+        amx_kernel::PP::BiasGeluStore<float, amx_kernel::PP::NONE> pp(C0);
+        mm(A, W, 0, N, pp);
+        ok = ok && C == C0;
+    }
+    std::cout << __func__ << "(" << M << "," << K << "," << N << ",transposeW=" << transposeW << ",special=" << special
+              << ") ratio=" << Wz.size() / (2.0 * K * rndup(N, 32)) << "  " << ANSIcolor(ok ? "1;32" : "1;31")
+              << (ok ? "Match!" : "Mismatch!") << ANSIcolor() << std::endl;
+}
+
+// single 32-column panel streamed through 4 C tiles (as unittest_* of test0.cpp & perf_dequant of
+// test_wpack.cpp), metric is bytes of the bf16 B, so bf16z is the effective bandwidth
+void perf_decode(int K) {
+    tileconfig_t tfg(1, 0, 8, 16, 64);
+    std::cout << "# K = " << K / 32 << "*32 = " << K << ", sizeof(B)=" << pretty_size(K * 32 * 2.0, "B") << std::endl;
+    tensor2D<bfloat16> B(K, 32);
+    auto Wz = bf16z::compress(randn_W(K + 32, 32).view(), false);    // decoder runs 2 tiles ahead
+    std::cout << "#   compressed " << pretty_size(Wz.size() * K / (K + 32.0), "B") << " ratio "
+              << Wz.size() / ((K + 32) * 64.0) << std::endl;
+    tensor2D<bfloat16> Bbuff(16 * 4, 32);
+    tensor2D<bfloat16> T(32, 32);
+    T = bfloat16(0.01f);
+    _tile_loadd(4, &T[0], 64);
+    _tile_loadd(5, &T[0], 64);
+
+    benchmark.tag(__func__, "bf16", K)(-1000, [&](){
+        auto * pB = &B[0];
+        for(int k = 0; k < K; k += 32) {
+            _tile_loadd(6, pB, 64); pB += 16 * 32;
+            amx_kernel::prefetch_bytes<1024, _MM_HINT_T1, 4096 * 16>(pB);
+            _tile_dpbf16ps(0, 4, 6);
+            _tile_dpbf16ps(1, 5, 6);
+            _tile_loadd(7, pB, 64); pB += 16 * 32;
+            amx_kernel::prefetch_bytes<1024, _MM_HINT_T1, 4096 * 16>(pB);
+            _tile_dpbf16ps(2, 4, 7);
+            _tile_dpbf16ps(3, 5, 7);
+        }
+    }, K * 64.0);
+
+    benchmark.tag(__func__, "bf16z", K)(-1000, [&](){
+        auto * src = Wz.panel(0);
+        auto dict = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+        src += 32;
+        auto * pB0 = &Bbuff(0, 0);
+        auto * pB1 = &Bbuff(32, 0);
+        bf16z::functional::decode_tile(src, pB1, dict);
+        bf16z::functional::decode_tile(src, pB1 + 16 * 32, dict);
+        for(int k = 0; k < K; k += 32) {
+            amx_kernel::prefetch_bytes<768, _MM_HINT_T1, 4096 * 16>(src);
+            bf16z::functional::decode_tile(src, pB0, dict);
+            _tile_loadd(6, pB1, 64);
+            _tile_dpbf16ps(0, 4, 6);
+            _tile_dpbf16ps(1, 5, 6);
+            amx_kernel::prefetch_bytes<768, _MM_HINT_T1, 4096 * 16>(src);
+            bf16z::functional::decode_tile(src, pB0 + 16 * 32, dict);
+            _tile_loadd(7, pB1 + 16 * 32, 64);
+            _tile_dpbf16ps(2, 4, 7);
+            _tile_dpbf16ps(3, 5, 7);
+            std::swap(pB0, pB1);
+        }
+    }, K * 64.0);
+}
+
+void perf_bf16z(int M, int K, int N) {
+    auto W = randn_W(N, K);
+    tensor2D<bfloat16> A(M, K);
+    tensor2D<float> C(M, N);
+    auto Wz = bf16z::compress(W.view(), true);
+    std::cout << "# M=" << M << " K=" << K << " N=" << N << " sizeof(W)=" << pretty_size(2.0 * K * N, "B")
+              << " compressed " << pretty_size(Wz.size(), "B") << std::endl;
+
+    std::vector<std::shared_ptr<amx_kernel::Matmul<bfloat16, bfloat16>>> mm(get_nthr());
+    for(auto & m : mm)
+        m.reset(new amx_kernel::Matmul<bfloat16, bfloat16>(true, true));
+    amx_kernel::PP::BiasGeluStore<float, amx_kernel::PP::NONE> pp(C);
+    benchmark.tag(__func__, "bf16", M, K, N)(-1000, [&](){
+        #pragma omp parallel
+        {
+            int n0, n1;
+            splitter(N / 32, omp_get_num_threads(), omp_get_thread_num(), n0, n1);
+            (*mm[omp_get_thread_num()])(A, W, n0 * 32, n1 * 32, pp);
+        }
+    }, 2.0 * K * N);
+
+    benchmark.tag(__func__, "bf16z", M, K, N)(-1000, [&](){
+        bf16z::matmul16m(A, Wz, C);
+    }, 2.0 * K * N);
+}
+
+int main(int argc, const char *argv[]) {
+    benchmark.set_app(argv[0]);
+    benchmark.set_unit("B/s");
+
+    for(auto transposeW : {false, true}) {
+        for(auto special : {false, true}) {
+            test_bf16z(1, 64, 32, transposeW, special);
+            test_bf16z(7, 128, 100, transposeW, special);
+            test_bf16z(16, 1024, 1000, transposeW, special);
+        }
+    }
+
+    perf_decode(16 * 32);
+    perf_decode(102400 * 32);
+
+    perf_bf16z(2, 4096, 4096);
+    perf_bf16z(2, 4096, 16384);
+    return 0;
+}
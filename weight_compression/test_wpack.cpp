@@ -0,0 +1,341 @@
+// wpack format: quantization error, matmul16m vs. reference, file round-trip & bandwidth
+//
+//   g++ -O2 -march=native -std=c++14 -fopenmp -I../include test_wpack.cpp -o test_wpack
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <iostream>
+#include <cmath>
+
+#include "kernels_amx.hpp"
+#include "timeit.hpp"
+#include "wpack.hpp"
+
+timeit benchmark(
+    {
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "HW_CYCLES"},
+    }
+);
+
+static bool initAMX = initXTILE();
+
+using ov::bfloat16;
+using wpack::WType;
+
+tensor2D<bfloat16> rand_W(int rows, int cols) {
+    tensor2D<bfloat16> W(rows, cols);
+    for(int i = 0; i < rows; i++)
+        for(int j = 0; j < cols; j++)
+            W(i, j) = (rand() % 2000 - 1000) / 1000.0f * (1 + j % 7);
+    return W;
+}
+
+void test_wpack(WType wtype, int group, int M, int K, int N, bool transposeW) {
+    auto W = rand_W(transposeW ? N : K, transposeW ? K : N);
+    auto w = [&](int k, int n) { return float(transposeW ? W(n, k) : W(k, n)); };
+    auto packed = wpack::pack(W.view(), transposeW, wtype, group);
+    auto Wq = wpack::dequantize(packed);
+
+    // rounding error is at most half of the step (group absmax / qmax),
+    // nf4 steps are non-uniform, the largest one is 0.31 of the column absmax (all K as a group)
+    // bf16 is exact for bf16 W
+    float qmax = wtype == WType::int8 ? 127.0f : 7.0f;
+    if (wpack::is_lut(wtype))
+        qmax = 1.0f / 0.31f;
+    if (wtype == WType::bf16)
+        qmax = INFINITY;
+    int errors = 0;
+    for(int n = 0; n < N; n++) {
+        for(int g0 = 0; g0 < K; g0 += group) {
+            float amax = 0;
+            for(int k = wpack::is_lut(wtype) ? 0 : g0; k < (wpack::is_lut(wtype) ? K : g0 + group); k++)
+                amax = std::max(amax, std::abs(w(k, n)));
+            for(int k = g0; k < g0 + group; k++)
+                if (std::abs(w(k, n) - Wq(k, n)) > amax / qmax * 0.501f)
+                    errors++;
+        }
+    }
+    if (wtype == WType::cb4)
+        errors = 0;     // learned codebook has no bound on the error of a single weight
+
+    tensor2D<bfloat16> A(M, K);
+    tensor2D<float> C(M, N), C0(M, N);
+    for(int m = 0; m < M; m++)
+        for(int k = 0; k < K; k++)
+            A(m, k) = (rand() % 200 - 100) / 100.0f;
+    wpack::matmul16m(A, packed, C);
+    for(int m = 0; m < M; m++)
+        for(int n = 0; n < N; n++) {
+            float sum = 0;
+            for(int k = 0; k < K; k++)
+                sum += float(A(m, k)) * (wpack::is_lut(wtype) ? Wq(k, n) : float(bfloat16(Wq(k, n))));
+            C0(m, n) = sum;
+        }
+    bool ok = errors == 0 && C.compare(C0, 1e-3f);
+    std::cout << __func__ << "(" << wpack::wtype_name(wtype) << ",g" << group << ",M=" << M << ",K=" << K
+              << ",N=" << N << ",transposeW=" << transposeW << ")  " << ANSIcolor(ok ? "1;32" : "1;31")
+              << (ok ? "Match!" : "Mismatch!") << ANSIcolor() << " quantization errors:" << errors << std::endl;
+}
+
+// codebook quantization error on normal distributed weights: learned codebook must not be worse than nf4
+void test_lut(int K, int N, int group) {
+    tensor2D<bfloat16> W(N, K);
+    for(int n = 0; n < N; n++)
+        for(int k = 0; k < K; k++) {
+            // Box-Muller, column scales differ
+            float u0 = (rand() + 1.0f) / (RAND_MAX + 2.0f), u1 = rand() / (RAND_MAX + 1.0f);
+            W(n, k) = std::sqrt(-2 * std::log(u0)) * std::cos(6.2831853f * u1) * (1 + n % 3);
+        }
+    double err[2];
+    WType types[2] = {WType::nf4, WType::cb4};
+    for(int i = 0; i < 2; i++) {
+        auto Wq = wpack::dequantize(wpack::pack(W.view(), true, types[i], group));
+        double e2 = 0, w2 = 0;
+        for(int n = 0; n < N; n++)
+            for(int k = 0; k < K; k++) {
+                double d = float(W(n, k)) - Wq(k, n);
+                e2 += d * d;
+                w2 += float(W(n, k)) * float(W(n, k));
+            }
+        err[i] = std::sqrt(e2 / w2);
+    }
+    bool ok = err[1] <= err[0] && err[0] < 0.15;
+    std::cout << __func__ << "(K=" << K << ",N=" << N << ",g" << group << ")  " << ANSIcolor(ok ? "1;32" : "1;31")
+              << (ok ? "Match!" : "Mismatch!") << ANSIcolor() << " relative RMS error nf4:" << err[0] << " cb4:" << err[1] << std::endl;
+}
+
+// W whose panels tolerate different quantization (relative RMS error of budget 0.02):
+//   panel p % 3 == 0 : multiples of 1/7, int4 is exact
+//   panel p % 3 == 1 : uniform in [-1, 1], int4 error is 0.07 & int8 one 0.004
+//   panel p % 3 == 2 : +-3.9 with an outlier of 1000 every 61 rows, int8 rounds all but outliers to 0 (0.03)
+tensor2D<bfloat16> rand_W_mixed(int N, int K) {
+    tensor2D<bfloat16> W(N, K);
+    for(int n = 0; n < N; n++) {
+        for(int k = 0; k < K; k++) {
+            switch(n / 32 % 3) {
+                case 0: W(n, k) = (rand() % 15 - 7) / 7.0f; break;
+                case 1: W(n, k) = (rand() % 2000 - 1000) / 1000.0f; break;
+                case 2: W(n, k) = k % 61 == n % 61 ? 1000.0f : rand() % 2 ? 3.9f : -3.9f; break;
+            }
+        }
+    }
+    return W;
+}
+
+// mixed: each panel is the cheapest type within error budget, results as of the per-panel dequantized W
+void test_mixed(int M, int K, int N, int group, float budget) {
+    auto W = rand_W_mixed(N, K);
+    auto packed = wpack::pack_mixed(W.view(), true, group, budget);
+    auto Wq = wpack::dequantize(packed);
+
+    int count[8] = {0};
+    int errors = 0;
+    bool ok = true;
+    for(int p = 0; p < packed.panels(); p++) {
+        auto wtype = packed.panel_type(p);
+        count[static_cast<int>(wtype)]++;
+        // types are of increasing size, so a panel of a type must be beyond budget of all cheaper ones
+        auto expected = p % 3 == 0 ? WType::int4 : p % 3 == 1 ? WType::int8 : WType::bf16;
+        ok &= wtype == expected;
+        double e2 = 0, w2 = 0;
+        for(int n = p * 32; n < std::min(N, p * 32 + 32); n++)
+            for(int k = 0; k < K; k++) {
+                double d = float(W(n, k)) - Wq(k, n);
+                e2 += d * d;
+                w2 += float(W(n, k)) * float(W(n, k));
+            }
+        if (e2 > w2 * budget * budget)
+            errors++;
+    }
+
+    tensor2D<bfloat16> A(M, K);
+    tensor2D<float> C(M, N), C0(M, N);
+    for(int m = 0; m < M; m++)
+        for(int k = 0; k < K; k++)
+            A(m, k) = (rand() % 200 - 100) / 100.0f;
+    wpack::matmul16m(A, packed, C);
+    float cmax = 0;
+    for(int m = 0; m < M; m++)
+        for(int n = 0; n < N; n++) {
+            float sum = 0;
+            for(int k = 0; k < K; k++)
+                sum += float(A(m, k)) * float(bfloat16(Wq(k, n)));
+            C0(m, n) = sum;
+            cmax = std::max(cmax, std::abs(sum));
+        }
+    // outliers of bf16 panels make C large, so the tolerance of summation order is relative
+    ok &= errors == 0 && C.compare(C0, cmax * 1e-5f + 1e-3f);
+    std::cout << __func__ << "(g" << group << ",M=" << M << ",K=" << K << ",N=" << N << ",budget=" << budget << ")  "
+              << ANSIcolor(ok ? "1;32" : "1;31") << (ok ? "Match!" : "Mismatch!") << ANSIcolor()
+              << " panels int4:" << count[static_cast<int>(WType::int4)] << " int8:" << count[static_cast<int>(WType::int8)]
+              << " bf16:" << count[static_cast<int>(WType::bf16)] << " errors:" << errors << std::endl;
+}
+
+// packed weights read back by mmap must give bitwise same results
+void test_file(const char * path) {
+    int M = 5, K = 256, N = 200;
+    auto W0 = rand_W(N, K);
+    auto W1 = rand_W(N, K);
+    auto p0 = wpack::pack(W0.view(), true, WType::int8, 64);
+    auto p1 = wpack::pack(W1.view(), true, WType::int4, 128);
+    auto p2 = wpack::pack(W1.view(), true, WType::cb4, 64);
+    auto p3 = wpack::pack_mixed(rand_W_mixed(N, K).view(), true, 64, 0.02f);
+    wpack::save(path, {{"layer0.weight", p0}, {"layer1.weight", p1}, {"layer2.weight", p2}, {"layer3.weight", p3}});
+
+    tensor2D<bfloat16> A(M, K);
+    tensor2D<float> C(M, N), C0(M, N);
+    bool ok = true;
+    {
+        wpack::file f(path);
+        wpack::PackedWeight * expected[] = {&p0, &p1, &p2, &p3};
+        for(auto name : {"layer0.weight", "layer1.weight", "layer2.weight", "layer3.weight"}) {
+            auto & w = f.get(name);
+            auto & w0 = *expected[name[5] - '0'];
+            ok &= w.K == K && w.N == N && w.wtype == w0.wtype && w.group == w0.group && w.size == w0.size;
+            ok &= reinterpret_cast<uintptr_t>(w.data) % 4096 == 0;
+            ok &= memcmp(w.data, w0.data, w.size) == 0;
+            wpack::matmul16m(A, w, C);
+            wpack::matmul16m(A, w0, C0);
+            ok &= C == C0;
+        }
+    }
+    unlink(path);
+    std::cout << __func__ << "(" << path << ")  " << ANSIcolor(ok ? "1;32" : "1;31") << (ok ? "Match!" : "Mismatch!")
+              << ANSIcolor() << std::endl;
+}
+
+// weight bandwidth of M<=16 FC: bf16 (AMX Matmul, prepacked) vs. int8/int4 wpack
+void perf_wpack(int M, int K, int N) {
+    auto W = rand_W(N, K);
+    tensor2D<bfloat16> A(M, K);
+    tensor2D<float> C(M, N);
+    std::cout << "# M=" << M << " K=" << K << " N=" << N << " sizeof(W)=" << pretty_size(2.0 * K * N, "B") << std::endl;
+
+    // one Matmul (packed B cache) per thread, each on its own N-panels
+    std::vector<std::shared_ptr<amx_kernel::Matmul<bfloat16, bfloat16>>> mm(get_nthr());
+    for(auto & m : mm)
+        m.reset(new amx_kernel::Matmul<bfloat16, bfloat16>(true, true));
+    amx_kernel::PP::BiasGeluStore<float, amx_kernel::PP::NONE> pp(C);
+    benchmark.tag(__func__, "bf16", M, K, N)(-1000, [&](){
+        #pragma omp parallel
+        {
+            int n0, n1;
+            splitter(N / 32, omp_get_num_threads(), omp_get_thread_num(), n0, n1);
+            (*mm[omp_get_thread_num()])(A, W, n0 * 32, n1 * 32, pp);
+        }
+    }, 2.0 * K * N);
+
+    for(auto wtype : {WType::int8, WType::int4, WType::nf4}) {
+        auto packed = wpack::pack(W.view(), true, wtype, 128);
+        benchmark.tag(__func__, wpack::wtype_name(wtype), "g128", M, K, N)(-1000, [&](){
+            wpack::matmul16m(A, packed, C);
+        }, packed.size);
+    }
+
+    // a third of panels of each type, types change every panel
+    auto mixed = wpack::pack_mixed(rand_W_mixed(N, K).view(), true, 128, 0.02f);
+    benchmark.tag(__func__, "mixed", "g128", M, K, N)(-1000, [&](){
+        wpack::matmul16m(A, mixed, C);
+    }, mixed.size);
+}
+
+// single 32-column panel streamed through 4 C tiles (as unittest_* of test0.cpp), dequantization
+// is 2 tiles ahead in a ping-pong buffer, metric is bytes of (compressed) B read
+void perf_dequant(int K) {
+    tileconfig_t tfg(1, 0, 8, 16, 64);
+    std::cout << "# K = " << K / 32 << "*32 = " << K << ", sizeof(B)=" << pretty_size(K * 32 * 2.0, "B") << std::endl;
+    tensor2D<bfloat16> B(K, 32);
+    tensor2D<int8_t> Bq(K + 32, 32);   // dequantizer runs 2 tiles ahead
+    tensor2D<bfloat16> Bbuff(16 * 4, 32);
+    for(int i = 0; i < (K + 32) * 32; i++)
+        Bq[i] = static_cast<int8_t>(rand());
+    auto s_one = _mm512_set1_ps(1.0f);
+    bfloat16 cb[16];
+    for(int j = 0; j < 16; j++)
+        cb[j] = wpack::nf4_levels[j];
+    auto table = _mm512_castsi256_si512(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(cb)));
+    tensor2D<bfloat16> T(32, 32);
+    T = bfloat16(0.01f);
+    _tile_loadd(4, &T[0], 64);
+    _tile_loadd(5, &T[0], 64);
+
+    benchmark.tag(__func__, "bf16", K)(-1000, [&](){
+        auto * pB = &B[0];
+        for(int k = 0; k < K; k += 32) {
+            _tile_loadd(6, pB, 64); pB += 16 * 32;
+            amx_kernel::prefetch_bytes<1024, _MM_HINT_T1, 4096 * 16>(pB);
+            _tile_dpbf16ps(0, 4, 6);
+            _tile_dpbf16ps(1, 5, 6);
+            _tile_loadd(7, pB, 64); pB += 16 * 32;
+            amx_kernel::prefetch_bytes<1024, _MM_HINT_T1, 4096 * 16>(pB);
+            _tile_dpbf16ps(2, 4, 7);
+            _tile_dpbf16ps(3, 5, 7);
+        }
+    }, K * 64.0);
+
+    // tbytes of B per tile dequantized by deq(src, dst)
+    auto pingpong = [&](const char * name, int tbytes, std::function<void(const int8_t*, bfloat16*)> deq) {
+        benchmark.tag("perf_dequant", name, K)(-1000, [&](){
+            auto * src = &Bq[0];
+            auto * pB0 = &Bbuff(0, 0);
+            auto * pB1 = &Bbuff(32, 0);
+            deq(src, pB1); src += tbytes;
+            deq(src, pB1 + 16 * 32); src += tbytes;
+            for(int k = 0; k < K; k += 32) {
+                amx_kernel::prefetch_bytes<512, _MM_HINT_T1, 4096 * 16>(src);
+                deq(src, pB0); src += tbytes;
+                _tile_loadd(6, pB1, 64);
+                _tile_dpbf16ps(0, 4, 6);
+                _tile_dpbf16ps(1, 5, 6);
+                deq(src, pB0 + 16 * 32); src += tbytes;
+                _tile_loadd(7, pB1 + 16 * 32, 64);
+                _tile_dpbf16ps(2, 4, 7);
+                _tile_dpbf16ps(3, 5, 7);
+                std::swap(pB0, pB1);
+            }
+        }, K / 32 * 2.0 * tbytes);
+    };
+    pingpong("int8", 512, [&](const int8_t * src, bfloat16 * dst) { wpack::functional::dequant_tile_i8(src, dst, s_one, s_one); });
+    pingpong("int4", 256, [&](const int8_t * src, bfloat16 * dst) { wpack::functional::dequant_tile_i4(src, dst, s_one, s_one); });
+    pingpong("lut4", 256, [&](const int8_t * src, bfloat16 * dst) { wpack::functional::dequant_tile_lut4(src, dst, table); });
+    // upper bound of 4-bit weights: 256 bytes copied into 1KB tile (fake_dequant_i4_16x32)
+    pingpong("fakeint4", 256, [&](const int8_t * src, bfloat16 * dst) {
+        for(int r = 0; r < 16; r += 4, src += 64, dst += 4 * 32) {
+            auto a = _mm512_load_si512(src);
+            _mm512_store_si512(dst, a);
+            _mm512_store_si512(dst + 32, a);
+            _mm512_store_si512(dst + 32 * 2, a);
+            _mm512_store_si512(dst + 32 * 3, a);
+        }
+    });
+}
+
+int main(int argc, const char *argv[]) {
+    benchmark.set_app(argv[0]);
+    benchmark.set_unit("B/s");
+
+    for(auto wtype : {WType::int8, WType::int4, WType::nf4, WType::cb4}) {
+        for(auto transposeW : {false, true}) {
+            test_wpack(wtype, 32, 1, 64, 32, transposeW);
+            test_wpack(wtype, 64, 7, 128, 100, transposeW);
+            test_wpack(wtype, 128, 16, 256, 200, transposeW);
+        }
+        test_wpack(wtype, 256, 2, 1024, 1000, true);
+    }
+    for(auto transposeW : {false, true})
+        test_wpack(WType::bf16, 32, 7, 128, 100, transposeW);
+    test_mixed(7, 256, 200, 64, 0.02f);
+    test_mixed(16, 1024, 1000, 128, 0.02f);
+    test_lut(1024, 256, 128);
+    test_lut(1024, 256, 32);
+    test_file("test_wpack.wpk");
+
+    perf_dequant(16 * 32);
+    perf_dequant(102400 * 32);
+
+    perf_wpack(2, 4096, 4096);
+    perf_wpack(2, 4096, 16384);
+    return 0;
+}
@@ -0,0 +1,107 @@
+// offline weight compression tool: 2D BF16/F32 tensors of a safetensors file are quantized
+// into int8/int4 (symmetric, per-group scales along K) or nf4/cb4 (per-group 16-entry codebook,
+// per-column scale) & repacked into wpack format (wpack.hpp). mixed[:budget] chooses int4, int8
+// or bf16 for each 32-column panel, the cheapest one of relative RMS error within budget (0.02)
+//
+//   g++ -O2 -march=native -std=c++14 -fopenmp -I../include wpack.cpp -o wpack
+//   ./wpack model.safetensors model.wpk [int8|int4|nf4|cb4|mixed[:budget]] [group_size] [name_filter ...]
+//
+// tensors are in PyTorch Linear layout [N, K] (out_features x in_features); tensors whose
+// name doesn't contain any of the filters (if given), or whose K isn't a multiple of
+// group_size, are skipped.
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <iostream>
+
+#include "safetensors.hpp"
+#include "wpack.hpp"
+
+using ov::bfloat16;
+
+template<typename TW>
+wpack::PackedWeight pack_and_check(const tensor2D<TW> & W, wpack::WType wtype, int group, float budget, double & max_rel_err) {
+    auto packed = wtype == wpack::WType::mixed ? wpack::pack_mixed(W.view(), true, group, budget)
+                                               : wpack::pack(W.view(), true, wtype, group);
+    auto Wq = wpack::dequantize(packed);
+    // error relative to the largest weight of the row (output channel)
+    max_rel_err = 0;
+    for(int n = 0; n < W.dims[0]; n++) {
+        double amax = 0, err = 0;
+        for(int k = 0; k < W.dims[1]; k++) {
+            amax = std::max(amax, std::abs(double(W(n, k))));
+            err = std::max(err, std::abs(double(W(n, k)) - Wq(k, n)));
+        }
+        if (amax > 0)
+            max_rel_err = std::max(max_rel_err, err / amax);
+    }
+    return packed;
+}
+
+int main(int argc, const char *argv[]) {
+    if (argc < 3) {
+        std::cout << "usage: " << argv[0] << " input.safetensors output.wpk [int8|int4|nf4|cb4|mixed[:budget]] [group_size] [name_filter ...]" << std::endl;
+        return 1;
+    }
+    std::string wtype_name = argc > 3 ? argv[3] : "int8";
+    float budget = 0.02f;
+    if (wtype_name.compare(0, 6, "mixed:") == 0) {
+        budget = atof(wtype_name.c_str() + 6);
+        wtype_name = "mixed";
+    }
+    int group = argc > 4 ? atoi(argv[4]) : 128;
+    std::vector<std::string> filters(argv + std::min(argc, 5), argv + argc);
+    auto wtype = wpack::WType::int8;
+    for(auto t : {wpack::WType::int8, wpack::WType::int4, wpack::WType::nf4, wpack::WType::cb4, wpack::WType::mixed})
+        if (wtype_name == wpack::wtype_name(t))
+            wtype = t;
+    if (wtype_name != wpack::wtype_name(wtype)) {
+        std::cout << "unknown weight type " << wtype_name << std::endl;
+        return 1;
+    }
+
+    try {
+        safetensors st(argv[1]);
+        std::vector<std::pair<std::string, wpack::PackedWeight>> tensors;
+        size_t bytes_in = 0, bytes_out = 0;
+        for(auto & name : st.keys()) {
+            auto & e = st.info(name);
+            bool selected = filters.empty();
+            for(auto & f : filters)
+                selected |= name.find(f) != std::string::npos;
+            if (!selected || e.shape.size() != 2 || (e.dtype != "BF16" && e.dtype != "F32") || e.shape[1] % group) {
+                std::cout << "  skip " << name << " (" << e.dtype << ")" << std::endl;
+                continue;
+            }
+            double err;
+            wpack::PackedWeight packed;
+            if (e.dtype == "BF16")
+                packed = pack_and_check(st.get<bfloat16>(name), wtype, group, budget, err);
+            else
+                packed = pack_and_check(st.get<float>(name), wtype, group, budget, err);
+            std::cout << "  pack " << name << " [" << packed.N << "," << packed.K << "] " << e.dtype << " -> "
+                      << wtype_name << "/g" << group << "  " << pretty_size(e.size, "B") << " -> " << pretty_size(packed.size, "B")
+                      << "  max error/row_max: " << err;
+            if (wtype == wpack::WType::mixed) {
+                int count[8] = {0};
+                for(int p = 0; p < packed.panels(); p++)
+                    count[static_cast<int>(packed.panel_type(p))]++;
+                std::cout << "  panels int4/int8/bf16: " << count[static_cast<int>(wpack::WType::int4)] << "/"
+                          << count[static_cast<int>(wpack::WType::int8)] << "/" << count[static_cast<int>(wpack::WType::bf16)];
+            }
+            std::cout << std::endl;
+            bytes_in += e.size;
+            bytes_out += packed.size;
+            tensors.emplace_back(name, packed);
+        }
+        wpack::save(argv[2], tensors);
+        std::cout << tensors.size() << " tensors, " << pretty_size(bytes_in, "B") << " -> " << pretty_size(bytes_out, "B")
+                  << " saved into " << argv[2] << std::endl;
+    } catch (std::exception & e) {
+        std::cout << ANSIcolor("1;31") << e.what() << ANSIcolor() << std::endl;
+        return 1;
+    }
+    return 0;
+}
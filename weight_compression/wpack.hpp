@@ -0,0 +1,740 @@
+#pragma once
+
+// packed file format of compressed weights (int8/int4 with per-group scales) for the fc16m
+// (M <= 16) AMX kernels. it's produced offline by wpack.cpp & mmapped at runtime, so model
+// loading does no quantization or repacking at all.
+//
+// file layout (little-endian):
+//   [64 bytes]        file_header   : magic "WPK1", version, number of tensors
+//   [128 bytes x T]   tensor_header : name, weight type, K, N, group size, offset & size of data
+//   [...]             tensor data, each starts at 4KB boundary
+//
+// data of a tensor is one stream in the order the kernel consumes it:
+//   for each 32-column N-panel                    (N is zero-padded to multiple of 32)
+//     for each group of G rows along K            (K must be multiple of G, G multiple of 32)
+//       [32 x fp32]  scales of the 32 columns      (w = q * scale, symmetric)
+//       for each 32 rows of the group
+//         [tile B0]  column 0~15 : 16 x (16 columns x 2 k-rows), int8 512 bytes / int4 256 bytes
+//         [tile B1]  column 16~31
+//   so any range of panels is a contiguous range of bytes (threads take disjoint ranges) and
+//   both HW & SW prefetchers see a single sequential stream per thread.
+//
+// int4 tile: byte i (0~255) holds element i of the bf16 tile in its low nibble and element
+// i + 256 in its high nibble, so 32 bytes are dequantized into bf16 tile rows r & r+8 with shifts.
+//
+// 4-bit codebook types (nf4, cb4) use the same int4 tiles, but a nibble is an index into a
+// 16-entry bf16 table, so dequantization is a table lookup (vpermw) with no int-to-float or
+// multiply. the table can't hold a per-column scale, which is applied to fp32 C instead:
+//   for each 32-column N-panel
+//     [32 x fp32]    scales of the 32 columns, max |w| of the column over all K
+//     for each group of G rows along K
+//       [16 x bf16]  codebook c of the group      (w = c[q] * scale)
+//       [tile B0][tile B1] for each 32 rows of the group
+//   nf4 : c is the NormalFloat4 levels (QLoRA) times max |w / scale| of the group
+//   cb4 : c is learned (1-D k-means over w / scale of the group, initialized by nf4)
+//
+// bf16 panels are tiles of the original weights (1KB each, no scales): [tile B0][tile B1] for each 32 rows.
+//
+// mixed tensors choose the type of each panel (bf16/int8/int4/...) offline, by an error budget:
+//   [panels x uint8]   type of each panel, padded to multiple of 64 bytes
+//   [panel 0][panel 1]...  each panel in the layout of its own type (same group size)
+// so panels are of different sizes, their offsets are indexed by PackedWeight::index().
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+#include "misc.hpp"
+#include "tensor2D.hpp"
+#include "bf16.hpp"
+#include "matmul16m.hpp"
+#include <omp.h>
+
+namespace wpack {
+
+enum class WType : uint32_t {
+    int8 = 1,
+    int4 = 2,
+    nf4 = 3,
+    cb4 = 4,
+    bf16 = 5,
+    mixed = 6,
+};
+
+inline bool is_lut(WType wtype) {
+    return wtype == WType::nf4 || wtype == WType::cb4;
+}
+
+// types of a panel (all but mixed)
+inline bool is_panel_type(WType wtype) {
+    return wtype == WType::int8 || wtype == WType::int4 || is_lut(wtype) || wtype == WType::bf16;
+}
+
+inline const char * wtype_name(WType wtype) {
+    switch(wtype) {
+        case WType::int8: return "int8";
+        case WType::int4: return "int4";
+        case WType::nf4: return "nf4";
+        case WType::cb4: return "cb4";
+        case WType::bf16: return "bf16";
+        case WType::mixed: return "mixed";
+    }
+    return "?";
+}
+
+// NormalFloat4 levels: quantiles of N(0, 1) normalized into [-1, 1], with an exact 0
+static const float nf4_levels[16] = {
+    -1.0f, -0.6961928009986877f, -0.5250730514526367f, -0.39491748809814453f,
+    -0.28444138169288635f, -0.18477343022823334f, -0.09105003625154495f, 0.0f,
+    0.07958029955625534f, 0.16093020141124725f, 0.24611230194568634f, 0.33791524171829224f,
+    0.44070982933044434f, 0.5626170039176941f, 0.7229568362236023f, 1.0f,
+};
+
+struct file_header {
+    char magic[4];
+    uint32_t version;
+    uint32_t count;
+    uint8_t reserved[52];
+};
+static_assert(sizeof(file_header) == 64, "file_header must be 64 bytes");
+
+struct tensor_header {
+    char name[80];
+    uint32_t wtype;
+    uint32_t K;
+    uint32_t N;
+    uint32_t group;
+    uint64_t offset;    // from the beginning of file
+    uint64_t size;
+    uint8_t reserved[16];
+};
+static_assert(sizeof(tensor_header) == 128, "tensor_header must be 128 bytes");
+
+// packed weight of K x N, non-owning view + keep-alive of the buffer or file mapping
+struct PackedWeight {
+    WType wtype = WType::int8;
+    int K = 0;
+    int N = 0;
+    int group = 0;
+    const int8_t * data = nullptr;
+    size_t size = 0;
+    std::shared_ptr<const void> owner;
+    std::vector<size_t> offsets;    // mixed only: of each panel from data, set by index()
+
+    static int tile_bytes(WType wtype) {
+        return wtype == WType::bf16 ? 1024 : wtype == WType::int8 ? 512 : 256;
+    }
+    // of uniform types, mixed ones depend on the types of panels
+    static size_t bytes(WType wtype, int K, int N, int group) {
+        size_t tiles = group / 32 * 2 * tile_bytes(wtype);
+        if (wtype == WType::bf16)
+            return static_cast<size_t>(rndup(N, 32) / 32) * (K / 32) * 2 * tile_bytes(wtype);
+        if (is_lut(wtype))
+            return static_cast<size_t>(rndup(N, 32) / 32) * (32 * sizeof(float) + (K / group) * (16 * sizeof(ov::bfloat16) + tiles));
+        return static_cast<size_t>(rndup(N, 32) / 32) * (K / group) * (32 * sizeof(float) + tiles);
+    }
+    static size_t table_bytes(int panels) {
+        return rndup(panels, 64);
+    }
+    int panels() const {
+        return rndup(N, 32) / 32;
+    }
+    size_t panel_bytes() const {
+        return size / panels();
+    }
+    WType panel_type(int p) const {
+        return wtype == WType::mixed ? static_cast<WType>(data[p]) : wtype;
+    }
+    const int8_t * panel(int p) const {
+        return wtype == WType::mixed ? data + offsets[p] : data + p * panel_bytes();
+    }
+    // offsets of panels of a mixed tensor from its type table, false if the table is invalid
+    bool index() {
+        if (wtype != WType::mixed)
+            return true;
+        offsets.resize(panels() + 1);
+        offsets[0] = table_bytes(panels());
+        if (size < offsets[0])
+            return false;
+        for(int p = 0; p < panels(); p++) {
+            if (!is_panel_type(panel_type(p)))
+                return false;
+            offsets[p + 1] = offsets[p] + bytes(panel_type(p), K, 32, group);
+        }
+        return offsets.back() == size;
+    }
+};
+
+// index of the nearest entry of a sorted 16-entry codebook (binary search over mid-points)
+inline int lut_nearest(const float * cb, float x) {
+    int j = 0;
+    for(int step = 8; step; step >>= 1)
+        if (x > (cb[j + step - 1] + cb[j + step]) * 0.5f)
+            j += step;
+    return j;
+}
+
+// sorted codebook of values v (|v| <= 1), entries are exact in bf16
+inline void lut_codebook(WType wtype, const std::vector<float> & v, float * cb) {
+    float amax = 0;
+    for(auto x : v)
+        amax = std::max(amax, std::abs(x));
+    for(int j = 0; j < 16; j++)
+        cb[j] = nf4_levels[j] * amax;
+    if (wtype == WType::cb4 && amax > 0) {
+        // Lloyd iterations, centroids of 1-D k-means stay sorted
+        for(int it = 0; it < 10; it++) {
+            double sum[16] = {0};
+            int cnt[16] = {0};
+            for(auto x : v) {
+                int j = lut_nearest(cb, x);
+                sum[j] += x;
+                cnt[j]++;
+            }
+            for(int j = 0; j < 16; j++)
+                if (cnt[j])
+                    cb[j] = static_cast<float>(sum[j] / cnt[j]);
+        }
+    }
+    for(int j = 0; j < 16; j++)
+        cb[j] = static_cast<float>(ov::bfloat16(cb[j]));
+    std::sort(cb, cb + 16);
+}
+
+// symmetric per-group quantization (or codebook types) & repack of W (K x N, or N x K if transposeW)
+template<typename TW>
+PackedWeight pack(tensor_view<TW> W, bool transposeW, WType wtype, int group) {
+    int K = W.dims[transposeW ? 1 : 0];
+    int N = W.dims[transposeW ? 0 : 1];
+    if (group <= 0 || group % 32 || K % group)
+        throw std::runtime_error("wpack: K (" + std::to_string(K) + ") must be multiple of group size (" +
+                                 std::to_string(group) + "), which must be multiple of 32");
+    if (!is_panel_type(wtype))
+        throw std::runtime_error(std::string("wpack: pack() can't produce ") + wtype_name(wtype) + ", see pack_mixed()");
+    PackedWeight ret;
+    ret.wtype = wtype;
+    ret.K = K;
+    ret.N = N;
+    ret.group = group;
+    ret.size = PackedWeight::bytes(wtype, K, N, group);
+    auto * buff = reinterpret_cast<int8_t*>(aligned_alloc(4096, rndup(ret.size, 4096)));
+    ret.owner = std::shared_ptr<int8_t>(buff, [](int8_t * p) { free(p); });
+    ret.data = buff;
+
+    auto w = [&](int k, int n) {
+        if (n >= N) return 0.0f;
+        return static_cast<float>(transposeW ? W(n, k) : W(k, n));
+    };
+    float qmax = wtype == WType::int8 ? 127.0f : 7.0f;
+    int tbytes = PackedWeight::tile_bytes(wtype);
+
+    // element i of bf16 tile: row i/32 is k-pair, (i%32)/2 is column & i%2 is k in pair
+    auto tile_k = [](int i) { return (i / 32) * 2 + (i & 1); };
+    auto tile_n = [](int t, int i) { return t * 16 + (i % 32) / 2; };
+    auto store_tile = [&](int8_t * dst, const int8_t * q) {
+        if (wtype == WType::int8) {
+            memcpy(dst, q, 512);
+        } else {
+            for(int i = 0; i < 256; i++)
+                dst[i] = static_cast<int8_t>((q[i] & 0xF) | (static_cast<uint8_t>(q[i + 256]) << 4));
+        }
+    };
+
+    #pragma omp parallel for
+    for(int p = 0; p < ret.panels(); p++) {
+        auto * dst = buff + p * ret.panel_bytes();
+        int n0 = p * 32;
+        int8_t q[512];
+        if (wtype == WType::bf16) {
+            auto * b = reinterpret_cast<ov::bfloat16*>(dst);
+            for(int k0 = 0; k0 < K; k0 += 32)
+                for(int t = 0; t < 2; t++)
+                    for(int i = 0; i < 512; i++)
+                        *b++ = w(k0 + tile_k(i), n0 + tile_n(t, i));
+            continue;
+        }
+        if (is_lut(wtype)) {
+            float scales[32], rscales[32];
+            for(int n = 0; n < 32; n++) {
+                float amax = 0;
+                for(int k = 0; k < K; k++)
+                    amax = std::max(amax, std::abs(w(k, n0 + n)));
+                scales[n] = amax;
+                rscales[n] = amax > 0 ? 1.0f / amax : 0.0f;
+            }
+            memcpy(dst, scales, sizeof(scales));
+            dst += sizeof(scales);
+            std::vector<float> u(group * 32);
+            for(int g0 = 0; g0 < K; g0 += group) {
+                for(int k = 0; k < group; k++)
+                    for(int n = 0; n < 32; n++)
+                        u[k * 32 + n] = w(g0 + k, n0 + n) * rscales[n];
+                float cb[16];
+                lut_codebook(wtype, u, cb);
+                for(int j = 0; j < 16; j++)
+                    reinterpret_cast<ov::bfloat16*>(dst)[j] = cb[j];
+                dst += 16 * sizeof(ov::bfloat16);
+                for(int k0 = 0; k0 < group; k0 += 32) {
+                    for(int t = 0; t < 2; t++, dst += tbytes) {
+                        for(int i = 0; i < 512; i++)
+                            q[i] = static_cast<int8_t>(lut_nearest(cb, u[(k0 + tile_k(i)) * 32 + tile_n(t, i)]));
+                        store_tile(dst, q);
+                    }
+                }
+            }
+            continue;
+        }
+        for(int g0 = 0; g0 < K; g0 += group) {
+            float scales[32], rscales[32];
+            for(int n = 0; n < 32; n++) {
+                float amax = 0;
+                for(int k = g0; k < g0 + group; k++)
+                    amax = std::max(amax, std::abs(w(k, n0 + n)));
+                scales[n] = amax / qmax;
+                rscales[n] = amax > 0 ? qmax / amax : 0.0f;
+            }
+            memcpy(dst, scales, sizeof(scales));
+            dst += sizeof(scales);
+            for(int k0 = g0; k0 < g0 + group; k0 += 32) {
+                for(int t = 0; t < 2; t++) {
+                    for(int i = 0; i < 512; i++) {
+                        int n = tile_n(t, i);
+                        float v = std::round(w(k0 + tile_k(i), n0 + n) * rscales[n]);
+                        q[i] = static_cast<int8_t>(std::min(std::max(v, -qmax), qmax));
+                    }
+                    store_tile(dst, q);
+                    dst += tbytes;
+                }
+            }
+        }
+    }
+    return ret;
+}
+
+// scalar unpack into fp32 K x N (for verification)
+inline tensor2D<float> dequantize(const PackedWeight & W) {
+    tensor2D<float> ret(W.K, W.N);
+    for(int p = 0; p < W.panels(); p++) {
+        auto * src = W.panel(p);
+        auto wtype = W.panel_type(p);
+        int tbytes = PackedWeight::tile_bytes(wtype);
+        if (wtype == WType::bf16) {
+            for(int k0 = 0; k0 < W.K; k0 += 32) {
+                for(int t = 0; t < 2; t++, src += tbytes) {
+                    for(int i = 0; i < 512; i++) {
+                        int k = k0 + (i / 32) * 2 + (i & 1);
+                        int n = p * 32 + t * 16 + (i % 32) / 2;
+                        if (n < W.N)
+                            ret(k, n) = static_cast<float>(reinterpret_cast<const ov::bfloat16*>(src)[i]);
+                    }
+                }
+            }
+            continue;
+        }
+        if (is_lut(wtype)) {
+            auto * scales = reinterpret_cast<const float*>(src);
+            src += 32 * sizeof(float);
+            for(int g0 = 0; g0 < W.K; g0 += W.group) {
+                auto * cb = reinterpret_cast<const ov::bfloat16*>(src);
+                src += 16 * sizeof(ov::bfloat16);
+                for(int k0 = g0; k0 < g0 + W.group; k0 += 32) {
+                    for(int t = 0; t < 2; t++, src += tbytes) {
+                        for(int i = 0; i < 512; i++) {
+                            auto b = static_cast<uint8_t>(src[i % 256]);
+                            int q = i < 256 ? (b & 0xF) : (b >> 4);
+                            int k = k0 + (i / 32) * 2 + (i & 1);
+                            int n = p * 32 + t * 16 + (i % 32) / 2;
+                            if (n < W.N)
+                                ret(k, n) = static_cast<float>(cb[q]) * scales[t * 16 + (i % 32) / 2];
+                        }
+                    }
+                }
+            }
+            continue;
+        }
+        for(int g0 = 0; g0 < W.K; g0 += W.group) {
+            auto * scales = reinterpret_cast<const float*>(src);
+            src += 32 * sizeof(float);
+            for(int k0 = g0; k0 < g0 + W.group; k0 += 32) {
+                for(int t = 0; t < 2; t++, src += tbytes) {
+                    for(int i = 0; i < 512; i++) {
+                        int q;
+                        if (wtype == WType::int8)
+                            q = src[i];
+                        else
+                            q = i < 256 ? static_cast<int8_t>(static_cast<uint8_t>(src[i]) << 4) >> 4 : src[i - 256] >> 4;
+                        int k = k0 + (i / 32) * 2 + (i & 1);
+                        int n = p * 32 + t * 16 + (i % 32) / 2;
+                        if (n < W.N)
+                            ret(k, n) = q * scales[t * 16 + (i % 32) / 2];
+                    }
+                }
+            }
+        }
+    }
+    return ret;
+}
+
+// each panel gets the first of candidates (cheapest first) whose relative RMS error on the panel
+// |W - Wq| / |W| is within budget, or bf16 if none is
+template<typename TW>
+PackedWeight pack_mixed(tensor_view<TW> W, bool transposeW, int group, float budget,
+                        std::vector<WType> candidates = {WType::int4, WType::int8}) {
+    int K = W.dims[transposeW ? 1 : 0];
+    int N = W.dims[transposeW ? 0 : 1];
+    int panels = rndup(N, 32) / 32;
+    std::vector<PackedWeight> packed(panels);
+    #pragma omp parallel for
+    for(int p = 0; p < panels; p++) {
+        int n0 = p * 32;
+        int n1 = std::min(N, n0 + 32);
+        auto Wp = transposeW ? W.Slice(n0, n1, 0, K) : W.Slice(0, K, n0, n1);
+        auto w = [&](int k, int n) {
+            return static_cast<float>(transposeW ? Wp(n, k) : Wp(k, n));
+        };
+        for(auto wtype : candidates) {
+            auto q = pack(Wp, transposeW, wtype, group);
+            auto Wq = dequantize(q);
+            double e2 = 0, w2 = 0;
+            for(int k = 0; k < K; k++) {
+                for(int n = 0; n < n1 - n0; n++) {
+                    double d = w(k, n) - Wq(k, n);
+                    e2 += d * d;
+                    w2 += static_cast<double>(w(k, n)) * w(k, n);
+                }
+            }
+            if (e2 <= w2 * budget * budget) {
+                packed[p] = q;
+                break;
+            }
+        }
+        if (!packed[p].data)
+            packed[p] = pack(Wp, transposeW, WType::bf16, group);
+    }
+
+    PackedWeight ret;
+    ret.wtype = WType::mixed;
+    ret.K = K;
+    ret.N = N;
+    ret.group = group;
+    ret.size = PackedWeight::table_bytes(panels);
+    for(auto & q : packed)
+        ret.size += q.size;
+    auto * buff = reinterpret_cast<int8_t*>(aligned_alloc(4096, rndup(ret.size, 4096)));
+    ret.owner = std::shared_ptr<int8_t>(buff, [](int8_t * p) { free(p); });
+    ret.data = buff;
+    memset(buff, 0, PackedWeight::table_bytes(panels));
+    for(int p = 0; p < panels; p++)
+        buff[p] = static_cast<int8_t>(packed[p].wtype);
+    ret.index();
+    for(int p = 0; p < panels; p++)
+        memcpy(buff + ret.offsets[p], packed[p].data, packed[p].size);
+    return ret;
+}
+
+// write packed weights into a file
+inline void save(const std::string & path, const std::vector<std::pair<std::string, PackedWeight>> & tensors) {
+    std::vector<tensor_header> headers(tensors.size());
+    uint64_t offset = rndup(sizeof(file_header) + sizeof(tensor_header) * tensors.size(), 4096);
+    for(size_t i = 0; i < tensors.size(); i++) {
+        auto & name = tensors[i].first;
+        auto & w = tensors[i].second;
+        if (name.size() >= sizeof(headers[i].name))
+            throw std::runtime_error("wpack: tensor name too long " + name);
+        memset(&headers[i], 0, sizeof(tensor_header));
+        memcpy(headers[i].name, name.c_str(), name.size());
+        headers[i].wtype = static_cast<uint32_t>(w.wtype);
+        headers[i].K = w.K;
+        headers[i].N = w.N;
+        headers[i].group = w.group;
+        headers[i].offset = offset;
+        headers[i].size = w.size;
+        offset = rndup(offset + w.size, 4096);
+    }
+    file_header fh;
+    memset(&fh, 0, sizeof(fh));
+    memcpy(fh.magic, "WPK1", 4);
+    fh.version = 1;
+    fh.count = tensors.size();
+
+    std::ofstream fw(path, std::ios::binary);
+    if (!fw)
+        throw std::runtime_error("wpack: cannot create " + path);
+    fw.write(reinterpret_cast<const char*>(&fh), sizeof(fh));
+    fw.write(reinterpret_cast<const char*>(headers.data()), sizeof(tensor_header) * headers.size());
+    for(size_t i = 0; i < tensors.size(); i++) {
+        fw.seekp(headers[i].offset);
+        fw.write(reinterpret_cast<const char*>(tensors[i].second.data), tensors[i].second.size);
+    }
+    // file size covers the padding of last tensor
+    fw.seekp(offset - 1);
+    fw.put(0);
+    if (!fw)
+        throw std::runtime_error("wpack: failed writing " + path);
+}
+
+// zero-copy loader: the file is mmapped (read-only, private), weights returned share the mapping
+struct file {
+    std::string path;
+    std::shared_ptr<uint8_t> mapping;
+    size_t length = 0;
+    std::map<std::string, PackedWeight> tensors;
+
+    file(const std::string & _path) : path(_path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("wpack: cannot open " + path);
+        struct stat st;
+        if (fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < sizeof(file_header)) {
+            close(fd);
+            throw std::runtime_error("wpack: invalid file " + path);
+        }
+        length = st.st_size;
+        void * p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED)
+            throw std::runtime_error("wpack: mmap failed " + path);
+        auto len = length;
+        mapping = std::shared_ptr<uint8_t>(reinterpret_cast<uint8_t*>(p), [len](uint8_t * p) { munmap(p, len); });
+
+        auto * fh = reinterpret_cast<const file_header*>(mapping.get());
+        if (memcmp(fh->magic, "WPK1", 4) != 0 || fh->version != 1)
+            throw std::runtime_error("wpack: bad magic/version " + path);
+        if (sizeof(file_header) + sizeof(tensor_header) * static_cast<size_t>(fh->count) > length)
+            throw std::runtime_error("wpack: tensor headers out of range " + path);
+        auto * th = reinterpret_cast<const tensor_header*>(mapping.get() + sizeof(file_header));
+        for(uint32_t i = 0; i < fh->count; i++, th++) {
+            std::string name(th->name, strnlen(th->name, sizeof(th->name)));
+            PackedWeight w;
+            w.wtype = static_cast<WType>(th->wtype);
+            w.K = th->K;
+            w.N = th->N;
+            w.group = th->group;
+            w.size = th->size;
+            if ((!is_panel_type(w.wtype) && w.wtype != WType::mixed) || w.group <= 0 || w.group % 32 || w.K % w.group ||
+                (w.wtype != WType::mixed && w.size != PackedWeight::bytes(w.wtype, w.K, w.N, w.group)) || th->offset % 4096 ||
+                th->offset + th->size > length)
+                throw std::runtime_error("wpack: bad tensor header " + name);
+            w.data = reinterpret_cast<const int8_t*>(mapping.get() + th->offset);
+            w.owner = mapping;
+            if (!w.index())
+                throw std::runtime_error("wpack: bad panel types of " + name);
+            tensors[name] = w;
+        }
+    }
+
+    bool has(const std::string & name) const {
+        return tensors.count(name) > 0;
+    }
+
+    const PackedWeight & get(const std::string & name) const {
+        auto it = tensors.find(name);
+        if (it == tensors.end())
+            throw std::runtime_error("wpack: tensor not found " + name);
+        return it->second;
+    }
+};
+
+namespace functional {
+    // scales of 16 columns duplicated for the (column, k-pair) elements of a bf16 tile row
+    inline void tile_scales(const float * scales, __m512 & lo, __m512 & hi) {
+        auto s = _mm512_loadu_ps(scales);
+        lo = _mm512_permutexvar_ps(_mm512_set_epi32(7, 7, 6, 6, 5, 5, 4, 4, 3, 3, 2, 2, 1, 1, 0, 0), s);
+        hi = _mm512_permutexvar_ps(_mm512_set_epi32(15, 15, 14, 14, 13, 13, 12, 12, 11, 11, 10, 10, 9, 9, 8, 8), s);
+    }
+
+    inline void store_bf16_row(ov::bfloat16 * dst, __m512i lo, __m512i hi, __m512 s_lo, __m512 s_hi) {
+        auto a = _mm512_mul_ps(_mm512_cvtepi32_ps(lo), s_lo);
+        auto b = _mm512_mul_ps(_mm512_cvtepi32_ps(hi), s_hi);
+        auto c = _mm512_cvtne2ps_pbh(b, a);
+        _mm512_store_si512(dst, reinterpret_cast<__m512i&>(c));
+    }
+
+    // dequantize one int8 tile (512 bytes) into bf16 tile (1KB)
+    inline void dequant_tile_i8(const int8_t * src, ov::bfloat16 * dst, __m512 s_lo, __m512 s_hi) {
+        for(int r = 0; r < 16; r++, src += 32, dst += 32) {
+            auto lo = _mm512_cvtepi8_epi32(_mm_load_si128(reinterpret_cast<const __m128i*>(src)));
+            auto hi = _mm512_cvtepi8_epi32(_mm_load_si128(reinterpret_cast<const __m128i*>(src + 16)));
+            store_bf16_row(dst, lo, hi, s_lo, s_hi);
+        }
+    }
+
+    // dequantize one int4 tile (256 bytes) into bf16 tile (1KB)
+    inline void dequant_tile_i4(const int8_t * src, ov::bfloat16 * dst, __m512 s_lo, __m512 s_hi) {
+        for(int r = 0; r < 8; r++, src += 32, dst += 32) {
+            auto x = _mm512_cvtepi8_epi16(_mm256_load_si256(reinterpret_cast<const __m256i*>(src)));
+            auto q0 = _mm512_srai_epi16(_mm512_slli_epi16(x, 12), 12);   // low nibbles : row r
+            auto q1 = _mm512_srai_epi16(_mm512_slli_epi16(x, 8), 12);    // high nibbles : row r + 8
+            store_bf16_row(dst, _mm512_cvtepi16_epi32(_mm512_castsi512_si256(q0)),
+                                _mm512_cvtepi16_epi32(_mm512_extracti64x4_epi64(q0, 1)), s_lo, s_hi);
+            store_bf16_row(dst + 8 * 32, _mm512_cvtepi16_epi32(_mm512_castsi512_si256(q1)),
+                                         _mm512_cvtepi16_epi32(_mm512_extracti64x4_epi64(q1, 1)), s_lo, s_hi);
+        }
+    }
+
+    // 4-bit indices of one int4 tile (256 bytes) looked up in the 16-entry bf16 codebook held in
+    // the low 16 words of table: zero-extend to words, mask/shift out the nibbles & vpermw, so
+    // each 32 bytes become bf16 tile rows r & r+8 with no int-to-float conversion or multiply
+    inline void dequant_tile_lut4(const int8_t * src, ov::bfloat16 * dst, __m512i table) {
+        auto nibble = _mm512_set1_epi16(0x0F);
+        for(int r = 0; r < 8; r++, src += 32, dst += 32) {
+            auto x = _mm512_cvtepu8_epi16(_mm256_load_si256(reinterpret_cast<const __m256i*>(src)));
+            _mm512_store_si512(dst, _mm512_permutexvar_epi16(_mm512_and_si512(x, nibble), table));
+            _mm512_store_si512(dst + 8 * 32, _mm512_permutexvar_epi16(_mm512_srli_epi16(x, 4), table));
+        }
+    }
+}
+
+// C[:, 32*p0 : 32*p1) = A * W for bf16 A of M <= 16 rows (K columns), panels [p0, p1) must be of wtype.
+// W is dequantized by amx_kernel::matmul16m_pingpong() (2 tiles ahead into a ping-pong buffer),
+// bf16 tiles are loaded from W directly
+template<WType wtype>
+void matmul16m(tensor_view<ov::bfloat16> A, const PackedWeight & W, tensor_view<float> C, int p0, int p1) {
+    constexpr int tbytes = wtype == WType::bf16 ? 1024 : wtype == WType::int8 ? 512 : 256;
+    constexpr int prefetch_ahead = 4096 * 16;
+    int M = A.dims[0];
+    int K = W.K;
+    int N = W.N;
+    int KB = K / 32;
+    int GB = W.group / 32;
+    assert(M <= 16 && A.dims[1] == K);
+    if (p0 >= p1)
+        return;
+    assert(W.panel_type(p0) == wtype && W.panel_type(p1 - 1) == wtype);
+
+    auto store = [&](int p) {
+        int n0 = p * 32;
+        if (is_lut(wtype)) {
+            static thread_local tensor2D<float> Cbuff(16, 32);
+            _tile_stored(0, &Cbuff(0, 0), Cbuff.stride);
+            _tile_stored(1, &Cbuff(0, 16), Cbuff.stride);
+            auto * scales = reinterpret_cast<const float*>(W.panel(p));
+            auto s0 = _mm512_loadu_ps(scales);
+            auto s1 = _mm512_loadu_ps(scales + 16);
+            int valid_n = std::min(32, N - n0);
+            auto k0 = _cvtu32_mask16(valid_n >= 16 ? 0xFFFF : (1u << valid_n) - 1);
+            auto k1 = _cvtu32_mask16(valid_n >= 32 ? 0xFFFF : valid_n > 16 ? (1u << (valid_n - 16)) - 1 : 0);
+            for(int m = 0; m < M; m++) {
+                _mm512_mask_storeu_ps(&C(m, n0), k0, _mm512_mul_ps(_mm512_loadu_ps(&Cbuff(m, 0)), s0));
+                _mm512_mask_storeu_ps(&C(m, n0 + 16), k1, _mm512_mul_ps(_mm512_loadu_ps(&Cbuff(m, 16)), s1));
+            }
+        } else {
+            amx_kernel::store_16m(M, C, n0, N);
+        }
+    };
+
+    if (wtype == WType::bf16) {
+        // C: 0,1  A: 2  B: 3,4
+        tileconfig_t tfg(1, 0, {M, M, M, 16, 16}, 64);
+        auto * pB = reinterpret_cast<const ov::bfloat16*>(W.panel(p0));
+        for(int p = p0; p < p1; p++) {
+            _tile_zero(0);
+            _tile_zero(1);
+            for(int kb = 0; kb < KB; kb++) {
+                _tile_loadd(2, &A(0, kb * 32), A.stride);
+                amx_kernel::prefetch_bytes<2 * tbytes, _MM_HINT_T1, prefetch_ahead>(pB);
+                _tile_loadd(3, pB, 64);
+                _tile_loadd(4, pB + 16 * 32, 64);
+                pB += 2 * 16 * 32;
+                _tile_dpbf16ps(0, 2, 3);
+                _tile_dpbf16ps(1, 2, 4);
+            }
+            store(p);
+        }
+        return;
+    }
+
+    // dequantizer walks the stream of panels [p0, p1) sequentially
+    auto * src = W.panel(p0);
+    int kb_next = 0;
+    __m512 s0_lo, s0_hi, s1_lo, s1_hi;
+    __m512i table;
+    auto dequant_tile = [&](ov::bfloat16 * dst, int t) {
+        if (t == 0 && kb_next % GB == 0) {
+            if (is_lut(wtype)) {
+                // column scales at the panel head are applied to C
+                if (kb_next == 0)
+                    src += 32 * sizeof(float);
+                table = _mm512_castsi256_si512(_mm256_load_si256(reinterpret_cast<const __m256i*>(src)));
+                src += 16 * sizeof(ov::bfloat16);
+            } else {
+                auto * scales = reinterpret_cast<const float*>(src);
+                functional::tile_scales(scales, s0_lo, s0_hi);
+                functional::tile_scales(scales + 16, s1_lo, s1_hi);
+                src += 32 * sizeof(float);
+            }
+        }
+        amx_kernel::prefetch_bytes<tbytes, _MM_HINT_T1, prefetch_ahead>(src);
+        if (wtype == WType::int8)
+            functional::dequant_tile_i8(src, dst, t ? s1_lo : s0_lo, t ? s1_hi : s0_hi);
+        else if (is_lut(wtype))
+            functional::dequant_tile_lut4(src, dst, table);
+        else
+            functional::dequant_tile_i4(src, dst, t ? s1_lo : s0_lo, t ? s1_hi : s0_hi);
+        src += tbytes;
+        if (t == 1 && ++kb_next == KB)
+            kb_next = 0;
+    };
+    amx_kernel::matmul16m_pingpong(A, p0, p1, dequant_tile, store);
+}
+
+// panels [p0, p1) of any types, each run of panels of the same type is one stream of the kernel of that type
+inline void matmul16m(tensor_view<ov::bfloat16> A, const PackedWeight & W, tensor_view<float> C, int p0, int p1) {
+    for(int p = p0; p < p1;) {
+        auto wtype = W.panel_type(p);
+        int q = p + 1;
+        while(q < p1 && W.panel_type(q) == wtype)
+            q++;
+        switch(wtype) {
+            case WType::int8: matmul16m<WType::int8>(A, W, C, p, q); break;
+            case WType::int4: matmul16m<WType::int4>(A, W, C, p, q); break;
+            case WType::nf4: matmul16m<WType::nf4>(A, W, C, p, q); break;
+            case WType::cb4: matmul16m<WType::cb4>(A, W, C, p, q); break;
+            case WType::bf16: matmul16m<WType::bf16>(A, W, C, p, q); break;
+            case WType::mixed: break;
+        }
+        p = q;
+    }
+}
+
+// panels of W are split among OpenMP threads, each thread streams its own contiguous bytes.
+// panels of mixed tensors are split by bytes, so each thread streams about the same amount
+inline void matmul16m(tensor_view<ov::bfloat16> A, const PackedWeight & W, tensor_view<float> C) {
+    #pragma omp parallel
+    {
+        int nthr = omp_get_num_threads();
+        int ithr = omp_get_thread_num();
+        int p0, p1;
+        if (W.wtype == WType::mixed) {
+            auto owner = [&](int p) {
+                return static_cast<int>((W.offsets[p] + W.offsets[p + 1]) / 2 * nthr / W.size);
+            };
+            p0 = p1 = 0;
+            for(int p = 0; p < W.panels(); p++) {
+                if (owner(p) < ithr) p0 = p + 1;
+                if (owner(p) <= ithr) p1 = p + 1;
+            }
+        } else {
+            splitter(W.panels(), nthr, ithr, p0, p1);
+        }
+        matmul16m(A, W, C, p0, p1);
+    }
+}
+
+}